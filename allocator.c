@@ -0,0 +1,466 @@
+#include "allocator.h"
+#include "bench.h"
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static uint32_t allocator_order(VkDeviceSize size) {
+    uint32_t order = 0;
+    while (((VkDeviceSize)ALLOCATOR_MIN_ALLOCATION_SIZE << order) < size)
+        order++;
+    return order;
+}
+
+void allocator_create(vulkan_t *vulkan, allocator_t *allocator) {
+    *allocator = (allocator_t){0};
+    vulkan->vkGetPhysicalDeviceMemoryProperties(vulkan->physical_device, &allocator->memory_properties);
+    allocator->buffer_image_granularity = vulkan->device_properties.limits.bufferImageGranularity;
+    allocator->max_memory_allocation_count = vulkan->device_properties.limits.maxMemoryAllocationCount;
+
+    for (uint32_t i = 0; i < allocator->memory_properties.memoryTypeCount; i++) {
+        uint32_t heap_index = allocator->memory_properties.memoryTypes[i].heapIndex;
+        VkDeviceSize heap_size = allocator->memory_properties.memoryHeaps[heap_index].size;
+        VkDeviceSize block_size = heap_size <= ALLOCATOR_SMALL_HEAP_SIZE ? heap_size / 8 : ALLOCATOR_LARGE_HEAP_BLOCK_SIZE;
+
+        // buddy blocks must be a power of two multiple of the smallest allocation
+        uint32_t levels = allocator_order(block_size);
+        if (levels > 0 && ((VkDeviceSize)ALLOCATOR_MIN_ALLOCATION_SIZE << levels) > block_size)
+            levels--;
+
+        for (uint32_t j = 0; j < ALLOCATOR_RESOURCE_COUNT; j++) {
+            allocator->pools[i][j].levels = levels;
+            allocator->pools[i][j].block_size = (VkDeviceSize)ALLOCATOR_MIN_ALLOCATION_SIZE << levels;
+        }
+    }
+}
+
+bool allocator_find_memory_type(allocator_t *allocator, uint32_t memory_type_bits, VkMemoryPropertyFlags required_flags,
+                                VkMemoryPropertyFlags preferred_flags, uint32_t *memory_type_index) {
+    VkMemoryPropertyFlags desired_flags[] = {required_flags | preferred_flags, required_flags};
+    for (uint32_t i = 0; i < 2; i++) {
+        for (uint32_t j = 0; j < allocator->memory_properties.memoryTypeCount; j++) {
+            VkMemoryPropertyFlags flags = allocator->memory_properties.memoryTypes[j].propertyFlags;
+            if ((memory_type_bits & (1u << j)) && (flags & desired_flags[i]) == desired_flags[i]) {
+                *memory_type_index = j;
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+static VkResult allocator_allocate_device_memory(vulkan_t *vulkan, allocator_t *allocator, uint32_t memory_type_index,
+                                                 VkDeviceSize size, VkDeviceMemory *memory, void **mapped) {
+    if (allocator->device_memory_count >= allocator->max_memory_allocation_count)
+        return VK_ERROR_TOO_MANY_OBJECTS;
+
+    VkMemoryAllocateInfo memory_allocate_info = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+        .allocationSize = size,
+        .memoryTypeIndex = memory_type_index,
+    };
+
+    VkResult result = vulkan->vkAllocateMemory(vulkan->logical_device, &memory_allocate_info, vulkan->allocation_callbacks,
+                                               memory);
+    if (result != VK_SUCCESS)
+        return result;
+
+    // host-visible memory stays mapped for its whole lifetime
+    *mapped = NULL;
+    if (allocator->memory_properties.memoryTypes[memory_type_index].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+        result = vulkan->vkMapMemory(vulkan->logical_device, *memory, 0, VK_WHOLE_SIZE, 0, mapped);
+        assert(result == VK_SUCCESS);
+    }
+
+    allocator->device_memory_count++;
+    allocator->stats.bytes_reserved += size;
+    return VK_SUCCESS;
+}
+
+static void allocator_free_device_memory(vulkan_t *vulkan, allocator_t *allocator, VkDeviceMemory memory, VkDeviceSize size) {
+    vulkan->vkFreeMemory(vulkan->logical_device, memory, vulkan->allocation_callbacks);
+    allocator->device_memory_count--;
+    allocator->stats.bytes_reserved -= size;
+}
+
+static VkResult allocator_create_block(vulkan_t *vulkan, allocator_t *allocator, allocator_pool_t *pool,
+                                       uint32_t memory_type_index, uint32_t *block_index) {
+    VkDeviceMemory memory = VK_NULL_HANDLE;
+    void *mapped = NULL;
+    VkResult result = allocator_allocate_device_memory(vulkan, allocator, memory_type_index, pool->block_size, &memory, &mapped);
+    if (result != VK_SUCCESS)
+        return result;
+
+    uint32_t index = pool->blocks_count;
+    for (uint32_t i = 0; i < pool->blocks_count; i++) {
+        if (pool->blocks[i].memory == VK_NULL_HANDLE) {
+            index = i;
+            break;
+        }
+    }
+    if (index == pool->blocks_count) {
+        if (pool->blocks_count == pool->blocks_capacity) {
+            uint32_t grown_capacity = pool->blocks_capacity ? pool->blocks_capacity * 2 : 4;
+            pool->blocks = (allocator_block_t *)arena_reallocate(&allocator->arena, pool->blocks,
+                                                                 sizeof(allocator_block_t) * pool->blocks_capacity,
+                                                                 sizeof(allocator_block_t) * grown_capacity);
+            pool->blocks_capacity = grown_capacity;
+        }
+        pool->blocks[pool->blocks_count++] = (allocator_block_t){0};
+    }
+
+    allocator_block_t *block = &pool->blocks[index];
+    uint8_t *longest = block->longest;
+    if (longest == NULL)
+        longest = (uint8_t *)arena_allocate(&allocator->arena, (2u << pool->levels) - 1);
+    *block = (allocator_block_t){.memory = memory, .mapped = mapped, .longest = longest};
+    for (uint32_t depth = 0; depth <= pool->levels; depth++)
+        memset(&block->longest[(1u << depth) - 1], pool->levels - depth + 1, 1u << depth);
+
+    allocator->stats.blocks_count++;
+    *block_index = index;
+    return VK_SUCCESS;
+}
+
+static void allocator_destroy_block(vulkan_t *vulkan, allocator_t *allocator, allocator_pool_t *pool, allocator_block_t *block) {
+    allocator_free_device_memory(vulkan, allocator, block->memory, pool->block_size);
+    *block = (allocator_block_t){.longest = block->longest};
+    allocator->stats.blocks_count--;
+}
+
+// walks from a changed node to the root, merging buddies that are both fully free again
+static void allocator_block_propagate(allocator_block_t *block, uint32_t node, uint32_t order) {
+    while (node > 0) {
+        node = (node - 1) / 2;
+        order++;
+        uint8_t left = block->longest[2 * node + 1];
+        uint8_t right = block->longest[2 * node + 2];
+        if (left == order && right == order)
+            block->longest[node] = order + 1;
+        else
+            block->longest[node] = left > right ? left : right;
+    }
+}
+
+static uint32_t allocator_block_allocate(allocator_pool_t *pool, allocator_block_t *block, uint32_t order,
+                                         VkDeviceSize *offset) {
+    uint32_t node = 0;
+    uint32_t depth = pool->levels - order;
+    for (uint32_t i = 0; i < depth; i++) {
+        uint32_t left = 2 * node + 1;
+        node = block->longest[left] > order ? left : left + 1;
+    }
+
+    block->longest[node] = 0;
+    allocator_block_propagate(block, node, order);
+
+    *offset = (VkDeviceSize)(node + 1 - (1u << depth)) * ((VkDeviceSize)ALLOCATOR_MIN_ALLOCATION_SIZE << order);
+    return node;
+}
+
+static allocator_pool_t *allocator_pool(allocator_t *allocator, uint32_t memory_type_index, allocator_resource_t resource) {
+    // buddy offsets are multiples of the smallest allocation, so a granularity below that can never be violated
+    if (allocator->buffer_image_granularity <= ALLOCATOR_MIN_ALLOCATION_SIZE)
+        resource = ALLOCATOR_RESOURCE_LINEAR;
+    return &allocator->pools[memory_type_index][resource];
+}
+
+VkResult allocator_allocate(vulkan_t *vulkan, allocator_t *allocator, const VkMemoryRequirements *memory_requirements,
+                            VkMemoryPropertyFlags required_flags, VkMemoryPropertyFlags preferred_flags,
+                            allocator_resource_t resource, allocation_t *allocation) {
+    uint32_t memory_type_index;
+    if (!allocator_find_memory_type(allocator, memory_requirements->memoryTypeBits, required_flags, preferred_flags,
+                                    &memory_type_index))
+        return VK_ERROR_FEATURE_NOT_PRESENT;
+
+    *allocation = (allocation_t){
+        .size = memory_requirements->size,
+        .memory_type_index = memory_type_index,
+        .resource = resource,
+    };
+
+    VkDeviceSize size = memory_requirements->size;
+    if (size < memory_requirements->alignment)
+        size = memory_requirements->alignment;
+
+    allocator_pool_t *pool = allocator_pool(allocator, memory_type_index, resource);
+    if (size > pool->block_size / 2) {
+        VkResult result = allocator_allocate_device_memory(vulkan, allocator, memory_type_index, memory_requirements->size,
+                                                           &allocation->memory, &allocation->mapped);
+        if (result != VK_SUCCESS)
+            return result;
+
+        allocation->dedicated = true;
+        allocator->stats.dedicated_count++;
+        allocator->stats.allocations_count++;
+        allocator->stats.bytes_used += allocation->size;
+        return VK_SUCCESS;
+    }
+
+    // buddy nodes are aligned to their own size, which covers any power of two alignment up to it
+    uint32_t order = allocator_order(size);
+    uint32_t block_index = pool->blocks_count;
+    for (uint32_t i = 0; i < pool->blocks_count; i++) {
+        if (pool->blocks[i].memory != VK_NULL_HANDLE && pool->blocks[i].longest[0] > order) {
+            block_index = i;
+            break;
+        }
+    }
+    if (block_index == pool->blocks_count) {
+        VkResult result = allocator_create_block(vulkan, allocator, pool, memory_type_index, &block_index);
+        if (result != VK_SUCCESS)
+            return result;
+    }
+
+    allocator_block_t *block = &pool->blocks[block_index];
+    allocation->node = allocator_block_allocate(pool, block, order, &allocation->offset);
+    allocation->order = order;
+    allocation->block_index = block_index;
+    allocation->memory = block->memory;
+    allocation->mapped = block->mapped ? (char *)block->mapped + allocation->offset : NULL;
+
+    VkDeviceSize allocated = (VkDeviceSize)ALLOCATOR_MIN_ALLOCATION_SIZE << order;
+    block->used += allocated;
+    allocator->stats.allocations_count++;
+    allocator->stats.bytes_used += allocation->size;
+    allocator->stats.bytes_wasted += allocated - allocation->size;
+    return VK_SUCCESS;
+}
+
+void allocator_free(vulkan_t *vulkan, allocator_t *allocator, allocation_t *allocation) {
+    if (allocation->memory == VK_NULL_HANDLE)
+        return;
+
+    allocator->stats.allocations_count--;
+    allocator->stats.bytes_used -= allocation->size;
+
+    if (allocation->dedicated) {
+        allocator_free_device_memory(vulkan, allocator, allocation->memory, allocation->size);
+        allocator->stats.dedicated_count--;
+        *allocation = (allocation_t){0};
+        return;
+    }
+
+    allocator_pool_t *pool = allocator_pool(allocator, allocation->memory_type_index, allocation->resource);
+    allocator_block_t *block = &pool->blocks[allocation->block_index];
+    VkDeviceSize allocated = (VkDeviceSize)ALLOCATOR_MIN_ALLOCATION_SIZE << allocation->order;
+
+    block->longest[allocation->node] = allocation->order + 1;
+    allocator_block_propagate(block, allocation->node, allocation->order);
+    block->used -= allocated;
+    allocator->stats.bytes_wasted -= allocated - allocation->size;
+
+    // an empty block is released unless it is the last one left, so one allocation bouncing in and out of an idle pool
+    // doesn't thrash vkAllocateMemory
+    if (block->used == 0) {
+        for (uint32_t i = 0; i < pool->blocks_count; i++) {
+            if (i != allocation->block_index && pool->blocks[i].memory != VK_NULL_HANDLE) {
+                allocator_destroy_block(vulkan, allocator, pool, block);
+                break;
+            }
+        }
+    }
+
+    *allocation = (allocation_t){0};
+}
+
+VkResult allocator_create_buffer(vulkan_t *vulkan, allocator_t *allocator, const VkBufferCreateInfo *buffer_create_info,
+                                 VkMemoryPropertyFlags required_flags, VkMemoryPropertyFlags preferred_flags, VkBuffer *buffer,
+                                 allocation_t *allocation) {
+    VkResult result = vulkan->vkCreateBuffer(vulkan->logical_device, buffer_create_info, vulkan->allocation_callbacks, buffer);
+    if (result != VK_SUCCESS)
+        return result;
+
+    VkMemoryRequirements memory_requirements;
+    vulkan->vkGetBufferMemoryRequirements(vulkan->logical_device, *buffer, &memory_requirements);
+
+    result = allocator_allocate(vulkan, allocator, &memory_requirements, required_flags, preferred_flags,
+                                ALLOCATOR_RESOURCE_LINEAR, allocation);
+    if (result != VK_SUCCESS) {
+        vulkan->vkDestroyBuffer(vulkan->logical_device, *buffer, vulkan->allocation_callbacks);
+        *buffer = VK_NULL_HANDLE;
+        return result;
+    }
+
+    result = vulkan->vkBindBufferMemory(vulkan->logical_device, *buffer, allocation->memory, allocation->offset);
+    assert(result == VK_SUCCESS);
+    return VK_SUCCESS;
+}
+
+void allocator_destroy_buffer(vulkan_t *vulkan, allocator_t *allocator, VkBuffer buffer, allocation_t *allocation) {
+    vulkan->vkDestroyBuffer(vulkan->logical_device, buffer, vulkan->allocation_callbacks);
+    allocator_free(vulkan, allocator, allocation);
+}
+
+VkResult allocator_create_image(vulkan_t *vulkan, allocator_t *allocator, const VkImageCreateInfo *image_create_info,
+                                VkMemoryPropertyFlags required_flags, VkMemoryPropertyFlags preferred_flags, VkImage *image,
+                                allocation_t *allocation) {
+    VkResult result = vulkan->vkCreateImage(vulkan->logical_device, image_create_info, vulkan->allocation_callbacks, image);
+    if (result != VK_SUCCESS)
+        return result;
+
+    VkMemoryRequirements memory_requirements;
+    vulkan->vkGetImageMemoryRequirements(vulkan->logical_device, *image, &memory_requirements);
+
+    allocator_resource_t resource =
+        image_create_info->tiling == VK_IMAGE_TILING_OPTIMAL ? ALLOCATOR_RESOURCE_OPTIMAL : ALLOCATOR_RESOURCE_LINEAR;
+    result = allocator_allocate(vulkan, allocator, &memory_requirements, required_flags, preferred_flags, resource, allocation);
+    if (result != VK_SUCCESS) {
+        vulkan->vkDestroyImage(vulkan->logical_device, *image, vulkan->allocation_callbacks);
+        *image = VK_NULL_HANDLE;
+        return result;
+    }
+
+    result = vulkan->vkBindImageMemory(vulkan->logical_device, *image, allocation->memory, allocation->offset);
+    assert(result == VK_SUCCESS);
+    return VK_SUCCESS;
+}
+
+void allocator_destroy_image(vulkan_t *vulkan, allocator_t *allocator, VkImage image, allocation_t *allocation) {
+    vulkan->vkDestroyImage(vulkan->logical_device, image, vulkan->allocation_callbacks);
+    allocator_free(vulkan, allocator, allocation);
+}
+
+void allocator_report(allocator_t *allocator) {
+    allocator_stats_t *stats = &allocator->stats;
+    printf("allocator: %u allocations, %u blocks, %u dedicated, %.2f MiB reserved, %.2f MiB used, %.2f MiB wasted\n",
+           stats->allocations_count, stats->blocks_count, stats->dedicated_count, stats->bytes_reserved / 1048576.0,
+           stats->bytes_used / 1048576.0, stats->bytes_wasted / 1048576.0);
+}
+
+void allocator_free_resources(vulkan_t *vulkan, allocator_t *allocator) {
+    for (uint32_t i = 0; i < VK_MAX_MEMORY_TYPES; i++) {
+        for (uint32_t j = 0; j < ALLOCATOR_RESOURCE_COUNT; j++) {
+            allocator_pool_t *pool = &allocator->pools[i][j];
+            for (uint32_t k = 0; k < pool->blocks_count; k++)
+                if (pool->blocks[k].memory != VK_NULL_HANDLE)
+                    allocator_destroy_block(vulkan, allocator, pool, &pool->blocks[k]);
+            pool->blocks = NULL;
+            pool->blocks_count = 0;
+            pool->blocks_capacity = 0;
+        }
+    }
+    arena_free(&allocator->arena);
+}
+
+// sizes between 256 bytes and 64 KiB, skewed toward the small end like real buffer populations
+static VkDeviceSize allocator_benchmark_size(uint64_t *random) {
+    uint32_t order = bench_random(random) % 9;
+    VkDeviceSize size = (VkDeviceSize)ALLOCATOR_MIN_ALLOCATION_SIZE << order;
+    return size - bench_random(random) % (size / 2);
+}
+
+void allocator_benchmark(uint32_t iterations) {
+    vulkan_t vulkan = {.headless = true};
+    bench_bootstrap(&vulkan);
+
+    allocator_t allocator;
+    allocator_create(&vulkan, &allocator);
+
+    // borrow the requirements of a real storage buffer so the benchmark lands on the memory type buffers would use
+    VkBufferCreateInfo buffer_create_info = {
+        .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+        .size = 65536,
+        .usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+    };
+    VkBuffer buffer = VK_NULL_HANDLE;
+    VkResult result = vulkan.vkCreateBuffer(vulkan.logical_device, &buffer_create_info, vulkan.allocation_callbacks, &buffer);
+    assert(result == VK_SUCCESS);
+    VkMemoryRequirements buffer_requirements;
+    vulkan.vkGetBufferMemoryRequirements(vulkan.logical_device, buffer, &buffer_requirements);
+    vulkan.vkDestroyBuffer(vulkan.logical_device, buffer, vulkan.allocation_callbacks);
+
+    uint32_t memory_type_index;
+    bool found = allocator_find_memory_type(&allocator, buffer_requirements.memoryTypeBits, 0,
+                                            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &memory_type_index);
+    assert(found);
+
+    // a bounded live set with random replacement, so the run churns instead of only growing
+    uint32_t live_count = iterations < 4096 ? iterations : 4096;
+    allocation_t *allocations = (allocation_t *)calloc(live_count, sizeof(allocation_t));
+    bench_samples_t allocate_samples, free_samples;
+    bench_samples_create(&allocate_samples, "allocator_allocate", iterations);
+    bench_samples_create(&free_samples, "allocator_free", iterations);
+
+    uint64_t random = 0x9e3779b97f4a7c15ull;
+    uint64_t start = bench_now_ns();
+    for (uint32_t i = 0; i < iterations; i++) {
+        uint32_t slot = i < live_count ? i : bench_random(&random) % live_count;
+        if (allocations[slot].memory != VK_NULL_HANDLE) {
+            uint64_t free_start = bench_now_ns();
+            allocator_free(&vulkan, &allocator, &allocations[slot]);
+            bench_samples_push(&free_samples, bench_now_ns() - free_start);
+        }
+
+        VkMemoryRequirements memory_requirements = {
+            .size = allocator_benchmark_size(&random),
+            .alignment = buffer_requirements.alignment,
+            .memoryTypeBits = buffer_requirements.memoryTypeBits,
+        };
+        uint64_t allocate_start = bench_now_ns();
+        result = allocator_allocate(&vulkan, &allocator, &memory_requirements, 0, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                                    ALLOCATOR_RESOURCE_LINEAR, &allocations[slot]);
+        bench_samples_push(&allocate_samples, bench_now_ns() - allocate_start);
+        assert(result == VK_SUCCESS);
+    }
+    uint64_t allocator_elapsed = bench_now_ns() - start;
+
+    printf("allocator: %u allocations with %u live, memory type %u\n", iterations, live_count, memory_type_index);
+    allocator_report(&allocator);
+    for (uint32_t i = 0; i < live_count; i++)
+        allocator_free(&vulkan, &allocator, &allocations[i]);
+
+    // the same churn straight through vkAllocateMemory, capped to stay clear of maxMemoryAllocationCount
+    uint32_t direct_live_count = allocator.max_memory_allocation_count / 2;
+    if (direct_live_count > live_count)
+        direct_live_count = live_count;
+    VkDeviceMemory *memories = (VkDeviceMemory *)calloc(direct_live_count, sizeof(VkDeviceMemory));
+    bench_samples_t direct_allocate_samples, direct_free_samples;
+    bench_samples_create(&direct_allocate_samples, "vkAllocateMemory", iterations);
+    bench_samples_create(&direct_free_samples, "vkFreeMemory", iterations);
+
+    random = 0x9e3779b97f4a7c15ull;
+    start = bench_now_ns();
+    for (uint32_t i = 0; i < iterations; i++) {
+        uint32_t slot = i < direct_live_count ? i : bench_random(&random) % direct_live_count;
+        if (memories[slot] != VK_NULL_HANDLE) {
+            uint64_t free_start = bench_now_ns();
+            vulkan.vkFreeMemory(vulkan.logical_device, memories[slot], vulkan.allocation_callbacks);
+            bench_samples_push(&direct_free_samples, bench_now_ns() - free_start);
+        }
+
+        VkMemoryAllocateInfo memory_allocate_info = {
+            .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+            .allocationSize = allocator_benchmark_size(&random),
+            .memoryTypeIndex = memory_type_index,
+        };
+        uint64_t allocate_start = bench_now_ns();
+        result = vulkan.vkAllocateMemory(vulkan.logical_device, &memory_allocate_info, vulkan.allocation_callbacks,
+                                         &memories[slot]);
+        bench_samples_push(&direct_allocate_samples, bench_now_ns() - allocate_start);
+        assert(result == VK_SUCCESS);
+    }
+    uint64_t direct_elapsed = bench_now_ns() - start;
+    for (uint32_t i = 0; i < direct_live_count; i++)
+        vulkan.vkFreeMemory(vulkan.logical_device, memories[i], vulkan.allocation_callbacks);
+
+    bench_samples_report(&allocate_samples);
+    bench_samples_report(&free_samples);
+    bench_samples_report(&direct_allocate_samples);
+    bench_samples_report(&direct_free_samples);
+    printf("allocator throughput %.0f ops/s, vkAllocateMemory throughput %.0f ops/s\n",
+           (allocate_samples.count + free_samples.count) / (allocator_elapsed / 1e9),
+           (direct_allocate_samples.count + direct_free_samples.count) / (direct_elapsed / 1e9));
+
+    bench_samples_free(&allocate_samples);
+    bench_samples_free(&free_samples);
+    bench_samples_free(&direct_allocate_samples);
+    bench_samples_free(&direct_free_samples);
+    free(memories);
+    free(allocations);
+
+    allocator_free_resources(&vulkan, &allocator);
+    vulkan_free_resources(&vulkan);
+}
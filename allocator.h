@@ -0,0 +1,90 @@
+#ifndef ALLOCATOR_H
+#define ALLOCATOR_H
+
+#include "vulkan.h"
+#include <stdbool.h>
+
+#define ALLOCATOR_MIN_ALLOCATION_SIZE 256
+#define ALLOCATOR_LARGE_HEAP_BLOCK_SIZE (64ull * 1024 * 1024)
+#define ALLOCATOR_SMALL_HEAP_SIZE (1024ull * 1024 * 1024)
+
+// buffers and linear images must not share a bufferImageGranularity page with optimal images, so they get separate pools
+typedef enum {
+    ALLOCATOR_RESOURCE_LINEAR,
+    ALLOCATOR_RESOURCE_OPTIMAL,
+    ALLOCATOR_RESOURCE_COUNT,
+} allocator_resource_t;
+
+typedef struct {
+    VkDeviceMemory memory;
+    VkDeviceSize offset;
+    VkDeviceSize size;
+    void *mapped;
+
+    // where the allocation came from, needed to give it back
+    uint32_t memory_type_index;
+    allocator_resource_t resource;
+    bool dedicated;
+    uint32_t block_index;
+    uint32_t node;
+    uint32_t order;
+} allocation_t;
+
+typedef struct {
+    VkDeviceMemory memory;
+    void *mapped;
+    VkDeviceSize used;
+    // buddy tree, each node holds one more than the largest free order below it (0 means fully allocated)
+    uint8_t *longest;
+} allocator_block_t;
+
+typedef struct {
+    VkDeviceSize block_size;
+    uint32_t levels;
+    uint32_t blocks_count;
+    uint32_t blocks_capacity;
+    // a freed block keeps its slot and buddy tree for the next block the pool creates
+    allocator_block_t *blocks;
+} allocator_pool_t;
+
+typedef struct {
+    uint32_t blocks_count;
+    uint32_t dedicated_count;
+    uint32_t allocations_count;
+    VkDeviceSize bytes_reserved;
+    VkDeviceSize bytes_used;
+    VkDeviceSize bytes_wasted;
+} allocator_stats_t;
+
+typedef struct {
+    // block arrays and buddy trees, which only ever grow until allocator_free_resources
+    arena_t arena;
+    VkPhysicalDeviceMemoryProperties memory_properties;
+    VkDeviceSize buffer_image_granularity;
+    uint32_t max_memory_allocation_count;
+    uint32_t device_memory_count;
+    allocator_pool_t pools[VK_MAX_MEMORY_TYPES][ALLOCATOR_RESOURCE_COUNT];
+    allocator_stats_t stats;
+} allocator_t;
+
+void allocator_create(vulkan_t *vulkan, allocator_t *allocator);
+bool allocator_find_memory_type(allocator_t *allocator, uint32_t memory_type_bits, VkMemoryPropertyFlags required_flags,
+                                VkMemoryPropertyFlags preferred_flags, uint32_t *memory_type_index);
+VkResult allocator_allocate(vulkan_t *vulkan, allocator_t *allocator, const VkMemoryRequirements *memory_requirements,
+                            VkMemoryPropertyFlags required_flags, VkMemoryPropertyFlags preferred_flags,
+                            allocator_resource_t resource, allocation_t *allocation);
+void allocator_free(vulkan_t *vulkan, allocator_t *allocator, allocation_t *allocation);
+VkResult allocator_create_buffer(vulkan_t *vulkan, allocator_t *allocator, const VkBufferCreateInfo *buffer_create_info,
+                                 VkMemoryPropertyFlags required_flags, VkMemoryPropertyFlags preferred_flags, VkBuffer *buffer,
+                                 allocation_t *allocation);
+void allocator_destroy_buffer(vulkan_t *vulkan, allocator_t *allocator, VkBuffer buffer, allocation_t *allocation);
+VkResult allocator_create_image(vulkan_t *vulkan, allocator_t *allocator, const VkImageCreateInfo *image_create_info,
+                                VkMemoryPropertyFlags required_flags, VkMemoryPropertyFlags preferred_flags, VkImage *image,
+                                allocation_t *allocation);
+void allocator_destroy_image(vulkan_t *vulkan, allocator_t *allocator, VkImage image, allocation_t *allocation);
+void allocator_report(allocator_t *allocator);
+void allocator_free_resources(vulkan_t *vulkan, allocator_t *allocator);
+
+void allocator_benchmark(uint32_t iterations);
+
+#endif // ALLOCATOR_H
@@ -0,0 +1,63 @@
+#include "arena.h"
+#include <assert.h>
+#include <stdalign.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define ARENA_ALIGNMENT alignof(max_align_t)
+#define ARENA_ALIGN(size) (((size) + ARENA_ALIGNMENT - 1) & ~(ARENA_ALIGNMENT - 1))
+
+// bump allocation out of the newest block, anything larger than a block gets a block of its own
+void *arena_allocate(arena_t *arena, size_t size) {
+    size = ARENA_ALIGN(size > 0 ? size : 1);
+    size_t header_size = ARENA_ALIGN(sizeof(arena_block_t));
+
+    arena_block_t *block = arena->blocks;
+    if (block == NULL || block->used + size > block->size) {
+        size_t block_size = size > ARENA_BLOCK_SIZE - header_size ? size : ARENA_BLOCK_SIZE - header_size;
+        block = (arena_block_t *)malloc(header_size + block_size);
+        assert(block);
+
+        block->size = block_size;
+        block->used = 0;
+        // an oversized block goes behind the current one so the space left in that one is not abandoned
+        if (arena->blocks != NULL && block_size > ARENA_BLOCK_SIZE - header_size) {
+            block->next = arena->blocks->next;
+            arena->blocks->next = block;
+        } else {
+            block->next = arena->blocks;
+            arena->blocks = block;
+        }
+        arena->blocks_count++;
+        arena->reserved_bytes += header_size + block_size;
+    }
+
+    void *data = (unsigned char *)block + header_size + block->used;
+    block->used += size;
+    arena->used_bytes += size;
+    arena->allocations++;
+    return data;
+}
+
+// the old copy stays behind until arena_free, so arrays grown by doubling waste at most what they end up using
+void *arena_reallocate(arena_t *arena, void *data, size_t size, size_t new_size) {
+    void *grown = arena_allocate(arena, new_size);
+    if (data != NULL)
+        memcpy(grown, data, size < new_size ? size : new_size);
+    return grown;
+}
+
+void arena_free(arena_t *arena) {
+    arena_block_t *block = arena->blocks;
+    while (block != NULL) {
+        arena_block_t *next = block->next;
+        free(block);
+        block = next;
+    }
+
+    arena->blocks = NULL;
+    arena->blocks_count = 0;
+    arena->allocations = 0;
+    arena->reserved_bytes = 0;
+    arena->used_bytes = 0;
+}
@@ -0,0 +1,28 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define ARENA_BLOCK_SIZE 16384
+
+typedef struct arena_block_s {
+    struct arena_block_s *next;
+    size_t size;
+    size_t used;
+} arena_block_t;
+
+// a zeroed arena is empty and ready to use, everything in it is released at once by arena_free
+typedef struct {
+    arena_block_t *blocks;
+    uint32_t blocks_count;
+    uint32_t allocations;
+    size_t reserved_bytes;
+    size_t used_bytes;
+} arena_t;
+
+void *arena_allocate(arena_t *arena, size_t size);
+void *arena_reallocate(arena_t *arena, void *data, size_t size, size_t new_size);
+void arena_free(arena_t *arena);
+
+#endif // ARENA_H
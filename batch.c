@@ -0,0 +1,428 @@
+#define _POSIX_C_SOURCE 200809L
+#include "batch.h"
+#include "bench.h"
+#include <assert.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#define BATCH_PNG_STORED_BLOCK 65535u
+#define BATCH_ADLER_MODULUS 65521u
+#define BATCH_ADLER_RUN 5552u
+
+static const char *batch_format_names[] = {
+    [BATCH_FORMAT_NONE] = "none",
+    [BATCH_FORMAT_RAW] = "raw",
+    [BATCH_FORMAT_PPM] = "ppm",
+    [BATCH_FORMAT_PNG] = "png",
+};
+
+static uint32_t batch_crc_table[256];
+
+bool batch_parse_format(const char *name, batch_format_t *format) {
+    for (uint32_t i = 0; i < sizeof(batch_format_names) / sizeof(*batch_format_names); i++) {
+        if (strcmp(name, batch_format_names[i]) == 0) {
+            *format = (batch_format_t)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+static void batch_crc_init(void) {
+    for (uint32_t n = 0; n < 256; n++) {
+        uint32_t c = n;
+        for (uint32_t k = 0; k < 8; k++)
+            c = c & 1 ? 0xedb88320u ^ (c >> 1) : c >> 1;
+        batch_crc_table[n] = c;
+    }
+}
+
+// png chunks are checksummed as they stream out, so a frame never has to be staged whole in memory
+typedef struct {
+    FILE *file;
+    uint32_t crc;
+    uint32_t adler_a;
+    uint32_t adler_b;
+    uint32_t block_left;
+    size_t data_left;
+} batch_png_t;
+
+static void batch_png_put(batch_png_t *png, const void *data, size_t size) {
+    const uint8_t *bytes = (const uint8_t *)data;
+    fwrite(bytes, 1, size, png->file);
+    for (size_t i = 0; i < size; i++)
+        png->crc = batch_crc_table[(png->crc ^ bytes[i]) & 0xff] ^ (png->crc >> 8);
+}
+
+static void batch_png_put_u32(batch_png_t *png, uint32_t value) {
+    uint8_t bytes[4] = {(uint8_t)(value >> 24), (uint8_t)(value >> 16), (uint8_t)(value >> 8), (uint8_t)value};
+    batch_png_put(png, bytes, sizeof(bytes));
+}
+
+static void batch_png_begin_chunk(batch_png_t *png, uint32_t length, const char *type) {
+    batch_png_put_u32(png, length);
+    png->crc = 0xffffffffu;
+    batch_png_put(png, type, 4);
+}
+
+static void batch_png_end_chunk(batch_png_t *png) {
+    batch_png_put_u32(png, png->crc ^ 0xffffffffu);
+}
+
+// uncompressed deflate: stored blocks of at most 65535 bytes, each behind a five byte header
+static void batch_png_put_data(batch_png_t *png, const uint8_t *data, size_t size) {
+    while (size > 0) {
+        if (png->block_left == 0) {
+            uint32_t length = png->data_left < BATCH_PNG_STORED_BLOCK ? (uint32_t)png->data_left : BATCH_PNG_STORED_BLOCK;
+            uint8_t header[5] = {png->data_left == length, (uint8_t)length, (uint8_t)(length >> 8), (uint8_t)~length,
+                                 (uint8_t)(~length >> 8)};
+            batch_png_put(png, header, sizeof(header));
+            png->block_left = length;
+        }
+
+        size_t count = size < png->block_left ? size : png->block_left;
+        batch_png_put(png, data, count);
+        for (size_t done = 0; done < count;) {
+            size_t run = count - done < BATCH_ADLER_RUN ? count - done : BATCH_ADLER_RUN;
+            for (size_t i = 0; i < run; i++) {
+                png->adler_a += data[done + i];
+                png->adler_b += png->adler_a;
+            }
+            png->adler_a %= BATCH_ADLER_MODULUS;
+            png->adler_b %= BATCH_ADLER_MODULUS;
+            done += run;
+        }
+
+        png->block_left -= (uint32_t)count;
+        png->data_left -= count;
+        data += count;
+        size -= count;
+    }
+}
+
+static void batch_write_png(FILE *file, const uint8_t *pixels, uint32_t width, uint32_t height) {
+    static const uint8_t signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+    fwrite(signature, 1, sizeof(signature), file);
+
+    batch_png_t png = {.file = file, .adler_a = 1};
+    batch_png_begin_chunk(&png, 13, "IHDR");
+    batch_png_put_u32(&png, width);
+    batch_png_put_u32(&png, height);
+    uint8_t format[5] = {8, 6, 0, 0, 0};
+    batch_png_put(&png, format, sizeof(format));
+    batch_png_end_chunk(&png);
+
+    // every row is led by filter type 0, the pixels themselves are already rgba8
+    size_t row_size = (size_t)width * BATCH_PIXEL_SIZE;
+    png.data_left = (size_t)height * (1 + row_size);
+    size_t blocks = (png.data_left + BATCH_PNG_STORED_BLOCK - 1) / BATCH_PNG_STORED_BLOCK;
+    size_t idat_size = 2 + png.data_left + blocks * 5 + 4;
+    assert(idat_size < 0x80000000u);
+
+    batch_png_begin_chunk(&png, (uint32_t)idat_size, "IDAT");
+    uint8_t zlib_header[2] = {0x78, 0x01};
+    batch_png_put(&png, zlib_header, sizeof(zlib_header));
+    uint8_t filter = 0;
+    for (uint32_t y = 0; y < height; y++) {
+        batch_png_put_data(&png, &filter, 1);
+        batch_png_put_data(&png, pixels + y * row_size, row_size);
+    }
+    batch_png_put_u32(&png, (png.adler_b << 16) | png.adler_a);
+    batch_png_end_chunk(&png);
+
+    batch_png_begin_chunk(&png, 0, "IEND");
+    batch_png_end_chunk(&png);
+}
+
+static void batch_write_ppm(FILE *file, const uint8_t *pixels, uint32_t width, uint32_t height, uint8_t *row) {
+    fprintf(file, "P6\n%u %u\n255\n", width, height);
+    for (uint32_t y = 0; y < height; y++) {
+        const uint8_t *source = pixels + (size_t)y * width * BATCH_PIXEL_SIZE;
+        for (uint32_t x = 0; x < width; x++) {
+            row[x * 3 + 0] = source[x * BATCH_PIXEL_SIZE + 0];
+            row[x * 3 + 1] = source[x * BATCH_PIXEL_SIZE + 1];
+            row[x * 3 + 2] = source[x * BATCH_PIXEL_SIZE + 2];
+        }
+        fwrite(row, 1, (size_t)width * 3, file);
+    }
+}
+
+static void batch_write_frame(batch_t *batch, uint64_t frame, const uint8_t *pixels) {
+    if (batch->format == BATCH_FORMAT_NONE)
+        return;
+
+    char path[1024];
+    int length = snprintf(path, sizeof(path), "%s/frame_%06llu.%s", batch->directory, (unsigned long long)frame,
+                          batch_format_names[batch->format]);
+    FILE *file = length > 0 && (size_t)length < sizeof(path) ? fopen(path, "wb") : NULL;
+    if (file == NULL) {
+        fprintf(stderr, "failed to open %s\n", path);
+        batch->stats.failed_writes++;
+        return;
+    }
+
+    if (batch->format == BATCH_FORMAT_RAW)
+        fwrite(pixels, 1, batch->frame_size, file);
+    else if (batch->format == BATCH_FORMAT_PPM)
+        batch_write_ppm(file, pixels, batch->extent.width, batch->extent.height, batch->scratch);
+    else
+        batch_write_png(file, pixels, batch->extent.width, batch->extent.height);
+
+    long size = ftell(file);
+    bool written = !ferror(file);
+    written = fclose(file) == 0 && written;
+    if (!written) {
+        fprintf(stderr, "failed to write %s\n", path);
+        batch->stats.failed_writes++;
+        return;
+    }
+    batch->stats.bytes_written += size > 0 ? (uint64_t)size : 0;
+}
+
+// frames are saved strictly in submission order, each one only after its fence says the copy has landed
+static void *batch_writer_main(void *data) {
+    batch_t *batch = (batch_t *)data;
+    vulkan_t *vulkan = batch->vulkan;
+
+    pthread_mutex_lock(&batch->mutex);
+    for (;;) {
+        while (batch->released_count == batch->submitted_count && !batch->quit)
+            pthread_cond_wait(&batch->submitted, &batch->mutex);
+        if (batch->released_count == batch->submitted_count)
+            break;
+        uint64_t frame = batch->released_count;
+        pthread_mutex_unlock(&batch->mutex);
+
+        batch_slot_t *slot = &batch->slots[frame % batch->slots_count];
+        uint64_t start = bench_now_ns();
+        VkResult result = vulkan->vkWaitForFences(vulkan->logical_device, 1, &slot->fence, VK_TRUE, UINT64_MAX);
+        assert(result == VK_SUCCESS);
+        uint64_t written = bench_now_ns();
+        batch_write_frame(batch, frame, (const uint8_t *)slot->allocation.mapped);
+        batch->stats.fence_wait_ns += written - start;
+        batch->stats.write_ns += bench_now_ns() - written;
+
+        pthread_mutex_lock(&batch->mutex);
+        batch->released_count++;
+        pthread_cond_broadcast(&batch->released);
+    }
+    pthread_mutex_unlock(&batch->mutex);
+    return NULL;
+}
+
+static void batch_clear_pass(vulkan_t *vulkan, graph_t *graph, VkCommandBuffer command_buffer, void *data) {
+    batch_t *batch = (batch_t *)data;
+    VkImageSubresourceRange subresource_range = {
+        .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+        .levelCount = 1,
+        .layerCount = 1,
+    };
+    float t = (float)(batch->frame % 240) / 240.0f;
+    VkClearColorValue clear_color = {.float32 = {t, 0.2f, 1.0f - t, 1.0f}};
+    vulkan->vkCmdClearColorImage(command_buffer, graph_image(graph, batch->target), VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                                 &clear_color, 1, &subresource_range);
+}
+
+static void batch_readback_pass(vulkan_t *vulkan, graph_t *graph, VkCommandBuffer command_buffer, void *data) {
+    batch_t *batch = (batch_t *)data;
+    VkBufferImageCopy region = {
+        .imageSubresource = {.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT, .layerCount = 1},
+        .imageExtent = {batch->extent.width, batch->extent.height, 1},
+    };
+    vulkan->vkCmdCopyImageToBuffer(command_buffer, graph_image(graph, batch->target), VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                                   graph_buffer(graph, batch->readback), 1, &region);
+}
+
+void batch_create(vulkan_t *vulkan, batch_t *batch, VkExtent2D extent, uint32_t slots_count, batch_format_t format,
+                  const char *directory) {
+    assert(slots_count > 0 && slots_count <= BATCH_MAX_SLOTS);
+    assert(format == BATCH_FORMAT_NONE || directory != NULL);
+
+    memset(batch, 0, sizeof(*batch));
+    batch->vulkan = vulkan;
+    batch->extent = extent;
+    batch->frame_size = (VkDeviceSize)extent.width * extent.height * BATCH_PIXEL_SIZE;
+    batch->format = format;
+    batch->directory = directory;
+    batch->slots_count = slots_count;
+    batch->scratch = (uint8_t *)malloc((size_t)extent.width * 3);
+    batch_crc_init();
+
+    if (format != BATCH_FORMAT_NONE && mkdir(directory, 0755) != 0 && errno != EEXIST)
+        fprintf(stderr, "failed to create %s\n", directory);
+
+    // the frame image is a graph transient, the readback buffer is swapped in per slot and left for the host to read
+    allocator_create(vulkan, &batch->allocator);
+    graph_create(&batch->graph, &batch->allocator, false);
+    batch->target = graph_create_image(&batch->graph, "frame", VK_FORMAT_R8G8B8A8_UNORM, extent);
+    batch->readback = graph_import_buffer(&batch->graph, "readback", VK_NULL_HANDLE,
+                                          (graph_state_t){VK_PIPELINE_STAGE_HOST_BIT, 0, VK_IMAGE_LAYOUT_UNDEFINED},
+                                          (graph_state_t){VK_PIPELINE_STAGE_HOST_BIT, VK_ACCESS_HOST_READ_BIT,
+                                                          VK_IMAGE_LAYOUT_UNDEFINED});
+    uint32_t pass = graph_add_pass(&batch->graph, "clear", batch_clear_pass, batch, false);
+    graph_use(&batch->graph, pass, batch->target, GRAPH_ACCESS_TRANSFER_WRITE);
+    pass = graph_add_pass(&batch->graph, "readback", batch_readback_pass, batch, true);
+    graph_use(&batch->graph, pass, batch->target, GRAPH_ACCESS_TRANSFER_READ);
+    graph_use(&batch->graph, pass, batch->readback, GRAPH_ACCESS_TRANSFER_WRITE);
+    graph_compile(vulkan, &batch->graph);
+
+    for (uint32_t i = 0; i < slots_count; i++) {
+        batch_slot_t *slot = &batch->slots[i];
+
+        // the cpu reads every byte back, which uncached memory makes painfully slow
+        VkBufferCreateInfo buffer_create_info = {
+            .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+            .size = batch->frame_size,
+            .usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+            .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+        };
+        VkResult result = allocator_create_buffer(vulkan, &batch->allocator, &buffer_create_info,
+                                                  VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                                  VK_MEMORY_PROPERTY_HOST_CACHED_BIT, &slot->buffer, &slot->allocation);
+        assert(result == VK_SUCCESS && slot->allocation.mapped);
+
+        VkCommandPoolCreateInfo command_pool_create_info = {
+            .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+            .flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT,
+            .queueFamilyIndex = vulkan->queues[VULKAN_QUEUE_GRAPHICS].family_index,
+        };
+        result = vulkan->vkCreateCommandPool(vulkan->logical_device, &command_pool_create_info, vulkan->allocation_callbacks,
+                                             &slot->command_pool);
+        assert(result == VK_SUCCESS);
+
+        VkCommandBufferAllocateInfo command_buffer_allocate_info = {
+            .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+            .commandPool = slot->command_pool,
+            .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+            .commandBufferCount = 1,
+        };
+        result = vulkan->vkAllocateCommandBuffers(vulkan->logical_device, &command_buffer_allocate_info, &slot->command_buffer);
+        assert(result == VK_SUCCESS);
+
+        VkFenceCreateInfo fence_create_info = {.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO};
+        result = vulkan->vkCreateFence(vulkan->logical_device, &fence_create_info, vulkan->allocation_callbacks, &slot->fence);
+        assert(result == VK_SUCCESS);
+    }
+
+    pthread_mutex_init(&batch->mutex, NULL);
+    pthread_cond_init(&batch->submitted, NULL);
+    pthread_cond_init(&batch->released, NULL);
+    int error = pthread_create(&batch->writer, NULL, batch_writer_main, batch);
+    assert(error == 0);
+}
+
+// the render thread only ever waits for a slot the writer still holds, never on the gpu or the disk directly
+void batch_render(batch_t *batch, uint32_t frames) {
+    vulkan_t *vulkan = batch->vulkan;
+    uint64_t start = bench_now_ns();
+
+    for (uint32_t i = 0; i < frames; i++) {
+        uint64_t frame = batch->frame;
+        batch_slot_t *slot = &batch->slots[frame % batch->slots_count];
+
+        uint64_t stall_start = bench_now_ns();
+        pthread_mutex_lock(&batch->mutex);
+        while (frame - batch->released_count >= batch->slots_count)
+            pthread_cond_wait(&batch->released, &batch->mutex);
+        pthread_mutex_unlock(&batch->mutex);
+        batch->stats.render_stall_ns += bench_now_ns() - stall_start;
+
+        VkResult result = vulkan->vkResetFences(vulkan->logical_device, 1, &slot->fence);
+        assert(result == VK_SUCCESS);
+        result = vulkan->vkResetCommandPool(vulkan->logical_device, slot->command_pool, 0);
+        assert(result == VK_SUCCESS);
+
+        VkCommandBufferBeginInfo command_buffer_begin_info = {
+            .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+            .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+        };
+        result = vulkan->vkBeginCommandBuffer(slot->command_buffer, &command_buffer_begin_info);
+        assert(result == VK_SUCCESS);
+        graph_set_buffer(&batch->graph, batch->readback, slot->buffer);
+        graph_execute(vulkan, &batch->graph, slot->command_buffer);
+        result = vulkan->vkEndCommandBuffer(slot->command_buffer);
+        assert(result == VK_SUCCESS);
+
+        VkSubmitInfo submit_info = {
+            .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+            .commandBufferCount = 1,
+            .pCommandBuffers = &slot->command_buffer,
+        };
+        result = vulkan->vkQueueSubmit(vulkan->queues[VULKAN_QUEUE_GRAPHICS].queue, 1, &submit_info, slot->fence);
+        assert(result == VK_SUCCESS);
+
+        pthread_mutex_lock(&batch->mutex);
+        batch->submitted_count = frame + 1;
+        pthread_cond_signal(&batch->submitted);
+        pthread_mutex_unlock(&batch->mutex);
+
+        batch->frame++;
+        batch->stats.frames++;
+        batch->stats.bytes_read_back += batch->frame_size;
+    }
+
+    // a run is over once its last frame is on disk
+    pthread_mutex_lock(&batch->mutex);
+    while (batch->released_count < batch->submitted_count)
+        pthread_cond_wait(&batch->released, &batch->mutex);
+    pthread_mutex_unlock(&batch->mutex);
+    batch->stats.elapsed_ns += bench_now_ns() - start;
+}
+
+void batch_report(batch_t *batch) {
+    batch_stats_t *stats = &batch->stats;
+    double seconds = stats->elapsed_ns > 0 ? stats->elapsed_ns / 1e9 : 1.0;
+
+    printf("batch: %llu frames of %ux%u through %u readback slots, format %s\n", (unsigned long long)stats->frames,
+           batch->extent.width, batch->extent.height, batch->slots_count, batch_format_names[batch->format]);
+    printf("%.1f frames/s, readback %.1f MB/s, written %.1f MB/s\n", stats->frames / seconds,
+           stats->bytes_read_back / seconds / 1e6, stats->bytes_written / seconds / 1e6);
+    printf("render thread waited %.1f ms for slots, writer waited %.1f ms on fences and spent %.1f ms writing\n",
+           stats->render_stall_ns / 1e6, stats->fence_wait_ns / 1e6, stats->write_ns / 1e6);
+    if (stats->failed_writes > 0)
+        printf("%llu frames failed to save\n", (unsigned long long)stats->failed_writes);
+}
+
+void batch_free_resources(vulkan_t *vulkan, batch_t *batch) {
+    pthread_mutex_lock(&batch->mutex);
+    batch->quit = true;
+    pthread_cond_broadcast(&batch->submitted);
+    pthread_mutex_unlock(&batch->mutex);
+    pthread_join(batch->writer, NULL);
+
+    for (uint32_t i = 0; i < batch->slots_count; i++) {
+        batch_slot_t *slot = &batch->slots[i];
+        vulkan->vkDestroyFence(vulkan->logical_device, slot->fence, vulkan->allocation_callbacks);
+        vulkan->vkDestroyCommandPool(vulkan->logical_device, slot->command_pool, vulkan->allocation_callbacks);
+        allocator_destroy_buffer(vulkan, &batch->allocator, slot->buffer, &slot->allocation);
+    }
+    graph_free_resources(vulkan, &batch->graph);
+    allocator_free_resources(vulkan, &batch->allocator);
+
+    free(batch->scratch);
+    pthread_cond_destroy(&batch->released);
+    pthread_cond_destroy(&batch->submitted);
+    pthread_mutex_destroy(&batch->mutex);
+}
+
+// nothing is written, so the only difference between the runs is how far the gpu can run ahead of the host
+void batch_benchmark(uint32_t iterations) {
+    vulkan_t vulkan = {.headless = true};
+    bench_bootstrap(&vulkan);
+
+    uint32_t slots_counts[] = {1, BATCH_DEFAULT_SLOTS};
+    for (uint32_t i = 0; i < sizeof(slots_counts) / sizeof(*slots_counts); i++) {
+        batch_t *batch = (batch_t *)malloc(sizeof(batch_t));
+        batch_create(&vulkan, batch, (VkExtent2D){BATCH_DEFAULT_WIDTH, BATCH_DEFAULT_HEIGHT}, slots_counts[i],
+                     BATCH_FORMAT_NONE, NULL);
+        batch_render(batch, iterations);
+        batch_report(batch);
+        batch_free_resources(&vulkan, batch);
+        free(batch);
+    }
+
+    vulkan_free_resources(&vulkan);
+}
@@ -0,0 +1,81 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include "allocator.h"
+#include "graph.h"
+#include "vulkan.h"
+#include <pthread.h>
+#include <stdbool.h>
+
+#define BATCH_MAX_SLOTS 8
+#define BATCH_DEFAULT_SLOTS 4
+#define BATCH_DEFAULT_WIDTH 1280
+#define BATCH_DEFAULT_HEIGHT 720
+#define BATCH_PIXEL_SIZE 4
+
+typedef enum {
+    BATCH_FORMAT_NONE,
+    BATCH_FORMAT_RAW,
+    BATCH_FORMAT_PPM,
+    BATCH_FORMAT_PNG,
+} batch_format_t;
+
+// frame f goes through slot f % slots_count, owned by the render thread until submitted and by the writer until saved
+typedef struct {
+    VkCommandPool command_pool;
+    VkCommandBuffer command_buffer;
+    VkFence fence;
+    VkBuffer buffer;
+    allocation_t allocation;
+} batch_slot_t;
+
+typedef struct {
+    uint64_t frames;
+    uint64_t failed_writes;
+    uint64_t bytes_read_back;
+    uint64_t bytes_written;
+    uint64_t elapsed_ns;
+    uint64_t render_stall_ns;
+    uint64_t fence_wait_ns;
+    uint64_t write_ns;
+} batch_stats_t;
+
+typedef struct {
+    vulkan_t *vulkan;
+    allocator_t allocator;
+    graph_t graph;
+    graph_resource_t target;
+    graph_resource_t readback;
+
+    VkExtent2D extent;
+    VkDeviceSize frame_size;
+    batch_format_t format;
+    const char *directory;
+    uint64_t frame;
+
+    uint32_t slots_count;
+    batch_slot_t slots[BATCH_MAX_SLOTS];
+
+    // submitted_count frames have been handed to the writer, released_count of them are saved and their slots free
+    pthread_t writer;
+    pthread_mutex_t mutex;
+    pthread_cond_t submitted;
+    pthread_cond_t released;
+    uint64_t submitted_count;
+    uint64_t released_count;
+    bool quit;
+    uint8_t *scratch;
+
+    batch_stats_t stats;
+} batch_t;
+
+bool batch_parse_format(const char *name, batch_format_t *format);
+void batch_create(vulkan_t *vulkan, batch_t *batch, VkExtent2D extent, uint32_t slots_count, batch_format_t format,
+                  const char *directory);
+void batch_render(batch_t *batch, uint32_t frames);
+void batch_report(batch_t *batch);
+void batch_free_resources(vulkan_t *vulkan, batch_t *batch);
+
+void batch_benchmark(uint32_t iterations);
+
+#endif // BATCH_H
@@ -0,0 +1,275 @@
+#define _POSIX_C_SOURCE 200809L
+#include "bench.h"
+#include "allocator.h"
+#include "batch.h"
+#include "compute.h"
+#include "descriptor.h"
+#include "device.h"
+#include "graph.h"
+#include "host_memory.h"
+#include "indirect.h"
+#include "pipeline_builder.h"
+#include "pipeline_cache.h"
+#include "recorder.h"
+#include "scheduler.h"
+#include "upload.h"
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+uint64_t bench_now_ns(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ull + (uint64_t)now.tv_nsec;
+}
+
+// xorshift64*, deterministic so runs are comparable
+uint64_t bench_random(uint64_t *state) {
+    *state ^= *state >> 12;
+    *state ^= *state << 25;
+    *state ^= *state >> 27;
+    return *state * 0x2545f4914f6cdd1dull;
+}
+
+void bench_samples_create(bench_samples_t *samples, const char *name, uint32_t capacity) {
+    samples->name = name;
+    samples->count = 0;
+    samples->capacity = capacity;
+    samples->samples = (uint64_t *)malloc(sizeof(uint64_t) * capacity);
+    assert(samples->samples);
+}
+
+void bench_samples_push(bench_samples_t *samples, uint64_t nanoseconds) {
+    assert(samples->count < samples->capacity);
+    samples->samples[samples->count++] = nanoseconds;
+}
+
+static int bench_compare_samples(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a;
+    uint64_t y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+// nearest-rank percentile, sorts the samples in place
+uint64_t bench_samples_percentile(bench_samples_t *samples, double percentile) {
+    assert(samples->count > 0);
+    qsort(samples->samples, samples->count, sizeof(uint64_t), bench_compare_samples);
+
+    uint32_t rank = (uint32_t)(percentile * samples->count + 0.999999);
+    if (rank > 0)
+        rank--;
+    if (rank >= samples->count)
+        rank = samples->count - 1;
+    return samples->samples[rank];
+}
+
+void bench_samples_report(bench_samples_t *samples) {
+    if (samples->count == 0)
+        return;
+
+    printf("%-48s min %10.3f us  median %10.3f us  p99 %10.3f us\n", samples->name,
+           bench_samples_percentile(samples, 0.0) / 1000.0, bench_samples_percentile(samples, 0.5) / 1000.0,
+           bench_samples_percentile(samples, 0.99) / 1000.0);
+}
+
+void bench_samples_free(bench_samples_t *samples) {
+    free(samples->samples);
+    samples->samples = NULL;
+    samples->count = 0;
+    samples->capacity = 0;
+}
+
+typedef struct {
+    const char *name;
+    void (*run)(vulkan_t *vulkan);
+} bench_phase_t;
+
+// benchmarks keep their pipeline cache out of the working directory, bench_run picks a fresh file for every run
+static char bench_pipeline_cache_path[] = "/tmp/vulkookbook.pipeline_cache.XXXXXX";
+
+static const bench_phase_t startup_phases[] = {
+    {"vulkan_load_global_level_functions", vulkan_load_global_level_functions},
+    {"vulkan_create_instance", vulkan_create_instance},
+    {"vulkan_load_instance_level_functions", vulkan_load_instance_level_functions},
+    {"vulkan_load_instance_level_extension_functions", vulkan_load_instance_level_extension_functions},
+    {"vulkan_create_physical_device", vulkan_create_physical_device},
+    {"vulkan_create_headless_surface", vulkan_create_headless_surface},
+    {"vulkan_create_logical_device", vulkan_create_logical_device},
+    {"vulkan_load_device_level_functions", vulkan_load_device_level_functions},
+    {"vulkan_get_device_queues", vulkan_get_device_queues},
+    {"vulkan_load_device_level_extension_functions", vulkan_load_device_level_extension_functions},
+    {"pipeline_cache_create", pipeline_cache_create},
+    {"vulkan_free_resources", vulkan_free_resources},
+};
+
+// runs every startup phase except the final teardown
+void bench_bootstrap(vulkan_t *vulkan) {
+    if (vulkan->pipeline_cache_path == NULL)
+        vulkan->pipeline_cache_path = bench_pipeline_cache_path;
+    uint32_t phases_count = sizeof(startup_phases) / sizeof(*startup_phases);
+    for (uint32_t i = 0; i < phases_count - 1; i++)
+        startup_phases[i].run(vulkan);
+}
+
+void bench_startup(uint32_t iterations) {
+    uint32_t phases_count = sizeof(startup_phases) / sizeof(*startup_phases);
+    bench_samples_t phases[sizeof(startup_phases) / sizeof(*startup_phases)];
+    bench_samples_t total;
+
+    for (uint32_t i = 0; i < phases_count; i++)
+        bench_samples_create(&phases[i], startup_phases[i].name, iterations);
+    bench_samples_create(&total, "total", iterations);
+
+    for (uint32_t i = 0; i < iterations; i++) {
+        // every iteration measures a first launch, not one that finds the cache the previous iteration stored
+        remove(bench_pipeline_cache_path);
+        vulkan_t vulkan = {.headless = true, .pipeline_cache_path = bench_pipeline_cache_path};
+        uint64_t chain_start = bench_now_ns();
+        for (uint32_t j = 0; j < phases_count; j++) {
+            uint64_t phase_start = bench_now_ns();
+            startup_phases[j].run(&vulkan);
+            bench_samples_push(&phases[j], bench_now_ns() - phase_start);
+        }
+        bench_samples_push(&total, bench_now_ns() - chain_start);
+    }
+
+    printf("startup: %u iterations\n", iterations);
+    for (uint32_t i = 0; i < phases_count; i++) {
+        bench_samples_report(&phases[i]);
+        bench_samples_free(&phases[i]);
+    }
+    bench_samples_report(&total);
+    bench_samples_free(&total);
+}
+
+// the same lists the dispatch tables are generated from, to resolve every device function through the loader instead
+#define BENCH_FUNCTION_NAME(name) #name,
+#define BENCH_EXTENSION_FUNCTION_NAME(name, extension) #name,
+static const char *bench_device_functions[] = {
+    VULKAN_DEVICE_LEVEL_FUNCTIONS(BENCH_FUNCTION_NAME) VULKAN_DEVICE_LEVEL_EXTENSION_FUNCTIONS(BENCH_EXTENSION_FUNCTION_NAME)};
+#undef BENCH_FUNCTION_NAME
+#undef BENCH_EXTENSION_FUNCTION_NAME
+
+#define BENCH_DISPATCH_CALLS 1000
+
+// each call sample covers BENCH_DISPATCH_CALLS calls, so its microseconds read as nanoseconds per call
+void bench_dispatch(uint32_t iterations) {
+    vulkan_t vulkan = {.headless = true};
+    bench_bootstrap(&vulkan);
+
+    VkBufferCreateInfo buffer_create_info = {
+        .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+        .size = 256,
+        .usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+        .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+    };
+    VkBuffer buffer = VK_NULL_HANDLE;
+    VkResult result = vulkan.vkCreateBuffer(vulkan.logical_device, &buffer_create_info, vulkan.allocation_callbacks, &buffer);
+    assert(result == VK_SUCCESS);
+
+    // the loader exports the very same trampoline, so calling vkGetBufferMemoryRequirements directly would measure this again
+    PFN_vkGetBufferMemoryRequirements trampoline =
+        (PFN_vkGetBufferMemoryRequirements)vkGetInstanceProcAddr(vulkan.instance, "vkGetBufferMemoryRequirements");
+    assert(trampoline);
+
+    bench_samples_t device_load, extension_load, trampoline_load, table_calls, trampoline_calls;
+    bench_samples_create(&device_load, "device table load, core functions", iterations);
+    bench_samples_create(&extension_load, "device table load, extension functions", iterations);
+    bench_samples_create(&trampoline_load, "trampoline load via vkGetInstanceProcAddr", iterations);
+    bench_samples_create(&table_calls, "1000 calls, device table", iterations);
+    bench_samples_create(&trampoline_calls, "1000 calls, vkGetInstanceProcAddr trampoline", iterations);
+
+    uint32_t functions_count = sizeof(bench_device_functions) / sizeof(*bench_device_functions);
+    uint32_t trampolines_found = 0;
+    VkMemoryRequirements memory_requirements;
+    for (uint32_t i = 0; i < iterations; i++) {
+        uint64_t start = bench_now_ns();
+        vulkan_load_device_level_functions(&vulkan);
+        bench_samples_push(&device_load, bench_now_ns() - start);
+
+        start = bench_now_ns();
+        vulkan_load_device_level_extension_functions(&vulkan);
+        bench_samples_push(&extension_load, bench_now_ns() - start);
+
+        // unlike the table this resolves every name, including those of extensions that were never enabled
+        trampolines_found = 0;
+        start = bench_now_ns();
+        for (uint32_t j = 0; j < functions_count; j++)
+            trampolines_found += vkGetInstanceProcAddr(vulkan.instance, bench_device_functions[j]) != NULL;
+        bench_samples_push(&trampoline_load, bench_now_ns() - start);
+
+        start = bench_now_ns();
+        for (uint32_t j = 0; j < BENCH_DISPATCH_CALLS; j++)
+            vulkan.vkGetBufferMemoryRequirements(vulkan.logical_device, buffer, &memory_requirements);
+        bench_samples_push(&table_calls, bench_now_ns() - start);
+
+        start = bench_now_ns();
+        for (uint32_t j = 0; j < BENCH_DISPATCH_CALLS; j++)
+            trampoline(vulkan.logical_device, buffer, &memory_requirements);
+        bench_samples_push(&trampoline_calls, bench_now_ns() - start);
+    }
+
+    printf("dispatch: %u device functions (%u resolved by the loader), vkGetBufferMemoryRequirements per call\n",
+           functions_count, trampolines_found);
+    bench_samples_report(&device_load);
+    bench_samples_report(&extension_load);
+    bench_samples_report(&trampoline_load);
+    bench_samples_report(&table_calls);
+    bench_samples_report(&trampoline_calls);
+
+    bench_samples_free(&device_load);
+    bench_samples_free(&extension_load);
+    bench_samples_free(&trampoline_load);
+    bench_samples_free(&table_calls);
+    bench_samples_free(&trampoline_calls);
+
+    vulkan.vkDestroyBuffer(vulkan.logical_device, buffer, vulkan.allocation_callbacks);
+    vulkan_free_resources(&vulkan);
+}
+
+typedef struct {
+    const char *name;
+    void (*run)(uint32_t iterations);
+} bench_t;
+
+static const bench_t benches[] = {
+    {"startup", bench_startup},
+    {"dispatch", bench_dispatch},
+    {"pipeline-cache", pipeline_cache_benchmark},
+    {"allocator", allocator_benchmark},
+    {"recording", recorder_benchmark},
+    {"upload", upload_benchmark},
+    {"compute", compute_benchmark},
+    {"graph", graph_benchmark},
+    {"descriptors", descriptor_benchmark},
+    {"pipeline-builder", pipeline_builder_benchmark},
+    {"host-memory", host_memory_benchmark},
+    {"batch", batch_benchmark},
+    {"devices", device_benchmark},
+    {"indirect", indirect_benchmark},
+    {"queues", scheduler_benchmark},
+};
+
+bool bench_run(const char *name, uint32_t iterations) {
+    for (uint32_t i = 0; i < sizeof(benches) / sizeof(*benches); i++) {
+        if (strcmp(name, benches[i].name) == 0) {
+            int fd = mkstemp(bench_pipeline_cache_path);
+            assert(fd >= 0);
+            close(fd);
+            remove(bench_pipeline_cache_path);
+
+            benches[i].run(iterations);
+            remove(bench_pipeline_cache_path);
+            return true;
+        }
+    }
+
+    fprintf(stderr, "unknown benchmark '%s', expected one of:", name);
+    for (uint32_t i = 0; i < sizeof(benches) / sizeof(*benches); i++)
+        fprintf(stderr, " %s", benches[i].name);
+    fprintf(stderr, "\n");
+    return false;
+}
@@ -0,0 +1,28 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include "vulkan.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef struct {
+    const char *name;
+    uint32_t count;
+    uint32_t capacity;
+    uint64_t *samples;
+} bench_samples_t;
+
+uint64_t bench_now_ns(void);
+uint64_t bench_random(uint64_t *state);
+void bench_samples_create(bench_samples_t *samples, const char *name, uint32_t capacity);
+void bench_samples_push(bench_samples_t *samples, uint64_t nanoseconds);
+uint64_t bench_samples_percentile(bench_samples_t *samples, double percentile);
+void bench_samples_report(bench_samples_t *samples);
+void bench_samples_free(bench_samples_t *samples);
+
+void bench_bootstrap(vulkan_t *vulkan);
+void bench_startup(uint32_t iterations);
+void bench_dispatch(uint32_t iterations);
+bool bench_run(const char *name, uint32_t iterations);
+
+#endif // BENCH_H
@@ -0,0 +1,757 @@
+#include "compute.h"
+#include "allocator.h"
+#include "bench.h"
+#include "shader.h"
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define COMPUTE_BENCHMARK_ELEMENTS (1u << 20)
+#define COMPUTE_BENCHMARK_MAX_LEVELS 8
+#define COMPUTE_REDUCE_VALUES_PER_INVOCATION 4
+#define COMPUTE_RADIX_KEYS_PER_INVOCATION 4
+#define COMPUTE_RADIX_BITS 4
+#define COMPUTE_RADIX_PASSES (32 / COMPUTE_RADIX_BITS)
+
+void compute_create(vulkan_t *vulkan, compute_t *compute) {
+    *compute = (compute_t){
+        .queue = vulkan->queues[VULKAN_QUEUE_COMPUTE],
+    };
+
+    VkDescriptorPoolSize pool_size = {
+        .type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+        .descriptorCount = COMPUTE_MAX_DESCRIPTOR_SETS * COMPUTE_MAX_BINDINGS,
+    };
+    VkDescriptorPoolCreateInfo descriptor_pool_create_info = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+        .maxSets = COMPUTE_MAX_DESCRIPTOR_SETS,
+        .poolSizeCount = 1,
+        .pPoolSizes = &pool_size,
+    };
+    VkResult result = vulkan->vkCreateDescriptorPool(vulkan->logical_device, &descriptor_pool_create_info,
+                                                     vulkan->allocation_callbacks, &compute->descriptor_pool);
+    assert(result == VK_SUCCESS);
+
+    VkCommandPoolCreateInfo command_pool_create_info = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+        .queueFamilyIndex = compute->queue.family_index,
+    };
+    result = vulkan->vkCreateCommandPool(vulkan->logical_device, &command_pool_create_info, vulkan->allocation_callbacks,
+                                         &compute->command_pool);
+    assert(result == VK_SUCCESS);
+
+    VkCommandBufferAllocateInfo command_buffer_allocate_info = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+        .commandPool = compute->command_pool,
+        .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+        .commandBufferCount = 1,
+    };
+    result = vulkan->vkAllocateCommandBuffers(vulkan->logical_device, &command_buffer_allocate_info, &compute->command_buffer);
+    assert(result == VK_SUCCESS);
+
+    VkFenceCreateInfo fence_create_info = {
+        .sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
+    };
+    result = vulkan->vkCreateFence(vulkan->logical_device, &fence_create_info, vulkan->allocation_callbacks, &compute->fence);
+    assert(result == VK_SUCCESS);
+}
+
+// every binding is a storage buffer, which is all the kernels here need
+void compute_create_kernel(vulkan_t *vulkan, compute_kernel_t *kernel, const char *path, uint32_t workgroup_size,
+                           uint32_t constants_count, const uint32_t *constants, uint32_t bindings_count,
+                           uint32_t push_constants_size) {
+    assert(bindings_count <= COMPUTE_MAX_BINDINGS && constants_count <= COMPUTE_MAX_CONSTANTS);
+    assert(workgroup_size <= vulkan->device_properties.limits.maxComputeWorkGroupSize[0] &&
+           workgroup_size <= vulkan->device_properties.limits.maxComputeWorkGroupInvocations);
+    *kernel = (compute_kernel_t){
+        .bindings_count = bindings_count,
+        .push_constants_size = push_constants_size,
+        .workgroup_size = workgroup_size,
+    };
+
+    VkDescriptorSetLayoutBinding bindings[COMPUTE_MAX_BINDINGS];
+    for (uint32_t i = 0; i < bindings_count; i++) {
+        bindings[i] = (VkDescriptorSetLayoutBinding){
+            .binding = i,
+            .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+            .descriptorCount = 1,
+            .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+        };
+    }
+    VkDescriptorSetLayoutCreateInfo descriptor_set_layout_create_info = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+        .bindingCount = bindings_count,
+        .pBindings = bindings,
+    };
+    VkResult result = vulkan->vkCreateDescriptorSetLayout(vulkan->logical_device, &descriptor_set_layout_create_info,
+                                                          vulkan->allocation_callbacks, &kernel->descriptor_set_layout);
+    assert(result == VK_SUCCESS);
+
+    VkPushConstantRange push_constant_range = {
+        .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+        .offset = 0,
+        .size = push_constants_size,
+    };
+    VkPipelineLayoutCreateInfo pipeline_layout_create_info = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+        .setLayoutCount = 1,
+        .pSetLayouts = &kernel->descriptor_set_layout,
+        .pushConstantRangeCount = push_constants_size > 0 ? 1 : 0,
+        .pPushConstantRanges = &push_constant_range,
+    };
+    result = vulkan->vkCreatePipelineLayout(vulkan->logical_device, &pipeline_layout_create_info, vulkan->allocation_callbacks,
+                                            &kernel->pipeline_layout);
+    assert(result == VK_SUCCESS);
+
+    uint32_t specialization_data[1 + COMPUTE_MAX_CONSTANTS] = {workgroup_size};
+    VkSpecializationMapEntry specialization_map_entries[1 + COMPUTE_MAX_CONSTANTS];
+    for (uint32_t i = 0; i <= constants_count; i++) {
+        if (i > 0)
+            specialization_data[i] = constants[i - 1];
+        specialization_map_entries[i] = (VkSpecializationMapEntry){
+            .constantID = i,
+            .offset = i * sizeof(uint32_t),
+            .size = sizeof(uint32_t),
+        };
+    }
+    VkSpecializationInfo specialization_info = {
+        .mapEntryCount = 1 + constants_count,
+        .pMapEntries = specialization_map_entries,
+        .dataSize = (1 + constants_count) * sizeof(uint32_t),
+        .pData = specialization_data,
+    };
+
+    VkShaderModule shader_module = shader_create_module(vulkan, path);
+    // any kernel may end up split across a device group, which needs a non-zero dispatch base
+    VkComputePipelineCreateInfo compute_pipeline_create_info = {
+        .sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+        .flags = vulkan->vkCmdDispatchBaseKHR != NULL ? VK_PIPELINE_CREATE_DISPATCH_BASE_KHR : 0,
+        .stage =
+            {
+                .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+                .stage = VK_SHADER_STAGE_COMPUTE_BIT,
+                .module = shader_module,
+                .pName = "main",
+                .pSpecializationInfo = &specialization_info,
+            },
+        .layout = kernel->pipeline_layout,
+    };
+    result = vulkan->vkCreateComputePipelines(vulkan->logical_device, vulkan->pipeline_cache, 1, &compute_pipeline_create_info,
+                                              vulkan->allocation_callbacks, &kernel->pipeline);
+    assert(result == VK_SUCCESS);
+
+    // the pipeline keeps what it needs, so the module can go right away
+    vulkan->vkDestroyShaderModule(vulkan->logical_device, shader_module, vulkan->allocation_callbacks);
+}
+
+// binds each buffer whole, in binding order, to a fresh set that lives until compute_reset_descriptor_sets
+VkDescriptorSet compute_bind_buffers(vulkan_t *vulkan, compute_t *compute, compute_kernel_t *kernel, const VkBuffer *buffers) {
+    assert(compute->descriptor_sets_count < COMPUTE_MAX_DESCRIPTOR_SETS);
+    VkDescriptorSetAllocateInfo descriptor_set_allocate_info = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+        .descriptorPool = compute->descriptor_pool,
+        .descriptorSetCount = 1,
+        .pSetLayouts = &kernel->descriptor_set_layout,
+    };
+    VkDescriptorSet descriptor_set = VK_NULL_HANDLE;
+    VkResult result = vulkan->vkAllocateDescriptorSets(vulkan->logical_device, &descriptor_set_allocate_info, &descriptor_set);
+    assert(result == VK_SUCCESS);
+    compute->descriptor_sets_count++;
+
+    VkDescriptorBufferInfo buffer_infos[COMPUTE_MAX_BINDINGS];
+    VkWriteDescriptorSet writes[COMPUTE_MAX_BINDINGS];
+    for (uint32_t i = 0; i < kernel->bindings_count; i++) {
+        buffer_infos[i] = (VkDescriptorBufferInfo){
+            .buffer = buffers[i],
+            .offset = 0,
+            .range = VK_WHOLE_SIZE,
+        };
+        writes[i] = (VkWriteDescriptorSet){
+            .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+            .dstSet = descriptor_set,
+            .dstBinding = i,
+            .descriptorCount = 1,
+            .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+            .pBufferInfo = &buffer_infos[i],
+        };
+    }
+    vulkan->vkUpdateDescriptorSets(vulkan->logical_device, kernel->bindings_count, writes, 0, NULL);
+    return descriptor_set;
+}
+
+void compute_reset_descriptor_sets(vulkan_t *vulkan, compute_t *compute) {
+    VkResult result = vulkan->vkResetDescriptorPool(vulkan->logical_device, compute->descriptor_pool, 0);
+    assert(result == VK_SUCCESS);
+    compute->descriptor_sets_count = 0;
+}
+
+// the recorded commands stay valid until the next compute_begin, so they can be submitted any number of times
+static void compute_wait_scheduled(vulkan_t *vulkan, compute_t *compute) {
+    if (compute->scheduler == NULL)
+        return;
+    VkResult result =
+        scheduler_wait(vulkan, compute->scheduler, VULKAN_QUEUE_COMPUTE, compute->timeline_value, UINT64_MAX);
+    assert(result == VK_SUCCESS);
+}
+
+VkCommandBuffer compute_begin(vulkan_t *vulkan, compute_t *compute) {
+    compute_wait_scheduled(vulkan, compute);
+    VkResult result = vulkan->vkResetCommandPool(vulkan->logical_device, compute->command_pool, 0);
+    assert(result == VK_SUCCESS);
+
+    VkCommandBufferBeginInfo command_buffer_begin_info = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+    };
+    result = vulkan->vkBeginCommandBuffer(compute->command_buffer, &command_buffer_begin_info);
+    assert(result == VK_SUCCESS);
+    compute->dispatches_count = 0;
+    return compute->command_buffer;
+}
+
+static void compute_bind_kernel(vulkan_t *vulkan, compute_t *compute, compute_kernel_t *kernel, VkDescriptorSet descriptor_set,
+                                const void *push_constants) {
+    vulkan->vkCmdBindPipeline(compute->command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, kernel->pipeline);
+    vulkan->vkCmdBindDescriptorSets(compute->command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, kernel->pipeline_layout, 0, 1,
+                                    &descriptor_set, 0, NULL);
+    if (kernel->push_constants_size > 0)
+        vulkan->vkCmdPushConstants(compute->command_buffer, kernel->pipeline_layout, VK_SHADER_STAGE_COMPUTE_BIT, 0,
+                                   kernel->push_constants_size, push_constants);
+}
+
+void compute_dispatch(vulkan_t *vulkan, compute_t *compute, compute_kernel_t *kernel, VkDescriptorSet descriptor_set,
+                      const void *push_constants, uint32_t groups) {
+    assert(groups <= vulkan->device_properties.limits.maxComputeWorkGroupCount[0]);
+    compute_bind_kernel(vulkan, compute, kernel, descriptor_set, push_constants);
+    vulkan->vkCmdDispatch(compute->command_buffer, groups, 1, 1);
+    compute->dispatches_count++;
+}
+
+// each device in the mask runs its own contiguous slice of the workgroups, reading and writing its own instance of
+// the bound memory, so the slices only come together if the caller copies them across
+void compute_dispatch_split(vulkan_t *vulkan, compute_t *compute, compute_kernel_t *kernel, VkDescriptorSet descriptor_set,
+                            const void *push_constants, uint32_t groups, uint32_t device_mask) {
+    if (vulkan->vkCmdDispatchBaseKHR == NULL) {
+        assert(device_mask & 1);
+        compute_dispatch(vulkan, compute, kernel, descriptor_set, push_constants, groups);
+        return;
+    }
+
+    assert(groups <= vulkan->device_properties.limits.maxComputeWorkGroupCount[0]);
+    uint32_t all_devices = UINT32_MAX >> (32 - vulkan->device_group_count);
+    device_mask &= all_devices;
+    uint32_t devices_count = 0;
+    for (uint32_t i = 0; i < vulkan->device_group_count; i++)
+        devices_count += (device_mask >> i) & 1;
+    assert(devices_count > 0);
+
+    compute_bind_kernel(vulkan, compute, kernel, descriptor_set, push_constants);
+    uint32_t slice = (groups + devices_count - 1) / devices_count;
+    uint32_t base = 0;
+    for (uint32_t i = 0; i < vulkan->device_group_count && base < groups; i++) {
+        if (!((device_mask >> i) & 1))
+            continue;
+        uint32_t count = groups - base < slice ? groups - base : slice;
+        vulkan->vkCmdSetDeviceMaskKHR(compute->command_buffer, 1u << i);
+        vulkan->vkCmdDispatchBaseKHR(compute->command_buffer, base, 0, 0, count, 1, 1);
+        base += count;
+    }
+    vulkan->vkCmdSetDeviceMaskKHR(compute->command_buffer, all_devices);
+    compute->dispatches_count++;
+}
+
+// kernels in a chain read what the previous dispatch or copy wrote, so one global barrier covers both
+void compute_barrier(vulkan_t *vulkan, compute_t *compute) {
+    VkMemoryBarrier memory_barrier = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+        .srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT,
+        .dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_READ_BIT |
+                         VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_HOST_READ_BIT,
+    };
+    vulkan->vkCmdPipelineBarrier(compute->command_buffer,
+                                 VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+                                 VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT |
+                                     VK_PIPELINE_STAGE_HOST_BIT,
+                                 0, 1, &memory_barrier, 0, NULL, 0, NULL);
+}
+
+void compute_end(vulkan_t *vulkan, compute_t *compute) {
+    VkResult result = vulkan->vkEndCommandBuffer(compute->command_buffer);
+    assert(result == VK_SUCCESS);
+}
+
+void compute_submit(vulkan_t *vulkan, compute_t *compute) {
+    VkSubmitInfo submit_info = {
+        .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+        .commandBufferCount = 1,
+        .pCommandBuffers = &compute->command_buffer,
+    };
+    VkResult result = vulkan->vkQueueSubmit(compute->queue.queue, 1, &submit_info, compute->fence);
+    assert(result == VK_SUCCESS);
+    result = vulkan->vkWaitForFences(vulkan->logical_device, 1, &compute->fence, VK_TRUE, UINT64_MAX);
+    assert(result == VK_SUCCESS);
+    result = vulkan->vkResetFences(vulkan->logical_device, 1, &compute->fence);
+    assert(result == VK_SUCCESS);
+}
+
+// returns right away with the compute timeline value that marks completion, the dispatches start once dependencies are met
+uint64_t compute_submit_scheduled(vulkan_t *vulkan, compute_t *compute, scheduler_t *scheduler, uint32_t dependencies_count,
+                                  const scheduler_dependency_t *dependencies) {
+    compute->scheduler = scheduler;
+    compute->timeline_value = scheduler_submit(vulkan, scheduler, VULKAN_QUEUE_COMPUTE, 1, &compute->command_buffer,
+                                               dependencies_count, dependencies);
+    scheduler_flush(vulkan, scheduler);
+    return compute->timeline_value;
+}
+
+void compute_destroy_kernel(vulkan_t *vulkan, compute_kernel_t *kernel) {
+    vulkan->vkDestroyPipeline(vulkan->logical_device, kernel->pipeline, vulkan->allocation_callbacks);
+    vulkan->vkDestroyPipelineLayout(vulkan->logical_device, kernel->pipeline_layout, vulkan->allocation_callbacks);
+    vulkan->vkDestroyDescriptorSetLayout(vulkan->logical_device, kernel->descriptor_set_layout, vulkan->allocation_callbacks);
+    *kernel = (compute_kernel_t){0};
+}
+
+void compute_free_resources(vulkan_t *vulkan, compute_t *compute) {
+    compute_wait_scheduled(vulkan, compute);
+    vulkan->vkDestroyFence(vulkan->logical_device, compute->fence, vulkan->allocation_callbacks);
+    vulkan->vkDestroyCommandPool(vulkan->logical_device, compute->command_pool, vulkan->allocation_callbacks);
+    vulkan->vkDestroyDescriptorPool(vulkan->logical_device, compute->descriptor_pool, vulkan->allocation_callbacks);
+    *compute = (compute_t){0};
+}
+
+typedef struct {
+    VkBuffer buffer;
+    allocation_t allocation;
+} compute_benchmark_buffer_t;
+
+typedef struct {
+    vulkan_t *vulkan;
+    allocator_t allocator;
+    compute_t compute;
+    compute_t copies;
+    compute_benchmark_buffer_t staging;
+    uint32_t workgroup_size;
+    uint32_t iterations;
+    bool verified;
+
+    compute_kernel_t saxpy;
+    compute_kernel_t reduce;
+    compute_kernel_t scan;
+    compute_kernel_t scan_add;
+    compute_kernel_t radix_count;
+    compute_kernel_t radix_scatter;
+} compute_benchmark_t;
+
+// multi-level exclusive scan: each level scans per workgroup and leaves one sum per group for the level above
+typedef struct {
+    uint32_t levels_count;
+    uint32_t counts[COMPUTE_BENCHMARK_MAX_LEVELS];
+    compute_benchmark_buffer_t sums[COMPUTE_BENCHMARK_MAX_LEVELS];
+    compute_benchmark_buffer_t scanned[COMPUTE_BENCHMARK_MAX_LEVELS];
+    VkDescriptorSet scan_sets[COMPUTE_BENCHMARK_MAX_LEVELS];
+    VkDescriptorSet add_sets[COMPUTE_BENCHMARK_MAX_LEVELS];
+} compute_benchmark_scan_t;
+
+static uint32_t compute_groups(uint32_t count, uint32_t per_group) {
+    return (count + per_group - 1) / per_group;
+}
+
+static compute_benchmark_buffer_t compute_benchmark_create_buffer(compute_benchmark_t *benchmark, VkDeviceSize size) {
+    VkBufferCreateInfo buffer_create_info = {
+        .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+        .size = size,
+        .usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+    };
+    compute_benchmark_buffer_t buffer;
+    VkResult result = allocator_create_buffer(benchmark->vulkan, &benchmark->allocator, &buffer_create_info,
+                                              VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 0, &buffer.buffer, &buffer.allocation);
+    assert(result == VK_SUCCESS);
+    return buffer;
+}
+
+static void compute_benchmark_destroy_buffer(compute_benchmark_t *benchmark, compute_benchmark_buffer_t *buffer) {
+    allocator_destroy_buffer(benchmark->vulkan, &benchmark->allocator, buffer->buffer, &buffer->allocation);
+}
+
+// device-local memory is not necessarily mappable, so inputs and results pass through the staging buffer, copied
+// from a command buffer of their own so the kernel recorded for measuring survives verification
+static void compute_benchmark_copy(compute_benchmark_t *benchmark, VkBuffer source, VkBuffer destination, VkDeviceSize size) {
+    vulkan_t *vulkan = benchmark->vulkan;
+    compute_begin(vulkan, &benchmark->copies);
+    VkBufferCopy region = {.size = size};
+    vulkan->vkCmdCopyBuffer(benchmark->copies.command_buffer, source, destination, 1, &region);
+    compute_barrier(vulkan, &benchmark->copies);
+    compute_end(vulkan, &benchmark->copies);
+    compute_submit(vulkan, &benchmark->copies);
+}
+
+static void compute_benchmark_write(compute_benchmark_t *benchmark, compute_benchmark_buffer_t *buffer, const void *data,
+                                    VkDeviceSize size) {
+    memcpy(benchmark->staging.allocation.mapped, data, size);
+    compute_benchmark_copy(benchmark, benchmark->staging.buffer, buffer->buffer, size);
+}
+
+static void compute_benchmark_read(compute_benchmark_t *benchmark, compute_benchmark_buffer_t *buffer, void *data,
+                                   VkDeviceSize size) {
+    compute_benchmark_copy(benchmark, buffer->buffer, benchmark->staging.buffer, size);
+    memcpy(data, benchmark->staging.allocation.mapped, size);
+}
+
+// replays the recorded kernel, which only ever reads its inputs, bytes being the traffic it cannot avoid, and prints the rates from the median run
+static void compute_benchmark_measure(compute_benchmark_t *benchmark, const char *name, bool verified, uint64_t elements,
+                                      uint64_t bytes) {
+    bench_samples_t samples;
+    bench_samples_create(&samples, name, benchmark->iterations);
+    for (uint32_t i = 0; i < benchmark->iterations; i++) {
+        uint64_t start = bench_now_ns();
+        compute_submit(benchmark->vulkan, &benchmark->compute);
+        bench_samples_push(&samples, bench_now_ns() - start);
+    }
+
+    double median = (double)bench_samples_percentile(&samples, 0.5);
+    bench_samples_report(&samples);
+    printf("%-48s %8.2f GB/s %10.2f Melements/s  %u dispatches  %s\n", "", (double)bytes / median,
+           (double)elements * 1000.0 / median, benchmark->compute.dispatches_count, verified ? "verified" : "MISMATCH");
+
+    benchmark->verified = benchmark->verified && verified;
+    bench_samples_free(&samples);
+}
+
+static void compute_benchmark_scan_create(compute_benchmark_t *benchmark, compute_benchmark_scan_t *scan, VkBuffer input,
+                                          VkBuffer output, uint32_t count) {
+    vulkan_t *vulkan = benchmark->vulkan;
+    *scan = (compute_benchmark_scan_t){0};
+
+    for (uint32_t level = 0;; level++) {
+        assert(level < COMPUTE_BENCHMARK_MAX_LEVELS);
+        uint32_t groups = compute_groups(count, benchmark->scan.workgroup_size);
+        scan->counts[level] = count;
+        scan->sums[level] = compute_benchmark_create_buffer(benchmark, groups * sizeof(uint32_t));
+        VkBuffer scan_buffers[] = {input, output, scan->sums[level].buffer};
+        scan->scan_sets[level] = compute_bind_buffers(vulkan, &benchmark->compute, &benchmark->scan, scan_buffers);
+
+        if (groups == 1) {
+            scan->levels_count = level + 1;
+            break;
+        }
+
+        // the level above scans this level's sums into the offsets its groups add back
+        scan->scanned[level] = compute_benchmark_create_buffer(benchmark, groups * sizeof(uint32_t));
+        VkBuffer add_buffers[] = {output, scan->scanned[level].buffer};
+        scan->add_sets[level] = compute_bind_buffers(vulkan, &benchmark->compute, &benchmark->scan_add, add_buffers);
+
+        input = scan->sums[level].buffer;
+        output = scan->scanned[level].buffer;
+        count = groups;
+    }
+}
+
+static void compute_benchmark_scan_record(compute_benchmark_t *benchmark, compute_benchmark_scan_t *scan) {
+    vulkan_t *vulkan = benchmark->vulkan;
+    for (uint32_t level = 0; level < scan->levels_count; level++) {
+        compute_dispatch(vulkan, &benchmark->compute, &benchmark->scan, scan->scan_sets[level], &scan->counts[level],
+                         compute_groups(scan->counts[level], benchmark->scan.workgroup_size));
+        compute_barrier(vulkan, &benchmark->compute);
+    }
+
+    // top down, so every level's offsets are final before the level below adds them
+    for (uint32_t level = scan->levels_count - 1; level-- > 0;) {
+        compute_dispatch(vulkan, &benchmark->compute, &benchmark->scan_add, scan->add_sets[level], &scan->counts[level],
+                         compute_groups(scan->counts[level], benchmark->scan_add.workgroup_size));
+        compute_barrier(vulkan, &benchmark->compute);
+    }
+}
+
+static void compute_benchmark_scan_free(compute_benchmark_t *benchmark, compute_benchmark_scan_t *scan) {
+    for (uint32_t level = 0; level < scan->levels_count; level++) {
+        compute_benchmark_destroy_buffer(benchmark, &scan->sums[level]);
+        if (level + 1 < scan->levels_count)
+            compute_benchmark_destroy_buffer(benchmark, &scan->scanned[level]);
+    }
+}
+
+static void compute_benchmark_saxpy(compute_benchmark_t *benchmark, const uint32_t *random_values) {
+    vulkan_t *vulkan = benchmark->vulkan;
+    uint32_t count = COMPUTE_BENCHMARK_ELEMENTS;
+    VkDeviceSize size = count * sizeof(float);
+
+    float *x = (float *)malloc(size);
+    float *y = (float *)malloc(size);
+    float *result = (float *)malloc(size);
+    for (uint32_t i = 0; i < count; i++) {
+        x[i] = (float)(random_values[i] & 0xffff) / 65536.0f;
+        y[i] = (float)(random_values[i] >> 16) / 65536.0f;
+    }
+
+    compute_benchmark_buffer_t x_buffer = compute_benchmark_create_buffer(benchmark, size);
+    compute_benchmark_buffer_t y_buffer = compute_benchmark_create_buffer(benchmark, size);
+    compute_benchmark_buffer_t result_buffer = compute_benchmark_create_buffer(benchmark, size);
+    compute_benchmark_write(benchmark, &x_buffer, x, size);
+    compute_benchmark_write(benchmark, &y_buffer, y, size);
+
+    struct {
+        uint32_t count;
+        float a;
+    } push_constants = {count, 2.5f};
+    VkBuffer buffers[] = {x_buffer.buffer, y_buffer.buffer, result_buffer.buffer};
+    VkDescriptorSet descriptor_set = compute_bind_buffers(vulkan, &benchmark->compute, &benchmark->saxpy, buffers);
+
+    compute_begin(vulkan, &benchmark->compute);
+    compute_dispatch(vulkan, &benchmark->compute, &benchmark->saxpy, descriptor_set, &push_constants,
+                     compute_groups(count, benchmark->saxpy.workgroup_size));
+    compute_barrier(vulkan, &benchmark->compute);
+    compute_end(vulkan, &benchmark->compute);
+    compute_submit(vulkan, &benchmark->compute);
+    compute_benchmark_read(benchmark, &result_buffer, result, size);
+
+    // the gpu may fuse the multiply-add, so allow the difference of one rounding
+    bool verified = true;
+    for (uint32_t i = 0; i < count && verified; i++) {
+        float expected = push_constants.a * x[i] + y[i];
+        float difference = result[i] > expected ? result[i] - expected : expected - result[i];
+        verified = difference <= expected * 1e-6f;
+    }
+    compute_benchmark_measure(benchmark, "saxpy", verified, count, 3ull * size);
+
+    compute_benchmark_destroy_buffer(benchmark, &x_buffer);
+    compute_benchmark_destroy_buffer(benchmark, &y_buffer);
+    compute_benchmark_destroy_buffer(benchmark, &result_buffer);
+    free(x);
+    free(y);
+    free(result);
+}
+
+static void compute_benchmark_reduce(compute_benchmark_t *benchmark, const uint32_t *random_values) {
+    vulkan_t *vulkan = benchmark->vulkan;
+    uint32_t count = COMPUTE_BENCHMARK_ELEMENTS;
+    uint32_t per_group = benchmark->reduce.workgroup_size * COMPUTE_REDUCE_VALUES_PER_INVOCATION;
+
+    compute_benchmark_buffer_t input = compute_benchmark_create_buffer(benchmark, count * sizeof(uint32_t));
+    compute_benchmark_write(benchmark, &input, random_values, count * sizeof(uint32_t));
+
+    // each level leaves one partial sum per group until a single group is left
+    uint32_t levels_count = 0;
+    uint32_t counts[COMPUTE_BENCHMARK_MAX_LEVELS];
+    compute_benchmark_buffer_t partials[COMPUTE_BENCHMARK_MAX_LEVELS];
+    VkDescriptorSet descriptor_sets[COMPUTE_BENCHMARK_MAX_LEVELS];
+    VkBuffer level_input = input.buffer;
+    for (uint32_t level_count = count;; level_count = compute_groups(level_count, per_group)) {
+        assert(levels_count < COMPUTE_BENCHMARK_MAX_LEVELS);
+        counts[levels_count] = level_count;
+        partials[levels_count] =
+            compute_benchmark_create_buffer(benchmark, compute_groups(level_count, per_group) * sizeof(uint32_t));
+        VkBuffer buffers[] = {level_input, partials[levels_count].buffer};
+        descriptor_sets[levels_count] = compute_bind_buffers(vulkan, &benchmark->compute, &benchmark->reduce, buffers);
+        level_input = partials[levels_count++].buffer;
+        if (level_count <= per_group)
+            break;
+    }
+
+    compute_begin(vulkan, &benchmark->compute);
+    for (uint32_t level = 0; level < levels_count; level++) {
+        compute_dispatch(vulkan, &benchmark->compute, &benchmark->reduce, descriptor_sets[level], &counts[level],
+                         compute_groups(counts[level], per_group));
+        compute_barrier(vulkan, &benchmark->compute);
+    }
+    compute_end(vulkan, &benchmark->compute);
+    compute_submit(vulkan, &benchmark->compute);
+
+    uint32_t sum = 0;
+    compute_benchmark_read(benchmark, &partials[levels_count - 1], &sum, sizeof(sum));
+
+    // sums wrap the same way on both sides
+    uint32_t expected = 0;
+    for (uint32_t i = 0; i < count; i++)
+        expected += random_values[i];
+    compute_benchmark_measure(benchmark, "reduction", sum == expected, count, count * sizeof(uint32_t));
+
+    for (uint32_t level = 0; level < levels_count; level++)
+        compute_benchmark_destroy_buffer(benchmark, &partials[level]);
+    compute_benchmark_destroy_buffer(benchmark, &input);
+}
+
+static void compute_benchmark_prefix_scan(compute_benchmark_t *benchmark, const uint32_t *random_values) {
+    vulkan_t *vulkan = benchmark->vulkan;
+    uint32_t count = COMPUTE_BENCHMARK_ELEMENTS;
+    VkDeviceSize size = count * sizeof(uint32_t);
+
+    compute_benchmark_buffer_t input = compute_benchmark_create_buffer(benchmark, size);
+    compute_benchmark_buffer_t output = compute_benchmark_create_buffer(benchmark, size);
+    compute_benchmark_write(benchmark, &input, random_values, size);
+
+    compute_benchmark_scan_t scan;
+    compute_benchmark_scan_create(benchmark, &scan, input.buffer, output.buffer, count);
+
+    compute_begin(vulkan, &benchmark->compute);
+    compute_benchmark_scan_record(benchmark, &scan);
+    compute_end(vulkan, &benchmark->compute);
+    compute_submit(vulkan, &benchmark->compute);
+
+    uint32_t *result = (uint32_t *)malloc(size);
+    compute_benchmark_read(benchmark, &output, result, size);
+    bool verified = true;
+    uint32_t expected = 0;
+    for (uint32_t i = 0; i < count && verified; i++) {
+        verified = result[i] == expected;
+        expected += random_values[i];
+    }
+
+    compute_benchmark_measure(benchmark, "exclusive prefix scan", verified, count, 2ull * size);
+
+    compute_benchmark_scan_free(benchmark, &scan);
+    compute_benchmark_destroy_buffer(benchmark, &input);
+    compute_benchmark_destroy_buffer(benchmark, &output);
+    free(result);
+}
+
+static int compute_compare_keys(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t *)a;
+    uint32_t y = *(const uint32_t *)b;
+    return (x > y) - (x < y);
+}
+
+// least significant digit first: count digits per group, scan the digit-major counts, then scatter stably
+static void compute_benchmark_radix_sort(compute_benchmark_t *benchmark, const uint32_t *random_values) {
+    vulkan_t *vulkan = benchmark->vulkan;
+    uint32_t count = COMPUTE_BENCHMARK_ELEMENTS;
+    VkDeviceSize size = count * sizeof(uint32_t);
+    uint32_t groups = compute_groups(count, benchmark->radix_scatter.workgroup_size * COMPUTE_RADIX_KEYS_PER_INVOCATION);
+    uint32_t digits = 1u << COMPUTE_RADIX_BITS;
+
+    compute_benchmark_buffer_t input = compute_benchmark_create_buffer(benchmark, size);
+    compute_benchmark_buffer_t keys[2] = {
+        compute_benchmark_create_buffer(benchmark, size),
+        compute_benchmark_create_buffer(benchmark, size),
+    };
+    compute_benchmark_buffer_t counts = compute_benchmark_create_buffer(benchmark, digits * groups * sizeof(uint32_t));
+    compute_benchmark_buffer_t offsets = compute_benchmark_create_buffer(benchmark, digits * groups * sizeof(uint32_t));
+    compute_benchmark_write(benchmark, &input, random_values, size);
+
+    compute_benchmark_scan_t scan;
+    compute_benchmark_scan_create(benchmark, &scan, counts.buffer, offsets.buffer, digits * groups);
+
+    // the first pass reads the untouched input, the rest ping-pong, so the sort can be replayed
+    VkDescriptorSet count_sets[COMPUTE_RADIX_PASSES];
+    VkDescriptorSet scatter_sets[COMPUTE_RADIX_PASSES];
+    for (uint32_t pass = 0; pass < COMPUTE_RADIX_PASSES; pass++) {
+        VkBuffer source = pass == 0 ? input.buffer : keys[(pass + 1) % 2].buffer;
+        VkBuffer count_buffers[] = {source, counts.buffer};
+        VkBuffer scatter_buffers[] = {source, keys[pass % 2].buffer, offsets.buffer};
+        count_sets[pass] = compute_bind_buffers(vulkan, &benchmark->compute, &benchmark->radix_count, count_buffers);
+        scatter_sets[pass] = compute_bind_buffers(vulkan, &benchmark->compute, &benchmark->radix_scatter, scatter_buffers);
+    }
+
+    compute_begin(vulkan, &benchmark->compute);
+    for (uint32_t pass = 0; pass < COMPUTE_RADIX_PASSES; pass++) {
+        uint32_t push_constants[] = {count, pass * COMPUTE_RADIX_BITS, groups};
+        compute_dispatch(vulkan, &benchmark->compute, &benchmark->radix_count, count_sets[pass], push_constants, groups);
+        compute_barrier(vulkan, &benchmark->compute);
+        compute_benchmark_scan_record(benchmark, &scan);
+        compute_dispatch(vulkan, &benchmark->compute, &benchmark->radix_scatter, scatter_sets[pass], push_constants, groups);
+        compute_barrier(vulkan, &benchmark->compute);
+    }
+    compute_end(vulkan, &benchmark->compute);
+    compute_submit(vulkan, &benchmark->compute);
+
+    uint32_t *result = (uint32_t *)malloc(size);
+    uint32_t *expected = (uint32_t *)malloc(size);
+    compute_benchmark_read(benchmark, &keys[(COMPUTE_RADIX_PASSES - 1) % 2], result, size);
+    memcpy(expected, random_values, size);
+    qsort(expected, count, sizeof(uint32_t), compute_compare_keys);
+    bool verified = memcmp(result, expected, size) == 0;
+
+    // every pass has to read and write every key once
+    compute_benchmark_measure(benchmark, "radix sort, 32-bit keys", verified, count,
+                              2ull * COMPUTE_RADIX_PASSES * size);
+
+    compute_benchmark_scan_free(benchmark, &scan);
+    compute_benchmark_destroy_buffer(benchmark, &input);
+    compute_benchmark_destroy_buffer(benchmark, &keys[0]);
+    compute_benchmark_destroy_buffer(benchmark, &keys[1]);
+    compute_benchmark_destroy_buffer(benchmark, &counts);
+    compute_benchmark_destroy_buffer(benchmark, &offsets);
+    free(result);
+    free(expected);
+}
+
+void compute_benchmark(uint32_t iterations) {
+    vulkan_t vulkan = {.headless = true};
+    bench_bootstrap(&vulkan);
+
+    compute_benchmark_t benchmark = {
+        .vulkan = &vulkan,
+        .iterations = iterations,
+        .verified = true,
+    };
+    allocator_create(&vulkan, &benchmark.allocator);
+    compute_create(&vulkan, &benchmark.compute);
+    compute_create(&vulkan, &benchmark.copies);
+
+    VkBufferCreateInfo buffer_create_info = {
+        .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+        .size = COMPUTE_BENCHMARK_ELEMENTS * sizeof(uint32_t),
+        .usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+    };
+    VkResult result = allocator_create_buffer(&vulkan, &benchmark.allocator, &buffer_create_info,
+                                              VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, 0,
+                                              &benchmark.staging.buffer, &benchmark.staging.allocation);
+    assert(result == VK_SUCCESS && benchmark.staging.allocation.mapped);
+
+    // the tree reductions in the kernels need a power of two, and radix scatter keeps a 16-wide prefix per invocation
+    uint32_t workgroup_size = 256;
+    while (workgroup_size > vulkan.device_properties.limits.maxComputeWorkGroupSize[0] ||
+           workgroup_size > vulkan.device_properties.limits.maxComputeWorkGroupInvocations)
+        workgroup_size /= 2;
+    uint32_t radix_workgroup_size = workgroup_size / 2;
+    assert(radix_workgroup_size >= (1u << COMPUTE_RADIX_BITS));
+    assert((1u << COMPUTE_RADIX_BITS) * radix_workgroup_size * sizeof(uint32_t) <=
+           vulkan.device_properties.limits.maxComputeSharedMemorySize);
+
+    uint32_t reduce_constants[] = {COMPUTE_REDUCE_VALUES_PER_INVOCATION};
+    uint32_t radix_constants[] = {COMPUTE_RADIX_KEYS_PER_INVOCATION};
+    compute_create_kernel(&vulkan, &benchmark.saxpy, "shaders/saxpy.spv", workgroup_size, 0, NULL, 3,
+                          2 * sizeof(uint32_t));
+    compute_create_kernel(&vulkan, &benchmark.reduce, "shaders/reduce.spv", workgroup_size, 1, reduce_constants, 2,
+                          sizeof(uint32_t));
+    compute_create_kernel(&vulkan, &benchmark.scan, "shaders/scan.spv", workgroup_size, 0, NULL, 3, sizeof(uint32_t));
+    compute_create_kernel(&vulkan, &benchmark.scan_add, "shaders/scan_add.spv", workgroup_size, 0, NULL, 2,
+                          sizeof(uint32_t));
+    compute_create_kernel(&vulkan, &benchmark.radix_count, "shaders/radix_count.spv", radix_workgroup_size, 1,
+                          radix_constants, 2, 3 * sizeof(uint32_t));
+    compute_create_kernel(&vulkan, &benchmark.radix_scatter, "shaders/radix_scatter.spv", radix_workgroup_size, 1,
+                          radix_constants, 3, 3 * sizeof(uint32_t));
+
+    uint64_t random = 0x9e3779b97f4a7c15ull;
+    uint32_t *random_values = (uint32_t *)malloc(COMPUTE_BENCHMARK_ELEMENTS * sizeof(uint32_t));
+    for (uint32_t i = 0; i < COMPUTE_BENCHMARK_ELEMENTS; i++)
+        random_values[i] = (uint32_t)(bench_random(&random) >> 32);
+
+    printf("compute: %u elements, workgroup size %u, %u runs per kernel on %s\n", COMPUTE_BENCHMARK_ELEMENTS, workgroup_size,
+           iterations, vulkan.device_properties.deviceName);
+    compute_benchmark_saxpy(&benchmark, random_values);
+    compute_benchmark_reduce(&benchmark, random_values);
+    compute_benchmark_prefix_scan(&benchmark, random_values);
+    compute_benchmark_radix_sort(&benchmark, random_values);
+    bool verified = benchmark.verified;
+
+    free(random_values);
+    compute_destroy_kernel(&vulkan, &benchmark.saxpy);
+    compute_destroy_kernel(&vulkan, &benchmark.reduce);
+    compute_destroy_kernel(&vulkan, &benchmark.scan);
+    compute_destroy_kernel(&vulkan, &benchmark.scan_add);
+    compute_destroy_kernel(&vulkan, &benchmark.radix_count);
+    compute_destroy_kernel(&vulkan, &benchmark.radix_scatter);
+    allocator_destroy_buffer(&vulkan, &benchmark.allocator, benchmark.staging.buffer, &benchmark.staging.allocation);
+    compute_free_resources(&vulkan, &benchmark.compute);
+    compute_free_resources(&vulkan, &benchmark.copies);
+    allocator_free_resources(&vulkan, &benchmark.allocator);
+    vulkan_free_resources(&vulkan);
+
+    // ci runs this suite for correctness as much as for speed, so a wrong result fails the run
+    if (!verified) {
+        fprintf(stderr, "compute: a kernel disagreed with the cpu reference\n");
+        exit(EXIT_FAILURE);
+    }
+}
@@ -0,0 +1,55 @@
+#ifndef COMPUTE_H
+#define COMPUTE_H
+
+#include "scheduler.h"
+#include "vulkan.h"
+
+#define COMPUTE_MAX_BINDINGS 4
+#define COMPUTE_MAX_CONSTANTS 4
+#define COMPUTE_MAX_DESCRIPTOR_SETS 256
+
+// one compute pipeline, specialization constant 0 is the workgroup size and 1.. are the kernel's own constants
+typedef struct {
+    VkDescriptorSetLayout descriptor_set_layout;
+    VkPipelineLayout pipeline_layout;
+    VkPipeline pipeline;
+    uint32_t bindings_count;
+    uint32_t push_constants_size;
+    uint32_t workgroup_size;
+} compute_kernel_t;
+
+typedef struct {
+    vulkan_queue_t queue;
+    VkDescriptorPool descriptor_pool;
+    VkCommandPool command_pool;
+    VkCommandBuffer command_buffer;
+    VkFence fence;
+    // set once the command buffer went out through a scheduler, compute_begin waits for it before recording again
+    scheduler_t *scheduler;
+    uint64_t timeline_value;
+    uint32_t descriptor_sets_count;
+    uint32_t dispatches_count;
+} compute_t;
+
+void compute_create(vulkan_t *vulkan, compute_t *compute);
+void compute_create_kernel(vulkan_t *vulkan, compute_kernel_t *kernel, const char *path, uint32_t workgroup_size,
+                           uint32_t constants_count, const uint32_t *constants, uint32_t bindings_count,
+                           uint32_t push_constants_size);
+VkDescriptorSet compute_bind_buffers(vulkan_t *vulkan, compute_t *compute, compute_kernel_t *kernel, const VkBuffer *buffers);
+void compute_reset_descriptor_sets(vulkan_t *vulkan, compute_t *compute);
+VkCommandBuffer compute_begin(vulkan_t *vulkan, compute_t *compute);
+void compute_dispatch(vulkan_t *vulkan, compute_t *compute, compute_kernel_t *kernel, VkDescriptorSet descriptor_set,
+                      const void *push_constants, uint32_t groups);
+void compute_dispatch_split(vulkan_t *vulkan, compute_t *compute, compute_kernel_t *kernel, VkDescriptorSet descriptor_set,
+                            const void *push_constants, uint32_t groups, uint32_t device_mask);
+void compute_barrier(vulkan_t *vulkan, compute_t *compute);
+void compute_end(vulkan_t *vulkan, compute_t *compute);
+void compute_submit(vulkan_t *vulkan, compute_t *compute);
+uint64_t compute_submit_scheduled(vulkan_t *vulkan, compute_t *compute, scheduler_t *scheduler, uint32_t dependencies_count,
+                                  const scheduler_dependency_t *dependencies);
+void compute_destroy_kernel(vulkan_t *vulkan, compute_kernel_t *kernel);
+void compute_free_resources(vulkan_t *vulkan, compute_t *compute);
+
+void compute_benchmark(uint32_t iterations);
+
+#endif // COMPUTE_H
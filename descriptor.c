@@ -0,0 +1,630 @@
+#include "descriptor.h"
+#include "allocator.h"
+#include "bench.h"
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define DESCRIPTOR_BENCHMARK_DRAWS 4096
+#define DESCRIPTOR_BENCHMARK_BUFFERS 64
+#define DESCRIPTOR_BENCHMARK_FRAMES 2
+
+static const VkDescriptorType descriptor_heap_types[DESCRIPTOR_HEAP_TYPE_COUNT] = {
+    [DESCRIPTOR_HEAP_SAMPLED_IMAGE] = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE,
+    [DESCRIPTOR_HEAP_STORAGE_IMAGE] = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+    [DESCRIPTOR_HEAP_STORAGE_BUFFER] = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+    [DESCRIPTOR_HEAP_SAMPLER] = VK_DESCRIPTOR_TYPE_SAMPLER,
+};
+
+// fnv-1a over the normalized key, which has no padding or stale entries left to tell equal keys apart
+static uint64_t descriptor_hash(const void *data, size_t size) {
+    const uint8_t *bytes = (const uint8_t *)data;
+    uint64_t hash = 0xcbf29ce484222325ull;
+    for (size_t i = 0; i < size; i++)
+        hash = (hash ^ bytes[i]) * 0x100000001b3ull;
+    return hash;
+}
+
+static uint32_t descriptor_min(uint32_t a, uint32_t b) {
+    return a < b ? a : b;
+}
+
+static void descriptor_free_list_create(arena_t *arena, descriptor_free_list_t *list, uint32_t capacity) {
+    *list = (descriptor_free_list_t){
+        .capacity = capacity,
+        .free_head = capacity > 0 ? 0 : DESCRIPTOR_FREE_LIST_END,
+        .next = (uint32_t *)arena_allocate(arena, sizeof(uint32_t) * (capacity > 0 ? capacity : 1)),
+    };
+    for (uint32_t i = 0; i < capacity; i++)
+        list->next[i] = i + 1 < capacity ? i + 1 : DESCRIPTOR_FREE_LIST_END;
+    for (uint32_t i = 0; i < DESCRIPTOR_MAX_FRAMES; i++)
+        list->retired_heads[i] = DESCRIPTOR_FREE_LIST_END;
+}
+
+// slots released during this frame index go back on the free list now that its commands have completed
+static void descriptor_free_list_recycle(descriptor_free_list_t *list, uint32_t frame_index) {
+    for (uint32_t slot = list->retired_heads[frame_index]; slot != DESCRIPTOR_FREE_LIST_END;) {
+        uint32_t next = list->next[slot];
+        list->next[slot] = list->free_head;
+        list->free_head = slot;
+        list->used_count--;
+        slot = next;
+    }
+    list->retired_heads[frame_index] = DESCRIPTOR_FREE_LIST_END;
+}
+
+// one set holding every resource, its arrays sized to the device's update-after-bind limits, written while bound and
+// only partially filled, with one pipeline layout whose push constants carry the slots a draw or dispatch reads
+static void descriptor_heap_create(vulkan_t *vulkan, descriptor_t *descriptor) {
+    descriptor_heap_t *heap = &descriptor->heap;
+    heap->available = vulkan_device_extension_enabled(vulkan, VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME);
+    if (!heap->available)
+        return;
+
+    VkPhysicalDeviceDescriptorIndexingPropertiesEXT *properties = &vulkan->descriptor_indexing_properties;
+    uint32_t limits[DESCRIPTOR_HEAP_TYPE_COUNT] = {
+        [DESCRIPTOR_HEAP_SAMPLED_IMAGE] = descriptor_min(properties->maxDescriptorSetUpdateAfterBindSampledImages,
+                                                         properties->maxPerStageDescriptorUpdateAfterBindSampledImages),
+        [DESCRIPTOR_HEAP_STORAGE_IMAGE] = descriptor_min(properties->maxDescriptorSetUpdateAfterBindStorageImages,
+                                                         properties->maxPerStageDescriptorUpdateAfterBindStorageImages),
+        [DESCRIPTOR_HEAP_STORAGE_BUFFER] = descriptor_min(properties->maxDescriptorSetUpdateAfterBindStorageBuffers,
+                                                          properties->maxPerStageDescriptorUpdateAfterBindStorageBuffers),
+        [DESCRIPTOR_HEAP_SAMPLER] = descriptor_min(properties->maxDescriptorSetUpdateAfterBindSamplers,
+                                                   properties->maxPerStageDescriptorUpdateAfterBindSamplers),
+    };
+
+    descriptor_set_layout_key_t key = {
+        .flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT_EXT,
+        .bindings_count = DESCRIPTOR_HEAP_TYPE_COUNT,
+    };
+    VkDescriptorPoolSize pool_sizes[DESCRIPTOR_HEAP_TYPE_COUNT];
+    for (uint32_t type = 0; type < DESCRIPTOR_HEAP_TYPE_COUNT; type++) {
+        // every binding is visible to every stage, so the per-stage resource total is shared between them
+        uint32_t capacity = descriptor_min(DESCRIPTOR_HEAP_CAPACITY, limits[type]);
+        capacity = descriptor_min(capacity, properties->maxPerStageUpdateAfterBindResources / DESCRIPTOR_HEAP_TYPE_COUNT);
+        assert(capacity > 0);
+        descriptor_free_list_create(&descriptor->arena, &heap->free_lists[type], capacity);
+
+        key.bindings[type] = (VkDescriptorSetLayoutBinding){
+            .binding = type,
+            .descriptorType = descriptor_heap_types[type],
+            .descriptorCount = capacity,
+            .stageFlags = VK_SHADER_STAGE_ALL,
+        };
+        key.binding_flags[type] = VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT_EXT |
+                                  VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT_EXT |
+                                  VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT_EXT;
+        pool_sizes[type] = (VkDescriptorPoolSize){
+            .type = descriptor_heap_types[type],
+            .descriptorCount = capacity,
+        };
+    }
+    heap->layout = descriptor_get_set_layout(vulkan, descriptor, &key);
+
+    descriptor_pipeline_layout_key_t pipeline_layout_key = {
+        .set_layouts_count = 1,
+        .set_layouts = {heap->layout},
+        .push_constant_ranges_count = 1,
+        .push_constant_ranges = {{VK_SHADER_STAGE_ALL, 0, DESCRIPTOR_HEAP_PUSH_CONSTANTS_SIZE}},
+    };
+    heap->pipeline_layout = descriptor_get_pipeline_layout(vulkan, descriptor, &pipeline_layout_key);
+
+    VkDescriptorPoolCreateInfo descriptor_pool_create_info = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+        .flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT_EXT,
+        .maxSets = 1,
+        .poolSizeCount = DESCRIPTOR_HEAP_TYPE_COUNT,
+        .pPoolSizes = pool_sizes,
+    };
+    VkResult result = vulkan->vkCreateDescriptorPool(vulkan->logical_device, &descriptor_pool_create_info,
+                                                     vulkan->allocation_callbacks, &heap->pool);
+    assert(result == VK_SUCCESS);
+
+    VkDescriptorSetAllocateInfo descriptor_set_allocate_info = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+        .descriptorPool = heap->pool,
+        .descriptorSetCount = 1,
+        .pSetLayouts = &heap->layout,
+    };
+    result = vulkan->vkAllocateDescriptorSets(vulkan->logical_device, &descriptor_set_allocate_info, &heap->set);
+    assert(result == VK_SUCCESS);
+}
+
+void descriptor_create(vulkan_t *vulkan, descriptor_t *descriptor, uint32_t frames_count) {
+    assert(frames_count > 0 && frames_count <= DESCRIPTOR_MAX_FRAMES);
+    memset(descriptor, 0, sizeof(*descriptor));
+    descriptor->frames_count = frames_count;
+    descriptor_heap_create(vulkan, descriptor);
+}
+
+// hash-consed, equal keys always get the same layout, which lives until descriptor_free_resources
+VkDescriptorSetLayout descriptor_get_set_layout(vulkan_t *vulkan, descriptor_t *descriptor,
+                                                const descriptor_set_layout_key_t *key) {
+    assert(key->bindings_count <= DESCRIPTOR_MAX_BINDINGS);
+    descriptor_set_layout_key_t normalized;
+    memset(&normalized, 0, sizeof(normalized));
+    normalized.flags = key->flags;
+    normalized.bindings_count = key->bindings_count;
+    bool binding_flags = false;
+    for (uint32_t i = 0; i < key->bindings_count; i++) {
+        assert(key->bindings[i].pImmutableSamplers == NULL);
+        normalized.bindings[i] = key->bindings[i];
+        normalized.binding_flags[i] = key->binding_flags[i];
+        binding_flags = binding_flags || key->binding_flags[i] != 0;
+    }
+
+    uint64_t hash = descriptor_hash(&normalized, sizeof(normalized));
+    uint32_t slot = (uint32_t)hash & (DESCRIPTOR_CACHE_CAPACITY - 1);
+    for (; descriptor->set_layouts[slot].layout != VK_NULL_HANDLE; slot = (slot + 1) & (DESCRIPTOR_CACHE_CAPACITY - 1)) {
+        descriptor_set_layout_entry_t *entry = &descriptor->set_layouts[slot];
+        if (entry->hash == hash && memcmp(&entry->key, &normalized, sizeof(normalized)) == 0) {
+            descriptor->frame_stats.layout_hits++;
+            return entry->layout;
+        }
+    }
+
+    // kept at most half full, so probes stay short
+    assert((descriptor->set_layouts_count + 1) * 2 <= DESCRIPTOR_CACHE_CAPACITY);
+    VkDescriptorSetLayoutBindingFlagsCreateInfoEXT binding_flags_create_info = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO_EXT,
+        .bindingCount = normalized.bindings_count,
+        .pBindingFlags = normalized.binding_flags,
+    };
+    VkDescriptorSetLayoutCreateInfo descriptor_set_layout_create_info = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+        .pNext = binding_flags ? &binding_flags_create_info : NULL,
+        .flags = normalized.flags,
+        .bindingCount = normalized.bindings_count,
+        .pBindings = normalized.bindings,
+    };
+    descriptor_set_layout_entry_t *entry = &descriptor->set_layouts[slot];
+    VkResult result = vulkan->vkCreateDescriptorSetLayout(vulkan->logical_device, &descriptor_set_layout_create_info,
+                                                          vulkan->allocation_callbacks, &entry->layout);
+    assert(result == VK_SUCCESS);
+    entry->hash = hash;
+    entry->key = normalized;
+    descriptor->set_layouts_count++;
+    descriptor->frame_stats.layout_misses++;
+    return entry->layout;
+}
+
+VkPipelineLayout descriptor_get_pipeline_layout(vulkan_t *vulkan, descriptor_t *descriptor,
+                                                const descriptor_pipeline_layout_key_t *key) {
+    assert(key->set_layouts_count <= DESCRIPTOR_MAX_SET_LAYOUTS &&
+           key->push_constant_ranges_count <= DESCRIPTOR_MAX_PUSH_CONSTANT_RANGES);
+    descriptor_pipeline_layout_key_t normalized;
+    memset(&normalized, 0, sizeof(normalized));
+    normalized.set_layouts_count = key->set_layouts_count;
+    normalized.push_constant_ranges_count = key->push_constant_ranges_count;
+    for (uint32_t i = 0; i < key->set_layouts_count; i++)
+        normalized.set_layouts[i] = key->set_layouts[i];
+    for (uint32_t i = 0; i < key->push_constant_ranges_count; i++)
+        normalized.push_constant_ranges[i] = key->push_constant_ranges[i];
+
+    uint64_t hash = descriptor_hash(&normalized, sizeof(normalized));
+    uint32_t slot = (uint32_t)hash & (DESCRIPTOR_CACHE_CAPACITY - 1);
+    for (; descriptor->pipeline_layouts[slot].layout != VK_NULL_HANDLE; slot = (slot + 1) & (DESCRIPTOR_CACHE_CAPACITY - 1)) {
+        descriptor_pipeline_layout_entry_t *entry = &descriptor->pipeline_layouts[slot];
+        if (entry->hash == hash && memcmp(&entry->key, &normalized, sizeof(normalized)) == 0) {
+            descriptor->frame_stats.layout_hits++;
+            return entry->layout;
+        }
+    }
+
+    assert((descriptor->pipeline_layouts_count + 1) * 2 <= DESCRIPTOR_CACHE_CAPACITY);
+    VkPipelineLayoutCreateInfo pipeline_layout_create_info = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+        .setLayoutCount = normalized.set_layouts_count,
+        .pSetLayouts = normalized.set_layouts,
+        .pushConstantRangeCount = normalized.push_constant_ranges_count,
+        .pPushConstantRanges = normalized.push_constant_ranges,
+    };
+    descriptor_pipeline_layout_entry_t *entry = &descriptor->pipeline_layouts[slot];
+    VkResult result = vulkan->vkCreatePipelineLayout(vulkan->logical_device, &pipeline_layout_create_info,
+                                                     vulkan->allocation_callbacks, &entry->layout);
+    assert(result == VK_SUCCESS);
+    entry->hash = hash;
+    entry->key = normalized;
+    descriptor->pipeline_layouts_count++;
+    descriptor->frame_stats.layout_misses++;
+    return entry->layout;
+}
+
+// the caller has waited for this frame index's previous commands, so its sets and retired heap slots are free again
+void descriptor_begin_frame(vulkan_t *vulkan, descriptor_t *descriptor, uint32_t frame_index) {
+    assert(frame_index < descriptor->frames_count);
+    descriptor_stats_t *frame = &descriptor->frame_stats, *total = &descriptor->total_stats;
+    total->updates += frame->updates;
+    total->binds += frame->binds;
+    total->sets_allocated += frame->sets_allocated;
+    total->pools_created += frame->pools_created;
+    total->layout_hits += frame->layout_hits;
+    total->layout_misses += frame->layout_misses;
+    descriptor->last_frame_stats = *frame;
+    *frame = (descriptor_stats_t){0};
+
+    descriptor->frame_index = frame_index;
+    descriptor_frame_t *pools = &descriptor->frames[frame_index];
+    for (uint32_t i = 0; i < pools->pools_count && i <= pools->current_pool; i++) {
+        VkResult result = vulkan->vkResetDescriptorPool(vulkan->logical_device, pools->pools[i], 0);
+        assert(result == VK_SUCCESS);
+    }
+    pools->current_pool = 0;
+    pools->current_pool_sets = 0;
+
+    if (descriptor->heap.available)
+        for (uint32_t type = 0; type < DESCRIPTOR_HEAP_TYPE_COUNT; type++)
+            descriptor_free_list_recycle(&descriptor->heap.free_lists[type], frame_index);
+}
+
+uint32_t descriptor_heap_allocate(descriptor_t *descriptor, descriptor_heap_type_t type) {
+    assert(descriptor->heap.available && type < DESCRIPTOR_HEAP_TYPE_COUNT);
+    descriptor_free_list_t *list = &descriptor->heap.free_lists[type];
+    uint32_t slot = list->free_head;
+    assert(slot != DESCRIPTOR_FREE_LIST_END);
+    list->free_head = list->next[slot];
+    list->used_count++;
+    return slot;
+}
+
+// commands recorded this frame may still read the slot, so it only returns to the free list when the frame retires
+void descriptor_heap_free(descriptor_t *descriptor, descriptor_heap_type_t type, uint32_t slot) {
+    assert(descriptor->heap.available && type < DESCRIPTOR_HEAP_TYPE_COUNT);
+    descriptor_free_list_t *list = &descriptor->heap.free_lists[type];
+    assert(slot < list->capacity);
+    list->next[slot] = list->retired_heads[descriptor->frame_index];
+    list->retired_heads[descriptor->frame_index] = slot;
+}
+
+void descriptor_heap_write_image(vulkan_t *vulkan, descriptor_t *descriptor, descriptor_heap_type_t type, uint32_t slot,
+                                 VkImageView image_view, VkImageLayout layout) {
+    assert(type == DESCRIPTOR_HEAP_SAMPLED_IMAGE || type == DESCRIPTOR_HEAP_STORAGE_IMAGE);
+    VkDescriptorImageInfo image_info = {
+        .imageView = image_view,
+        .imageLayout = layout,
+    };
+    VkWriteDescriptorSet write = {
+        .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+        .dstSet = descriptor->heap.set,
+        .dstBinding = type,
+        .dstArrayElement = slot,
+        .descriptorCount = 1,
+        .descriptorType = descriptor_heap_types[type],
+        .pImageInfo = &image_info,
+    };
+    descriptor_update(vulkan, descriptor, 1, &write);
+}
+
+void descriptor_heap_write_buffer(vulkan_t *vulkan, descriptor_t *descriptor, uint32_t slot, VkBuffer buffer,
+                                  VkDeviceSize offset, VkDeviceSize range) {
+    VkDescriptorBufferInfo buffer_info = {
+        .buffer = buffer,
+        .offset = offset,
+        .range = range,
+    };
+    VkWriteDescriptorSet write = {
+        .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+        .dstSet = descriptor->heap.set,
+        .dstBinding = DESCRIPTOR_HEAP_STORAGE_BUFFER,
+        .dstArrayElement = slot,
+        .descriptorCount = 1,
+        .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+        .pBufferInfo = &buffer_info,
+    };
+    descriptor_update(vulkan, descriptor, 1, &write);
+}
+
+void descriptor_heap_write_sampler(vulkan_t *vulkan, descriptor_t *descriptor, uint32_t slot, VkSampler sampler) {
+    VkDescriptorImageInfo image_info = {
+        .sampler = sampler,
+    };
+    VkWriteDescriptorSet write = {
+        .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+        .dstSet = descriptor->heap.set,
+        .dstBinding = DESCRIPTOR_HEAP_SAMPLER,
+        .dstArrayElement = slot,
+        .descriptorCount = 1,
+        .descriptorType = VK_DESCRIPTOR_TYPE_SAMPLER,
+        .pImageInfo = &image_info,
+    };
+    descriptor_update(vulkan, descriptor, 1, &write);
+}
+
+void descriptor_bind_heap(vulkan_t *vulkan, descriptor_t *descriptor, VkCommandBuffer command_buffer,
+                          VkPipelineBindPoint bind_point) {
+    assert(descriptor->heap.available);
+    descriptor_bind(vulkan, descriptor, command_buffer, bind_point, descriptor->heap.pipeline_layout, 0, 1,
+                    &descriptor->heap.set);
+}
+
+static VkDescriptorPool descriptor_create_pool(vulkan_t *vulkan, descriptor_t *descriptor) {
+    VkDescriptorPoolSize pool_sizes[] = {
+        {VK_DESCRIPTOR_TYPE_SAMPLER, DESCRIPTOR_POOL_SETS},
+        {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, DESCRIPTOR_POOL_SETS * 2},
+        {VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, DESCRIPTOR_POOL_SETS * 2},
+        {VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, DESCRIPTOR_POOL_SETS},
+        {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, DESCRIPTOR_POOL_SETS * 2},
+        {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, DESCRIPTOR_POOL_SETS * 2},
+    };
+    VkDescriptorPoolCreateInfo descriptor_pool_create_info = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+        .maxSets = DESCRIPTOR_POOL_SETS,
+        .poolSizeCount = sizeof(pool_sizes) / sizeof(*pool_sizes),
+        .pPoolSizes = pool_sizes,
+    };
+    VkDescriptorPool pool;
+    VkResult result = vulkan->vkCreateDescriptorPool(vulkan->logical_device, &descriptor_pool_create_info,
+                                                     vulkan->allocation_callbacks, &pool);
+    assert(result == VK_SUCCESS);
+    descriptor->frame_stats.pools_created++;
+    return pool;
+}
+
+// the fallback path, sets that only live for the current frame, from pools that are never freed set by set
+VkDescriptorSet descriptor_allocate_set(vulkan_t *vulkan, descriptor_t *descriptor, VkDescriptorSetLayout layout) {
+    descriptor_frame_t *frame = &descriptor->frames[descriptor->frame_index];
+    for (;;) {
+        if (frame->current_pool_sets == DESCRIPTOR_POOL_SETS) {
+            frame->current_pool++;
+            frame->current_pool_sets = 0;
+        }
+        if (frame->current_pool == frame->pools_count) {
+            if (frame->pools_count == frame->pools_capacity) {
+                uint32_t grown_capacity = frame->pools_capacity ? frame->pools_capacity * 2 : 4;
+                frame->pools = (VkDescriptorPool *)arena_reallocate(&descriptor->arena, frame->pools,
+                                                                    sizeof(VkDescriptorPool) * frame->pools_capacity,
+                                                                    sizeof(VkDescriptorPool) * grown_capacity);
+                frame->pools_capacity = grown_capacity;
+            }
+            frame->pools[frame->pools_count++] = descriptor_create_pool(vulkan, descriptor);
+        }
+
+        VkDescriptorSetAllocateInfo descriptor_set_allocate_info = {
+            .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+            .descriptorPool = frame->pools[frame->current_pool],
+            .descriptorSetCount = 1,
+            .pSetLayouts = &layout,
+        };
+        VkDescriptorSet set;
+        VkResult result = vulkan->vkAllocateDescriptorSets(vulkan->logical_device, &descriptor_set_allocate_info, &set);
+        if (result == VK_SUCCESS) {
+            frame->current_pool_sets++;
+            descriptor->frame_stats.sets_allocated++;
+            return set;
+        }
+
+        // with VK_KHR_maintenance1 a pool can also run out of descriptors before its sets, the rest move on to the next one
+        assert(result == VK_ERROR_OUT_OF_POOL_MEMORY || result == VK_ERROR_FRAGMENTED_POOL);
+        frame->current_pool++;
+        frame->current_pool_sets = 0;
+    }
+}
+
+void descriptor_update(vulkan_t *vulkan, descriptor_t *descriptor, uint32_t writes_count, const VkWriteDescriptorSet *writes) {
+    vulkan->vkUpdateDescriptorSets(vulkan->logical_device, writes_count, writes, 0, NULL);
+    descriptor->frame_stats.updates += writes_count;
+}
+
+void descriptor_bind(vulkan_t *vulkan, descriptor_t *descriptor, VkCommandBuffer command_buffer, VkPipelineBindPoint bind_point,
+                     VkPipelineLayout pipeline_layout, uint32_t first_set, uint32_t sets_count, const VkDescriptorSet *sets) {
+    vulkan->vkCmdBindDescriptorSets(command_buffer, bind_point, pipeline_layout, first_set, sets_count, sets, 0, NULL);
+    descriptor->frame_stats.binds++;
+}
+
+void descriptor_report(descriptor_t *descriptor) {
+    descriptor_stats_t *stats = &descriptor->last_frame_stats;
+    printf("descriptor: last frame %u updates, %u binds, %u sets, %u pools created; %u set layouts, %u pipeline layouts, "
+           "%u cache hits, %u misses\n",
+           stats->updates, stats->binds, stats->sets_allocated, stats->pools_created, descriptor->set_layouts_count,
+           descriptor->pipeline_layouts_count, descriptor->total_stats.layout_hits + descriptor->frame_stats.layout_hits,
+           descriptor->total_stats.layout_misses + descriptor->frame_stats.layout_misses);
+    if (!descriptor->heap.available) {
+        printf("descriptor: no bindless heap, VK_EXT_descriptor_indexing is unavailable\n");
+        return;
+    }
+    descriptor_free_list_t *lists = descriptor->heap.free_lists;
+    printf("descriptor: heap %u/%u sampled images, %u/%u storage images, %u/%u storage buffers, %u/%u samplers\n",
+           lists[DESCRIPTOR_HEAP_SAMPLED_IMAGE].used_count, lists[DESCRIPTOR_HEAP_SAMPLED_IMAGE].capacity,
+           lists[DESCRIPTOR_HEAP_STORAGE_IMAGE].used_count, lists[DESCRIPTOR_HEAP_STORAGE_IMAGE].capacity,
+           lists[DESCRIPTOR_HEAP_STORAGE_BUFFER].used_count, lists[DESCRIPTOR_HEAP_STORAGE_BUFFER].capacity,
+           lists[DESCRIPTOR_HEAP_SAMPLER].used_count, lists[DESCRIPTOR_HEAP_SAMPLER].capacity);
+}
+
+void descriptor_free_resources(vulkan_t *vulkan, descriptor_t *descriptor) {
+    for (uint32_t i = 0; i < descriptor->frames_count; i++) {
+        descriptor_frame_t *frame = &descriptor->frames[i];
+        for (uint32_t j = 0; j < frame->pools_count; j++)
+            vulkan->vkDestroyDescriptorPool(vulkan->logical_device, frame->pools[j], vulkan->allocation_callbacks);
+        *frame = (descriptor_frame_t){0};
+    }
+
+    if (descriptor->heap.available)
+        vulkan->vkDestroyDescriptorPool(vulkan->logical_device, descriptor->heap.pool, vulkan->allocation_callbacks);
+    descriptor->heap = (descriptor_heap_t){0};
+
+    for (uint32_t i = 0; i < DESCRIPTOR_CACHE_CAPACITY; i++) {
+        if (descriptor->pipeline_layouts[i].layout != VK_NULL_HANDLE)
+            vulkan->vkDestroyPipelineLayout(vulkan->logical_device, descriptor->pipeline_layouts[i].layout,
+                                            vulkan->allocation_callbacks);
+        if (descriptor->set_layouts[i].layout != VK_NULL_HANDLE)
+            vulkan->vkDestroyDescriptorSetLayout(vulkan->logical_device, descriptor->set_layouts[i].layout,
+                                                 vulkan->allocation_callbacks);
+        descriptor->pipeline_layouts[i].layout = VK_NULL_HANDLE;
+        descriptor->set_layouts[i].layout = VK_NULL_HANDLE;
+    }
+    descriptor->pipeline_layouts_count = 0;
+    descriptor->set_layouts_count = 0;
+    arena_free(&descriptor->arena);
+}
+
+// records the per-draw resource changes of a frame both ways: a freshly allocated, written and bound set per draw, or
+// the heap bound once and a push constant slot per draw
+void descriptor_benchmark(uint32_t iterations) {
+    vulkan_t vulkan = {.headless = true};
+    bench_bootstrap(&vulkan);
+    allocator_t allocator;
+    allocator_create(&vulkan, &allocator);
+    descriptor_t *descriptor = (descriptor_t *)malloc(sizeof(descriptor_t));
+    descriptor_create(&vulkan, descriptor, DESCRIPTOR_BENCHMARK_FRAMES);
+
+    VkCommandPoolCreateInfo command_pool_create_info = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+        .queueFamilyIndex = vulkan.queues[VULKAN_QUEUE_GRAPHICS].family_index,
+    };
+    VkCommandPool command_pool;
+    VkResult result = vulkan.vkCreateCommandPool(vulkan.logical_device, &command_pool_create_info, vulkan.allocation_callbacks,
+                                                 &command_pool);
+    assert(result == VK_SUCCESS);
+    VkCommandBufferAllocateInfo command_buffer_allocate_info = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+        .commandPool = command_pool,
+        .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+        .commandBufferCount = 1,
+    };
+    VkCommandBuffer command_buffer;
+    result = vulkan.vkAllocateCommandBuffers(vulkan.logical_device, &command_buffer_allocate_info, &command_buffer);
+    assert(result == VK_SUCCESS);
+    VkCommandBufferBeginInfo begin_info = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+        .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+    };
+
+    VkBufferCreateInfo buffer_create_info = {
+        .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+        .size = 256,
+        .usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+        .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+    };
+    VkBuffer buffers[DESCRIPTOR_BENCHMARK_BUFFERS];
+    allocation_t allocations[DESCRIPTOR_BENCHMARK_BUFFERS];
+    for (uint32_t i = 0; i < DESCRIPTOR_BENCHMARK_BUFFERS; i++) {
+        result = allocator_create_buffer(&vulkan, &allocator, &buffer_create_info, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 0,
+                                         &buffers[i], &allocations[i]);
+        assert(result == VK_SUCCESS);
+    }
+
+    // layout lookups, a cache hit against creating the same layout from scratch
+    descriptor_set_layout_key_t key = {
+        .bindings_count = 1,
+        .bindings = {{0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_ALL, NULL}},
+    };
+    VkDescriptorSetLayout set_layout = descriptor_get_set_layout(&vulkan, descriptor, &key);
+    descriptor_pipeline_layout_key_t pipeline_layout_key = {
+        .set_layouts_count = 1,
+        .set_layouts = {set_layout},
+    };
+    VkPipelineLayout pipeline_layout = descriptor_get_pipeline_layout(&vulkan, descriptor, &pipeline_layout_key);
+
+    bench_samples_t cached_samples, created_samples;
+    bench_samples_create(&cached_samples, "descriptor_get_set_layout (cached)", iterations);
+    bench_samples_create(&created_samples, "vkCreateDescriptorSetLayout", iterations);
+    for (uint32_t i = 0; i < iterations; i++) {
+        uint64_t start = bench_now_ns();
+        VkDescriptorSetLayout cached = descriptor_get_set_layout(&vulkan, descriptor, &key);
+        bench_samples_push(&cached_samples, bench_now_ns() - start);
+        assert(cached == set_layout);
+
+        VkDescriptorSetLayoutCreateInfo descriptor_set_layout_create_info = {
+            .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+            .bindingCount = key.bindings_count,
+            .pBindings = key.bindings,
+        };
+        VkDescriptorSetLayout created;
+        start = bench_now_ns();
+        result = vulkan.vkCreateDescriptorSetLayout(vulkan.logical_device, &descriptor_set_layout_create_info,
+                                                    vulkan.allocation_callbacks, &created);
+        bench_samples_push(&created_samples, bench_now_ns() - start);
+        assert(result == VK_SUCCESS);
+        vulkan.vkDestroyDescriptorSetLayout(vulkan.logical_device, created, vulkan.allocation_callbacks);
+    }
+    bench_samples_report(&cached_samples);
+    bench_samples_report(&created_samples);
+    bench_samples_free(&cached_samples);
+    bench_samples_free(&created_samples);
+
+    // a set per draw from the frame's pools
+    bench_samples_t pooled_samples;
+    bench_samples_create(&pooled_samples, "per-draw sets, 4096 draws", iterations);
+    for (uint32_t i = 0; i < iterations; i++) {
+        descriptor_begin_frame(&vulkan, descriptor, i % DESCRIPTOR_BENCHMARK_FRAMES);
+        result = vulkan.vkResetCommandPool(vulkan.logical_device, command_pool, 0);
+        assert(result == VK_SUCCESS);
+        result = vulkan.vkBeginCommandBuffer(command_buffer, &begin_info);
+        assert(result == VK_SUCCESS);
+
+        uint64_t start = bench_now_ns();
+        for (uint32_t draw = 0; draw < DESCRIPTOR_BENCHMARK_DRAWS; draw++) {
+            VkDescriptorSet set = descriptor_allocate_set(&vulkan, descriptor, set_layout);
+            VkDescriptorBufferInfo buffer_info = {
+                .buffer = buffers[draw % DESCRIPTOR_BENCHMARK_BUFFERS],
+                .range = VK_WHOLE_SIZE,
+            };
+            VkWriteDescriptorSet write = {
+                .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+                .dstSet = set,
+                .descriptorCount = 1,
+                .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                .pBufferInfo = &buffer_info,
+            };
+            descriptor_update(&vulkan, descriptor, 1, &write);
+            descriptor_bind(&vulkan, descriptor, command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline_layout, 0, 1, &set);
+        }
+        bench_samples_push(&pooled_samples, bench_now_ns() - start);
+
+        result = vulkan.vkEndCommandBuffer(command_buffer);
+        assert(result == VK_SUCCESS);
+    }
+    // rolls the last recorded frame's counters over into last_frame_stats
+    descriptor_begin_frame(&vulkan, descriptor, 0);
+    bench_samples_report(&pooled_samples);
+    printf("%-48s %u updates, %u binds, %u sets per frame\n", "", descriptor->last_frame_stats.updates,
+           descriptor->last_frame_stats.binds, descriptor->last_frame_stats.sets_allocated);
+    bench_samples_free(&pooled_samples);
+
+    // the heap written once up front, then bound once per frame with each draw's slot pushed
+    if (descriptor->heap.available) {
+        uint32_t slots[DESCRIPTOR_BENCHMARK_BUFFERS];
+        for (uint32_t i = 0; i < DESCRIPTOR_BENCHMARK_BUFFERS; i++) {
+            slots[i] = descriptor_heap_allocate(descriptor, DESCRIPTOR_HEAP_STORAGE_BUFFER);
+            descriptor_heap_write_buffer(&vulkan, descriptor, slots[i], buffers[i], 0, VK_WHOLE_SIZE);
+        }
+
+        bench_samples_t bindless_samples;
+        bench_samples_create(&bindless_samples, "bindless heap, 4096 draws", iterations);
+        for (uint32_t i = 0; i < iterations; i++) {
+            descriptor_begin_frame(&vulkan, descriptor, i % DESCRIPTOR_BENCHMARK_FRAMES);
+            result = vulkan.vkResetCommandPool(vulkan.logical_device, command_pool, 0);
+            assert(result == VK_SUCCESS);
+            result = vulkan.vkBeginCommandBuffer(command_buffer, &begin_info);
+            assert(result == VK_SUCCESS);
+
+            uint64_t start = bench_now_ns();
+            descriptor_bind_heap(&vulkan, descriptor, command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS);
+            for (uint32_t draw = 0; draw < DESCRIPTOR_BENCHMARK_DRAWS; draw++)
+                vulkan.vkCmdPushConstants(command_buffer, descriptor->heap.pipeline_layout, VK_SHADER_STAGE_ALL, 0,
+                                          sizeof(uint32_t), &slots[draw % DESCRIPTOR_BENCHMARK_BUFFERS]);
+            bench_samples_push(&bindless_samples, bench_now_ns() - start);
+
+            result = vulkan.vkEndCommandBuffer(command_buffer);
+            assert(result == VK_SUCCESS);
+        }
+        descriptor_begin_frame(&vulkan, descriptor, 0);
+        bench_samples_report(&bindless_samples);
+        printf("%-48s %u updates, %u binds, %u sets per frame\n", "", descriptor->last_frame_stats.updates,
+               descriptor->last_frame_stats.binds, descriptor->last_frame_stats.sets_allocated);
+        bench_samples_free(&bindless_samples);
+
+        for (uint32_t i = 0; i < DESCRIPTOR_BENCHMARK_BUFFERS; i++)
+            descriptor_heap_free(descriptor, DESCRIPTOR_HEAP_STORAGE_BUFFER, slots[i]);
+    }
+    descriptor_report(descriptor);
+
+    for (uint32_t i = 0; i < DESCRIPTOR_BENCHMARK_BUFFERS; i++)
+        allocator_destroy_buffer(&vulkan, &allocator, buffers[i], &allocations[i]);
+    vulkan.vkDestroyCommandPool(vulkan.logical_device, command_pool, vulkan.allocation_callbacks);
+    descriptor_free_resources(&vulkan, descriptor);
+    free(descriptor);
+    allocator_free_resources(&vulkan, &allocator);
+    vulkan_free_resources(&vulkan);
+}
@@ -0,0 +1,133 @@
+#ifndef DESCRIPTOR_H
+#define DESCRIPTOR_H
+
+#include "vulkan.h"
+#include <stdbool.h>
+
+#define DESCRIPTOR_MAX_FRAMES 8
+#define DESCRIPTOR_MAX_BINDINGS 8
+#define DESCRIPTOR_MAX_SET_LAYOUTS 4
+#define DESCRIPTOR_MAX_PUSH_CONSTANT_RANGES 2
+#define DESCRIPTOR_HEAP_CAPACITY 16384
+#define DESCRIPTOR_HEAP_PUSH_CONSTANTS_SIZE 128
+#define DESCRIPTOR_CACHE_CAPACITY 256
+#define DESCRIPTOR_POOL_SETS 256
+#define DESCRIPTOR_FREE_LIST_END UINT32_MAX
+
+// one runtime array per type in the heap's single set, indexed by slot from shaders
+typedef enum {
+    DESCRIPTOR_HEAP_SAMPLED_IMAGE,
+    DESCRIPTOR_HEAP_STORAGE_IMAGE,
+    DESCRIPTOR_HEAP_STORAGE_BUFFER,
+    DESCRIPTOR_HEAP_SAMPLER,
+    DESCRIPTOR_HEAP_TYPE_COUNT,
+} descriptor_heap_type_t;
+
+// free slots are chained through next, and so are slots released during a frame until that frame has retired
+typedef struct {
+    uint32_t capacity;
+    uint32_t used_count;
+    uint32_t free_head;
+    uint32_t retired_heads[DESCRIPTOR_MAX_FRAMES];
+    uint32_t *next;
+} descriptor_free_list_t;
+
+typedef struct {
+    bool available;
+    VkDescriptorSetLayout layout;
+    VkPipelineLayout pipeline_layout;
+    VkDescriptorPool pool;
+    VkDescriptorSet set;
+    descriptor_free_list_t free_lists[DESCRIPTOR_HEAP_TYPE_COUNT];
+} descriptor_heap_t;
+
+// only the first count entries of a key are looked at, whatever follows them is ignored
+typedef struct {
+    VkDescriptorSetLayoutCreateFlags flags;
+    uint32_t bindings_count;
+    VkDescriptorSetLayoutBinding bindings[DESCRIPTOR_MAX_BINDINGS];
+    VkDescriptorBindingFlagsEXT binding_flags[DESCRIPTOR_MAX_BINDINGS];
+} descriptor_set_layout_key_t;
+
+typedef struct {
+    uint32_t set_layouts_count;
+    VkDescriptorSetLayout set_layouts[DESCRIPTOR_MAX_SET_LAYOUTS];
+    uint32_t push_constant_ranges_count;
+    VkPushConstantRange push_constant_ranges[DESCRIPTOR_MAX_PUSH_CONSTANT_RANGES];
+} descriptor_pipeline_layout_key_t;
+
+typedef struct {
+    uint64_t hash;
+    descriptor_set_layout_key_t key;
+    VkDescriptorSetLayout layout;
+} descriptor_set_layout_entry_t;
+
+typedef struct {
+    uint64_t hash;
+    descriptor_pipeline_layout_key_t key;
+    VkPipelineLayout layout;
+} descriptor_pipeline_layout_entry_t;
+
+// pools a frame has drawn sets from, all reset together once the frame comes around again
+typedef struct {
+    uint32_t pools_count;
+    uint32_t current_pool;
+    // over-allocating a pool is only a reported error with VK_KHR_maintenance1, so sets are counted against maxSets
+    uint32_t current_pool_sets;
+    uint32_t pools_capacity;
+    VkDescriptorPool *pools;
+} descriptor_frame_t;
+
+typedef struct {
+    uint32_t updates;
+    uint32_t binds;
+    uint32_t sets_allocated;
+    uint32_t pools_created;
+    uint32_t layout_hits;
+    uint32_t layout_misses;
+} descriptor_stats_t;
+
+typedef struct {
+    // the heap's free lists and the frames' pool arrays, released together by descriptor_free_resources
+    arena_t arena;
+    descriptor_heap_t heap;
+
+    uint32_t set_layouts_count;
+    descriptor_set_layout_entry_t set_layouts[DESCRIPTOR_CACHE_CAPACITY];
+    uint32_t pipeline_layouts_count;
+    descriptor_pipeline_layout_entry_t pipeline_layouts[DESCRIPTOR_CACHE_CAPACITY];
+
+    uint32_t frames_count;
+    uint32_t frame_index;
+    descriptor_frame_t frames[DESCRIPTOR_MAX_FRAMES];
+
+    descriptor_stats_t frame_stats;
+    descriptor_stats_t last_frame_stats;
+    descriptor_stats_t total_stats;
+} descriptor_t;
+
+void descriptor_create(vulkan_t *vulkan, descriptor_t *descriptor, uint32_t frames_count);
+VkDescriptorSetLayout descriptor_get_set_layout(vulkan_t *vulkan, descriptor_t *descriptor,
+                                                const descriptor_set_layout_key_t *key);
+VkPipelineLayout descriptor_get_pipeline_layout(vulkan_t *vulkan, descriptor_t *descriptor,
+                                                const descriptor_pipeline_layout_key_t *key);
+void descriptor_begin_frame(vulkan_t *vulkan, descriptor_t *descriptor, uint32_t frame_index);
+uint32_t descriptor_heap_allocate(descriptor_t *descriptor, descriptor_heap_type_t type);
+void descriptor_heap_free(descriptor_t *descriptor, descriptor_heap_type_t type, uint32_t slot);
+void descriptor_heap_write_image(vulkan_t *vulkan, descriptor_t *descriptor, descriptor_heap_type_t type, uint32_t slot,
+                                 VkImageView image_view, VkImageLayout layout);
+void descriptor_heap_write_buffer(vulkan_t *vulkan, descriptor_t *descriptor, uint32_t slot, VkBuffer buffer,
+                                  VkDeviceSize offset, VkDeviceSize range);
+void descriptor_heap_write_sampler(vulkan_t *vulkan, descriptor_t *descriptor, uint32_t slot, VkSampler sampler);
+void descriptor_bind_heap(vulkan_t *vulkan, descriptor_t *descriptor, VkCommandBuffer command_buffer,
+                          VkPipelineBindPoint bind_point);
+VkDescriptorSet descriptor_allocate_set(vulkan_t *vulkan, descriptor_t *descriptor, VkDescriptorSetLayout layout);
+void descriptor_update(vulkan_t *vulkan, descriptor_t *descriptor, uint32_t writes_count, const VkWriteDescriptorSet *writes);
+void descriptor_bind(vulkan_t *vulkan, descriptor_t *descriptor, VkCommandBuffer command_buffer, VkPipelineBindPoint bind_point,
+                     VkPipelineLayout pipeline_layout, uint32_t first_set, uint32_t sets_count, const VkDescriptorSet *sets);
+void descriptor_report(descriptor_t *descriptor);
+void descriptor_free_resources(vulkan_t *vulkan, descriptor_t *descriptor);
+
+void descriptor_benchmark(uint32_t iterations);
+
+#endif // DESCRIPTOR_H
@@ -0,0 +1,261 @@
+#include "device.h"
+#include "allocator.h"
+#include "bench.h"
+#include "compute.h"
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define DEVICE_BENCHMARK_ELEMENTS (1u << 22)
+#define DEVICE_BENCHMARK_WORKGROUP_SIZE 256
+
+static const char *device_type_names[] = {
+    [VK_PHYSICAL_DEVICE_TYPE_OTHER] = "other",
+    [VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU] = "integrated",
+    [VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU] = "discrete",
+    [VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU] = "virtual",
+    [VK_PHYSICAL_DEVICE_TYPE_CPU] = "cpu",
+};
+
+// higher is better, a software rasterizer only wins when nothing else is there
+static uint64_t device_type_rank(VkPhysicalDeviceType type) {
+    switch (type) {
+    case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU:
+        return 4;
+    case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU:
+        return 3;
+    case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU:
+        return 2;
+    case VK_PHYSICAL_DEVICE_TYPE_CPU:
+        return 1;
+    default:
+        return 0;
+    }
+}
+
+static const char *device_check_requirements(vulkan_t *vulkan, device_candidate_t *candidate) {
+    uint32_t families_count = 0;
+    vulkan->vkGetPhysicalDeviceQueueFamilyProperties(candidate->physical_device, &families_count, NULL);
+    VkQueueFamilyProperties *families =
+        (VkQueueFamilyProperties *)arena_allocate(&vulkan->arena, sizeof(VkQueueFamilyProperties) * families_count);
+    vulkan->vkGetPhysicalDeviceQueueFamilyProperties(candidate->physical_device, &families_count, families);
+    VkQueueFlags queue_flags = 0;
+    for (uint32_t i = 0; i < families_count; i++)
+        queue_flags |= families[i].queueFlags;
+    if ((queue_flags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT)) != (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT))
+        return "no graphics or no compute queue";
+
+    if (vulkan->headless)
+        return NULL;
+
+    uint32_t extensions_count = 0;
+    VkResult result = vulkan->vkEnumerateDeviceExtensionProperties(candidate->physical_device, NULL, &extensions_count, NULL);
+    assert(result == VK_SUCCESS);
+    VkExtensionProperties *extensions =
+        (VkExtensionProperties *)arena_allocate(&vulkan->arena, sizeof(VkExtensionProperties) * extensions_count);
+    result = vulkan->vkEnumerateDeviceExtensionProperties(candidate->physical_device, NULL, &extensions_count, extensions);
+    assert(result == VK_SUCCESS);
+    for (uint32_t i = 0; i < extensions_count; i++)
+        if (strcmp(extensions[i].extensionName, VK_KHR_SWAPCHAIN_EXTENSION_NAME) == 0)
+            return NULL;
+    return "no swapchain";
+}
+
+// without VK_KHR_device_group_creation every device is a group of its own
+static void device_find_group(device_candidate_t *candidate, uint32_t groups_count,
+                              const VkPhysicalDeviceGroupPropertiesKHR *groups) {
+    candidate->group_count = 1;
+    candidate->group_devices[0] = candidate->physical_device;
+    for (uint32_t i = 0; i < groups_count; i++) {
+        for (uint32_t j = 0; j < groups[i].physicalDeviceCount; j++) {
+            if (groups[i].physicalDevices[j] != candidate->physical_device)
+                continue;
+            candidate->group_count = groups[i].physicalDeviceCount;
+            memcpy(candidate->group_devices, groups[i].physicalDevices, sizeof(VkPhysicalDevice) * candidate->group_count);
+            return;
+        }
+    }
+}
+
+static int device_compare_candidates(const void *a, const void *b) {
+    const device_candidate_t *x = (const device_candidate_t *)a, *y = (const device_candidate_t *)b;
+    if (x->score != y->score)
+        return x->score < y->score ? 1 : -1;
+    return x->index < y->index ? -1 : x->index > y->index;
+}
+
+// fills one candidate per enumerated device and sorts them best first, rejected devices last with a score of 0
+void device_rank(vulkan_t *vulkan, device_candidate_t *candidates) {
+    uint32_t groups_count = 0;
+    VkPhysicalDeviceGroupPropertiesKHR *groups = NULL;
+    if (vulkan->vkEnumeratePhysicalDeviceGroupsKHR != NULL) {
+        VkResult result = vulkan->vkEnumeratePhysicalDeviceGroupsKHR(vulkan->instance, &groups_count, NULL);
+        assert(result == VK_SUCCESS);
+        groups = (VkPhysicalDeviceGroupPropertiesKHR *)arena_allocate(
+            &vulkan->arena, sizeof(VkPhysicalDeviceGroupPropertiesKHR) * groups_count);
+        for (uint32_t i = 0; i < groups_count; i++)
+            groups[i] = (VkPhysicalDeviceGroupPropertiesKHR){.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_GROUP_PROPERTIES_KHR};
+        result = vulkan->vkEnumeratePhysicalDeviceGroupsKHR(vulkan->instance, &groups_count, groups);
+        assert(result == VK_SUCCESS);
+    }
+
+    for (uint32_t i = 0; i < vulkan->device_count; i++) {
+        device_candidate_t *candidate = &candidates[i];
+        *candidate = (device_candidate_t){
+            .index = i,
+            .physical_device = vulkan->available_devices[i],
+        };
+        vulkan->vkGetPhysicalDeviceProperties(candidate->physical_device, &candidate->properties);
+        vulkan->vkGetPhysicalDeviceFeatures(candidate->physical_device, &candidate->features);
+
+        VkPhysicalDeviceMemoryProperties memory_properties;
+        vulkan->vkGetPhysicalDeviceMemoryProperties(candidate->physical_device, &memory_properties);
+        for (uint32_t j = 0; j < memory_properties.memoryHeapCount; j++)
+            if (memory_properties.memoryHeaps[j].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT)
+                candidate->device_local_size += memory_properties.memoryHeaps[j].size;
+
+        device_find_group(candidate, groups_count, groups);
+        candidate->rejection = device_check_requirements(vulkan, candidate);
+        if (candidate->rejection != NULL)
+            continue;
+
+        // compared field by field: device type, then devices in the group, then local memory, then shared memory
+        uint64_t local_mib = candidate->device_local_size >> 20;
+        uint64_t shared_kib = candidate->properties.limits.maxComputeSharedMemorySize >> 10;
+        candidate->score = device_type_rank(candidate->properties.deviceType) << 58 | (uint64_t)candidate->group_count << 52 |
+                           (local_mib < (1ull << 36) ? local_mib : (1ull << 36) - 1) << 16 |
+                           (shared_kib < 0xffff ? shared_kib : 0xffff);
+    }
+
+    qsort(candidates, vulkan->device_count, sizeof(device_candidate_t), device_compare_candidates);
+}
+
+// an override wins over the score but not over the requirements, and a bad one falls back to the best device
+const device_candidate_t *device_select(const device_candidate_t *candidates, uint32_t count, const char *override) {
+    if (override != NULL) {
+        char *end = NULL;
+        unsigned long index = strtoul(override, &end, 10);
+        bool by_index = end != override && *end == '\0';
+
+        const device_candidate_t *match = NULL;
+        for (uint32_t i = 0; i < count && match == NULL; i++)
+            if (by_index ? candidates[i].index == index : strstr(candidates[i].properties.deviceName, override) != NULL)
+                match = &candidates[i];
+
+        if (match == NULL)
+            fprintf(stderr, "no device matches %s\n", override);
+        else if (match->rejection != NULL)
+            fprintf(stderr, "device %s cannot be used: %s\n", match->properties.deviceName, match->rejection);
+        else
+            return match;
+    }
+
+    return count > 0 && candidates[0].rejection == NULL ? &candidates[0] : NULL;
+}
+
+// everything the device has, except robust buffer access, which puts a bounds check on every buffer access
+VkPhysicalDeviceFeatures device_enable_features(const VkPhysicalDeviceFeatures *supported) {
+    VkPhysicalDeviceFeatures features = *supported;
+    features.robustBufferAccess = VK_FALSE;
+    return features;
+}
+
+void device_report(const device_candidate_t *candidates, uint32_t count, VkPhysicalDevice selected) {
+    printf("devices:\n");
+    for (uint32_t i = 0; i < count; i++) {
+        const device_candidate_t *candidate = &candidates[i];
+        VkPhysicalDeviceType type = candidate->properties.deviceType;
+        const char *type_name = type <= VK_PHYSICAL_DEVICE_TYPE_CPU ? device_type_names[type] : "unknown";
+        printf("  %c %u %s, %s, %llu MiB local, group of %u", candidate->physical_device == selected ? '*' : ' ',
+               candidate->index, candidate->properties.deviceName, type_name,
+               (unsigned long long)(candidate->device_local_size >> 20), candidate->group_count);
+        if (candidate->rejection != NULL)
+            printf(", rejected: %s\n", candidate->rejection);
+        else
+            printf(", score %016llx\n", (unsigned long long)candidate->score);
+    }
+}
+
+typedef struct {
+    uint32_t count;
+    float a;
+} device_benchmark_push_constants_t;
+
+// saxpy split across the first 1, 2, ... devices of the group, each device writing its slice into its own memory
+void device_benchmark(uint32_t iterations) {
+    vulkan_t vulkan = {.headless = true};
+    bench_bootstrap(&vulkan);
+
+    device_candidate_t *candidates =
+        (device_candidate_t *)arena_allocate(&vulkan.arena, sizeof(device_candidate_t) * vulkan.device_count);
+    device_rank(&vulkan, candidates);
+    device_report(candidates, vulkan.device_count, vulkan.physical_device);
+
+    allocator_t allocator;
+    allocator_create(&vulkan, &allocator);
+    VkBufferCreateInfo buffer_create_info = {
+        .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+        .size = DEVICE_BENCHMARK_ELEMENTS * sizeof(float),
+        .usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+    };
+    VkBuffer buffers[3];
+    allocation_t allocations[3];
+    for (uint32_t i = 0; i < 3; i++) {
+        VkResult result = allocator_create_buffer(&vulkan, &allocator, &buffer_create_info, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                                                  0, &buffers[i], &allocations[i]);
+        assert(result == VK_SUCCESS);
+    }
+
+    compute_t compute;
+    compute_create(&vulkan, &compute);
+    compute_kernel_t saxpy;
+    compute_create_kernel(&vulkan, &saxpy, "shaders/saxpy.spv", DEVICE_BENCHMARK_WORKGROUP_SIZE, 0, NULL, 3,
+                          sizeof(device_benchmark_push_constants_t));
+    VkDescriptorSet descriptor_set = compute_bind_buffers(&vulkan, &compute, &saxpy, buffers);
+
+    // the values do not matter for timing, only that they are not denormals or nans
+    VkCommandBuffer command_buffer = compute_begin(&vulkan, &compute);
+    vulkan.vkCmdFillBuffer(command_buffer, buffers[0], 0, VK_WHOLE_SIZE, 0x3f800000);
+    vulkan.vkCmdFillBuffer(command_buffer, buffers[1], 0, VK_WHOLE_SIZE, 0x40000000);
+    compute_barrier(&vulkan, &compute);
+    compute_end(&vulkan, &compute);
+    compute_submit(&vulkan, &compute);
+
+    device_benchmark_push_constants_t push_constants = {.count = DEVICE_BENCHMARK_ELEMENTS, .a = 0.5f};
+    uint32_t groups = (DEVICE_BENCHMARK_ELEMENTS + DEVICE_BENCHMARK_WORKGROUP_SIZE - 1) / DEVICE_BENCHMARK_WORKGROUP_SIZE;
+    uint64_t single_median = 0;
+    for (uint32_t devices = 1; devices <= vulkan.device_group_count; devices++) {
+        compute_begin(&vulkan, &compute);
+        compute_dispatch_split(&vulkan, &compute, &saxpy, descriptor_set, &push_constants, groups,
+                               UINT32_MAX >> (32 - devices));
+        compute_end(&vulkan, &compute);
+
+        bench_samples_t samples;
+        bench_samples_create(&samples, "split saxpy", iterations);
+        for (uint32_t i = 0; i < iterations; i++) {
+            uint64_t start = bench_now_ns();
+            compute_submit(&vulkan, &compute);
+            bench_samples_push(&samples, bench_now_ns() - start);
+        }
+
+        uint64_t median = bench_samples_percentile(&samples, 0.5);
+        if (devices == 1)
+            single_median = median;
+        printf("%u of %u devices: %.2f Gelements/s, %.2fx one device\n", devices, vulkan.device_group_count,
+               median > 0 ? DEVICE_BENCHMARK_ELEMENTS / (double)median : 0.0,
+               median > 0 ? single_median / (double)median : 0.0);
+        bench_samples_report(&samples);
+        bench_samples_free(&samples);
+    }
+    if (vulkan.device_group_count == 1)
+        printf("the selected device is not in a multi-device group, so only one device was measured\n");
+
+    compute_destroy_kernel(&vulkan, &saxpy);
+    compute_free_resources(&vulkan, &compute);
+    for (uint32_t i = 0; i < 3; i++)
+        allocator_destroy_buffer(&vulkan, &allocator, buffers[i], &allocations[i]);
+    allocator_free_resources(&vulkan, &allocator);
+    vulkan_free_resources(&vulkan);
+}
@@ -0,0 +1,26 @@
+#ifndef DEVICE_H
+#define DEVICE_H
+
+#include "vulkan.h"
+
+// one enumerated physical device, with the group it belongs to and the reason it cannot be used, if any
+typedef struct {
+    uint32_t index;
+    VkPhysicalDevice physical_device;
+    VkPhysicalDeviceProperties properties;
+    VkPhysicalDeviceFeatures features;
+    VkDeviceSize device_local_size;
+    uint32_t group_count;
+    VkPhysicalDevice group_devices[VK_MAX_DEVICE_GROUP_SIZE];
+    const char *rejection;
+    uint64_t score;
+} device_candidate_t;
+
+void device_rank(vulkan_t *vulkan, device_candidate_t *candidates);
+const device_candidate_t *device_select(const device_candidate_t *candidates, uint32_t count, const char *override);
+VkPhysicalDeviceFeatures device_enable_features(const VkPhysicalDeviceFeatures *supported);
+void device_report(const device_candidate_t *candidates, uint32_t count, VkPhysicalDevice selected);
+
+void device_benchmark(uint32_t iterations);
+
+#endif // DEVICE_H
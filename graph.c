@@ -0,0 +1,751 @@
+#include "graph.h"
+#include "bench.h"
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define GRAPH_BENCHMARK_WIDTH 1920
+#define GRAPH_BENCHMARK_HEIGHT 1080
+#define GRAPH_BENCHMARK_SHADOW_SIZE 2048
+
+#define GRAPH_WRITE_ACCESSES                                                                                                  \
+    (VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT |         \
+     VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_HOST_WRITE_BIT | VK_ACCESS_MEMORY_WRITE_BIT)
+
+typedef struct {
+    VkPipelineStageFlags stages;
+    VkAccessFlags accesses;
+    VkImageLayout layout;
+    VkImageUsageFlags image_usage;
+    VkBufferUsageFlags buffer_usage;
+    // whether earlier contents matter, and whether the pass leaves new ones behind
+    bool reads;
+    bool writes;
+} graph_access_info_t;
+
+static const graph_access_info_t graph_accesses[GRAPH_ACCESS_COUNT] = {
+    [GRAPH_ACCESS_TRANSFER_READ] = {VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT,
+                                    VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
+                                    VK_BUFFER_USAGE_TRANSFER_SRC_BIT, true, false},
+    [GRAPH_ACCESS_TRANSFER_WRITE] = {VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+                                     VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_DST_BIT,
+                                     VK_BUFFER_USAGE_TRANSFER_DST_BIT, false, true},
+    [GRAPH_ACCESS_COMPUTE_READ] = {VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT,
+                                   VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_USAGE_SAMPLED_BIT,
+                                   VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, true, false},
+    [GRAPH_ACCESS_COMPUTE_WRITE] = {VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+                                    VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_USAGE_STORAGE_BIT, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                                    true, true},
+    [GRAPH_ACCESS_FRAGMENT_READ] = {VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT,
+                                    VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_USAGE_SAMPLED_BIT,
+                                    VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, true, false},
+    [GRAPH_ACCESS_COLOR_ATTACHMENT_WRITE] = {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+                                             VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+                                             VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, 0,
+                                             false, true},
+    // the depth test reads what earlier passes left behind
+    [GRAPH_ACCESS_DEPTH_ATTACHMENT_WRITE] = {VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT |
+                                                 VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+                                             VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT |
+                                                 VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+                                             VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+                                             VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, 0, true, true},
+    // draw parameters written on the gpu, read back by the command processor rather than by a shader
+    [GRAPH_ACCESS_INDIRECT_READ] = {VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, VK_ACCESS_INDIRECT_COMMAND_READ_BIT,
+                                    VK_IMAGE_LAYOUT_UNDEFINED, 0, VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, true, false},
+};
+
+// what a resource's last accesses still require from whatever touches it next
+typedef struct {
+    VkPipelineStageFlags write_stages;
+    VkAccessFlags write_accesses;
+    VkPipelineStageFlags read_stages;
+    VkPipelineStageFlags visible_stages;
+    VkImageLayout layout;
+} graph_track_t;
+
+static VkDeviceSize graph_align(VkDeviceSize value, VkDeviceSize alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+static VkImageAspectFlags graph_format_aspect(VkFormat format) {
+    switch (format) {
+    case VK_FORMAT_D16_UNORM:
+    case VK_FORMAT_X8_D24_UNORM_PACK32:
+    case VK_FORMAT_D32_SFLOAT:
+        return VK_IMAGE_ASPECT_DEPTH_BIT;
+    case VK_FORMAT_D16_UNORM_S8_UINT:
+    case VK_FORMAT_D24_UNORM_S8_UINT:
+    case VK_FORMAT_D32_SFLOAT_S8_UINT:
+        return VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT;
+    case VK_FORMAT_S8_UINT:
+        return VK_IMAGE_ASPECT_STENCIL_BIT;
+    default:
+        return VK_IMAGE_ASPECT_COLOR_BIT;
+    }
+}
+
+void graph_create(graph_t *graph, allocator_t *allocator, bool aliasing) {
+    memset(graph, 0, sizeof(*graph));
+    graph->allocator = allocator;
+    graph->aliasing = aliasing;
+}
+
+static graph_resource_t graph_add_resource(graph_t *graph, graph_resource_info_t *info) {
+    assert(!graph->compiled && graph->resources_count < GRAPH_MAX_RESOURCES);
+    info->first_pass = UINT32_MAX;
+    graph->resources[graph->resources_count] = *info;
+    return graph->resources_count++;
+}
+
+graph_resource_t graph_create_image(graph_t *graph, const char *name, VkFormat format, VkExtent2D extent) {
+    graph_resource_info_t info = {
+        .name = name,
+        .image = true,
+        .aspect = graph_format_aspect(format),
+        .format = format,
+        .extent = extent,
+    };
+    return graph_add_resource(graph, &info);
+}
+
+graph_resource_t graph_create_buffer(graph_t *graph, const char *name, VkDeviceSize size) {
+    graph_resource_info_t info = {
+        .name = name,
+        .size = size,
+    };
+    return graph_add_resource(graph, &info);
+}
+
+graph_resource_t graph_import_image(graph_t *graph, const char *name, VkImage image, VkImageAspectFlags aspect,
+                                    graph_state_t initial, graph_state_t final) {
+    graph_resource_info_t info = {
+        .name = name,
+        .image = true,
+        .imported = true,
+        .image_handle = image,
+        .aspect = aspect,
+        .initial = initial,
+        .final = final,
+    };
+    return graph_add_resource(graph, &info);
+}
+
+graph_resource_t graph_import_buffer(graph_t *graph, const char *name, VkBuffer buffer, graph_state_t initial,
+                                     graph_state_t final) {
+    graph_resource_info_t info = {
+        .name = name,
+        .imported = true,
+        .buffer_handle = buffer,
+        .initial = initial,
+        .final = final,
+    };
+    return graph_add_resource(graph, &info);
+}
+
+// a compiled graph can be replayed against new imported handles, such as the next swapchain image
+void graph_set_image(graph_t *graph, graph_resource_t resource, VkImage image) {
+    assert(resource < graph->resources_count && graph->resources[resource].imported && graph->resources[resource].image);
+    graph->resources[resource].image_handle = image;
+}
+
+void graph_set_buffer(graph_t *graph, graph_resource_t resource, VkBuffer buffer) {
+    assert(resource < graph->resources_count && graph->resources[resource].imported && !graph->resources[resource].image);
+    graph->resources[resource].buffer_handle = buffer;
+}
+
+uint32_t graph_add_pass(graph_t *graph, const char *name, graph_record_t record, void *data, bool side_effects) {
+    assert(!graph->compiled && graph->passes_count < GRAPH_MAX_PASSES);
+    graph->passes[graph->passes_count] = (graph_pass_t){
+        .name = name,
+        .record = record,
+        .data = data,
+        .side_effects = side_effects,
+    };
+    return graph->passes_count++;
+}
+
+// one use per resource and pass, so a pass never needs a barrier against itself
+void graph_use(graph_t *graph, uint32_t pass, graph_resource_t resource, graph_access_t access) {
+    assert(!graph->compiled && pass < graph->passes_count && resource < graph->resources_count && access < GRAPH_ACCESS_COUNT);
+    graph_pass_t *info = &graph->passes[pass];
+    assert(info->uses_count < GRAPH_MAX_PASS_USES);
+    for (uint32_t i = 0; i < info->uses_count; i++)
+        assert(info->uses[i].resource != resource);
+    info->uses[info->uses_count++] = (graph_use_t){.resource = resource, .access = access};
+}
+
+// back to front, a pass survives if it has side effects or writes contents a surviving pass or an output still reads
+static void graph_cull(graph_t *graph) {
+    for (uint32_t i = 0; i < graph->resources_count; i++) {
+        graph_resource_info_t *resource = &graph->resources[i];
+        resource->needed = resource->imported && resource->final.stages != 0;
+    }
+
+    for (uint32_t p = graph->passes_count; p-- > 0;) {
+        graph_pass_t *pass = &graph->passes[p];
+        bool live = pass->side_effects;
+        for (uint32_t i = 0; i < pass->uses_count; i++)
+            live = live || (graph_accesses[pass->uses[i].access].writes && graph->resources[pass->uses[i].resource].needed);
+        pass->culled = !live;
+        if (!live)
+            continue;
+
+        // a write replaces what earlier passes wrote, unless this pass reads it first
+        for (uint32_t i = 0; i < pass->uses_count; i++) {
+            const graph_access_info_t *access = &graph_accesses[pass->uses[i].access];
+            graph_resource_info_t *resource = &graph->resources[pass->uses[i].resource];
+            if (access->writes)
+                resource->needed = false;
+            if (access->reads)
+                resource->needed = true;
+        }
+    }
+
+    for (uint32_t p = 0; p < graph->passes_count; p++) {
+        graph_pass_t *pass = &graph->passes[p];
+        if (pass->culled) {
+            graph->stats.culled_count++;
+            continue;
+        }
+        for (uint32_t i = 0; i < pass->uses_count; i++) {
+            const graph_access_info_t *access = &graph_accesses[pass->uses[i].access];
+            graph_resource_info_t *resource = &graph->resources[pass->uses[i].resource];
+            if (resource->first_pass == UINT32_MAX)
+                resource->first_pass = p;
+            resource->last_pass = p;
+            resource->usage |= resource->image ? access->image_usage : access->buffer_usage;
+            resource->used_stages |= access->stages;
+            resource->written_accesses |= access->accesses & GRAPH_WRITE_ACCESSES;
+        }
+    }
+}
+
+static bool graph_transient(graph_resource_info_t *resource) {
+    return !resource->imported && resource->first_pass != UINT32_MAX;
+}
+
+static bool graph_lifetimes_overlap(graph_t *graph, graph_resource_info_t *a, graph_resource_info_t *b) {
+    return !graph->aliasing || (a->first_pass <= b->last_pass && b->first_pass <= a->last_pass);
+}
+
+static bool graph_memory_overlaps(graph_resource_info_t *a, graph_resource_info_t *b) {
+    return a->memory_offset < b->memory_offset + b->memory_requirements.size &&
+           b->memory_offset < a->memory_offset + a->memory_requirements.size;
+}
+
+// transients share one allocation, largest first, each at the lowest offset clear of every placed resource it lives
+// alongside, with sizes rounded to bufferImageGranularity so buffers and optimal images can take turns on the same pages
+static void graph_place_transients(vulkan_t *vulkan, graph_t *graph) {
+    VkDeviceSize granularity = vulkan->device_properties.limits.bufferImageGranularity;
+    VkMemoryRequirements memory_requirements = {.alignment = 1, .memoryTypeBits = UINT32_MAX};
+    graph_resource_t order[GRAPH_MAX_RESOURCES];
+    uint32_t order_count = 0;
+
+    for (graph_resource_t r = 0; r < graph->resources_count; r++) {
+        graph_resource_info_t *resource = &graph->resources[r];
+        if (!graph_transient(resource))
+            continue;
+
+        VkResult result;
+        if (resource->image) {
+            VkImageCreateInfo image_create_info = {
+                .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+                .imageType = VK_IMAGE_TYPE_2D,
+                .format = resource->format,
+                .extent = {resource->extent.width, resource->extent.height, 1},
+                .mipLevels = 1,
+                .arrayLayers = 1,
+                .samples = VK_SAMPLE_COUNT_1_BIT,
+                .tiling = VK_IMAGE_TILING_OPTIMAL,
+                .usage = resource->usage,
+                .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+                .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+            };
+            result = vulkan->vkCreateImage(vulkan->logical_device, &image_create_info, vulkan->allocation_callbacks,
+                                           &resource->image_handle);
+            assert(result == VK_SUCCESS);
+            vulkan->vkGetImageMemoryRequirements(vulkan->logical_device, resource->image_handle,
+                                                 &resource->memory_requirements);
+        } else {
+            VkBufferCreateInfo buffer_create_info = {
+                .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+                .size = resource->size,
+                .usage = resource->usage,
+                .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+            };
+            result = vulkan->vkCreateBuffer(vulkan->logical_device, &buffer_create_info, vulkan->allocation_callbacks,
+                                            &resource->buffer_handle);
+            assert(result == VK_SUCCESS);
+            vulkan->vkGetBufferMemoryRequirements(vulkan->logical_device, resource->buffer_handle,
+                                                  &resource->memory_requirements);
+        }
+
+        VkMemoryRequirements *requirements = &resource->memory_requirements;
+        if (requirements->alignment < granularity)
+            requirements->alignment = granularity;
+        requirements->size = graph_align(requirements->size, requirements->alignment);
+        if (requirements->alignment > memory_requirements.alignment)
+            memory_requirements.alignment = requirements->alignment;
+        memory_requirements.memoryTypeBits &= requirements->memoryTypeBits;
+        graph->stats.unaliased_bytes += requirements->size;
+        graph->stats.transient_count++;
+
+        uint32_t slot = order_count++;
+        while (slot > 0 && graph->resources[order[slot - 1]].memory_requirements.size < requirements->size) {
+            order[slot] = order[slot - 1];
+            slot--;
+        }
+        order[slot] = r;
+    }
+
+    for (uint32_t i = 0; i < order_count; i++) {
+        graph_resource_info_t *resource = &graph->resources[order[i]];
+        resource->memory_offset = 0;
+        for (bool moved = true; moved;) {
+            moved = false;
+            for (uint32_t j = 0; j < i; j++) {
+                graph_resource_info_t *placed = &graph->resources[order[j]];
+                if (graph_lifetimes_overlap(graph, resource, placed) && graph_memory_overlaps(resource, placed)) {
+                    resource->memory_offset = graph_align(placed->memory_offset + placed->memory_requirements.size,
+                                                          resource->memory_requirements.alignment);
+                    moved = true;
+                }
+            }
+        }
+        VkDeviceSize end = resource->memory_offset + resource->memory_requirements.size;
+        if (end > memory_requirements.size)
+            memory_requirements.size = end;
+    }
+    graph->stats.transient_bytes = memory_requirements.size;
+    if (order_count == 0)
+        return;
+
+    assert(graph->allocator && memory_requirements.memoryTypeBits != 0);
+    VkResult result = allocator_allocate(vulkan, graph->allocator, &memory_requirements, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 0,
+                                         ALLOCATOR_RESOURCE_OPTIMAL, &graph->memory);
+    assert(result == VK_SUCCESS);
+
+    for (uint32_t i = 0; i < order_count; i++) {
+        graph_resource_info_t *resource = &graph->resources[order[i]];
+        VkDeviceSize offset = graph->memory.offset + resource->memory_offset;
+        if (resource->image)
+            result = vulkan->vkBindImageMemory(vulkan->logical_device, resource->image_handle, graph->memory.memory, offset);
+        else
+            result = vulkan->vkBindBufferMemory(vulkan->logical_device, resource->buffer_handle, graph->memory.memory, offset);
+        assert(result == VK_SUCCESS);
+    }
+}
+
+// the handle is filled in by graph_execute, so imported resources can change between replays
+static void graph_add_barrier(graph_t *graph, graph_batch_t *batch, graph_resource_t r, graph_track_t *track,
+                              VkPipelineStageFlags src_stages, VkAccessFlags src_accesses, VkPipelineStageFlags dst_stages,
+                              VkAccessFlags dst_accesses, VkImageLayout layout) {
+    graph_resource_info_t *resource = &graph->resources[r];
+    batch->src_stages |= src_stages ? src_stages : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+    batch->dst_stages |= dst_stages;
+
+    if (resource->image) {
+        assert(graph->image_barriers_count < GRAPH_MAX_BARRIERS);
+        graph->image_barrier_resources[graph->image_barriers_count] = r;
+        graph->image_barriers[graph->image_barriers_count++] = (VkImageMemoryBarrier){
+            .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+            .srcAccessMask = src_accesses,
+            .dstAccessMask = dst_accesses,
+            .oldLayout = track->layout,
+            .newLayout = layout,
+            .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .subresourceRange = {resource->aspect, 0, VK_REMAINING_MIP_LEVELS, 0, VK_REMAINING_ARRAY_LAYERS},
+        };
+        batch->image_barriers_count++;
+    } else {
+        assert(graph->buffer_barriers_count < GRAPH_MAX_BARRIERS);
+        graph->buffer_barrier_resources[graph->buffer_barriers_count] = r;
+        graph->buffer_barriers[graph->buffer_barriers_count++] = (VkBufferMemoryBarrier){
+            .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+            .srcAccessMask = src_accesses,
+            .dstAccessMask = dst_accesses,
+            .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .size = VK_WHOLE_SIZE,
+        };
+        batch->buffer_barriers_count++;
+    }
+}
+
+// walks the surviving passes in order, giving each one barrier batch covering every hazard on the resources it uses
+static void graph_build_barriers(graph_t *graph) {
+    graph_track_t tracks[GRAPH_MAX_RESOURCES];
+    for (graph_resource_t r = 0; r < graph->resources_count; r++) {
+        graph_resource_info_t *resource = &graph->resources[r];
+        tracks[r] = (graph_track_t){
+            .write_stages = resource->initial.stages,
+            .write_accesses = resource->initial.accesses,
+            .layout = resource->imported ? resource->initial.layout : VK_IMAGE_LAYOUT_UNDEFINED,
+        };
+        if (!graph_transient(resource))
+            continue;
+
+        // a transient's first use waits for everything sharing its memory, this frame or the one before on the queue
+        for (graph_resource_t a = 0; a < graph->resources_count; a++) {
+            graph_resource_info_t *alias = &graph->resources[a];
+            if (graph_transient(alias) && graph_memory_overlaps(resource, alias)) {
+                tracks[r].write_stages |= alias->used_stages;
+                tracks[r].write_accesses |= alias->written_accesses;
+            }
+        }
+    }
+
+    for (uint32_t p = 0; p < graph->passes_count; p++) {
+        graph_pass_t *pass = &graph->passes[p];
+        if (pass->culled)
+            continue;
+
+        pass->batch = (graph_batch_t){
+            .image_barriers_first = graph->image_barriers_count,
+            .buffer_barriers_first = graph->buffer_barriers_count,
+        };
+        for (uint32_t i = 0; i < pass->uses_count; i++) {
+            graph_resource_t r = pass->uses[i].resource;
+            const graph_access_info_t *access = &graph_accesses[pass->uses[i].access];
+            graph_track_t *track = &tracks[r];
+            bool transition = graph->resources[r].image && track->layout != access->layout;
+
+            if (transition || access->writes) {
+                // writes and layout changes wait for every access since the last write
+                VkPipelineStageFlags src_stages = track->write_stages | track->read_stages;
+                if (src_stages || transition)
+                    graph_add_barrier(graph, &pass->batch, r, track, src_stages, track->write_accesses, access->stages,
+                                      access->accesses, access->layout);
+                track->write_stages = access->stages;
+                track->write_accesses = access->accesses & GRAPH_WRITE_ACCESSES;
+                track->read_stages = access->writes ? 0 : access->stages;
+                track->visible_stages = access->stages;
+            } else {
+                // reads only wait for the last write, once per stage
+                if (track->write_stages && (access->stages & ~track->visible_stages)) {
+                    graph_add_barrier(graph, &pass->batch, r, track, track->write_stages, track->write_accesses,
+                                      access->stages, access->accesses, access->layout);
+                    track->visible_stages |= access->stages;
+                }
+                track->read_stages |= access->stages;
+            }
+            track->layout = access->layout;
+        }
+        graph->stats.image_barriers += pass->batch.image_barriers_count;
+        graph->stats.buffer_barriers += pass->batch.buffer_barriers_count;
+        if (pass->batch.image_barriers_count + pass->batch.buffer_barriers_count > 0)
+            graph->stats.barrier_calls++;
+    }
+
+    // outputs end up in the state whoever consumes them next expects
+    graph->final_batch = (graph_batch_t){
+        .image_barriers_first = graph->image_barriers_count,
+        .buffer_barriers_first = graph->buffer_barriers_count,
+    };
+    for (graph_resource_t r = 0; r < graph->resources_count; r++) {
+        graph_resource_info_t *resource = &graph->resources[r];
+        if (!resource->imported || resource->final.stages == 0)
+            continue;
+        graph_track_t *track = &tracks[r];
+        VkImageLayout layout = resource->image && resource->final.layout != VK_IMAGE_LAYOUT_UNDEFINED ? resource->final.layout
+                                                                                                       : track->layout;
+        if (resource->first_pass == UINT32_MAX && layout == track->layout)
+            continue;
+        graph_add_barrier(graph, &graph->final_batch, r, track, track->write_stages | track->read_stages,
+                          track->write_accesses, resource->final.stages, resource->final.accesses, layout);
+    }
+    graph->stats.image_barriers += graph->final_batch.image_barriers_count;
+    graph->stats.buffer_barriers += graph->final_batch.buffer_barriers_count;
+    if (graph->final_batch.image_barriers_count + graph->final_batch.buffer_barriers_count > 0)
+        graph->stats.barrier_calls++;
+}
+
+void graph_compile(vulkan_t *vulkan, graph_t *graph) {
+    assert(!graph->compiled);
+    graph->stats = (graph_stats_t){.passes_count = graph->passes_count};
+    graph_cull(graph);
+    graph_place_transients(vulkan, graph);
+    graph_build_barriers(graph);
+    graph->compiled = true;
+}
+
+static void graph_flush(vulkan_t *vulkan, graph_t *graph, VkCommandBuffer command_buffer, graph_batch_t *batch) {
+    if (batch->image_barriers_count + batch->buffer_barriers_count == 0)
+        return;
+    for (uint32_t i = batch->image_barriers_first; i < batch->image_barriers_first + batch->image_barriers_count; i++)
+        graph->image_barriers[i].image = graph->resources[graph->image_barrier_resources[i]].image_handle;
+    for (uint32_t i = batch->buffer_barriers_first; i < batch->buffer_barriers_first + batch->buffer_barriers_count; i++)
+        graph->buffer_barriers[i].buffer = graph->resources[graph->buffer_barrier_resources[i]].buffer_handle;
+    vulkan->vkCmdPipelineBarrier(command_buffer, batch->src_stages, batch->dst_stages, 0, 0, NULL, batch->buffer_barriers_count,
+                                 &graph->buffer_barriers[batch->buffer_barriers_first], batch->image_barriers_count,
+                                 &graph->image_barriers[batch->image_barriers_first]);
+}
+
+void graph_execute(vulkan_t *vulkan, graph_t *graph, VkCommandBuffer command_buffer) {
+    assert(graph->compiled);
+    for (uint32_t p = 0; p < graph->passes_count; p++) {
+        graph_pass_t *pass = &graph->passes[p];
+        if (pass->culled)
+            continue;
+        graph_flush(vulkan, graph, command_buffer, &pass->batch);
+        if (pass->record)
+            pass->record(vulkan, graph, command_buffer, pass->data);
+    }
+    graph_flush(vulkan, graph, command_buffer, &graph->final_batch);
+}
+
+VkImage graph_image(graph_t *graph, graph_resource_t resource) {
+    assert(resource < graph->resources_count && graph->resources[resource].image);
+    return graph->resources[resource].image_handle;
+}
+
+VkBuffer graph_buffer(graph_t *graph, graph_resource_t resource) {
+    assert(resource < graph->resources_count && !graph->resources[resource].image);
+    return graph->resources[resource].buffer_handle;
+}
+
+void graph_report(graph_t *graph) {
+    graph_stats_t *stats = &graph->stats;
+    printf("graph: %u passes, %u culled, %u transients, %u barrier calls for %u image and %u buffer barriers, "
+           "%.2f MiB transient, %.2f MiB unaliased\n",
+           stats->passes_count, stats->culled_count, stats->transient_count, stats->barrier_calls, stats->image_barriers,
+           stats->buffer_barriers, stats->transient_bytes / 1048576.0, stats->unaliased_bytes / 1048576.0);
+}
+
+void graph_free_resources(vulkan_t *vulkan, graph_t *graph) {
+    for (graph_resource_t r = 0; r < graph->resources_count; r++) {
+        graph_resource_info_t *resource = &graph->resources[r];
+        if (resource->imported)
+            continue;
+        if (resource->image_handle != VK_NULL_HANDLE)
+            vulkan->vkDestroyImage(vulkan->logical_device, resource->image_handle, vulkan->allocation_callbacks);
+        if (resource->buffer_handle != VK_NULL_HANDLE)
+            vulkan->vkDestroyBuffer(vulkan->logical_device, resource->buffer_handle, vulkan->allocation_callbacks);
+    }
+    if (graph->memory.memory != VK_NULL_HANDLE)
+        allocator_free(vulkan, graph->allocator, &graph->memory);
+    graph_create(graph, graph->allocator, graph->aliasing);
+}
+
+// the synthetic passes only record work their declared accesses make legal, clears and fills of what they transfer-write
+static void graph_benchmark_record(vulkan_t *vulkan, graph_t *graph, VkCommandBuffer command_buffer, void *data) {
+    graph_pass_t *pass = &graph->passes[(uintptr_t)data];
+    for (uint32_t i = 0; i < pass->uses_count; i++) {
+        if (pass->uses[i].access != GRAPH_ACCESS_TRANSFER_WRITE)
+            continue;
+        graph_resource_info_t *resource = &graph->resources[pass->uses[i].resource];
+        if (resource->image) {
+            VkClearColorValue clear_color = {.float32 = {0.0f, 0.0f, 0.0f, 1.0f}};
+            VkImageSubresourceRange subresource_range = {resource->aspect, 0, 1, 0, 1};
+            vulkan->vkCmdClearColorImage(command_buffer, resource->image_handle, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                                         &clear_color, 1, &subresource_range);
+        } else {
+            vulkan->vkCmdFillBuffer(command_buffer, resource->buffer_handle, 0, VK_WHOLE_SIZE, 0);
+        }
+    }
+}
+
+static uint32_t graph_benchmark_pass(graph_t *graph, const char *name) {
+    return graph_add_pass(graph, name, graph_benchmark_record, (void *)(uintptr_t)graph->passes_count, false);
+}
+
+// a deferred frame: shadows, g-buffer, ssao, lighting, exposure, bloom and tonemapping, plus a debug overlay and a
+// histogram nobody reads, which culling drops
+static void graph_benchmark_build(graph_t *graph, VkImage output) {
+    VkExtent2D full = {GRAPH_BENCHMARK_WIDTH, GRAPH_BENCHMARK_HEIGHT};
+    VkExtent2D half = {GRAPH_BENCHMARK_WIDTH / 2, GRAPH_BENCHMARK_HEIGHT / 2};
+    VkExtent2D shadow = {GRAPH_BENCHMARK_SHADOW_SIZE, GRAPH_BENCHMARK_SHADOW_SIZE};
+
+    graph_resource_t shadow_map = graph_create_image(graph, "shadow map", VK_FORMAT_D16_UNORM, shadow);
+    graph_resource_t albedo = graph_create_image(graph, "albedo", VK_FORMAT_R8G8B8A8_UNORM, full);
+    graph_resource_t normal = graph_create_image(graph, "normal", VK_FORMAT_R16G16B16A16_SFLOAT, full);
+    graph_resource_t depth = graph_create_image(graph, "depth", VK_FORMAT_D16_UNORM, full);
+    graph_resource_t ssao = graph_create_image(graph, "ssao", VK_FORMAT_R8_UNORM, full);
+    graph_resource_t ssao_blurred = graph_create_image(graph, "ssao blurred", VK_FORMAT_R8_UNORM, full);
+    graph_resource_t hdr = graph_create_image(graph, "hdr", VK_FORMAT_R16G16B16A16_SFLOAT, full);
+    graph_resource_t exposure = graph_create_buffer(graph, "exposure", 256);
+    graph_resource_t bloom_down = graph_create_image(graph, "bloom downsampled", VK_FORMAT_R16G16B16A16_SFLOAT, half);
+    graph_resource_t bloom_up = graph_create_image(graph, "bloom upsampled", VK_FORMAT_R16G16B16A16_SFLOAT, full);
+    graph_resource_t debug = graph_create_image(graph, "debug", VK_FORMAT_R8G8B8A8_UNORM, full);
+    graph_resource_t histogram = graph_create_buffer(graph, "histogram", 1024);
+    graph_resource_t target = graph_import_image(
+        graph, "output", output, VK_IMAGE_ASPECT_COLOR_BIT, (graph_state_t){0, 0, VK_IMAGE_LAYOUT_UNDEFINED},
+        (graph_state_t){VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL});
+
+    uint32_t pass = graph_benchmark_pass(graph, "shadows");
+    graph_use(graph, pass, shadow_map, GRAPH_ACCESS_DEPTH_ATTACHMENT_WRITE);
+
+    pass = graph_benchmark_pass(graph, "g-buffer");
+    graph_use(graph, pass, albedo, GRAPH_ACCESS_COLOR_ATTACHMENT_WRITE);
+    graph_use(graph, pass, normal, GRAPH_ACCESS_COLOR_ATTACHMENT_WRITE);
+    graph_use(graph, pass, depth, GRAPH_ACCESS_DEPTH_ATTACHMENT_WRITE);
+
+    pass = graph_benchmark_pass(graph, "ssao");
+    graph_use(graph, pass, depth, GRAPH_ACCESS_FRAGMENT_READ);
+    graph_use(graph, pass, normal, GRAPH_ACCESS_FRAGMENT_READ);
+    graph_use(graph, pass, ssao, GRAPH_ACCESS_COLOR_ATTACHMENT_WRITE);
+
+    pass = graph_benchmark_pass(graph, "ssao blur");
+    graph_use(graph, pass, ssao, GRAPH_ACCESS_FRAGMENT_READ);
+    graph_use(graph, pass, ssao_blurred, GRAPH_ACCESS_COLOR_ATTACHMENT_WRITE);
+
+    pass = graph_benchmark_pass(graph, "lighting");
+    graph_use(graph, pass, albedo, GRAPH_ACCESS_FRAGMENT_READ);
+    graph_use(graph, pass, normal, GRAPH_ACCESS_FRAGMENT_READ);
+    graph_use(graph, pass, depth, GRAPH_ACCESS_FRAGMENT_READ);
+    graph_use(graph, pass, ssao_blurred, GRAPH_ACCESS_FRAGMENT_READ);
+    graph_use(graph, pass, shadow_map, GRAPH_ACCESS_FRAGMENT_READ);
+    graph_use(graph, pass, hdr, GRAPH_ACCESS_COLOR_ATTACHMENT_WRITE);
+
+    pass = graph_benchmark_pass(graph, "luminance");
+    graph_use(graph, pass, hdr, GRAPH_ACCESS_COMPUTE_READ);
+    graph_use(graph, pass, exposure, GRAPH_ACCESS_TRANSFER_WRITE);
+
+    pass = graph_benchmark_pass(graph, "bloom downsample");
+    graph_use(graph, pass, hdr, GRAPH_ACCESS_FRAGMENT_READ);
+    graph_use(graph, pass, bloom_down, GRAPH_ACCESS_COLOR_ATTACHMENT_WRITE);
+
+    pass = graph_benchmark_pass(graph, "bloom upsample");
+    graph_use(graph, pass, bloom_down, GRAPH_ACCESS_FRAGMENT_READ);
+    graph_use(graph, pass, bloom_up, GRAPH_ACCESS_COLOR_ATTACHMENT_WRITE);
+
+    pass = graph_benchmark_pass(graph, "debug overlay");
+    graph_use(graph, pass, depth, GRAPH_ACCESS_FRAGMENT_READ);
+    graph_use(graph, pass, normal, GRAPH_ACCESS_FRAGMENT_READ);
+    graph_use(graph, pass, debug, GRAPH_ACCESS_COLOR_ATTACHMENT_WRITE);
+
+    pass = graph_benchmark_pass(graph, "tonemap");
+    graph_use(graph, pass, hdr, GRAPH_ACCESS_FRAGMENT_READ);
+    graph_use(graph, pass, bloom_up, GRAPH_ACCESS_FRAGMENT_READ);
+    graph_use(graph, pass, exposure, GRAPH_ACCESS_FRAGMENT_READ);
+    graph_use(graph, pass, target, GRAPH_ACCESS_TRANSFER_WRITE);
+
+    pass = graph_benchmark_pass(graph, "histogram");
+    graph_use(graph, pass, hdr, GRAPH_ACCESS_COMPUTE_READ);
+    graph_use(graph, pass, histogram, GRAPH_ACCESS_TRANSFER_WRITE);
+}
+
+void graph_benchmark(uint32_t iterations) {
+    vulkan_t vulkan = {.headless = true};
+    bench_bootstrap(&vulkan);
+    allocator_t allocator;
+    allocator_create(&vulkan, &allocator);
+    vulkan_queue_t queue = vulkan.queues[VULKAN_QUEUE_GRAPHICS];
+
+    VkCommandPoolCreateInfo command_pool_create_info = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+        .flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT,
+        .queueFamilyIndex = queue.family_index,
+    };
+    VkCommandPool command_pool;
+    VkResult result = vulkan.vkCreateCommandPool(vulkan.logical_device, &command_pool_create_info, vulkan.allocation_callbacks,
+                                                 &command_pool);
+    assert(result == VK_SUCCESS);
+    VkCommandBufferAllocateInfo command_buffer_allocate_info = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+        .commandPool = command_pool,
+        .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+        .commandBufferCount = 1,
+    };
+    VkCommandBuffer command_buffer;
+    result = vulkan.vkAllocateCommandBuffers(vulkan.logical_device, &command_buffer_allocate_info, &command_buffer);
+    assert(result == VK_SUCCESS);
+    VkFenceCreateInfo fence_create_info = {
+        .sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
+    };
+    VkFence fence;
+    result = vulkan.vkCreateFence(vulkan.logical_device, &fence_create_info, vulkan.allocation_callbacks, &fence);
+    assert(result == VK_SUCCESS);
+
+    VkImageCreateInfo image_create_info = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+        .imageType = VK_IMAGE_TYPE_2D,
+        .format = VK_FORMAT_R8G8B8A8_UNORM,
+        .extent = {GRAPH_BENCHMARK_WIDTH, GRAPH_BENCHMARK_HEIGHT, 1},
+        .mipLevels = 1,
+        .arrayLayers = 1,
+        .samples = VK_SAMPLE_COUNT_1_BIT,
+        .tiling = VK_IMAGE_TILING_OPTIMAL,
+        .usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
+        .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+        .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+    };
+    VkImage output;
+    allocation_t output_allocation;
+    result = allocator_create_image(&vulkan, &allocator, &image_create_info, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 0, &output,
+                                    &output_allocation);
+    assert(result == VK_SUCCESS);
+
+    graph_t *graph = (graph_t *)malloc(sizeof(graph_t));
+    for (uint32_t aliasing = 0; aliasing < 2; aliasing++) {
+        bench_samples_t compile_samples, record_samples, submit_samples;
+        bench_samples_create(&compile_samples, aliasing ? "graph build and compile (aliasing)" : "graph build and compile",
+                             iterations);
+        bench_samples_create(&record_samples, aliasing ? "graph execute (aliasing)" : "graph execute", iterations);
+        bench_samples_create(&submit_samples, aliasing ? "graph submit and wait (aliasing)" : "graph submit and wait",
+                             iterations);
+
+        for (uint32_t i = 0; i < iterations; i++) {
+            uint64_t start = bench_now_ns();
+            graph_create(graph, &allocator, aliasing);
+            graph_benchmark_build(graph, output);
+            graph_compile(&vulkan, graph);
+            bench_samples_push(&compile_samples, bench_now_ns() - start);
+
+            VkCommandBufferBeginInfo begin_info = {
+                .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+                .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+            };
+            result = vulkan.vkBeginCommandBuffer(command_buffer, &begin_info);
+            assert(result == VK_SUCCESS);
+            start = bench_now_ns();
+            graph_execute(&vulkan, graph, command_buffer);
+            bench_samples_push(&record_samples, bench_now_ns() - start);
+            result = vulkan.vkEndCommandBuffer(command_buffer);
+            assert(result == VK_SUCCESS);
+
+            VkSubmitInfo submit_info = {
+                .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+                .commandBufferCount = 1,
+                .pCommandBuffers = &command_buffer,
+            };
+            start = bench_now_ns();
+            result = vulkan.vkQueueSubmit(queue.queue, 1, &submit_info, fence);
+            assert(result == VK_SUCCESS);
+            result = vulkan.vkWaitForFences(vulkan.logical_device, 1, &fence, VK_TRUE, UINT64_MAX);
+            assert(result == VK_SUCCESS);
+            bench_samples_push(&submit_samples, bench_now_ns() - start);
+            result = vulkan.vkResetFences(vulkan.logical_device, 1, &fence);
+            assert(result == VK_SUCCESS);
+
+            if (i + 1 == iterations) {
+                graph_report(graph);
+                // without batching every barrier would be a vkCmdPipelineBarrier of its own
+                printf("%-48s %u barrier calls, %u unbatched\n", aliasing ? "batching (aliasing)" : "batching",
+                       graph->stats.barrier_calls, graph->stats.image_barriers + graph->stats.buffer_barriers);
+                printf("%-48s %.2f MiB peak transient memory, %.2f MiB without aliasing\n",
+                       aliasing ? "transient memory (aliasing)" : "transient memory",
+                       graph->stats.transient_bytes / 1048576.0, graph->stats.unaliased_bytes / 1048576.0);
+            }
+            graph_free_resources(&vulkan, graph);
+        }
+
+        bench_samples_report(&compile_samples);
+        bench_samples_report(&record_samples);
+        bench_samples_report(&submit_samples);
+        bench_samples_free(&compile_samples);
+        bench_samples_free(&record_samples);
+        bench_samples_free(&submit_samples);
+    }
+    free(graph);
+
+    allocator_destroy_image(&vulkan, &allocator, output, &output_allocation);
+    vulkan.vkDestroyFence(vulkan.logical_device, fence, vulkan.allocation_callbacks);
+    vulkan.vkDestroyCommandPool(vulkan.logical_device, command_pool, vulkan.allocation_callbacks);
+    allocator_free_resources(&vulkan, &allocator);
+    vulkan_free_resources(&vulkan);
+}
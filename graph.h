@@ -0,0 +1,144 @@
+#ifndef GRAPH_H
+#define GRAPH_H
+
+#include "allocator.h"
+#include "vulkan.h"
+#include <stdbool.h>
+
+#define GRAPH_MAX_PASSES 64
+#define GRAPH_MAX_RESOURCES 64
+#define GRAPH_MAX_PASS_USES 16
+#define GRAPH_MAX_BARRIERS (GRAPH_MAX_PASSES * GRAPH_MAX_PASS_USES + GRAPH_MAX_RESOURCES)
+
+typedef uint32_t graph_resource_t;
+typedef struct graph_s graph_t;
+
+// how a pass touches a resource, each one implying a stage, an access mask, a layout and a usage flag
+typedef enum {
+    GRAPH_ACCESS_TRANSFER_READ,
+    GRAPH_ACCESS_TRANSFER_WRITE,
+    GRAPH_ACCESS_COMPUTE_READ,
+    GRAPH_ACCESS_COMPUTE_WRITE,
+    GRAPH_ACCESS_FRAGMENT_READ,
+    GRAPH_ACCESS_COLOR_ATTACHMENT_WRITE,
+    GRAPH_ACCESS_DEPTH_ATTACHMENT_WRITE,
+    GRAPH_ACCESS_INDIRECT_READ,
+    GRAPH_ACCESS_COUNT,
+} graph_access_t;
+
+// the state an imported resource arrives in, or has to be left in (no stages means the graph may leave it as it is)
+typedef struct {
+    VkPipelineStageFlags stages;
+    VkAccessFlags accesses;
+    VkImageLayout layout;
+} graph_state_t;
+
+typedef void (*graph_record_t)(vulkan_t *vulkan, graph_t *graph, VkCommandBuffer command_buffer, void *data);
+
+typedef struct {
+    graph_resource_t resource;
+    graph_access_t access;
+} graph_use_t;
+
+// every barrier a pass boundary needs, emitted as one vkCmdPipelineBarrier
+typedef struct {
+    VkPipelineStageFlags src_stages;
+    VkPipelineStageFlags dst_stages;
+    uint32_t image_barriers_first;
+    uint32_t image_barriers_count;
+    uint32_t buffer_barriers_first;
+    uint32_t buffer_barriers_count;
+} graph_batch_t;
+
+typedef struct {
+    const char *name;
+    graph_record_t record;
+    void *data;
+    bool side_effects;
+    uint32_t uses_count;
+    graph_use_t uses[GRAPH_MAX_PASS_USES];
+
+    bool culled;
+    graph_batch_t batch;
+} graph_pass_t;
+
+typedef struct {
+    const char *name;
+    bool image;
+    bool imported;
+    VkImage image_handle;
+    VkBuffer buffer_handle;
+    VkImageAspectFlags aspect;
+
+    // transient resources are described here and created by graph_compile
+    VkFormat format;
+    VkExtent2D extent;
+    VkDeviceSize size;
+    VkFlags usage;
+
+    graph_state_t initial;
+    graph_state_t final;
+
+    bool needed;
+    VkPipelineStageFlags used_stages;
+    VkAccessFlags written_accesses;
+    uint32_t first_pass;
+    uint32_t last_pass;
+    VkMemoryRequirements memory_requirements;
+    VkDeviceSize memory_offset;
+} graph_resource_info_t;
+
+typedef struct {
+    uint32_t passes_count;
+    uint32_t culled_count;
+    uint32_t transient_count;
+    uint32_t barrier_calls;
+    uint32_t image_barriers;
+    uint32_t buffer_barriers;
+    VkDeviceSize transient_bytes;
+    VkDeviceSize unaliased_bytes;
+} graph_stats_t;
+
+struct graph_s {
+    allocator_t *allocator;
+    bool aliasing;
+    bool compiled;
+
+    uint32_t passes_count;
+    graph_pass_t passes[GRAPH_MAX_PASSES];
+    uint32_t resources_count;
+    graph_resource_info_t resources[GRAPH_MAX_RESOURCES];
+
+    allocation_t memory;
+    uint32_t image_barriers_count;
+    VkImageMemoryBarrier image_barriers[GRAPH_MAX_BARRIERS];
+    graph_resource_t image_barrier_resources[GRAPH_MAX_BARRIERS];
+    uint32_t buffer_barriers_count;
+    VkBufferMemoryBarrier buffer_barriers[GRAPH_MAX_BARRIERS];
+    graph_resource_t buffer_barrier_resources[GRAPH_MAX_BARRIERS];
+    graph_batch_t final_batch;
+
+    graph_stats_t stats;
+};
+
+void graph_create(graph_t *graph, allocator_t *allocator, bool aliasing);
+graph_resource_t graph_create_image(graph_t *graph, const char *name, VkFormat format, VkExtent2D extent);
+graph_resource_t graph_create_buffer(graph_t *graph, const char *name, VkDeviceSize size);
+graph_resource_t graph_import_image(graph_t *graph, const char *name, VkImage image, VkImageAspectFlags aspect,
+                                    graph_state_t initial, graph_state_t final);
+graph_resource_t graph_import_buffer(graph_t *graph, const char *name, VkBuffer buffer, graph_state_t initial,
+                                     graph_state_t final);
+void graph_set_image(graph_t *graph, graph_resource_t resource, VkImage image);
+void graph_set_buffer(graph_t *graph, graph_resource_t resource, VkBuffer buffer);
+uint32_t graph_add_pass(graph_t *graph, const char *name, graph_record_t record, void *data, bool side_effects);
+void graph_use(graph_t *graph, uint32_t pass, graph_resource_t resource, graph_access_t access);
+void graph_compile(vulkan_t *vulkan, graph_t *graph);
+void graph_execute(vulkan_t *vulkan, graph_t *graph, VkCommandBuffer command_buffer);
+VkImage graph_image(graph_t *graph, graph_resource_t resource);
+VkBuffer graph_buffer(graph_t *graph, graph_resource_t resource);
+void graph_report(graph_t *graph);
+void graph_free_resources(vulkan_t *vulkan, graph_t *graph);
+
+void graph_benchmark(uint32_t iterations);
+
+#endif // GRAPH_H
@@ -0,0 +1,233 @@
+#include "host_memory.h"
+#include "bench.h"
+#include "vulkan.h"
+#include <assert.h>
+#include <stdalign.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// sits right in front of every block handed to the driver, so frees and reallocations know what they release
+typedef struct {
+    void *base;
+    size_t size;
+    VkSystemAllocationScope scope;
+} host_memory_header_t;
+
+static const char *host_memory_scope_names[HOST_MEMORY_SCOPE_COUNT] = {
+    [VK_SYSTEM_ALLOCATION_SCOPE_COMMAND] = "command",
+    [VK_SYSTEM_ALLOCATION_SCOPE_OBJECT] = "object",
+    [VK_SYSTEM_ALLOCATION_SCOPE_CACHE] = "cache",
+    [VK_SYSTEM_ALLOCATION_SCOPE_DEVICE] = "device",
+    [VK_SYSTEM_ALLOCATION_SCOPE_INSTANCE] = "instance",
+};
+
+static void host_memory_add(host_memory_scope_t *scope, size_t size) {
+    uint64_t bytes = atomic_fetch_add_explicit(&scope->bytes, size, memory_order_relaxed) + size;
+    atomic_fetch_add_explicit(&scope->count, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&scope->allocations, 1, memory_order_relaxed);
+
+    uint64_t peak = atomic_load_explicit(&scope->peak_bytes, memory_order_relaxed);
+    while (bytes > peak &&
+           !atomic_compare_exchange_weak_explicit(&scope->peak_bytes, &peak, bytes, memory_order_relaxed, memory_order_relaxed))
+        ;
+}
+
+static void host_memory_remove(host_memory_scope_t *scope, size_t size) {
+    atomic_fetch_sub_explicit(&scope->bytes, size, memory_order_relaxed);
+    atomic_fetch_sub_explicit(&scope->count, 1, memory_order_relaxed);
+}
+
+static host_memory_header_t *host_memory_header(void *memory) {
+    return (host_memory_header_t *)((unsigned char *)memory - sizeof(host_memory_header_t));
+}
+
+static VKAPI_ATTR void *VKAPI_CALL host_memory_allocate(void *user_data, size_t size, size_t alignment,
+                                                        VkSystemAllocationScope scope) {
+    host_memory_t *host_memory = (host_memory_t *)user_data;
+    assert(scope < HOST_MEMORY_SCOPE_COUNT && (alignment & (alignment - 1)) == 0);
+    if (size == 0)
+        return NULL;
+    if (alignment < alignof(max_align_t))
+        alignment = alignof(max_align_t);
+
+    // the header's size is a multiple of its alignment, so it stays aligned right in front of any aligned block
+    size_t header_size = sizeof(host_memory_header_t);
+    unsigned char *base = (unsigned char *)malloc(header_size + alignment - 1 + size);
+    if (base == NULL)
+        return NULL;
+
+    uintptr_t address = ((uintptr_t)base + header_size + alignment - 1) & ~(uintptr_t)(alignment - 1);
+    void *memory = (void *)address;
+    host_memory_header_t *header = host_memory_header(memory);
+    header->base = base;
+    header->size = size;
+    header->scope = scope;
+
+    host_memory_add(&host_memory->scopes[scope], size);
+    host_memory_add(&host_memory->total, size);
+    return memory;
+}
+
+static VKAPI_ATTR void VKAPI_CALL host_memory_free(void *user_data, void *memory) {
+    host_memory_t *host_memory = (host_memory_t *)user_data;
+    if (memory == NULL)
+        return;
+
+    host_memory_header_t *header = host_memory_header(memory);
+    host_memory_remove(&host_memory->scopes[header->scope], header->size);
+    host_memory_remove(&host_memory->total, header->size);
+    free(header->base);
+}
+
+// a fresh block every time, the alignment the driver asks for may differ from the original one
+static VKAPI_ATTR void *VKAPI_CALL host_memory_reallocate(void *user_data, void *original, size_t size, size_t alignment,
+                                                          VkSystemAllocationScope scope) {
+    if (original == NULL)
+        return host_memory_allocate(user_data, size, alignment, scope);
+    if (size == 0) {
+        host_memory_free(user_data, original);
+        return NULL;
+    }
+
+    void *memory = host_memory_allocate(user_data, size, alignment, scope);
+    if (memory == NULL)
+        return NULL;
+
+    size_t original_size = host_memory_header(original)->size;
+    memcpy(memory, original, original_size < size ? original_size : size);
+    host_memory_free(user_data, original);
+    return memory;
+}
+
+static VKAPI_ATTR void VKAPI_CALL host_memory_internal_allocate(void *user_data, size_t size, VkInternalAllocationType type,
+                                                                VkSystemAllocationScope scope) {
+    host_memory_t *host_memory = (host_memory_t *)user_data;
+    (void)type;
+    host_memory_add(&host_memory->internal_scopes[scope], size);
+}
+
+static VKAPI_ATTR void VKAPI_CALL host_memory_internal_free(void *user_data, size_t size, VkInternalAllocationType type,
+                                                            VkSystemAllocationScope scope) {
+    host_memory_t *host_memory = (host_memory_t *)user_data;
+    (void)type;
+    host_memory_remove(&host_memory->internal_scopes[scope], size);
+}
+
+void host_memory_create(host_memory_t *host_memory) {
+    static_assert(alignof(max_align_t) % alignof(host_memory_header_t) == 0, "headers must stay aligned in front of blocks");
+
+    memset(host_memory, 0, sizeof(*host_memory));
+    host_memory->callbacks = (VkAllocationCallbacks){
+        .pUserData = host_memory,
+        .pfnAllocation = host_memory_allocate,
+        .pfnReallocation = host_memory_reallocate,
+        .pfnFree = host_memory_free,
+        .pfnInternalAllocation = host_memory_internal_allocate,
+        .pfnInternalFree = host_memory_internal_free,
+    };
+}
+
+static void host_memory_read_scope(host_memory_scope_t *scope, host_memory_stats_t *stats) {
+    stats->bytes = atomic_load_explicit(&scope->bytes, memory_order_relaxed);
+    stats->count = atomic_load_explicit(&scope->count, memory_order_relaxed);
+    stats->peak_bytes = atomic_load_explicit(&scope->peak_bytes, memory_order_relaxed);
+    stats->allocations = atomic_load_explicit(&scope->allocations, memory_order_relaxed);
+}
+
+void host_memory_read(host_memory_t *host_memory, VkSystemAllocationScope scope, host_memory_stats_t *stats) {
+    assert(scope < HOST_MEMORY_SCOPE_COUNT);
+    host_memory_read_scope(&host_memory->scopes[scope], stats);
+}
+
+void host_memory_read_total(host_memory_t *host_memory, host_memory_stats_t *stats) {
+    host_memory_read_scope(&host_memory->total, stats);
+}
+
+void host_memory_report(host_memory_t *host_memory) {
+    printf("%-10s %12s %10s %12s %12s %14s\n", "scope", "live bytes", "live", "peak bytes", "allocations", "internal peak");
+    for (uint32_t i = 0; i < HOST_MEMORY_SCOPE_COUNT; i++) {
+        host_memory_stats_t stats, internal;
+        host_memory_read_scope(&host_memory->scopes[i], &stats);
+        host_memory_read_scope(&host_memory->internal_scopes[i], &internal);
+        printf("%-10s %12llu %10llu %12llu %12llu %14llu\n", host_memory_scope_names[i], (unsigned long long)stats.bytes,
+               (unsigned long long)stats.count, (unsigned long long)stats.peak_bytes, (unsigned long long)stats.allocations,
+               (unsigned long long)internal.peak_bytes);
+    }
+
+    host_memory_stats_t total;
+    host_memory_read_total(host_memory, &total);
+    printf("%-10s %12llu %10llu %12llu %12llu\n", "total", (unsigned long long)total.bytes, (unsigned long long)total.count,
+           (unsigned long long)total.peak_bytes, (unsigned long long)total.allocations);
+}
+
+// one round of the objects a frame typically creates and throws away
+static void host_memory_benchmark_churn(vulkan_t *vulkan, const VkAllocationCallbacks *callbacks, bench_samples_t *samples) {
+    VkFenceCreateInfo fence_create_info = {.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO};
+    VkSemaphoreCreateInfo semaphore_create_info = {.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO};
+    VkBufferCreateInfo buffer_create_info = {
+        .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+        .size = 65536,
+        .usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+    };
+    VkCommandPoolCreateInfo command_pool_create_info = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+        .flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT,
+        .queueFamilyIndex = vulkan->queues[VULKAN_QUEUE_GRAPHICS].family_index,
+    };
+
+    VkFence fence = VK_NULL_HANDLE;
+    VkSemaphore semaphore = VK_NULL_HANDLE;
+    VkBuffer buffer = VK_NULL_HANDLE;
+    VkCommandPool command_pool = VK_NULL_HANDLE;
+
+    uint64_t start = bench_now_ns();
+    VkResult result = vulkan->vkCreateFence(vulkan->logical_device, &fence_create_info, callbacks, &fence);
+    assert(result == VK_SUCCESS);
+    result = vulkan->vkCreateSemaphore(vulkan->logical_device, &semaphore_create_info, callbacks, &semaphore);
+    assert(result == VK_SUCCESS);
+    result = vulkan->vkCreateBuffer(vulkan->logical_device, &buffer_create_info, callbacks, &buffer);
+    assert(result == VK_SUCCESS);
+    result = vulkan->vkCreateCommandPool(vulkan->logical_device, &command_pool_create_info, callbacks, &command_pool);
+    assert(result == VK_SUCCESS);
+
+    vulkan->vkDestroyCommandPool(vulkan->logical_device, command_pool, callbacks);
+    vulkan->vkDestroyBuffer(vulkan->logical_device, buffer, callbacks);
+    vulkan->vkDestroySemaphore(vulkan->logical_device, semaphore, callbacks);
+    vulkan->vkDestroyFence(vulkan->logical_device, fence, callbacks);
+    bench_samples_push(samples, bench_now_ns() - start);
+}
+
+void host_memory_benchmark(uint32_t iterations) {
+    vulkan_t vulkan = {.headless = true};
+    bench_bootstrap(&vulkan);
+
+    printf("host memory after startup, arena %u allocations, %zu bytes used in %u blocks, %zu reserved\n",
+           vulkan.arena.allocations, vulkan.arena.used_bytes, vulkan.arena.blocks_count, vulkan.arena.reserved_bytes);
+    host_memory_report(&vulkan.host_memory);
+
+    bench_samples_t driver, counted;
+    bench_samples_create(&driver, "object churn, driver allocator", iterations);
+    bench_samples_create(&counted, "object churn, counting callbacks", iterations);
+
+    host_memory_stats_t before, after;
+    host_memory_read_total(&vulkan.host_memory, &before);
+    for (uint32_t i = 0; i < iterations; i++) {
+        host_memory_benchmark_churn(&vulkan, NULL, &driver);
+        host_memory_benchmark_churn(&vulkan, vulkan.allocation_callbacks, &counted);
+    }
+    host_memory_read_total(&vulkan.host_memory, &after);
+
+    printf("object churn: %.1f host allocations per fence, semaphore, buffer and command pool round\n",
+           iterations > 0 ? (double)(after.allocations - before.allocations) / iterations : 0.0);
+    bench_samples_report(&driver);
+    bench_samples_report(&counted);
+    bench_samples_free(&driver);
+    bench_samples_free(&counted);
+
+    // everything the driver took through the callbacks has to be back once the instance is gone
+    vulkan_free_resources(&vulkan);
+    printf("host memory after teardown\n");
+    host_memory_report(&vulkan.host_memory);
+}
@@ -0,0 +1,40 @@
+#ifndef HOST_MEMORY_H
+#define HOST_MEMORY_H
+
+#include <stdatomic.h>
+#include <stdint.h>
+#include <vulkan/vulkan.h>
+
+#define HOST_MEMORY_SCOPE_COUNT (VK_SYSTEM_ALLOCATION_SCOPE_INSTANCE + 1)
+
+// counters may be bumped from any thread the driver allocates on
+typedef struct {
+    atomic_uint_fast64_t bytes;
+    atomic_uint_fast64_t count;
+    atomic_uint_fast64_t peak_bytes;
+    atomic_uint_fast64_t allocations;
+} host_memory_scope_t;
+
+typedef struct {
+    uint64_t bytes;
+    uint64_t count;
+    uint64_t peak_bytes;
+    uint64_t allocations;
+} host_memory_stats_t;
+
+// heap allocations made through the callbacks, and the driver's own internal allocations it only tells us about
+typedef struct {
+    VkAllocationCallbacks callbacks;
+    host_memory_scope_t scopes[HOST_MEMORY_SCOPE_COUNT];
+    host_memory_scope_t total;
+    host_memory_scope_t internal_scopes[HOST_MEMORY_SCOPE_COUNT];
+} host_memory_t;
+
+void host_memory_create(host_memory_t *host_memory);
+void host_memory_read(host_memory_t *host_memory, VkSystemAllocationScope scope, host_memory_stats_t *stats);
+void host_memory_read_total(host_memory_t *host_memory, host_memory_stats_t *stats);
+void host_memory_report(host_memory_t *host_memory);
+
+void host_memory_benchmark(uint32_t iterations);
+
+#endif // HOST_MEMORY_H
@@ -0,0 +1,1074 @@
+#include "indirect.h"
+#include "bench.h"
+#include "shader.h"
+#include <assert.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define INDIRECT_MAX_BINDINGS 10
+#define INDIRECT_BENCHMARK_WARMUP 8
+#define INDIRECT_SPACING 2.5f
+#define INDIRECT_NEAR 0.1f
+
+typedef struct {
+    uint32_t source_size[2];
+    uint32_t destination_size[2];
+    uint32_t reduce;
+} indirect_hiz_push_constants_t;
+
+// a cube, an octahedron and a square pyramid, small enough that the cost of a draw is all in submitting it
+static const float indirect_vertices[] = {
+    // cube, vertex i has its x, y and z at the plus side where bits 0, 1 and 2 of i are set
+    -0.5f, -0.5f, -0.5f, 0.5f, -0.5f, -0.5f, -0.5f, 0.5f, -0.5f, 0.5f, 0.5f, -0.5f,
+    -0.5f, -0.5f, 0.5f, 0.5f, -0.5f, 0.5f, -0.5f, 0.5f, 0.5f, 0.5f, 0.5f, 0.5f,
+    // octahedron, +x, -x, +y, -y, +z, -z
+    0.7f, 0.0f, 0.0f, -0.7f, 0.0f, 0.0f, 0.0f, 0.7f, 0.0f, 0.0f, -0.7f, 0.0f, 0.0f, 0.0f, 0.7f, 0.0f, 0.0f, -0.7f,
+    // pyramid, the base corners going round and then the apex
+    -0.5f, -0.5f, -0.5f, 0.5f, -0.5f, -0.5f, 0.5f, -0.5f, 0.5f, -0.5f, -0.5f, 0.5f, 0.0f, 0.5f, 0.0f,
+};
+
+static const uint16_t indirect_indices[] = {
+    // cube
+    0, 2, 6, 0, 6, 4, 1, 3, 7, 1, 7, 5, 0, 1, 5, 0, 5, 4, 2, 3, 7, 2, 7, 6, 0, 1, 3, 0, 3, 2, 4, 5, 7, 4, 7, 6,
+    // octahedron
+    0, 2, 4, 0, 2, 5, 0, 3, 4, 0, 3, 5, 1, 2, 4, 1, 2, 5, 1, 3, 4, 1, 3, 5,
+    // pyramid
+    0, 1, 2, 0, 2, 3, 0, 1, 4, 1, 2, 4, 2, 3, 4, 3, 0, 4,
+};
+
+static const indirect_mesh_t indirect_meshes[INDIRECT_MESHES_COUNT] = {
+    {36, 0, 0, 0.866f},
+    {24, 36, 8, 0.7f},
+    {18, 60, 14, 0.866f},
+};
+
+static const char *indirect_path_names[] = {
+    [INDIRECT_PATH_PER_DRAW] = "per-draw",
+    [INDIRECT_PATH_GPU_DRIVEN] = "gpu-driven",
+};
+
+static float indirect_random_float(uint64_t *state) {
+    return (float)(bench_random(state) >> 40) / (float)(1u << 24);
+}
+
+// column-major throughout, as glsl reads a mat4
+static void indirect_multiply(float *result, const float *a, const float *b) {
+    for (uint32_t c = 0; c < 4; c++) {
+        for (uint32_t r = 0; r < 4; r++) {
+            float sum = 0.0f;
+            for (uint32_t k = 0; k < 4; k++)
+                sum += a[k * 4 + r] * b[c * 4 + k];
+            result[c * 4 + r] = sum;
+        }
+    }
+}
+
+// vulkan clip space: depth runs 0 at the near plane to 1 at the far one, and y points down
+static void indirect_perspective(float *matrix, float fov_y, float aspect, float near, float far) {
+    float f = 1.0f / tanf(fov_y * 0.5f);
+    memset(matrix, 0, 16 * sizeof(float));
+    matrix[0] = f / aspect;
+    matrix[5] = -f;
+    matrix[10] = far / (near - far);
+    matrix[11] = -1.0f;
+    matrix[14] = near * far / (near - far);
+}
+
+static void indirect_look_at(float *matrix, const float *eye, const float *target) {
+    float f[3] = {target[0] - eye[0], target[1] - eye[1], target[2] - eye[2]};
+    float length = sqrtf(f[0] * f[0] + f[1] * f[1] + f[2] * f[2]);
+    for (uint32_t i = 0; i < 3; i++)
+        f[i] /= length;
+    // side is forward crossed with +y
+    float s[3] = {-f[2], 0.0f, f[0]};
+    length = sqrtf(s[0] * s[0] + s[2] * s[2]);
+    s[0] /= length;
+    s[2] /= length;
+    float u[3] = {s[1] * f[2] - s[2] * f[1], s[2] * f[0] - s[0] * f[2], s[0] * f[1] - s[1] * f[0]};
+
+    float view[16] = {
+        s[0], u[0], -f[0], 0.0f, s[1], u[1], -f[1], 0.0f, s[2], u[2], -f[2], 0.0f,
+        -(s[0] * eye[0] + s[1] * eye[1] + s[2] * eye[2]),
+        -(u[0] * eye[0] + u[1] * eye[1] + u[2] * eye[2]),
+        f[0] * eye[0] + f[1] * eye[1] + f[2] * eye[2],
+        1.0f,
+    };
+    memcpy(matrix, view, sizeof(view));
+}
+
+// gribb and hartmann, with the near plane at clip z = 0; planes point inwards and are normalized for sphere tests
+static void indirect_frustum_planes(const float *matrix, float planes[6][4]) {
+    for (uint32_t i = 0; i < 4; i++) {
+        float x = matrix[i * 4 + 0], y = matrix[i * 4 + 1], z = matrix[i * 4 + 2], w = matrix[i * 4 + 3];
+        planes[0][i] = w + x;
+        planes[1][i] = w - x;
+        planes[2][i] = w + y;
+        planes[3][i] = w - y;
+        planes[4][i] = z;
+        planes[5][i] = w - z;
+    }
+    for (uint32_t p = 0; p < 6; p++) {
+        float length = sqrtf(planes[p][0] * planes[p][0] + planes[p][1] * planes[p][1] + planes[p][2] * planes[p][2]);
+        for (uint32_t i = 0; i < 4; i++)
+            planes[p][i] /= length;
+    }
+}
+
+static bool indirect_sphere_visible(const float planes[6][4], float x, float y, float z, float radius) {
+    for (uint32_t p = 0; p < 6; p++)
+        if (planes[p][0] * x + planes[p][1] * y + planes[p][2] * z + planes[p][3] < -radius)
+            return false;
+    return true;
+}
+
+// a slow orbit just inside the edge of the field, looking across it so that near instances hide far ones
+static void indirect_camera(indirect_t *indirect, float *view_projection) {
+    float angle = (float)(indirect->frame % 3600) * (6.2831853f / 3600.0f);
+    float radius = indirect->field_size * 0.45f;
+    float eye[3] = {radius * cosf(angle), 3.0f, radius * sinf(angle)};
+    float target[3] = {0.0f, 0.0f, 0.0f};
+
+    float view[16], projection[16];
+    indirect_look_at(view, eye, target);
+    indirect_perspective(projection, 1.0471976f, (float)indirect->extent.width / (float)indirect->extent.height, INDIRECT_NEAR,
+                         indirect->field_size * 1.5f);
+    indirect_multiply(view_projection, projection, view);
+}
+
+static VkDeviceSize indirect_align(VkDeviceSize offset, VkDeviceSize alignment) {
+    return (offset + alignment - 1) / alignment * alignment;
+}
+
+static VkCommandBuffer indirect_begin(indirect_t *indirect) {
+    vulkan_t *vulkan = indirect->vulkan;
+    VkResult result = vulkan->vkResetFences(vulkan->logical_device, 1, &indirect->fence);
+    assert(result == VK_SUCCESS);
+    result = vulkan->vkResetCommandPool(vulkan->logical_device, indirect->command_pool, 0);
+    assert(result == VK_SUCCESS);
+
+    VkCommandBufferBeginInfo command_buffer_begin_info = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+        .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+    };
+    result = vulkan->vkBeginCommandBuffer(indirect->command_buffer, &command_buffer_begin_info);
+    assert(result == VK_SUCCESS);
+    return indirect->command_buffer;
+}
+
+static void indirect_submit(indirect_t *indirect) {
+    vulkan_t *vulkan = indirect->vulkan;
+    VkResult result = vulkan->vkEndCommandBuffer(indirect->command_buffer);
+    assert(result == VK_SUCCESS);
+
+    VkSubmitInfo submit_info = {
+        .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+        .commandBufferCount = 1,
+        .pCommandBuffers = &indirect->command_buffer,
+    };
+    result = vulkan->vkQueueSubmit(vulkan->queues[VULKAN_QUEUE_GRAPHICS].queue, 1, &submit_info, indirect->fence);
+    assert(result == VK_SUCCESS);
+}
+
+static void indirect_wait(indirect_t *indirect) {
+    vulkan_t *vulkan = indirect->vulkan;
+    VkResult result = vulkan->vkWaitForFences(vulkan->logical_device, 1, &indirect->fence, VK_TRUE, UINT64_MAX);
+    assert(result == VK_SUCCESS);
+}
+
+static void indirect_create_buffer(indirect_t *indirect, VkDeviceSize size, VkBufferUsageFlags usage, bool host,
+                                   VkBuffer *buffer, allocation_t *allocation) {
+    VkBufferCreateInfo buffer_create_info = {
+        .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+        .size = size,
+        .usage = usage,
+        .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+    };
+    VkMemoryPropertyFlags required = host ? VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
+                                          : VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+    VkResult result = allocator_create_buffer(indirect->vulkan, &indirect->allocator, &buffer_create_info, required, 0, buffer,
+                                              allocation);
+    assert(result == VK_SUCCESS && (!host || allocation->mapped));
+}
+
+// instances are scattered over a square field that grows with their number, so the density on screen stays the same
+static void indirect_create_scene(indirect_t *indirect, uint64_t seed) {
+    vulkan_t *vulkan = indirect->vulkan;
+    uint32_t count = indirect->instances_count;
+    VkDeviceSize array_size = (VkDeviceSize)count * sizeof(float);
+    VkDeviceSize alignment = vulkan->device_properties.limits.minStorageBufferOffsetAlignment;
+    indirect->field_size = sqrtf((float)count) * INDIRECT_SPACING;
+
+    for (uint32_t i = 0; i < INDIRECT_ARRAY_COUNT; i++)
+        indirect->arrays[i] = arena_allocate(&indirect->arena, array_size);
+    float *x = (float *)indirect->arrays[INDIRECT_ARRAY_X];
+    float *y = (float *)indirect->arrays[INDIRECT_ARRAY_Y];
+    float *z = (float *)indirect->arrays[INDIRECT_ARRAY_Z];
+    float *scale = (float *)indirect->arrays[INDIRECT_ARRAY_SCALE];
+    uint32_t *mesh = (uint32_t *)indirect->arrays[INDIRECT_ARRAY_MESH];
+    uint32_t *color = (uint32_t *)indirect->arrays[INDIRECT_ARRAY_COLOR];
+
+    uint64_t state = seed ? seed : 1;
+    for (uint32_t i = 0; i < count; i++) {
+        x[i] = (indirect_random_float(&state) - 0.5f) * indirect->field_size;
+        y[i] = (indirect_random_float(&state) - 0.5f) * 4.0f;
+        z[i] = (indirect_random_float(&state) - 0.5f) * indirect->field_size;
+        scale[i] = 0.5f + indirect_random_float(&state);
+        mesh[i] = (uint32_t)(bench_random(&state) % INDIRECT_MESHES_COUNT);
+        color[i] = 0xff000000u | ((uint32_t)(bench_random(&state) & 0x00bfbfbfu) + 0x00404040u);
+    }
+
+    VkDeviceSize scene_size = 0;
+    for (uint32_t i = 0; i < INDIRECT_ARRAY_COUNT; i++) {
+        indirect->array_offsets[i] = indirect_align(scene_size, alignment);
+        scene_size = indirect->array_offsets[i] + array_size;
+    }
+    indirect->meshes_offset = indirect_align(scene_size, alignment);
+    scene_size = indirect->meshes_offset + sizeof(indirect_meshes);
+    indirect->indices_offset = sizeof(indirect_vertices);
+    VkDeviceSize geometry_size = indirect->indices_offset + sizeof(indirect_indices);
+
+    indirect_create_buffer(indirect, scene_size, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, false,
+                           &indirect->scene, &indirect->scene_allocation);
+    VkBufferUsageFlags geometry_usage =
+        VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+    indirect_create_buffer(indirect, geometry_size, geometry_usage, false, &indirect->geometry, &indirect->geometry_allocation);
+    indirect_create_buffer(indirect, sizeof(indirect_frame_t), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, true,
+                           &indirect->frame_constants, &indirect->frame_constants_allocation);
+    indirect_create_buffer(indirect, sizeof(uint32_t), VK_BUFFER_USAGE_TRANSFER_DST_BIT, true, &indirect->readback,
+                           &indirect->readback_allocation);
+
+    // the scene never changes, so it goes over once through a staging buffer laid out just like its destinations
+    VkBuffer staging;
+    allocation_t staging_allocation;
+    indirect_create_buffer(indirect, scene_size + geometry_size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, true, &staging,
+                           &staging_allocation);
+    uint8_t *mapped = (uint8_t *)staging_allocation.mapped;
+    for (uint32_t i = 0; i < INDIRECT_ARRAY_COUNT; i++)
+        memcpy(mapped + indirect->array_offsets[i], indirect->arrays[i], array_size);
+    memcpy(mapped + indirect->meshes_offset, indirect_meshes, sizeof(indirect_meshes));
+    memcpy(mapped + scene_size, indirect_vertices, sizeof(indirect_vertices));
+    memcpy(mapped + scene_size + indirect->indices_offset, indirect_indices, sizeof(indirect_indices));
+
+    VkCommandBuffer command_buffer = indirect_begin(indirect);
+    VkBufferCopy regions[2] = {
+        {.srcOffset = 0, .dstOffset = 0, .size = scene_size},
+        {.srcOffset = scene_size, .dstOffset = 0, .size = geometry_size},
+    };
+    vulkan->vkCmdCopyBuffer(command_buffer, staging, indirect->scene, 1, &regions[0]);
+    vulkan->vkCmdCopyBuffer(command_buffer, staging, indirect->geometry, 1, &regions[1]);
+
+    VkBufferMemoryBarrier buffer_barriers[2] = {
+        {
+            .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+            .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+            .dstAccessMask = VK_ACCESS_SHADER_READ_BIT,
+            .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .buffer = indirect->scene,
+            .size = VK_WHOLE_SIZE,
+        },
+        {
+            .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+            .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+            .dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT,
+            .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .buffer = indirect->geometry,
+            .size = VK_WHOLE_SIZE,
+        },
+    };
+    // the pyramid starts out in the layout the graph expects it in between frames
+    VkImageMemoryBarrier image_barrier = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+        .dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+        .oldLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+        .newLayout = VK_IMAGE_LAYOUT_GENERAL,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .image = indirect->pyramid,
+        .subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, VK_REMAINING_MIP_LEVELS, 0, 1},
+    };
+    vulkan->vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                                 VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT |
+                                     VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                                 0, 0, NULL, 2, buffer_barriers, 1, &image_barrier);
+    indirect_submit(indirect);
+    indirect_wait(indirect);
+    allocator_destroy_buffer(vulkan, &indirect->allocator, staging, &staging_allocation);
+}
+
+static void indirect_create_pyramid(indirect_t *indirect) {
+    vulkan_t *vulkan = indirect->vulkan;
+    uint32_t largest = indirect->extent.width > indirect->extent.height ? indirect->extent.width : indirect->extent.height;
+    indirect->pyramid_levels = 1;
+    while (largest >> indirect->pyramid_levels)
+        indirect->pyramid_levels++;
+    assert(indirect->pyramid_levels <= INDIRECT_MAX_PYRAMID_LEVELS);
+
+    VkImageCreateInfo image_create_info = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+        .imageType = VK_IMAGE_TYPE_2D,
+        .format = VK_FORMAT_R32_SFLOAT,
+        .extent = {indirect->extent.width, indirect->extent.height, 1},
+        .mipLevels = indirect->pyramid_levels,
+        .arrayLayers = 1,
+        .samples = VK_SAMPLE_COUNT_1_BIT,
+        .tiling = VK_IMAGE_TILING_OPTIMAL,
+        .usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+        .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+        .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+    };
+    VkResult result = allocator_create_image(vulkan, &indirect->allocator, &image_create_info,
+                                             VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 0, &indirect->pyramid,
+                                             &indirect->pyramid_allocation);
+    assert(result == VK_SUCCESS);
+
+    // culling samples the whole chain, each reduction step writes one level and reads the one below
+    for (uint32_t level = 0; level <= indirect->pyramid_levels; level++) {
+        bool whole = level == indirect->pyramid_levels;
+        VkImageViewCreateInfo image_view_create_info = {
+            .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+            .image = indirect->pyramid,
+            .viewType = VK_IMAGE_VIEW_TYPE_2D,
+            .format = VK_FORMAT_R32_SFLOAT,
+            .subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, whole ? 0 : level, whole ? indirect->pyramid_levels : 1, 0, 1},
+        };
+        result = vulkan->vkCreateImageView(vulkan->logical_device, &image_view_create_info, vulkan->allocation_callbacks,
+                                           whole ? &indirect->pyramid_view : &indirect->pyramid_level_views[level]);
+        assert(result == VK_SUCCESS);
+    }
+
+    // every lookup is a texelFetch, the sampler is only there because combined image samplers need one
+    VkSamplerCreateInfo sampler_create_info = {
+        .sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO,
+        .magFilter = VK_FILTER_NEAREST,
+        .minFilter = VK_FILTER_NEAREST,
+        .mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST,
+        .addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+        .addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+        .addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+        .maxLod = (float)indirect->pyramid_levels,
+    };
+    result = vulkan->vkCreateSampler(vulkan->logical_device, &sampler_create_info, vulkan->allocation_callbacks,
+                                     &indirect->sampler);
+    assert(result == VK_SUCCESS);
+}
+
+static void indirect_create_render_pass(indirect_t *indirect) {
+    vulkan_t *vulkan = indirect->vulkan;
+    // the graph has both attachments in their attachment layouts before the pass begins, and leaves them there after
+    VkAttachmentDescription attachments[2] = {
+        {
+            .format = VK_FORMAT_R8G8B8A8_UNORM,
+            .samples = VK_SAMPLE_COUNT_1_BIT,
+            .loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
+            .storeOp = VK_ATTACHMENT_STORE_OP_STORE,
+            .stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
+            .stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
+            .initialLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+            .finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+        },
+        {
+            .format = VK_FORMAT_D32_SFLOAT,
+            .samples = VK_SAMPLE_COUNT_1_BIT,
+            .loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
+            .storeOp = VK_ATTACHMENT_STORE_OP_STORE,
+            .stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
+            .stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
+            .initialLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+            .finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+        },
+    };
+    VkAttachmentReference color_reference = {0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL};
+    VkAttachmentReference depth_reference = {1, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL};
+    VkSubpassDescription subpass = {
+        .pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS,
+        .colorAttachmentCount = 1,
+        .pColorAttachments = &color_reference,
+        .pDepthStencilAttachment = &depth_reference,
+    };
+    VkRenderPassCreateInfo render_pass_create_info = {
+        .sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO,
+        .attachmentCount = 2,
+        .pAttachments = attachments,
+        .subpassCount = 1,
+        .pSubpasses = &subpass,
+    };
+    VkResult result = vulkan->vkCreateRenderPass(vulkan->logical_device, &render_pass_create_info, vulkan->allocation_callbacks,
+                                                 &indirect->render_pass);
+    assert(result == VK_SUCCESS);
+}
+
+static VkDescriptorSetLayout indirect_create_set_layout(vulkan_t *vulkan, uint32_t bindings_count, const VkDescriptorType *types,
+                                                        VkShaderStageFlags stages) {
+    assert(bindings_count <= INDIRECT_MAX_BINDINGS);
+    VkDescriptorSetLayoutBinding bindings[INDIRECT_MAX_BINDINGS];
+    for (uint32_t i = 0; i < bindings_count; i++) {
+        bindings[i] = (VkDescriptorSetLayoutBinding){
+            .binding = i,
+            .descriptorType = types[i],
+            .descriptorCount = 1,
+            .stageFlags = stages,
+        };
+    }
+    VkDescriptorSetLayoutCreateInfo descriptor_set_layout_create_info = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+        .bindingCount = bindings_count,
+        .pBindings = bindings,
+    };
+    VkDescriptorSetLayout layout;
+    VkResult result = vulkan->vkCreateDescriptorSetLayout(vulkan->logical_device, &descriptor_set_layout_create_info,
+                                                          vulkan->allocation_callbacks, &layout);
+    assert(result == VK_SUCCESS);
+    return layout;
+}
+
+static VkPipelineLayout indirect_create_pipeline_layout(vulkan_t *vulkan, VkDescriptorSetLayout set_layout,
+                                                        uint32_t push_constants_size) {
+    VkPushConstantRange push_constant_range = {
+        .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+        .offset = 0,
+        .size = push_constants_size,
+    };
+    VkPipelineLayoutCreateInfo pipeline_layout_create_info = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+        .setLayoutCount = 1,
+        .pSetLayouts = &set_layout,
+        .pushConstantRangeCount = push_constants_size > 0 ? 1 : 0,
+        .pPushConstantRanges = &push_constant_range,
+    };
+    VkPipelineLayout layout;
+    VkResult result = vulkan->vkCreatePipelineLayout(vulkan->logical_device, &pipeline_layout_create_info,
+                                                     vulkan->allocation_callbacks, &layout);
+    assert(result == VK_SUCCESS);
+    return layout;
+}
+
+// a workgroup size of zero leaves the shader's own in place
+static VkPipeline indirect_create_compute_pipeline(vulkan_t *vulkan, const char *path, VkPipelineLayout layout,
+                                                   uint32_t workgroup_size) {
+    VkSpecializationMapEntry specialization_map_entry = {.constantID = 0, .offset = 0, .size = sizeof(uint32_t)};
+    VkSpecializationInfo specialization_info = {
+        .mapEntryCount = 1,
+        .pMapEntries = &specialization_map_entry,
+        .dataSize = sizeof(uint32_t),
+        .pData = &workgroup_size,
+    };
+
+    VkShaderModule shader_module = shader_create_module(vulkan, path);
+    VkComputePipelineCreateInfo compute_pipeline_create_info = {
+        .sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+        .stage =
+            {
+                .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+                .stage = VK_SHADER_STAGE_COMPUTE_BIT,
+                .module = shader_module,
+                .pName = "main",
+                .pSpecializationInfo = workgroup_size > 0 ? &specialization_info : NULL,
+            },
+        .layout = layout,
+    };
+    VkPipeline pipeline;
+    VkResult result = vulkan->vkCreateComputePipelines(vulkan->logical_device, vulkan->pipeline_cache, 1,
+                                                       &compute_pipeline_create_info, vulkan->allocation_callbacks, &pipeline);
+    assert(result == VK_SUCCESS);
+    vulkan->vkDestroyShaderModule(vulkan->logical_device, shader_module, vulkan->allocation_callbacks);
+    return pipeline;
+}
+
+static void indirect_create_draw_pipeline(indirect_t *indirect) {
+    vulkan_t *vulkan = indirect->vulkan;
+    VkShaderModule vertex_module = shader_create_module(vulkan, "shaders/indirect.vert.spv");
+    VkShaderModule fragment_module = shader_create_module(vulkan, "shaders/indirect.frag.spv");
+    VkPipelineShaderStageCreateInfo stages[2] = {
+        {
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+            .stage = VK_SHADER_STAGE_VERTEX_BIT,
+            .module = vertex_module,
+            .pName = "main",
+        },
+        {
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+            .stage = VK_SHADER_STAGE_FRAGMENT_BIT,
+            .module = fragment_module,
+            .pName = "main",
+        },
+    };
+
+    // positions are the only vertex attribute, everything per instance comes out of the storage arrays
+    VkVertexInputBindingDescription vertex_binding = {0, 3 * sizeof(float), VK_VERTEX_INPUT_RATE_VERTEX};
+    VkVertexInputAttributeDescription vertex_attribute = {0, 0, VK_FORMAT_R32G32B32_SFLOAT, 0};
+    VkPipelineVertexInputStateCreateInfo vertex_input_state = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO,
+        .vertexBindingDescriptionCount = 1,
+        .pVertexBindingDescriptions = &vertex_binding,
+        .vertexAttributeDescriptionCount = 1,
+        .pVertexAttributeDescriptions = &vertex_attribute,
+    };
+    VkPipelineInputAssemblyStateCreateInfo input_assembly_state = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO,
+        .topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST,
+    };
+    VkViewport viewport = {0.0f, 0.0f, (float)indirect->extent.width, (float)indirect->extent.height, 0.0f, 1.0f};
+    VkRect2D scissor = {{0, 0}, indirect->extent};
+    VkPipelineViewportStateCreateInfo viewport_state = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO,
+        .viewportCount = 1,
+        .pViewports = &viewport,
+        .scissorCount = 1,
+        .pScissors = &scissor,
+    };
+    VkPipelineRasterizationStateCreateInfo rasterization_state = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO,
+        .polygonMode = VK_POLYGON_MODE_FILL,
+        .cullMode = VK_CULL_MODE_NONE,
+        .frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE,
+        .lineWidth = 1.0f,
+    };
+    VkPipelineMultisampleStateCreateInfo multisample_state = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO,
+        .rasterizationSamples = VK_SAMPLE_COUNT_1_BIT,
+    };
+    VkPipelineDepthStencilStateCreateInfo depth_stencil_state = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO,
+        .depthTestEnable = VK_TRUE,
+        .depthWriteEnable = VK_TRUE,
+        .depthCompareOp = VK_COMPARE_OP_LESS,
+    };
+    VkPipelineColorBlendAttachmentState color_blend_attachment = {
+        .colorWriteMask =
+            VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT,
+    };
+    VkPipelineColorBlendStateCreateInfo color_blend_state = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO,
+        .attachmentCount = 1,
+        .pAttachments = &color_blend_attachment,
+    };
+
+    VkGraphicsPipelineCreateInfo graphics_pipeline_create_info = {
+        .sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
+        .stageCount = 2,
+        .pStages = stages,
+        .pVertexInputState = &vertex_input_state,
+        .pInputAssemblyState = &input_assembly_state,
+        .pViewportState = &viewport_state,
+        .pRasterizationState = &rasterization_state,
+        .pMultisampleState = &multisample_state,
+        .pDepthStencilState = &depth_stencil_state,
+        .pColorBlendState = &color_blend_state,
+        .layout = indirect->draw_pipeline_layout,
+        .renderPass = indirect->render_pass,
+        .subpass = 0,
+    };
+    VkResult result = vulkan->vkCreateGraphicsPipelines(vulkan->logical_device, vulkan->pipeline_cache, 1,
+                                                        &graphics_pipeline_create_info, vulkan->allocation_callbacks,
+                                                        &indirect->draw_pipeline);
+    assert(result == VK_SUCCESS);
+
+    vulkan->vkDestroyShaderModule(vulkan->logical_device, fragment_module, vulkan->allocation_callbacks);
+    vulkan->vkDestroyShaderModule(vulkan->logical_device, vertex_module, vulkan->allocation_callbacks);
+}
+
+static void indirect_create_pipelines(indirect_t *indirect) {
+    vulkan_t *vulkan = indirect->vulkan;
+    VkDescriptorType draw_types[] = {
+        VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+        VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+    };
+    VkDescriptorType cull_types[INDIRECT_MAX_BINDINGS];
+    for (uint32_t i = 0; i < INDIRECT_MAX_BINDINGS; i++)
+        cull_types[i] = i == 9 ? VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    VkDescriptorType hiz_types[] = {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE};
+
+    indirect->draw_set_layout = indirect_create_set_layout(vulkan, 6, draw_types, VK_SHADER_STAGE_VERTEX_BIT);
+    indirect->cull_set_layout = indirect_create_set_layout(vulkan, 10, cull_types, VK_SHADER_STAGE_COMPUTE_BIT);
+    indirect->hiz_set_layout = indirect_create_set_layout(vulkan, 2, hiz_types, VK_SHADER_STAGE_COMPUTE_BIT);
+    indirect->draw_pipeline_layout = indirect_create_pipeline_layout(vulkan, indirect->draw_set_layout, 0);
+    indirect->cull_pipeline_layout = indirect_create_pipeline_layout(vulkan, indirect->cull_set_layout, 0);
+    indirect->hiz_pipeline_layout =
+        indirect_create_pipeline_layout(vulkan, indirect->hiz_set_layout, sizeof(indirect_hiz_push_constants_t));
+
+    indirect_create_draw_pipeline(indirect);
+    indirect->cull_pipeline = indirect_create_compute_pipeline(vulkan, "shaders/indirect_cull.spv",
+                                                               indirect->cull_pipeline_layout, INDIRECT_CULL_WORKGROUP_SIZE);
+    indirect->hiz_pipeline =
+        indirect_create_compute_pipeline(vulkan, "shaders/indirect_hiz.spv", indirect->hiz_pipeline_layout, 0);
+}
+
+static void indirect_write_buffer(vulkan_t *vulkan, VkDescriptorSet set, uint32_t binding, VkBuffer buffer,
+                                  VkDeviceSize offset, VkDeviceSize range) {
+    VkDescriptorBufferInfo buffer_info = {.buffer = buffer, .offset = offset, .range = range};
+    VkWriteDescriptorSet write = {
+        .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+        .dstSet = set,
+        .dstBinding = binding,
+        .descriptorCount = 1,
+        .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+        .pBufferInfo = &buffer_info,
+    };
+    vulkan->vkUpdateDescriptorSets(vulkan->logical_device, 1, &write, 0, NULL);
+}
+
+static void indirect_write_image(vulkan_t *vulkan, VkDescriptorSet set, uint32_t binding, VkDescriptorType type,
+                                 VkSampler sampler, VkImageView image_view, VkImageLayout layout) {
+    VkDescriptorImageInfo image_info = {.sampler = sampler, .imageView = image_view, .imageLayout = layout};
+    VkWriteDescriptorSet write = {
+        .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+        .dstSet = set,
+        .dstBinding = binding,
+        .descriptorCount = 1,
+        .descriptorType = type,
+        .pImageInfo = &image_info,
+    };
+    vulkan->vkUpdateDescriptorSets(vulkan->logical_device, 1, &write, 0, NULL);
+}
+
+// every set is written once, the transients they point at keep their handles for as long as the graphs live
+static void indirect_create_descriptors(indirect_t *indirect) {
+    vulkan_t *vulkan = indirect->vulkan;
+    indirect_target_t *target = &indirect->targets[INDIRECT_PATH_GPU_DRIVEN];
+    uint32_t levels = indirect->pyramid_levels;
+
+    VkDescriptorPoolSize pool_sizes[] = {
+        {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 6 + 9},
+        {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1 + levels},
+        {VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, levels},
+    };
+    VkDescriptorPoolCreateInfo descriptor_pool_create_info = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+        .maxSets = 2 + levels,
+        .poolSizeCount = sizeof(pool_sizes) / sizeof(*pool_sizes),
+        .pPoolSizes = pool_sizes,
+    };
+    VkResult result = vulkan->vkCreateDescriptorPool(vulkan->logical_device, &descriptor_pool_create_info,
+                                                     vulkan->allocation_callbacks, &indirect->descriptor_pool);
+    assert(result == VK_SUCCESS);
+
+    VkDescriptorSetLayout layouts[2 + INDIRECT_MAX_PYRAMID_LEVELS] = {indirect->draw_set_layout, indirect->cull_set_layout};
+    for (uint32_t i = 0; i < levels; i++)
+        layouts[2 + i] = indirect->hiz_set_layout;
+    VkDescriptorSet sets[2 + INDIRECT_MAX_PYRAMID_LEVELS];
+    VkDescriptorSetAllocateInfo descriptor_set_allocate_info = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+        .descriptorPool = indirect->descriptor_pool,
+        .descriptorSetCount = 2 + levels,
+        .pSetLayouts = layouts,
+    };
+    result = vulkan->vkAllocateDescriptorSets(vulkan->logical_device, &descriptor_set_allocate_info, sets);
+    assert(result == VK_SUCCESS);
+    indirect->draw_set = sets[0];
+    indirect->cull_set = sets[1];
+    memcpy(indirect->hiz_sets, sets + 2, levels * sizeof(VkDescriptorSet));
+
+    VkDeviceSize array_size = (VkDeviceSize)indirect->instances_count * sizeof(float);
+    indirect_write_buffer(vulkan, indirect->draw_set, 0, indirect->frame_constants, 0, sizeof(indirect_frame_t));
+    indirect_write_buffer(vulkan, indirect->cull_set, 0, indirect->frame_constants, 0, sizeof(indirect_frame_t));
+    for (uint32_t i = INDIRECT_ARRAY_X; i <= INDIRECT_ARRAY_SCALE; i++)
+        indirect_write_buffer(vulkan, indirect->draw_set, 1 + i, indirect->scene, indirect->array_offsets[i], array_size);
+    indirect_write_buffer(vulkan, indirect->draw_set, 5, indirect->scene, indirect->array_offsets[INDIRECT_ARRAY_COLOR],
+                          array_size);
+    for (uint32_t i = INDIRECT_ARRAY_X; i <= INDIRECT_ARRAY_MESH; i++)
+        indirect_write_buffer(vulkan, indirect->cull_set, 1 + i, indirect->scene, indirect->array_offsets[i], array_size);
+    indirect_write_buffer(vulkan, indirect->cull_set, 6, indirect->scene, indirect->meshes_offset, sizeof(indirect_meshes));
+    indirect_write_buffer(vulkan, indirect->cull_set, 7, graph_buffer(&target->graph, target->commands), 0, VK_WHOLE_SIZE);
+    indirect_write_buffer(vulkan, indirect->cull_set, 8, graph_buffer(&target->graph, target->count), 0, VK_WHOLE_SIZE);
+    indirect_write_image(vulkan, indirect->cull_set, 9, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, indirect->sampler,
+                         indirect->pyramid_view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+
+    // level 0 copies the depth buffer, which the graph has in a read-only layout by then
+    for (uint32_t level = 0; level < levels; level++) {
+        indirect_write_image(vulkan, indirect->hiz_sets[level], 0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, indirect->sampler,
+                             level == 0 ? target->depth_view : indirect->pyramid_level_views[level - 1],
+                             level == 0 ? VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_GENERAL);
+        indirect_write_image(vulkan, indirect->hiz_sets[level], 1, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_NULL_HANDLE,
+                             indirect->pyramid_level_views[level], VK_IMAGE_LAYOUT_GENERAL);
+    }
+}
+
+static void indirect_begin_draw(vulkan_t *vulkan, indirect_t *indirect, VkCommandBuffer command_buffer,
+                                indirect_target_t *target) {
+    VkClearValue clear_values[2] = {
+        {.color = {.float32 = {0.05f, 0.05f, 0.08f, 1.0f}}},
+        {.depthStencil = {1.0f, 0}},
+    };
+    VkRenderPassBeginInfo render_pass_begin_info = {
+        .sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
+        .renderPass = indirect->render_pass,
+        .framebuffer = target->framebuffer,
+        .renderArea = {{0, 0}, indirect->extent},
+        .clearValueCount = 2,
+        .pClearValues = clear_values,
+    };
+    vulkan->vkCmdBeginRenderPass(command_buffer, &render_pass_begin_info, VK_SUBPASS_CONTENTS_INLINE);
+    vulkan->vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, indirect->draw_pipeline);
+    vulkan->vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, indirect->draw_pipeline_layout, 0, 1,
+                                    &indirect->draw_set, 0, NULL);
+    VkDeviceSize vertex_offset = 0;
+    vulkan->vkCmdBindVertexBuffers(command_buffer, 0, 1, &indirect->geometry, &vertex_offset);
+    vulkan->vkCmdBindIndexBuffer(command_buffer, indirect->geometry, indirect->indices_offset, VK_INDEX_TYPE_UINT16);
+}
+
+// the host culls against the frustum and records one draw per survivor, the instance index riding in firstInstance
+static void indirect_per_draw_pass(vulkan_t *vulkan, graph_t *graph, VkCommandBuffer command_buffer, void *data) {
+    indirect_t *indirect = (indirect_t *)data;
+    const float *x = (const float *)indirect->arrays[INDIRECT_ARRAY_X];
+    const float *y = (const float *)indirect->arrays[INDIRECT_ARRAY_Y];
+    const float *z = (const float *)indirect->arrays[INDIRECT_ARRAY_Z];
+    const float *scale = (const float *)indirect->arrays[INDIRECT_ARRAY_SCALE];
+    const uint32_t *mesh = (const uint32_t *)indirect->arrays[INDIRECT_ARRAY_MESH];
+
+    indirect_begin_draw(vulkan, indirect, command_buffer, &indirect->targets[INDIRECT_PATH_PER_DRAW]);
+    uint32_t draws = 0;
+    for (uint32_t i = 0; i < indirect->instances_count; i++) {
+        const indirect_mesh_t *instance_mesh = &indirect_meshes[mesh[i]];
+        if (!indirect_sphere_visible(indirect->constants.planes, x[i], y[i], z[i], instance_mesh->radius * scale[i]))
+            continue;
+        vulkan->vkCmdDrawIndexed(command_buffer, instance_mesh->index_count, 1, instance_mesh->first_index,
+                                 instance_mesh->vertex_offset, i);
+        draws++;
+    }
+    vulkan->vkCmdEndRenderPass(command_buffer);
+    indirect->draws = draws;
+}
+
+static void indirect_reset_pass(vulkan_t *vulkan, graph_t *graph, VkCommandBuffer command_buffer, void *data) {
+    indirect_t *indirect = (indirect_t *)data;
+    indirect_target_t *target = &indirect->targets[INDIRECT_PATH_GPU_DRIVEN];
+    vulkan->vkCmdFillBuffer(command_buffer, graph_buffer(graph, target->count), 0, sizeof(uint32_t), 0);
+    // without a count every slot gets drawn, so the ones culling leaves alone have to hold empty draws
+    if (vulkan->vkCmdDrawIndexedIndirectCountKHR == NULL)
+        vulkan->vkCmdFillBuffer(command_buffer, graph_buffer(graph, target->commands), 0, VK_WHOLE_SIZE, 0);
+}
+
+static void indirect_cull_pass(vulkan_t *vulkan, graph_t *graph, VkCommandBuffer command_buffer, void *data) {
+    indirect_t *indirect = (indirect_t *)data;
+    vulkan->vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, indirect->cull_pipeline);
+    vulkan->vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, indirect->cull_pipeline_layout, 0, 1,
+                                    &indirect->cull_set, 0, NULL);
+    vulkan->vkCmdDispatch(command_buffer,
+                          (indirect->instances_count + INDIRECT_CULL_WORKGROUP_SIZE - 1) / INDIRECT_CULL_WORKGROUP_SIZE, 1, 1);
+}
+
+// one call however many instances there are, the gpu reads back how many of the commands culling wrote
+static void indirect_gpu_draw_pass(vulkan_t *vulkan, graph_t *graph, VkCommandBuffer command_buffer, void *data) {
+    indirect_t *indirect = (indirect_t *)data;
+    indirect_target_t *target = &indirect->targets[INDIRECT_PATH_GPU_DRIVEN];
+    VkBuffer commands = graph_buffer(graph, target->commands);
+
+    indirect_begin_draw(vulkan, indirect, command_buffer, target);
+    if (vulkan->vkCmdDrawIndexedIndirectCountKHR != NULL)
+        vulkan->vkCmdDrawIndexedIndirectCountKHR(command_buffer, commands, 0, graph_buffer(graph, target->count), 0,
+                                                 indirect->instances_count, sizeof(VkDrawIndexedIndirectCommand));
+    else
+        vulkan->vkCmdDrawIndexedIndirect(command_buffer, commands, 0, indirect->instances_count,
+                                         sizeof(VkDrawIndexedIndirectCommand));
+    vulkan->vkCmdEndRenderPass(command_buffer);
+}
+
+// each level is a dispatch of its own, and waits for the one below it to land
+static void indirect_hiz_pass(vulkan_t *vulkan, graph_t *graph, VkCommandBuffer command_buffer, void *data) {
+    indirect_t *indirect = (indirect_t *)data;
+    vulkan->vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, indirect->hiz_pipeline);
+
+    uint32_t source_size[2] = {indirect->extent.width, indirect->extent.height};
+    for (uint32_t level = 0; level < indirect->pyramid_levels; level++) {
+        indirect_hiz_push_constants_t push_constants = {
+            .source_size = {source_size[0], source_size[1]},
+            .destination_size = {source_size[0], source_size[1]},
+            .reduce = level > 0,
+        };
+        if (level > 0) {
+            push_constants.destination_size[0] = source_size[0] > 1 ? source_size[0] / 2 : 1;
+            push_constants.destination_size[1] = source_size[1] > 1 ? source_size[1] / 2 : 1;
+        }
+
+        vulkan->vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, indirect->hiz_pipeline_layout, 0, 1,
+                                        &indirect->hiz_sets[level], 0, NULL);
+        vulkan->vkCmdPushConstants(command_buffer, indirect->hiz_pipeline_layout, VK_SHADER_STAGE_COMPUTE_BIT, 0,
+                                   sizeof(push_constants), &push_constants);
+        uint32_t groups_x = (push_constants.destination_size[0] + INDIRECT_HIZ_WORKGROUP_SIZE - 1) / INDIRECT_HIZ_WORKGROUP_SIZE;
+        uint32_t groups_y = (push_constants.destination_size[1] + INDIRECT_HIZ_WORKGROUP_SIZE - 1) / INDIRECT_HIZ_WORKGROUP_SIZE;
+        vulkan->vkCmdDispatch(command_buffer, groups_x, groups_y, 1);
+
+        VkImageMemoryBarrier image_barrier = {
+            .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+            .srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+            .dstAccessMask = VK_ACCESS_SHADER_READ_BIT,
+            .oldLayout = VK_IMAGE_LAYOUT_GENERAL,
+            .newLayout = VK_IMAGE_LAYOUT_GENERAL,
+            .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .image = indirect->pyramid,
+            .subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, level, 1, 0, 1},
+        };
+        vulkan->vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                                     VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, NULL, 0, NULL, 1, &image_barrier);
+        source_size[0] = push_constants.destination_size[0];
+        source_size[1] = push_constants.destination_size[1];
+    }
+}
+
+static void indirect_readback_pass(vulkan_t *vulkan, graph_t *graph, VkCommandBuffer command_buffer, void *data) {
+    indirect_t *indirect = (indirect_t *)data;
+    indirect_target_t *target = &indirect->targets[INDIRECT_PATH_GPU_DRIVEN];
+    VkBufferCopy region = {.size = sizeof(uint32_t)};
+    vulkan->vkCmdCopyBuffer(command_buffer, graph_buffer(graph, target->count), graph_buffer(graph, target->readback), 1,
+                            &region);
+}
+
+static void indirect_create_target(indirect_t *indirect, indirect_path_t path) {
+    vulkan_t *vulkan = indirect->vulkan;
+    indirect_target_t *target = &indirect->targets[path];
+    graph_t *graph = &target->graph;
+
+    graph_create(graph, &indirect->allocator, true);
+    target->color = graph_create_image(graph, "color", VK_FORMAT_R8G8B8A8_UNORM, indirect->extent);
+    target->depth = graph_create_image(graph, "depth", VK_FORMAT_D32_SFLOAT, indirect->extent);
+    if (path == INDIRECT_PATH_PER_DRAW) {
+        uint32_t pass = graph_add_pass(graph, "draw", indirect_per_draw_pass, indirect, true);
+        graph_use(graph, pass, target->color, GRAPH_ACCESS_COLOR_ATTACHMENT_WRITE);
+        graph_use(graph, pass, target->depth, GRAPH_ACCESS_DEPTH_ATTACHMENT_WRITE);
+    } else {
+        // the pyramid carries over from frame to frame, culling reads what the previous frame's depth left in it
+        graph_state_t pyramid_state = {VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                                       VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL};
+        target->pyramid = graph_import_image(graph, "pyramid", indirect->pyramid, VK_IMAGE_ASPECT_COLOR_BIT, pyramid_state,
+                                             pyramid_state);
+        target->commands = graph_create_buffer(graph, "commands",
+                                               (VkDeviceSize)indirect->instances_count * sizeof(VkDrawIndexedIndirectCommand));
+        target->count = graph_create_buffer(graph, "count", sizeof(uint32_t));
+        target->readback = graph_import_buffer(graph, "readback", indirect->readback,
+                                               (graph_state_t){VK_PIPELINE_STAGE_HOST_BIT, 0, VK_IMAGE_LAYOUT_UNDEFINED},
+                                               (graph_state_t){VK_PIPELINE_STAGE_HOST_BIT, VK_ACCESS_HOST_READ_BIT,
+                                                               VK_IMAGE_LAYOUT_UNDEFINED});
+
+        uint32_t pass = graph_add_pass(graph, "reset", indirect_reset_pass, indirect, false);
+        graph_use(graph, pass, target->count, GRAPH_ACCESS_TRANSFER_WRITE);
+        if (vulkan->vkCmdDrawIndexedIndirectCountKHR == NULL)
+            graph_use(graph, pass, target->commands, GRAPH_ACCESS_TRANSFER_WRITE);
+        pass = graph_add_pass(graph, "cull", indirect_cull_pass, indirect, false);
+        graph_use(graph, pass, target->pyramid, GRAPH_ACCESS_COMPUTE_READ);
+        graph_use(graph, pass, target->commands, GRAPH_ACCESS_COMPUTE_WRITE);
+        graph_use(graph, pass, target->count, GRAPH_ACCESS_COMPUTE_WRITE);
+        pass = graph_add_pass(graph, "draw", indirect_gpu_draw_pass, indirect, true);
+        graph_use(graph, pass, target->commands, GRAPH_ACCESS_INDIRECT_READ);
+        graph_use(graph, pass, target->count, GRAPH_ACCESS_INDIRECT_READ);
+        graph_use(graph, pass, target->color, GRAPH_ACCESS_COLOR_ATTACHMENT_WRITE);
+        graph_use(graph, pass, target->depth, GRAPH_ACCESS_DEPTH_ATTACHMENT_WRITE);
+        pass = graph_add_pass(graph, "hiz", indirect_hiz_pass, indirect, false);
+        graph_use(graph, pass, target->depth, GRAPH_ACCESS_COMPUTE_READ);
+        graph_use(graph, pass, target->pyramid, GRAPH_ACCESS_COMPUTE_WRITE);
+        pass = graph_add_pass(graph, "readback", indirect_readback_pass, indirect, false);
+        graph_use(graph, pass, target->count, GRAPH_ACCESS_TRANSFER_READ);
+        graph_use(graph, pass, target->readback, GRAPH_ACCESS_TRANSFER_WRITE);
+    }
+    graph_compile(vulkan, graph);
+
+    VkImage images[2] = {graph_image(graph, target->color), graph_image(graph, target->depth)};
+    VkFormat formats[2] = {VK_FORMAT_R8G8B8A8_UNORM, VK_FORMAT_D32_SFLOAT};
+    VkImageAspectFlags aspects[2] = {VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_ASPECT_DEPTH_BIT};
+    VkImageView *views[2] = {&target->color_view, &target->depth_view};
+    for (uint32_t i = 0; i < 2; i++) {
+        VkImageViewCreateInfo image_view_create_info = {
+            .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+            .image = images[i],
+            .viewType = VK_IMAGE_VIEW_TYPE_2D,
+            .format = formats[i],
+            .subresourceRange = {aspects[i], 0, 1, 0, 1},
+        };
+        VkResult result = vulkan->vkCreateImageView(vulkan->logical_device, &image_view_create_info,
+                                                    vulkan->allocation_callbacks, views[i]);
+        assert(result == VK_SUCCESS);
+    }
+
+    VkImageView attachments[2] = {target->color_view, target->depth_view};
+    VkFramebufferCreateInfo framebuffer_create_info = {
+        .sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO,
+        .renderPass = indirect->render_pass,
+        .attachmentCount = 2,
+        .pAttachments = attachments,
+        .width = indirect->extent.width,
+        .height = indirect->extent.height,
+        .layers = 1,
+    };
+    VkResult result = vulkan->vkCreateFramebuffer(vulkan->logical_device, &framebuffer_create_info, vulkan->allocation_callbacks,
+                                                  &target->framebuffer);
+    assert(result == VK_SUCCESS);
+}
+
+void indirect_create(vulkan_t *vulkan, indirect_t *indirect, VkExtent2D extent, uint32_t instances_count, uint64_t seed) {
+    assert(instances_count > 0);
+    memset(indirect, 0, sizeof(*indirect));
+    indirect->vulkan = vulkan;
+    indirect->extent = extent;
+    indirect->instances_count = instances_count;
+    // every compacted command names its instance through firstInstance, and the fallback draws them all in one call
+    indirect->gpu_driven = vulkan->device_features.drawIndirectFirstInstance && vulkan->device_features.multiDrawIndirect &&
+                           instances_count <= vulkan->device_properties.limits.maxDrawIndirectCount;
+    allocator_create(vulkan, &indirect->allocator);
+
+    VkCommandPoolCreateInfo command_pool_create_info = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+        .flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT,
+        .queueFamilyIndex = vulkan->queues[VULKAN_QUEUE_GRAPHICS].family_index,
+    };
+    VkResult result = vulkan->vkCreateCommandPool(vulkan->logical_device, &command_pool_create_info,
+                                                  vulkan->allocation_callbacks, &indirect->command_pool);
+    assert(result == VK_SUCCESS);
+    VkCommandBufferAllocateInfo command_buffer_allocate_info = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+        .commandPool = indirect->command_pool,
+        .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+        .commandBufferCount = 1,
+    };
+    result = vulkan->vkAllocateCommandBuffers(vulkan->logical_device, &command_buffer_allocate_info, &indirect->command_buffer);
+    assert(result == VK_SUCCESS);
+    VkFenceCreateInfo fence_create_info = {.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO};
+    result = vulkan->vkCreateFence(vulkan->logical_device, &fence_create_info, vulkan->allocation_callbacks, &indirect->fence);
+    assert(result == VK_SUCCESS);
+
+    indirect_create_pyramid(indirect);
+    indirect_create_scene(indirect, seed);
+    indirect_create_render_pass(indirect);
+    for (uint32_t path = 0; path < INDIRECT_PATH_COUNT; path++)
+        indirect_create_target(indirect, (indirect_path_t)path);
+    indirect_create_pipelines(indirect);
+    indirect_create_descriptors(indirect);
+
+    indirect->constants.instances_count = instances_count;
+    indirect->constants.pyramid_size[0] = (float)extent.width;
+    indirect->constants.pyramid_size[1] = (float)extent.height;
+}
+
+// frames are rendered one at a time, so the constants buffer is never read while the host rewrites it
+void indirect_render(indirect_t *indirect, indirect_path_t path, indirect_timing_t *timing) {
+    assert(path != INDIRECT_PATH_GPU_DRIVEN || indirect->gpu_driven);
+    vulkan_t *vulkan = indirect->vulkan;
+    indirect_target_t *target = &indirect->targets[path];
+    uint64_t start = bench_now_ns();
+
+    indirect_frame_t *constants = &indirect->constants;
+    indirect_camera(indirect, constants->view_projection);
+    indirect_frustum_planes(constants->view_projection, constants->planes);
+    constants->pyramid_levels = path == INDIRECT_PATH_GPU_DRIVEN && indirect->pyramid_built ? indirect->pyramid_levels : 0;
+    memcpy(constants->pyramid_view_projection, indirect->pyramid_view_projection, sizeof(constants->pyramid_view_projection));
+    memcpy(indirect->frame_constants_allocation.mapped, constants, sizeof(*constants));
+
+    VkCommandBuffer command_buffer = indirect_begin(indirect);
+    graph_execute(vulkan, &target->graph, command_buffer);
+    indirect_submit(indirect);
+    uint64_t submitted = bench_now_ns();
+    indirect_wait(indirect);
+
+    timing->cpu_ns = submitted - start;
+    timing->frame_ns = bench_now_ns() - start;
+    if (path == INDIRECT_PATH_GPU_DRIVEN) {
+        memcpy(indirect->pyramid_view_projection, constants->view_projection, sizeof(indirect->pyramid_view_projection));
+        indirect->pyramid_built = true;
+        timing->draws = *(const uint32_t *)indirect->readback_allocation.mapped;
+    } else {
+        timing->draws = indirect->draws;
+    }
+    indirect->frame++;
+}
+
+void indirect_free_resources(vulkan_t *vulkan, indirect_t *indirect) {
+    vulkan->vkDestroyPipeline(vulkan->logical_device, indirect->hiz_pipeline, vulkan->allocation_callbacks);
+    vulkan->vkDestroyPipeline(vulkan->logical_device, indirect->cull_pipeline, vulkan->allocation_callbacks);
+    vulkan->vkDestroyPipeline(vulkan->logical_device, indirect->draw_pipeline, vulkan->allocation_callbacks);
+    vulkan->vkDestroyPipelineLayout(vulkan->logical_device, indirect->hiz_pipeline_layout, vulkan->allocation_callbacks);
+    vulkan->vkDestroyPipelineLayout(vulkan->logical_device, indirect->cull_pipeline_layout, vulkan->allocation_callbacks);
+    vulkan->vkDestroyPipelineLayout(vulkan->logical_device, indirect->draw_pipeline_layout, vulkan->allocation_callbacks);
+    vulkan->vkDestroyDescriptorPool(vulkan->logical_device, indirect->descriptor_pool, vulkan->allocation_callbacks);
+    vulkan->vkDestroyDescriptorSetLayout(vulkan->logical_device, indirect->hiz_set_layout, vulkan->allocation_callbacks);
+    vulkan->vkDestroyDescriptorSetLayout(vulkan->logical_device, indirect->cull_set_layout, vulkan->allocation_callbacks);
+    vulkan->vkDestroyDescriptorSetLayout(vulkan->logical_device, indirect->draw_set_layout, vulkan->allocation_callbacks);
+
+    for (uint32_t path = 0; path < INDIRECT_PATH_COUNT; path++) {
+        indirect_target_t *target = &indirect->targets[path];
+        vulkan->vkDestroyFramebuffer(vulkan->logical_device, target->framebuffer, vulkan->allocation_callbacks);
+        vulkan->vkDestroyImageView(vulkan->logical_device, target->depth_view, vulkan->allocation_callbacks);
+        vulkan->vkDestroyImageView(vulkan->logical_device, target->color_view, vulkan->allocation_callbacks);
+        graph_free_resources(vulkan, &target->graph);
+    }
+    vulkan->vkDestroyRenderPass(vulkan->logical_device, indirect->render_pass, vulkan->allocation_callbacks);
+
+    vulkan->vkDestroySampler(vulkan->logical_device, indirect->sampler, vulkan->allocation_callbacks);
+    vulkan->vkDestroyImageView(vulkan->logical_device, indirect->pyramid_view, vulkan->allocation_callbacks);
+    for (uint32_t level = 0; level < indirect->pyramid_levels; level++)
+        vulkan->vkDestroyImageView(vulkan->logical_device, indirect->pyramid_level_views[level], vulkan->allocation_callbacks);
+    allocator_destroy_image(vulkan, &indirect->allocator, indirect->pyramid, &indirect->pyramid_allocation);
+
+    allocator_destroy_buffer(vulkan, &indirect->allocator, indirect->readback, &indirect->readback_allocation);
+    allocator_destroy_buffer(vulkan, &indirect->allocator, indirect->frame_constants, &indirect->frame_constants_allocation);
+    allocator_destroy_buffer(vulkan, &indirect->allocator, indirect->geometry, &indirect->geometry_allocation);
+    allocator_destroy_buffer(vulkan, &indirect->allocator, indirect->scene, &indirect->scene_allocation);
+    allocator_free_resources(vulkan, &indirect->allocator);
+
+    vulkan->vkDestroyFence(vulkan->logical_device, indirect->fence, vulkan->allocation_callbacks);
+    vulkan->vkDestroyCommandPool(vulkan->logical_device, indirect->command_pool, vulkan->allocation_callbacks);
+    arena_free(&indirect->arena);
+}
+
+// both paths fly the same camera over the same field, the per-draw one paying on the host for every instance it keeps
+void indirect_benchmark(uint32_t iterations) {
+    vulkan_t vulkan = {.headless = true};
+    bench_bootstrap(&vulkan);
+    printf("indirect draws %s\n", vulkan.vkCmdDrawIndexedIndirectCountKHR != NULL
+                                      ? "take their count from the gpu"
+                                      : "run over every slot, VK_KHR_draw_indirect_count is unavailable");
+    if (!vulkan.device_features.drawIndirectFirstInstance || !vulkan.device_features.multiDrawIndirect)
+        printf("gpu-driven path is unavailable, the device lacks multiDrawIndirect or drawIndirectFirstInstance\n");
+
+    static const char *cpu_names[] = {
+        [INDIRECT_PATH_PER_DRAW] = "per-draw record and submit",
+        [INDIRECT_PATH_GPU_DRIVEN] = "gpu-driven record and submit",
+    };
+    static const char *frame_names[] = {
+        [INDIRECT_PATH_PER_DRAW] = "per-draw frame",
+        [INDIRECT_PATH_GPU_DRIVEN] = "gpu-driven frame",
+    };
+    uint32_t instances_counts[] = {1024, 16384, 131072, 262144};
+    for (uint32_t i = 0; i < sizeof(instances_counts) / sizeof(*instances_counts); i++) {
+        indirect_t *indirect = (indirect_t *)malloc(sizeof(indirect_t));
+        indirect_create(&vulkan, indirect, (VkExtent2D){INDIRECT_DEFAULT_WIDTH, INDIRECT_DEFAULT_HEIGHT},
+                        instances_counts[i], 1 + i);
+
+        for (uint32_t path = 0; path < INDIRECT_PATH_COUNT; path++) {
+            if (path == INDIRECT_PATH_GPU_DRIVEN && !indirect->gpu_driven) {
+                printf("%u instances, %s: unavailable on this device\n", instances_counts[i], indirect_path_names[path]);
+                continue;
+            }
+            indirect->frame = 0;
+            indirect->pyramid_built = false;
+            indirect_timing_t timing;
+            for (uint32_t w = 0; w < INDIRECT_BENCHMARK_WARMUP; w++)
+                indirect_render(indirect, (indirect_path_t)path, &timing);
+
+            bench_samples_t cpu, frame;
+            bench_samples_create(&cpu, cpu_names[path], iterations);
+            bench_samples_create(&frame, frame_names[path], iterations);
+            uint64_t draws = 0;
+            for (uint32_t j = 0; j < iterations; j++) {
+                indirect_render(indirect, (indirect_path_t)path, &timing);
+                bench_samples_push(&cpu, timing.cpu_ns);
+                bench_samples_push(&frame, timing.frame_ns);
+                draws += timing.draws;
+            }
+
+            printf("%u instances, %s: %.0f drawn per frame\n", instances_counts[i], indirect_path_names[path],
+                   iterations > 0 ? (double)draws / iterations : 0.0);
+            bench_samples_report(&cpu);
+            bench_samples_report(&frame);
+            bench_samples_free(&frame);
+            bench_samples_free(&cpu);
+        }
+
+        indirect_free_resources(&vulkan, indirect);
+        free(indirect);
+    }
+
+    vulkan_free_resources(&vulkan);
+}
@@ -0,0 +1,136 @@
+#ifndef INDIRECT_H
+#define INDIRECT_H
+
+#include "allocator.h"
+#include "graph.h"
+#include "vulkan.h"
+#include <stdbool.h>
+
+#define INDIRECT_MESHES_COUNT 3
+#define INDIRECT_MAX_PYRAMID_LEVELS 16
+#define INDIRECT_CULL_WORKGROUP_SIZE 64
+#define INDIRECT_HIZ_WORKGROUP_SIZE 8
+#define INDIRECT_DEFAULT_WIDTH 1280
+#define INDIRECT_DEFAULT_HEIGHT 720
+
+typedef enum {
+    INDIRECT_PATH_PER_DRAW,
+    INDIRECT_PATH_GPU_DRIVEN,
+    INDIRECT_PATH_COUNT,
+} indirect_path_t;
+
+// the instance attributes, one storage array each so a shader only pulls in the ones it reads
+typedef enum {
+    INDIRECT_ARRAY_X,
+    INDIRECT_ARRAY_Y,
+    INDIRECT_ARRAY_Z,
+    INDIRECT_ARRAY_SCALE,
+    INDIRECT_ARRAY_MESH,
+    INDIRECT_ARRAY_COLOR,
+    INDIRECT_ARRAY_COUNT,
+} indirect_array_t;
+
+// laid out as the shaders read it, the radius bounds the mesh around its origin at scale 1
+typedef struct {
+    uint32_t index_count;
+    uint32_t first_index;
+    int32_t vertex_offset;
+    float radius;
+} indirect_mesh_t;
+
+// std430, rewritten by the host before every frame; no pyramid levels means nothing is tested for occlusion
+typedef struct {
+    float view_projection[16];
+    float pyramid_view_projection[16];
+    float planes[6][4];
+    uint32_t instances_count;
+    uint32_t pyramid_levels;
+    float pyramid_size[2];
+} indirect_frame_t;
+
+// each path renders through a graph of its own, with its own transient attachments
+typedef struct {
+    graph_t graph;
+    graph_resource_t color;
+    graph_resource_t depth;
+    graph_resource_t pyramid;
+    graph_resource_t commands;
+    graph_resource_t count;
+    graph_resource_t readback;
+    VkImageView color_view;
+    VkImageView depth_view;
+    VkFramebuffer framebuffer;
+} indirect_target_t;
+
+typedef struct {
+    uint64_t cpu_ns;
+    uint64_t frame_ns;
+    uint32_t draws;
+} indirect_timing_t;
+
+typedef struct {
+    vulkan_t *vulkan;
+    allocator_t allocator;
+    VkExtent2D extent;
+    uint32_t instances_count;
+    // without multiDrawIndirect and drawIndirectFirstInstance only the per-draw path can render
+    bool gpu_driven;
+    float field_size;
+    uint64_t frame;
+    uint32_t draws;
+    indirect_frame_t constants;
+
+    // the host keeps its own copy of the instances in the arena, the per-draw path culls against it
+    arena_t arena;
+    void *arrays[INDIRECT_ARRAY_COUNT];
+    VkDeviceSize array_offsets[INDIRECT_ARRAY_COUNT];
+    VkDeviceSize meshes_offset;
+    VkBuffer scene;
+    allocation_t scene_allocation;
+    VkDeviceSize indices_offset;
+    VkBuffer geometry;
+    allocation_t geometry_allocation;
+    VkBuffer frame_constants;
+    allocation_t frame_constants_allocation;
+    VkBuffer readback;
+    allocation_t readback_allocation;
+
+    // level 0 is the depth buffer as is, every level above keeps the farthest depth under each of its texels
+    uint32_t pyramid_levels;
+    bool pyramid_built;
+    float pyramid_view_projection[16];
+    VkImage pyramid;
+    allocation_t pyramid_allocation;
+    VkImageView pyramid_view;
+    VkImageView pyramid_level_views[INDIRECT_MAX_PYRAMID_LEVELS];
+    VkSampler sampler;
+
+    VkRenderPass render_pass;
+    VkDescriptorSetLayout draw_set_layout;
+    VkDescriptorSetLayout cull_set_layout;
+    VkDescriptorSetLayout hiz_set_layout;
+    VkPipelineLayout draw_pipeline_layout;
+    VkPipelineLayout cull_pipeline_layout;
+    VkPipelineLayout hiz_pipeline_layout;
+    VkPipeline draw_pipeline;
+    VkPipeline cull_pipeline;
+    VkPipeline hiz_pipeline;
+    VkDescriptorPool descriptor_pool;
+    VkDescriptorSet draw_set;
+    VkDescriptorSet cull_set;
+    VkDescriptorSet hiz_sets[INDIRECT_MAX_PYRAMID_LEVELS];
+
+    VkCommandPool command_pool;
+    VkCommandBuffer command_buffer;
+    VkFence fence;
+
+    indirect_target_t targets[INDIRECT_PATH_COUNT];
+} indirect_t;
+
+void indirect_create(vulkan_t *vulkan, indirect_t *indirect, VkExtent2D extent, uint32_t instances_count, uint64_t seed);
+void indirect_render(indirect_t *indirect, indirect_path_t path, indirect_timing_t *timing);
+void indirect_free_resources(vulkan_t *vulkan, indirect_t *indirect);
+
+void indirect_benchmark(uint32_t iterations);
+
+#endif // INDIRECT_H
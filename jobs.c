@@ -0,0 +1,168 @@
+#define _POSIX_C_SOURCE 200809L
+#include "jobs.h"
+#include <assert.h>
+#include <sched.h>
+#include <stdio.h>
+#include <unistd.h>
+
+static _Thread_local jobs_worker_t *jobs_current_worker = NULL;
+
+static void jobs_deque_push(jobs_deque_t *deque, job_t *job) {
+    long long bottom = atomic_load_explicit(&deque->bottom, memory_order_relaxed);
+    long long top = atomic_load_explicit(&deque->top, memory_order_acquire);
+    assert(bottom - top < JOBS_DEQUE_CAPACITY);
+
+    atomic_store_explicit(&deque->entries[bottom & (JOBS_DEQUE_CAPACITY - 1)], job, memory_order_relaxed);
+    atomic_store_explicit(&deque->bottom, bottom + 1, memory_order_release);
+}
+
+static job_t *jobs_deque_pop(jobs_deque_t *deque) {
+    long long bottom = atomic_load_explicit(&deque->bottom, memory_order_relaxed) - 1;
+    atomic_store_explicit(&deque->bottom, bottom, memory_order_relaxed);
+    atomic_thread_fence(memory_order_seq_cst);
+    long long top = atomic_load_explicit(&deque->top, memory_order_relaxed);
+
+    if (top > bottom) {
+        atomic_store_explicit(&deque->bottom, bottom + 1, memory_order_relaxed);
+        return NULL;
+    }
+
+    job_t *job = atomic_load_explicit(&deque->entries[bottom & (JOBS_DEQUE_CAPACITY - 1)], memory_order_relaxed);
+    if (top == bottom) {
+        // last entry, race the thieves for it
+        if (!atomic_compare_exchange_strong_explicit(&deque->top, &top, top + 1, memory_order_seq_cst,
+                                                     memory_order_relaxed))
+            job = NULL;
+        atomic_store_explicit(&deque->bottom, bottom + 1, memory_order_relaxed);
+    }
+    return job;
+}
+
+static job_t *jobs_deque_steal(jobs_deque_t *deque) {
+    long long top = atomic_load_explicit(&deque->top, memory_order_acquire);
+    atomic_thread_fence(memory_order_seq_cst);
+    long long bottom = atomic_load_explicit(&deque->bottom, memory_order_acquire);
+    if (top >= bottom)
+        return NULL;
+
+    job_t *job = atomic_load_explicit(&deque->entries[top & (JOBS_DEQUE_CAPACITY - 1)], memory_order_relaxed);
+    if (!atomic_compare_exchange_strong_explicit(&deque->top, &top, top + 1, memory_order_seq_cst, memory_order_relaxed))
+        return NULL;
+    return job;
+}
+
+// own deque first, then a sweep over the others starting at a random victim
+static bool jobs_execute_one(jobs_t *jobs, jobs_worker_t *worker) {
+    job_t *job = jobs_deque_pop(&worker->deque);
+    if (job == NULL && jobs->workers_count > 1) {
+        worker->random_state ^= worker->random_state << 13;
+        worker->random_state ^= worker->random_state >> 7;
+        worker->random_state ^= worker->random_state << 17;
+        uint32_t first = (uint32_t)(worker->random_state % jobs->workers_count);
+        for (uint32_t i = 0; i < jobs->workers_count && job == NULL; i++) {
+            uint32_t victim = (first + i) % jobs->workers_count;
+            if (victim != worker->index)
+                job = jobs_deque_steal(&jobs->workers[victim].deque);
+        }
+        if (job)
+            worker->stolen_count++;
+    }
+    if (job == NULL)
+        return false;
+
+    atomic_fetch_sub_explicit(&jobs->pending, 1, memory_order_relaxed);
+    job->function(worker->index, job->data);
+    atomic_fetch_sub_explicit(job->remaining, 1, memory_order_release);
+    worker->executed_count++;
+    return true;
+}
+
+static void *jobs_worker_main(void *argument) {
+    jobs_worker_t *worker = (jobs_worker_t *)argument;
+    jobs_t *jobs = worker->jobs;
+    jobs_current_worker = worker;
+
+    while (!atomic_load_explicit(&jobs->quit, memory_order_acquire)) {
+        if (jobs_execute_one(jobs, worker))
+            continue;
+
+        // nothing to steal, sleep until jobs_run publishes more work
+        pthread_mutex_lock(&jobs->mutex);
+        while (atomic_load(&jobs->pending) == 0 && !atomic_load(&jobs->quit))
+            pthread_cond_wait(&jobs->wake, &jobs->mutex);
+        pthread_mutex_unlock(&jobs->mutex);
+    }
+    return NULL;
+}
+
+uint32_t jobs_hardware_threads(void) {
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+    if (count < 1)
+        return 1;
+    return count > JOBS_MAX_WORKERS ? JOBS_MAX_WORKERS : (uint32_t)count;
+}
+
+void jobs_create(jobs_t *jobs, uint32_t workers_count) {
+    assert(workers_count > 0 && workers_count <= JOBS_MAX_WORKERS);
+    jobs->workers_count = workers_count;
+    atomic_init(&jobs->pending, 0);
+    atomic_init(&jobs->quit, false);
+    pthread_mutex_init(&jobs->mutex, NULL);
+    pthread_cond_init(&jobs->wake, NULL);
+
+    for (uint32_t i = 0; i < workers_count; i++) {
+        jobs_worker_t *worker = &jobs->workers[i];
+        worker->jobs = jobs;
+        worker->index = i;
+        worker->random_state = 0x9e3779b97f4a7c15ull * (i + 1);
+        worker->executed_count = 0;
+        worker->stolen_count = 0;
+        atomic_init(&worker->deque.top, 0);
+        atomic_init(&worker->deque.bottom, 0);
+    }
+
+    for (uint32_t i = 1; i < workers_count; i++) {
+        int error = pthread_create(&jobs->workers[i].thread, NULL, jobs_worker_main, &jobs->workers[i]);
+        assert(error == 0);
+    }
+}
+
+// pushes onto the calling worker's deque and helps out until every job in the list has finished
+void jobs_run(jobs_t *jobs, uint32_t jobs_count, job_t *job_list) {
+    jobs_worker_t *worker = jobs_current_worker ? jobs_current_worker : &jobs->workers[0];
+
+    atomic_uint remaining;
+    atomic_init(&remaining, jobs_count);
+    atomic_fetch_add(&jobs->pending, jobs_count);
+    for (uint32_t i = 0; i < jobs_count; i++) {
+        job_list[i].remaining = &remaining;
+        jobs_deque_push(&worker->deque, &job_list[i]);
+    }
+
+    pthread_mutex_lock(&jobs->mutex);
+    pthread_cond_broadcast(&jobs->wake);
+    pthread_mutex_unlock(&jobs->mutex);
+
+    while (atomic_load_explicit(&remaining, memory_order_acquire) > 0)
+        if (!jobs_execute_one(jobs, worker))
+            sched_yield();
+}
+
+void jobs_report(jobs_t *jobs) {
+    for (uint32_t i = 0; i < jobs->workers_count; i++)
+        printf("worker %2u: %llu jobs, %llu stolen\n", i, (unsigned long long)jobs->workers[i].executed_count,
+               (unsigned long long)jobs->workers[i].stolen_count);
+}
+
+void jobs_free_resources(jobs_t *jobs) {
+    pthread_mutex_lock(&jobs->mutex);
+    atomic_store(&jobs->quit, true);
+    pthread_cond_broadcast(&jobs->wake);
+    pthread_mutex_unlock(&jobs->mutex);
+
+    for (uint32_t i = 1; i < jobs->workers_count; i++)
+        pthread_join(jobs->workers[i].thread, NULL);
+
+    pthread_mutex_destroy(&jobs->mutex);
+    pthread_cond_destroy(&jobs->wake);
+}
@@ -0,0 +1,56 @@
+#ifndef JOBS_H
+#define JOBS_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#define JOBS_MAX_WORKERS 32
+#define JOBS_DEQUE_CAPACITY 4096
+
+typedef void (*job_function_t)(uint32_t worker_index, void *data);
+
+typedef struct {
+    job_function_t function;
+    void *data;
+    atomic_uint *remaining;
+} job_t;
+
+// chase-lev deque, the owner pushes and pops at the bottom while thieves take from the top
+typedef struct {
+    atomic_llong top;
+    atomic_llong bottom;
+    _Atomic(job_t *) entries[JOBS_DEQUE_CAPACITY];
+} jobs_deque_t;
+
+typedef struct jobs_s jobs_t;
+
+typedef struct {
+    jobs_t *jobs;
+    uint32_t index;
+    pthread_t thread;
+    uint64_t random_state;
+    jobs_deque_t deque;
+    uint64_t executed_count;
+    uint64_t stolen_count;
+} jobs_worker_t;
+
+// worker 0 is whichever thread calls jobs_run, the rest are spawned by jobs_create
+struct jobs_s {
+    uint32_t workers_count;
+    jobs_worker_t workers[JOBS_MAX_WORKERS];
+
+    atomic_uint pending;
+    atomic_bool quit;
+    pthread_mutex_t mutex;
+    pthread_cond_t wake;
+};
+
+uint32_t jobs_hardware_threads(void);
+void jobs_create(jobs_t *jobs, uint32_t workers_count);
+void jobs_run(jobs_t *jobs, uint32_t jobs_count, job_t *job_list);
+void jobs_report(jobs_t *jobs);
+void jobs_free_resources(jobs_t *jobs);
+
+#endif // JOBS_H
@@ -1,38 +1,193 @@
+#include "batch.h"
+#include "bench.h"
+#include "graph.h"
+#include "host_memory.h"
+#include "pipeline_cache.h"
+#include "profiler.h"
+#include "runtime.h"
+#include "scheduler.h"
 #include "sdl.h"
+#include "swapchain.h"
 #include "vulkan.h"
 #include <assert.h>
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <vulkan/vk_enum_string_helper.h>
 #include <vulkan/vulkan_core.h>
 
-void blah(vulkan_t *vulkan, sdl_t *sdl) {
-    VkResult res;
-    VkPresentModeKHR desired_present_mode = VK_PRESENT_MODE_IMMEDIATE_KHR;
-    uint32_t present_modes_count;
-
-    res = vulkan->vkGetPhysicalDeviceSurfacePresentModesKHR(vulkan->physical_device, vulkan->surface, &present_modes_count, NULL);
-    assert(res == VK_SUCCESS);
-    VkPresentModeKHR *present_modes = (VkPresentModeKHR *)malloc(sizeof(VkPresentModeKHR *) * present_modes_count);
-    res = vulkan->vkGetPhysicalDeviceSurfacePresentModesKHR(vulkan->physical_device, vulkan->surface, &present_modes_count,
-                                                            present_modes);
-    assert(res == VK_SUCCESS);
-
-    bool desired_present_mode_supported = false;
-    for (int i = 0; i < present_modes_count; i++)
-        if (desired_present_mode == present_modes[i])
-            desired_present_mode_supported = true;
-
-    if (desired_present_mode_supported)
-        vulkan->present_mode = desired_present_mode;
-    else
-        vulkan->present_mode = VK_PRESENT_MODE_FIFO_KHR;
+static VkPresentModeKHR parse_present_mode(const char *name) {
+    if (strcmp(name, "mailbox") == 0)
+        return VK_PRESENT_MODE_MAILBOX_KHR;
+    if (strcmp(name, "fifo-relaxed") == 0)
+        return VK_PRESENT_MODE_FIFO_RELAXED_KHR;
+    if (strcmp(name, "immediate") == 0)
+        return VK_PRESENT_MODE_IMMEDIATE_KHR;
+    return VK_PRESENT_MODE_FIFO_KHR;
+}
+
+// the frame is a graph of one pass clearing the swapchain image, which the graph leaves ready to present
+typedef struct {
+    graph_t graph;
+    graph_resource_t target;
+} frame_graph_t;
+
+static void clear_pass(vulkan_t *vulkan, graph_t *graph, VkCommandBuffer command_buffer, void *data) {
+    swapchain_t *swapchain = (swapchain_t *)data;
+    VkImageSubresourceRange subresource_range = {
+        .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+        .levelCount = 1,
+        .layerCount = 1,
+    };
+    float t = (float)(swapchain->frame_counter % 240) / 240.0f;
+    VkClearColorValue clear_color = {.float32 = {t, 0.2f, 1.0f - t, 1.0f}};
+    vulkan->vkCmdClearColorImage(command_buffer, swapchain->images[swapchain->image_index],
+                                 VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, &clear_color, 1, &subresource_range);
+}
+
+static void create_frame_graph(vulkan_t *vulkan, swapchain_t *swapchain, frame_graph_t *frame_graph) {
+    graph_create(&frame_graph->graph, NULL, false);
+    frame_graph->target = graph_import_image(
+        &frame_graph->graph, "swapchain image", VK_NULL_HANDLE, VK_IMAGE_ASPECT_COLOR_BIT,
+        (graph_state_t){swapchain->wait_stage, 0, VK_IMAGE_LAYOUT_UNDEFINED},
+        (graph_state_t){VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR});
+    uint32_t pass = graph_add_pass(&frame_graph->graph, "clear", clear_pass, swapchain, false);
+    graph_use(&frame_graph->graph, pass, frame_graph->target, GRAPH_ACCESS_TRANSFER_WRITE);
+    graph_compile(vulkan, &frame_graph->graph);
+}
+
+static void record_frame(vulkan_t *vulkan, swapchain_t *swapchain, frame_graph_t *frame_graph,
+                         VkCommandBuffer command_buffer) {
+    graph_set_image(&frame_graph->graph, frame_graph->target, swapchain->images[swapchain->image_index]);
+    graph_execute(vulkan, &frame_graph->graph, command_buffer);
+}
+
+// with a window this runs on the render thread and only learns about the window through the runtime's queue
+static void run_frames(vulkan_t *vulkan, runtime_t *runtime, swapchain_t *swapchain, frame_graph_t *frame_graph,
+                       profiler_t *profiler, uint32_t frames) {
+    // only frames that were recorded count towards the limit
+    for (uint32_t frame = 0; frames == 0 || frame < frames;) {
+        if (runtime != NULL) {
+            if (!runtime_poll(runtime))
+                break;
+            // a minimized window has nothing to present to, so sleep until it comes back or closes
+            if ((runtime->width == 0 || runtime->height == 0) && !runtime_wait_for_size(runtime))
+                break;
+            if (runtime->resized) {
+                swapchain_recreate(vulkan, swapchain, runtime->width, runtime->height);
+                runtime->resized = false;
+            }
+        }
+
+        profiler_cpu_begin(profiler, "frame");
+        VkCommandBuffer command_buffer;
+        profiler_cpu_begin(profiler, "begin frame");
+        bool began = swapchain_begin_frame(vulkan, swapchain, &command_buffer);
+        profiler_cpu_end(profiler);
+        if (began) {
+            profiler_begin_frame(vulkan, profiler, swapchain->frame_index, command_buffer);
+            profiler_cpu_begin(profiler, "record");
+            profiler_gpu_begin(vulkan, profiler, command_buffer, "clear");
+            record_frame(vulkan, swapchain, frame_graph, command_buffer);
+            profiler_gpu_end(vulkan, profiler, command_buffer);
+            profiler_cpu_end(profiler);
+            profiler_end_frame(profiler);
+
+            profiler_cpu_begin(profiler, "submit and present");
+            swapchain_end_frame(vulkan, swapchain, 0, NULL);
+            profiler_cpu_end(profiler);
+            if (runtime != NULL)
+                runtime_presented(runtime);
+            frame++;
+        }
+
+        if (swapchain->needs_recreate) {
+            uint32_t width = swapchain->extent.width, height = swapchain->extent.height;
+            if (runtime != NULL) {
+                width = runtime->width;
+                height = runtime->height;
+            }
+            if (width > 0 && height > 0)
+                swapchain_recreate(vulkan, swapchain, width, height);
+        }
+        profiler_cpu_end(profiler);
+    }
+}
+
+// everything the render thread needs, while the main thread stays behind pumping sdl events
+typedef struct {
+    vulkan_t *vulkan;
+    runtime_t *runtime;
+    swapchain_t *swapchain;
+    frame_graph_t *frame_graph;
+    profiler_t *profiler;
+    uint32_t frames;
+} render_context_t;
 
-    free(present_modes);
+static void render_main(void *data) {
+    render_context_t *context = (render_context_t *)data;
+    run_frames(context->vulkan, context->runtime, context->swapchain, context->frame_graph, context->profiler, context->frames);
 }
 
 int main(int argc, char *argv[]) {
     vulkan_t vulkan = {0};
     sdl_t sdl = {0};
+    const char *bench = NULL;
+    uint32_t bench_iterations = 100;
+    uint32_t frames = 0;
+    uint32_t frames_in_flight = 2;
+    const char *profile_path = NULL;
+    bool host_memory_report_enabled = false;
+    VkPresentModeKHR desired_present_mode = VK_PRESENT_MODE_MAILBOX_KHR;
+    const char *batch_directory = NULL;
+    batch_format_t batch_format = BATCH_FORMAT_PNG;
+    VkExtent2D batch_extent = {BATCH_DEFAULT_WIDTH, BATCH_DEFAULT_HEIGHT};
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--headless") == 0)
+            vulkan.headless = true;
+        else if (strcmp(argv[i], "--device") == 0 && i + 1 < argc)
+            vulkan.device_override = argv[++i];
+        else if (strcmp(argv[i], "--pipeline-cache") == 0 && i + 1 < argc)
+            vulkan.pipeline_cache_path = argv[++i];
+        else if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc)
+            frames = (uint32_t)strtoul(argv[++i], NULL, 10);
+        else if (strcmp(argv[i], "--frames-in-flight") == 0 && i + 1 < argc)
+            frames_in_flight = (uint32_t)strtoul(argv[++i], NULL, 10);
+        else if (strcmp(argv[i], "--present-mode") == 0 && i + 1 < argc)
+            desired_present_mode = parse_present_mode(argv[++i]);
+        else if (strcmp(argv[i], "--profile") == 0 && i + 1 < argc)
+            profile_path = argv[++i];
+        else if (strcmp(argv[i], "--host-memory") == 0)
+            host_memory_report_enabled = true;
+        else if (strcmp(argv[i], "--bench") == 0 && i + 1 < argc)
+            bench = argv[++i];
+        else if (strcmp(argv[i], "--iterations") == 0 && i + 1 < argc)
+            bench_iterations = (uint32_t)strtoul(argv[++i], NULL, 10);
+        else if (strcmp(argv[i], "--batch") == 0 && i + 1 < argc)
+            batch_directory = argv[++i];
+        else if (strcmp(argv[i], "--batch-format") == 0 && i + 1 < argc) {
+            if (!batch_parse_format(argv[++i], &batch_format)) {
+                fprintf(stderr, "unknown batch format %s\n", argv[i]);
+                return EXIT_FAILURE;
+            }
+        } else if (strcmp(argv[i], "--batch-size") == 0 && i + 1 < argc) {
+            uint32_t width = 0, height = 0;
+            char trailing;
+            if (sscanf(argv[++i], "%ux%u%c", &width, &height, &trailing) != 2 || width == 0 || height == 0) {
+                fprintf(stderr, "batch size must look like 1280x720, not %s\n", argv[i]);
+                return EXIT_FAILURE;
+            }
+            batch_extent = (VkExtent2D){width, height};
+        }
+    }
+
+    // batch renders never present, so they need no window even on a desktop
+    if (batch_directory)
+        vulkan.headless = true;
+
+    if (bench)
+        return bench_run(bench, bench_iterations) ? EXIT_SUCCESS : EXIT_FAILURE;
 
     vulkan_load_global_level_functions(&vulkan);
     vulkan_create_instance(&vulkan);
@@ -40,17 +195,82 @@ int main(int argc, char *argv[]) {
     vulkan_load_instance_level_extension_functions(&vulkan);
     vulkan_create_physical_device(&vulkan);
 
-    sdl_create_window(&vulkan, &sdl);
+    if (vulkan.headless)
+        vulkan_create_headless_surface(&vulkan);
+    else
+        sdl_create_window(&vulkan, &sdl);
 
     vulkan_create_logical_device(&vulkan);
-
-    blah(&vulkan, &sdl);
-
     vulkan_load_device_level_functions(&vulkan);
+    vulkan_get_device_queues(&vulkan);
     vulkan_load_device_level_extension_functions(&vulkan);
+    pipeline_cache_create(&vulkan);
+
+    // headless runs have no window to close, so they stop after a fixed number of frames
+    if (vulkan.headless && frames == 0)
+        frames = 300;
 
-    sdl_free_resources(&vulkan, &sdl);
+    if (batch_directory) {
+        batch_t *batch = (batch_t *)malloc(sizeof(batch_t));
+        batch_create(&vulkan, batch, batch_extent, BATCH_DEFAULT_SLOTS, batch_format, batch_directory);
+        batch_render(batch, frames);
+        batch_report(batch);
+        batch_free_resources(&vulkan, batch);
+        free(batch);
+    } else if (vulkan.surface != VK_NULL_HANDLE && vulkan.vkCreateSwapchainKHR != NULL) {
+        uint32_t width = 512, height = 512;
+        if (!vulkan.headless)
+            sdl_get_window_size(&sdl, &width, &height);
+
+        scheduler_t scheduler;
+        scheduler_create(&vulkan, &scheduler);
+        swapchain_t swapchain;
+        swapchain_create(&vulkan, &swapchain, &scheduler, frames_in_flight, desired_present_mode, width, height);
+
+        profiler_t profiler;
+        if (profile_path)
+            profiler_create(&vulkan, &profiler, swapchain.frames_in_flight, VULKAN_QUEUE_GRAPHICS);
+
+        frame_graph_t *frame_graph = (frame_graph_t *)malloc(sizeof(frame_graph_t));
+        create_frame_graph(&vulkan, &swapchain, frame_graph);
+
+        if (vulkan.headless) {
+            run_frames(&vulkan, NULL, &swapchain, frame_graph, profile_path ? &profiler : NULL, frames);
+        } else {
+            runtime_t runtime;
+            runtime_create(&runtime, width, height);
+            render_context_t context = {
+                .vulkan = &vulkan,
+                .runtime = &runtime,
+                .swapchain = &swapchain,
+                .frame_graph = frame_graph,
+                .profiler = profile_path ? &profiler : NULL,
+                .frames = frames,
+            };
+            runtime_run(&runtime, render_main, &context);
+            runtime_report(&runtime);
+            runtime_free_resources(&runtime);
+        }
+        graph_free_resources(&vulkan, &frame_graph->graph);
+        free(frame_graph);
+        swapchain_free_resources(&vulkan, &swapchain);
+        scheduler_free_resources(&vulkan, &scheduler);
+
+        if (profile_path) {
+            profiler_flush(&vulkan, &profiler);
+            if (!profiler_write_trace(&profiler, profile_path))
+                fprintf(stderr, "failed to write profile to %s\n", profile_path);
+            profiler_free_resources(&vulkan, &profiler);
+        }
+    }
+
+    if (!vulkan.headless)
+        sdl_free_resources(&vulkan, &sdl);
     vulkan_free_resources(&vulkan);
 
+    // after teardown, so anything still live is a leak and the peaks cover the whole run
+    if (host_memory_report_enabled)
+        host_memory_report(&vulkan.host_memory);
+
     return 0;
 }
@@ -0,0 +1,363 @@
+#define _POSIX_C_SOURCE 200809L
+#include "pipeline_builder.h"
+#include "jobs.h"
+#include "pipeline_cache.h"
+#include "shader.h"
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static uint64_t pipeline_builder_hash_bytes(uint64_t hash, const void *data, size_t size) {
+    const unsigned char *bytes = (const unsigned char *)data;
+    for (size_t i = 0; i < size; i++) {
+        hash ^= bytes[i];
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
+
+// fnv-1a over the spir-v, the specialization data and the pipeline state
+static uint64_t pipeline_builder_hash(const pipeline_request_t *request) {
+    uint64_t hash = 0xcbf29ce484222325ull;
+    hash = pipeline_builder_hash_bytes(hash, request->code, request->code_size);
+    hash = pipeline_builder_hash_bytes(hash, &request->constants_count, sizeof(request->constants_count));
+    hash = pipeline_builder_hash_bytes(hash, request->constants, request->constants_count * sizeof(uint32_t));
+    hash = pipeline_builder_hash_bytes(hash, &request->layout, sizeof(request->layout));
+    hash = pipeline_builder_hash_bytes(hash, &request->flags, sizeof(request->flags));
+    return hash;
+}
+
+static bool pipeline_builder_equal(const pipeline_request_t *a, const pipeline_request_t *b) {
+    return a->code_size == b->code_size && a->constants_count == b->constants_count && a->layout == b->layout &&
+           a->flags == b->flags && memcmp(a->constants, b->constants, a->constants_count * sizeof(uint32_t)) == 0 &&
+           memcmp(a->code, b->code, a->code_size) == 0;
+}
+
+// a failed build is reported as a null pipeline rather than an assert, callers simply keep their fallback
+static VkPipeline pipeline_builder_compile(vulkan_t *vulkan, VkPipelineCache cache, const pipeline_request_t *request) {
+    VkShaderModuleCreateInfo shader_module_create_info = {
+        .sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
+        .codeSize = request->code_size,
+        .pCode = request->code,
+    };
+    VkShaderModule shader_module = VK_NULL_HANDLE;
+    VkResult result = vulkan->vkCreateShaderModule(vulkan->logical_device, &shader_module_create_info,
+                                                   vulkan->allocation_callbacks, &shader_module);
+    if (result != VK_SUCCESS)
+        return VK_NULL_HANDLE;
+
+    VkSpecializationMapEntry specialization_map_entries[PIPELINE_BUILDER_MAX_CONSTANTS];
+    for (uint32_t i = 0; i < request->constants_count; i++) {
+        specialization_map_entries[i] = (VkSpecializationMapEntry){
+            .constantID = i,
+            .offset = i * sizeof(uint32_t),
+            .size = sizeof(uint32_t),
+        };
+    }
+    VkSpecializationInfo specialization_info = {
+        .mapEntryCount = request->constants_count,
+        .pMapEntries = specialization_map_entries,
+        .dataSize = request->constants_count * sizeof(uint32_t),
+        .pData = request->constants,
+    };
+
+    VkComputePipelineCreateInfo compute_pipeline_create_info = {
+        .sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+        .flags = request->flags,
+        .stage =
+            {
+                .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+                .stage = VK_SHADER_STAGE_COMPUTE_BIT,
+                .module = shader_module,
+                .pName = "main",
+                .pSpecializationInfo = request->constants_count > 0 ? &specialization_info : NULL,
+            },
+        .layout = request->layout,
+    };
+
+    VkPipeline pipeline = VK_NULL_HANDLE;
+    result = vulkan->vkCreateComputePipelines(vulkan->logical_device, cache, 1, &compute_pipeline_create_info,
+                                              vulkan->allocation_callbacks, &pipeline);
+    vulkan->vkDestroyShaderModule(vulkan->logical_device, shader_module, vulkan->allocation_callbacks);
+    return result == VK_SUCCESS ? pipeline : VK_NULL_HANDLE;
+}
+
+// workers drain the queue before honouring quit, so every future handed out eventually settles
+static void *pipeline_builder_worker_main(void *data) {
+    pipeline_builder_worker_t *worker = (pipeline_builder_worker_t *)data;
+    pipeline_builder_t *builder = worker->builder;
+
+    pthread_mutex_lock(&builder->mutex);
+    for (;;) {
+        while (builder->queue_head == NULL && !builder->quit)
+            pthread_cond_wait(&builder->wake, &builder->mutex);
+        if (builder->queue_head == NULL)
+            break;
+
+        pipeline_future_t *future = builder->queue_head;
+        builder->queue_head = future->next;
+        if (builder->queue_head == NULL)
+            builder->queue_tail = NULL;
+        builder->queue_depth--;
+        pthread_mutex_unlock(&builder->mutex);
+
+        VkPipeline pipeline = pipeline_builder_compile(builder->vulkan, worker->cache, &future->request);
+        uint64_t latency = bench_now_ns() - future->requested_ns;
+
+        pthread_mutex_lock(&builder->mutex);
+        future->pipeline = pipeline;
+        atomic_store_explicit(&future->state, pipeline != VK_NULL_HANDLE ? PIPELINE_FUTURE_READY : PIPELINE_FUTURE_FAILED,
+                              memory_order_release);
+        if (pipeline != VK_NULL_HANDLE)
+            builder->stats.compiled++;
+        else
+            builder->stats.failed++;
+        bench_samples_push(&builder->latencies, latency);
+        builder->outstanding--;
+        pthread_cond_broadcast(&builder->done);
+    }
+    pthread_mutex_unlock(&builder->mutex);
+    return NULL;
+}
+
+void pipeline_builder_create(vulkan_t *vulkan, pipeline_builder_t *builder, uint32_t workers_count) {
+    assert(workers_count > 0 && workers_count <= PIPELINE_BUILDER_MAX_WORKERS);
+
+    memset(builder, 0, sizeof(*builder));
+    builder->vulkan = vulkan;
+    builder->workers_count = workers_count;
+    pthread_mutex_init(&builder->mutex, NULL);
+    pthread_cond_init(&builder->wake, NULL);
+    pthread_cond_init(&builder->done, NULL);
+    bench_samples_create(&builder->queue_depths, "queue depth", PIPELINE_BUILDER_CAPACITY);
+    bench_samples_create(&builder->latencies, "pipeline build, request to ready", PIPELINE_BUILDER_CAPACITY);
+
+    for (uint32_t i = 0; i < workers_count; i++) {
+        builder->workers[i].builder = builder;
+        builder->workers[i].cache = pipeline_cache_create_worker(vulkan);
+        int error = pthread_create(&builder->workers[i].thread, NULL, pipeline_builder_worker_main, &builder->workers[i]);
+        assert(error == 0);
+    }
+}
+
+// identical requests share one future, only the first one queues a build
+pipeline_future_t *pipeline_builder_request(pipeline_builder_t *builder, const pipeline_request_t *request) {
+    assert(request->constants_count <= PIPELINE_BUILDER_MAX_CONSTANTS);
+    uint64_t hash = pipeline_builder_hash(request);
+
+    pthread_mutex_lock(&builder->mutex);
+    builder->stats.requests++;
+
+    uint32_t index = (uint32_t)hash & (PIPELINE_BUILDER_CAPACITY - 1);
+    while (builder->futures[index] != NULL) {
+        pipeline_future_t *future = builder->futures[index];
+        if (future->hash == hash && pipeline_builder_equal(&future->request, request)) {
+            builder->stats.hits++;
+            pthread_mutex_unlock(&builder->mutex);
+            return future;
+        }
+        index = (index + 1) & (PIPELINE_BUILDER_CAPACITY - 1);
+    }
+    assert(builder->futures_count < PIPELINE_BUILDER_CAPACITY / 2);
+
+    pipeline_future_t *future = (pipeline_future_t *)calloc(1, sizeof(pipeline_future_t));
+    uint32_t *code = (uint32_t *)malloc(request->code_size);
+    memcpy(code, request->code, request->code_size);
+    future->hash = hash;
+    future->request = *request;
+    future->request.code = code;
+    atomic_init(&future->state, PIPELINE_FUTURE_PENDING);
+    future->requested_ns = bench_now_ns();
+    builder->futures[index] = future;
+    builder->futures_count++;
+
+    if (builder->queue_tail != NULL)
+        builder->queue_tail->next = future;
+    else
+        builder->queue_head = future;
+    builder->queue_tail = future;
+    builder->queue_depth++;
+    builder->outstanding++;
+    if (builder->queue_depth > builder->stats.max_queue_depth)
+        builder->stats.max_queue_depth = builder->queue_depth;
+    bench_samples_push(&builder->queue_depths, builder->queue_depth);
+
+    pthread_cond_signal(&builder->wake);
+    pthread_mutex_unlock(&builder->mutex);
+    return future;
+}
+
+// never blocks, a pending or failed build hands back the fallback
+VkPipeline pipeline_future_get(pipeline_future_t *future, VkPipeline fallback) {
+    if (atomic_load_explicit(&future->state, memory_order_acquire) == PIPELINE_FUTURE_READY)
+        return future->pipeline;
+    return fallback;
+}
+
+VkPipeline pipeline_builder_wait(pipeline_builder_t *builder, pipeline_future_t *future) {
+    pthread_mutex_lock(&builder->mutex);
+    while (atomic_load_explicit(&future->state, memory_order_acquire) == PIPELINE_FUTURE_PENDING)
+        pthread_cond_wait(&builder->done, &builder->mutex);
+    pthread_mutex_unlock(&builder->mutex);
+    return future->pipeline;
+}
+
+void pipeline_builder_wait_idle(pipeline_builder_t *builder) {
+    pthread_mutex_lock(&builder->mutex);
+    while (builder->outstanding > 0)
+        pthread_cond_wait(&builder->done, &builder->mutex);
+    pthread_mutex_unlock(&builder->mutex);
+}
+
+void pipeline_builder_report(pipeline_builder_t *builder) {
+    pthread_mutex_lock(&builder->mutex);
+    pipeline_builder_stats_t *stats = &builder->stats;
+    printf("pipeline builder: %u workers, %u requests, %u hits (%.1f%%), %u compiled, %u failed\n", builder->workers_count,
+           stats->requests, stats->hits, stats->requests > 0 ? 100.0 * stats->hits / stats->requests : 0.0, stats->compiled,
+           stats->failed);
+    if (builder->queue_depths.count > 0)
+        printf("%-48s min %10llu     median %10llu     p99 %10llu     max %u\n", builder->queue_depths.name,
+               (unsigned long long)bench_samples_percentile(&builder->queue_depths, 0.0),
+               (unsigned long long)bench_samples_percentile(&builder->queue_depths, 0.5),
+               (unsigned long long)bench_samples_percentile(&builder->queue_depths, 0.99), stats->max_queue_depth);
+    bench_samples_report(&builder->latencies);
+    pthread_mutex_unlock(&builder->mutex);
+}
+
+void pipeline_builder_free_resources(vulkan_t *vulkan, pipeline_builder_t *builder) {
+    pthread_mutex_lock(&builder->mutex);
+    builder->quit = true;
+    pthread_cond_broadcast(&builder->wake);
+    pthread_mutex_unlock(&builder->mutex);
+
+    VkPipelineCache caches[PIPELINE_BUILDER_MAX_WORKERS];
+    for (uint32_t i = 0; i < builder->workers_count; i++) {
+        pthread_join(builder->workers[i].thread, NULL);
+        caches[i] = builder->workers[i].cache;
+    }
+
+    if (vulkan->pipeline_cache != VK_NULL_HANDLE)
+        pipeline_cache_merge(vulkan, builder->workers_count, caches);
+    for (uint32_t i = 0; i < builder->workers_count; i++)
+        vulkan->vkDestroyPipelineCache(vulkan->logical_device, caches[i], vulkan->allocation_callbacks);
+
+    for (uint32_t i = 0; i < PIPELINE_BUILDER_CAPACITY; i++) {
+        pipeline_future_t *future = builder->futures[i];
+        if (future == NULL)
+            continue;
+        if (future->pipeline != VK_NULL_HANDLE)
+            vulkan->vkDestroyPipeline(vulkan->logical_device, future->pipeline, vulkan->allocation_callbacks);
+        free((void *)future->request.code);
+        free(future);
+    }
+
+    bench_samples_free(&builder->queue_depths);
+    bench_samples_free(&builder->latencies);
+    pthread_cond_destroy(&builder->done);
+    pthread_cond_destroy(&builder->wake);
+    pthread_mutex_destroy(&builder->mutex);
+    memset(builder, 0, sizeof(*builder));
+}
+
+#define PIPELINE_BUILDER_BENCHMARK_VARIANTS 128
+#define PIPELINE_BUILDER_BENCHMARK_REQUESTS_PER_FRAME 4
+#define PIPELINE_BUILDER_BENCHMARK_FRAME_NS 2000000ull
+
+// a frame asks for a few random variants and draws with whatever is ready, pacing itself like a 500 hz render loop
+void pipeline_builder_benchmark(uint32_t iterations) {
+    vulkan_t vulkan = {.headless = true};
+    bench_bootstrap(&vulkan);
+
+    size_t code_size = 0;
+    uint32_t *code = shader_load_code("shaders/pipeline_cache.spv", &code_size);
+
+    VkDescriptorSetLayoutBinding binding = {
+        .binding = 0,
+        .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+        .descriptorCount = 1,
+        .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+    };
+    VkDescriptorSetLayoutCreateInfo descriptor_set_layout_create_info = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+        .bindingCount = 1,
+        .pBindings = &binding,
+    };
+    VkDescriptorSetLayout descriptor_set_layout = VK_NULL_HANDLE;
+    VkResult result = vulkan.vkCreateDescriptorSetLayout(vulkan.logical_device, &descriptor_set_layout_create_info,
+                                                         vulkan.allocation_callbacks, &descriptor_set_layout);
+    assert(result == VK_SUCCESS);
+
+    VkPipelineLayoutCreateInfo pipeline_layout_create_info = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+        .setLayoutCount = 1,
+        .pSetLayouts = &descriptor_set_layout,
+    };
+    VkPipelineLayout pipeline_layout = VK_NULL_HANDLE;
+    result = vulkan.vkCreatePipelineLayout(vulkan.logical_device, &pipeline_layout_create_info, vulkan.allocation_callbacks,
+                                           &pipeline_layout);
+    assert(result == VK_SUCCESS);
+
+    // the fallback is the unspecialized shader, built up front the way a renderer would ship it
+    pipeline_request_t request = {
+        .code = code,
+        .code_size = code_size,
+        .layout = pipeline_layout,
+    };
+    bench_samples_t blocking, requests;
+    bench_samples_create(&blocking, "blocking vkCreateComputePipelines", 1);
+    bench_samples_create(&requests, "pipeline_builder_request", iterations * PIPELINE_BUILDER_BENCHMARK_REQUESTS_PER_FRAME);
+
+    uint64_t start = bench_now_ns();
+    VkPipeline fallback = pipeline_builder_compile(&vulkan, vulkan.pipeline_cache, &request);
+    bench_samples_push(&blocking, bench_now_ns() - start);
+    assert(fallback != VK_NULL_HANDLE);
+
+    uint32_t workers_count = jobs_hardware_threads() > 1 ? jobs_hardware_threads() - 1 : 1;
+    if (workers_count > PIPELINE_BUILDER_MAX_WORKERS)
+        workers_count = PIPELINE_BUILDER_MAX_WORKERS;
+    pipeline_builder_t builder;
+    pipeline_builder_create(&vulkan, &builder, workers_count);
+
+    uint64_t random_state = 0x9e3779b97f4a7c15ull;
+    uint32_t fallback_draws = 0;
+    request.constants_count = 1;
+    for (uint32_t i = 0; i < iterations; i++) {
+        uint64_t frame_start = bench_now_ns();
+        for (uint32_t j = 0; j < PIPELINE_BUILDER_BENCHMARK_REQUESTS_PER_FRAME; j++) {
+            request.constants[0] = 1 + (uint32_t)(bench_random(&random_state) % PIPELINE_BUILDER_BENCHMARK_VARIANTS);
+
+            start = bench_now_ns();
+            pipeline_future_t *future = pipeline_builder_request(&builder, &request);
+            bench_samples_push(&requests, bench_now_ns() - start);
+
+            if (pipeline_future_get(future, fallback) == fallback)
+                fallback_draws++;
+        }
+
+        uint64_t elapsed = bench_now_ns() - frame_start;
+        if (elapsed < PIPELINE_BUILDER_BENCHMARK_FRAME_NS) {
+            uint64_t remaining = PIPELINE_BUILDER_BENCHMARK_FRAME_NS - elapsed;
+            struct timespec pause = {.tv_sec = 0, .tv_nsec = (long)remaining};
+            nanosleep(&pause, NULL);
+        }
+    }
+    pipeline_builder_wait_idle(&builder);
+
+    printf("pipeline builder: %u frames, %u draws, %u drew with the fallback pipeline\n", iterations,
+           iterations * PIPELINE_BUILDER_BENCHMARK_REQUESTS_PER_FRAME, fallback_draws);
+    bench_samples_report(&blocking);
+    bench_samples_report(&requests);
+    pipeline_builder_report(&builder);
+
+    pipeline_builder_free_resources(&vulkan, &builder);
+    bench_samples_free(&blocking);
+    bench_samples_free(&requests);
+    free(code);
+
+    vulkan.vkDestroyPipeline(vulkan.logical_device, fallback, vulkan.allocation_callbacks);
+    vulkan.vkDestroyPipelineLayout(vulkan.logical_device, pipeline_layout, vulkan.allocation_callbacks);
+    vulkan.vkDestroyDescriptorSetLayout(vulkan.logical_device, descriptor_set_layout, vulkan.allocation_callbacks);
+    vulkan_free_resources(&vulkan);
+}
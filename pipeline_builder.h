@@ -0,0 +1,92 @@
+#ifndef PIPELINE_BUILDER_H
+#define PIPELINE_BUILDER_H
+
+#include "bench.h"
+#include "vulkan.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#define PIPELINE_BUILDER_MAX_WORKERS 16
+#define PIPELINE_BUILDER_MAX_CONSTANTS 8
+#define PIPELINE_BUILDER_CAPACITY 1024
+
+typedef enum {
+    PIPELINE_FUTURE_PENDING,
+    PIPELINE_FUTURE_READY,
+    PIPELINE_FUTURE_FAILED,
+} pipeline_future_state_t;
+
+// everything a compute pipeline is built from, specialization constant i has id i and the entry point is main
+typedef struct {
+    const uint32_t *code;
+    size_t code_size;
+    uint32_t constants_count;
+    uint32_t constants[PIPELINE_BUILDER_MAX_CONSTANTS];
+    VkPipelineLayout layout;
+    VkPipelineCreateFlags flags;
+} pipeline_request_t;
+
+// the shared result of every request with the same content, the builder owns it and its copy of the code
+typedef struct pipeline_future_s {
+    uint64_t hash;
+    pipeline_request_t request;
+    atomic_int state;
+    VkPipeline pipeline;
+    uint64_t requested_ns;
+    struct pipeline_future_s *next;
+} pipeline_future_t;
+
+typedef struct pipeline_builder_s pipeline_builder_t;
+
+// each worker compiles into a pipeline cache of its own, merged into the device's when the builder is freed
+typedef struct {
+    pipeline_builder_t *builder;
+    pthread_t thread;
+    VkPipelineCache cache;
+} pipeline_builder_worker_t;
+
+typedef struct {
+    uint32_t requests;
+    uint32_t hits;
+    uint32_t compiled;
+    uint32_t failed;
+    uint32_t max_queue_depth;
+} pipeline_builder_stats_t;
+
+struct pipeline_builder_s {
+    vulkan_t *vulkan;
+    uint32_t workers_count;
+    pipeline_builder_worker_t workers[PIPELINE_BUILDER_MAX_WORKERS];
+
+    pthread_mutex_t mutex;
+    pthread_cond_t wake;
+    pthread_cond_t done;
+    bool quit;
+
+    // requests waiting for a worker, and those plus the ones being compiled
+    pipeline_future_t *queue_head;
+    pipeline_future_t *queue_tail;
+    uint32_t queue_depth;
+    uint32_t outstanding;
+
+    uint32_t futures_count;
+    pipeline_future_t *futures[PIPELINE_BUILDER_CAPACITY];
+
+    pipeline_builder_stats_t stats;
+    bench_samples_t queue_depths;
+    bench_samples_t latencies;
+};
+
+void pipeline_builder_create(vulkan_t *vulkan, pipeline_builder_t *builder, uint32_t workers_count);
+pipeline_future_t *pipeline_builder_request(pipeline_builder_t *builder, const pipeline_request_t *request);
+VkPipeline pipeline_future_get(pipeline_future_t *future, VkPipeline fallback);
+VkPipeline pipeline_builder_wait(pipeline_builder_t *builder, pipeline_future_t *future);
+void pipeline_builder_wait_idle(pipeline_builder_t *builder);
+void pipeline_builder_report(pipeline_builder_t *builder);
+void pipeline_builder_free_resources(vulkan_t *vulkan, pipeline_builder_t *builder);
+
+void pipeline_builder_benchmark(uint32_t iterations);
+
+#endif // PIPELINE_BUILDER_H
@@ -0,0 +1,237 @@
+#define _POSIX_C_SOURCE 200809L
+#include "pipeline_cache.h"
+#include "bench.h"
+#include "shader.h"
+#include <assert.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// a blob written by another driver or gpu must never reach vkCreatePipelineCache
+bool pipeline_cache_validate(vulkan_t *vulkan, const void *data, size_t size) {
+    VkPipelineCacheHeaderVersionOne header;
+    if (size < sizeof(header))
+        return false;
+    memcpy(&header, data, sizeof(header));
+
+    return header.headerSize >= sizeof(header) && header.headerSize <= size &&
+           header.headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE &&
+           header.vendorID == vulkan->device_properties.vendorID && header.deviceID == vulkan->device_properties.deviceID &&
+           memcmp(header.pipelineCacheUUID, vulkan->device_properties.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+}
+
+void pipeline_cache_create(vulkan_t *vulkan) {
+    if (vulkan->pipeline_cache_path == NULL)
+        vulkan->pipeline_cache_path = PIPELINE_CACHE_DEFAULT_PATH;
+
+    void *data = MAP_FAILED;
+    size_t size = 0;
+    int fd = open(vulkan->pipeline_cache_path, O_RDONLY);
+    if (fd >= 0) {
+        struct stat file_stat;
+        if (fstat(fd, &file_stat) == 0 && file_stat.st_size > 0) {
+            size = (size_t)file_stat.st_size;
+            data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        }
+        close(fd);
+    }
+
+    VkPipelineCacheCreateInfo pipeline_cache_create_info = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO,
+    };
+    if (data != MAP_FAILED && pipeline_cache_validate(vulkan, data, size)) {
+        pipeline_cache_create_info.initialDataSize = size;
+        pipeline_cache_create_info.pInitialData = data;
+    }
+
+    VkResult result = vulkan->vkCreatePipelineCache(vulkan->logical_device, &pipeline_cache_create_info,
+                                                    vulkan->allocation_callbacks, &vulkan->pipeline_cache);
+    assert(result == VK_SUCCESS && vulkan->pipeline_cache != VK_NULL_HANDLE);
+
+    // the driver copies the initial data, so the mapping is only needed for the create call
+    if (data != MAP_FAILED)
+        munmap(data, size);
+}
+
+VkPipelineCache pipeline_cache_create_worker(vulkan_t *vulkan) {
+    VkPipelineCacheCreateInfo pipeline_cache_create_info = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO,
+    };
+
+    VkPipelineCache worker_cache = VK_NULL_HANDLE;
+    VkResult result = vulkan->vkCreatePipelineCache(vulkan->logical_device, &pipeline_cache_create_info,
+                                                    vulkan->allocation_callbacks, &worker_cache);
+    assert(result == VK_SUCCESS && worker_cache != VK_NULL_HANDLE);
+    return worker_cache;
+}
+
+void pipeline_cache_merge(vulkan_t *vulkan, uint32_t worker_caches_count, const VkPipelineCache *worker_caches) {
+    if (worker_caches_count == 0)
+        return;
+
+    VkResult result =
+        vulkan->vkMergePipelineCaches(vulkan->logical_device, vulkan->pipeline_cache, worker_caches_count, worker_caches);
+    assert(result == VK_SUCCESS);
+}
+
+void pipeline_cache_store(vulkan_t *vulkan) {
+    size_t size = 0;
+    VkResult result = vulkan->vkGetPipelineCacheData(vulkan->logical_device, vulkan->pipeline_cache, &size, NULL);
+    assert(result == VK_SUCCESS);
+    if (size == 0)
+        return;
+
+    void *data = malloc(size);
+    result = vulkan->vkGetPipelineCacheData(vulkan->logical_device, vulkan->pipeline_cache, &size, data);
+    assert(result == VK_SUCCESS);
+
+    // write next to the real file and rename over it so a crash mid-write never leaves a torn cache behind
+    size_t temporary_path_size = strlen(vulkan->pipeline_cache_path) + 32;
+    char *temporary_path = (char *)malloc(temporary_path_size);
+    snprintf(temporary_path, temporary_path_size, "%s.%ld.tmp", vulkan->pipeline_cache_path, (long)getpid());
+
+    FILE *file = fopen(temporary_path, "wb");
+    if (file == NULL) {
+        fprintf(stderr, "failed to write pipeline cache to %s\n", vulkan->pipeline_cache_path);
+    } else {
+        bool written = fwrite(data, 1, size, file) == size && fflush(file) == 0 && fsync(fileno(file)) == 0;
+        written = fclose(file) == 0 && written;
+        if (!written || rename(temporary_path, vulkan->pipeline_cache_path) != 0) {
+            fprintf(stderr, "failed to write pipeline cache to %s\n", vulkan->pipeline_cache_path);
+            remove(temporary_path);
+        }
+    }
+
+    free(temporary_path);
+    free(data);
+}
+
+void pipeline_cache_free(vulkan_t *vulkan) {
+    pipeline_cache_store(vulkan);
+    vulkan->vkDestroyPipelineCache(vulkan->logical_device, vulkan->pipeline_cache, vulkan->allocation_callbacks);
+    vulkan->pipeline_cache = VK_NULL_HANDLE;
+}
+
+// every variant gets its own specialization constant, so each pipeline is a distinct cache entry
+static void pipeline_cache_benchmark_pass(vulkan_t *vulkan, VkPipelineCache cache, VkShaderModule shader_module,
+                                          VkPipelineLayout pipeline_layout, uint32_t variants, bench_samples_t *samples) {
+    VkSpecializationMapEntry specialization_map_entry = {
+        .constantID = 0,
+        .offset = 0,
+        .size = sizeof(uint32_t),
+    };
+
+    for (uint32_t i = 0; i < variants; i++) {
+        VkSpecializationInfo specialization_info = {
+            .mapEntryCount = 1,
+            .pMapEntries = &specialization_map_entry,
+            .dataSize = sizeof(uint32_t),
+            .pData = &i,
+        };
+
+        VkComputePipelineCreateInfo compute_pipeline_create_info = {
+            .sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+            .stage =
+                {
+                    .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+                    .stage = VK_SHADER_STAGE_COMPUTE_BIT,
+                    .module = shader_module,
+                    .pName = "main",
+                    .pSpecializationInfo = &specialization_info,
+                },
+            .layout = pipeline_layout,
+        };
+
+        VkPipeline pipeline = VK_NULL_HANDLE;
+        uint64_t start = bench_now_ns();
+        VkResult result = vulkan->vkCreateComputePipelines(vulkan->logical_device, cache, 1, &compute_pipeline_create_info,
+                                                           vulkan->allocation_callbacks, &pipeline);
+        bench_samples_push(samples, bench_now_ns() - start);
+        assert(result == VK_SUCCESS && pipeline != VK_NULL_HANDLE);
+
+        vulkan->vkDestroyPipeline(vulkan->logical_device, pipeline, vulkan->allocation_callbacks);
+    }
+}
+
+void pipeline_cache_benchmark(uint32_t iterations) {
+    vulkan_t vulkan = {.headless = true};
+    bench_bootstrap(&vulkan);
+
+    VkShaderModule shader_module = shader_create_module(&vulkan, "shaders/pipeline_cache.spv");
+
+    VkDescriptorSetLayoutBinding binding = {
+        .binding = 0,
+        .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+        .descriptorCount = 1,
+        .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+    };
+    VkDescriptorSetLayoutCreateInfo descriptor_set_layout_create_info = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+        .bindingCount = 1,
+        .pBindings = &binding,
+    };
+    VkDescriptorSetLayout descriptor_set_layout = VK_NULL_HANDLE;
+    VkResult result = vulkan.vkCreateDescriptorSetLayout(vulkan.logical_device, &descriptor_set_layout_create_info,
+                                                         vulkan.allocation_callbacks, &descriptor_set_layout);
+    assert(result == VK_SUCCESS);
+
+    VkPipelineLayoutCreateInfo pipeline_layout_create_info = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+        .setLayoutCount = 1,
+        .pSetLayouts = &descriptor_set_layout,
+    };
+    VkPipelineLayout pipeline_layout = VK_NULL_HANDLE;
+    result = vulkan.vkCreatePipelineLayout(vulkan.logical_device, &pipeline_layout_create_info, vulkan.allocation_callbacks,
+                                           &pipeline_layout);
+    assert(result == VK_SUCCESS);
+
+    bench_samples_t cold, warm, load;
+    bench_samples_create(&cold, "pipeline creation, cold cache", iterations);
+    bench_samples_create(&warm, "pipeline creation, warm cache", iterations);
+    bench_samples_create(&load, "cache load from serialized data", 1);
+
+    VkPipelineCache cold_cache = pipeline_cache_create_worker(&vulkan);
+    pipeline_cache_benchmark_pass(&vulkan, cold_cache, shader_module, pipeline_layout, iterations, &cold);
+
+    size_t size = 0;
+    result = vulkan.vkGetPipelineCacheData(vulkan.logical_device, cold_cache, &size, NULL);
+    assert(result == VK_SUCCESS);
+    void *data = malloc(size);
+    result = vulkan.vkGetPipelineCacheData(vulkan.logical_device, cold_cache, &size, data);
+    assert(result == VK_SUCCESS && pipeline_cache_validate(&vulkan, data, size));
+
+    VkPipelineCacheCreateInfo pipeline_cache_create_info = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO,
+        .initialDataSize = size,
+        .pInitialData = data,
+    };
+    VkPipelineCache warm_cache = VK_NULL_HANDLE;
+    uint64_t start = bench_now_ns();
+    result = vulkan.vkCreatePipelineCache(vulkan.logical_device, &pipeline_cache_create_info, vulkan.allocation_callbacks,
+                                          &warm_cache);
+    bench_samples_push(&load, bench_now_ns() - start);
+    assert(result == VK_SUCCESS);
+
+    pipeline_cache_benchmark_pass(&vulkan, warm_cache, shader_module, pipeline_layout, iterations, &warm);
+
+    printf("pipeline cache: %u pipeline variants, %zu byte cache\n", iterations, size);
+    bench_samples_report(&load);
+    bench_samples_report(&cold);
+    bench_samples_report(&warm);
+
+    bench_samples_free(&load);
+    bench_samples_free(&cold);
+    bench_samples_free(&warm);
+    free(data);
+
+    vulkan.vkDestroyPipelineCache(vulkan.logical_device, warm_cache, vulkan.allocation_callbacks);
+    vulkan.vkDestroyPipelineCache(vulkan.logical_device, cold_cache, vulkan.allocation_callbacks);
+    vulkan.vkDestroyPipelineLayout(vulkan.logical_device, pipeline_layout, vulkan.allocation_callbacks);
+    vulkan.vkDestroyDescriptorSetLayout(vulkan.logical_device, descriptor_set_layout, vulkan.allocation_callbacks);
+    vulkan.vkDestroyShaderModule(vulkan.logical_device, shader_module, vulkan.allocation_callbacks);
+    vulkan_free_resources(&vulkan);
+}
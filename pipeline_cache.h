@@ -0,0 +1,18 @@
+#ifndef PIPELINE_CACHE_H
+#define PIPELINE_CACHE_H
+
+#include "vulkan.h"
+#include <stdbool.h>
+
+#define PIPELINE_CACHE_DEFAULT_PATH "vulkookbook.pipeline_cache"
+
+bool pipeline_cache_validate(vulkan_t *vulkan, const void *data, size_t size);
+void pipeline_cache_create(vulkan_t *vulkan);
+VkPipelineCache pipeline_cache_create_worker(vulkan_t *vulkan);
+void pipeline_cache_merge(vulkan_t *vulkan, uint32_t worker_caches_count, const VkPipelineCache *worker_caches);
+void pipeline_cache_store(vulkan_t *vulkan);
+void pipeline_cache_free(vulkan_t *vulkan);
+
+void pipeline_cache_benchmark(uint32_t iterations);
+
+#endif // PIPELINE_CACHE_H
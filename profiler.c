@@ -0,0 +1,291 @@
+#include "profiler.h"
+#include "bench.h"
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+static uint32_t profiler_first_query(uint32_t frame_index) {
+    return frame_index * PROFILER_MAX_GPU_SCOPES * 2;
+}
+
+// timestamps live on their own clock, so one is written right away and matched against the cpu clock around it
+static void profiler_calibrate(vulkan_t *vulkan, profiler_t *profiler, vulkan_queue_t queue) {
+    VkCommandPoolCreateInfo command_pool_create_info = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+        .flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT,
+        .queueFamilyIndex = queue.family_index,
+    };
+    VkCommandPool command_pool = VK_NULL_HANDLE;
+    VkResult result = vulkan->vkCreateCommandPool(vulkan->logical_device, &command_pool_create_info, vulkan->allocation_callbacks,
+                                                  &command_pool);
+    assert(result == VK_SUCCESS);
+
+    VkCommandBufferAllocateInfo command_buffer_allocate_info = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+        .commandPool = command_pool,
+        .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+        .commandBufferCount = 1,
+    };
+    VkCommandBuffer command_buffer = VK_NULL_HANDLE;
+    result = vulkan->vkAllocateCommandBuffers(vulkan->logical_device, &command_buffer_allocate_info, &command_buffer);
+    assert(result == VK_SUCCESS);
+
+    VkFenceCreateInfo fence_create_info = {
+        .sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
+    };
+    VkFence fence = VK_NULL_HANDLE;
+    result = vulkan->vkCreateFence(vulkan->logical_device, &fence_create_info, vulkan->allocation_callbacks, &fence);
+    assert(result == VK_SUCCESS);
+
+    VkCommandBufferBeginInfo command_buffer_begin_info = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+        .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+    };
+    result = vulkan->vkBeginCommandBuffer(command_buffer, &command_buffer_begin_info);
+    assert(result == VK_SUCCESS);
+    vulkan->vkCmdResetQueryPool(command_buffer, profiler->query_pool, 0, 1);
+    vulkan->vkCmdWriteTimestamp(command_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, profiler->query_pool, 0);
+    result = vulkan->vkEndCommandBuffer(command_buffer);
+    assert(result == VK_SUCCESS);
+
+    VkSubmitInfo submit_info = {
+        .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+        .commandBufferCount = 1,
+        .pCommandBuffers = &command_buffer,
+    };
+    uint64_t cpu_before = bench_now_ns();
+    result = vulkan->vkQueueSubmit(queue.queue, 1, &submit_info, fence);
+    assert(result == VK_SUCCESS);
+    result = vulkan->vkWaitForFences(vulkan->logical_device, 1, &fence, VK_TRUE, UINT64_MAX);
+    assert(result == VK_SUCCESS);
+    uint64_t cpu_after = bench_now_ns();
+
+    uint64_t timestamp = 0;
+    result = vulkan->vkGetQueryPoolResults(vulkan->logical_device, profiler->query_pool, 0, 1, sizeof(timestamp), &timestamp,
+                                           sizeof(timestamp), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT);
+    assert(result == VK_SUCCESS);
+
+    // the timestamp landed somewhere between submit and fence, the midpoint is the best guess
+    uint64_t gpu_ns = (uint64_t)((double)(timestamp & profiler->timestamp_mask) * profiler->timestamp_period);
+    profiler->gpu_to_cpu_offset_ns = (int64_t)(cpu_before + (cpu_after - cpu_before) / 2) - (int64_t)gpu_ns;
+
+    vulkan->vkDestroyFence(vulkan->logical_device, fence, vulkan->allocation_callbacks);
+    vulkan->vkDestroyCommandPool(vulkan->logical_device, command_pool, vulkan->allocation_callbacks);
+}
+
+void profiler_create(vulkan_t *vulkan, profiler_t *profiler, uint32_t frames_count, vulkan_queue_type_t queue) {
+    assert(frames_count > 0 && frames_count <= PROFILER_MAX_FRAMES);
+    *profiler = (profiler_t){
+        .frames_count = frames_count,
+        .timestamp_period = vulkan->device_properties.limits.timestampPeriod,
+        .events_capacity = 1024,
+    };
+    profiler->events = (profiler_event_t *)malloc(sizeof(profiler_event_t) * profiler->events_capacity);
+
+    uint32_t valid_bits = vulkan->queue_families[vulkan->queues[queue].family_index].timestampValidBits;
+    profiler->timestamp_mask = valid_bits >= 64 ? ~0ull : (1ull << valid_bits) - 1;
+    profiler->timestamps_supported = valid_bits > 0 && profiler->timestamp_period > 0.0;
+    if (!profiler->timestamps_supported)
+        return;
+
+    VkQueryPoolCreateInfo query_pool_create_info = {
+        .sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+        .queryType = VK_QUERY_TYPE_TIMESTAMP,
+        .queryCount = frames_count * PROFILER_MAX_GPU_SCOPES * 2,
+    };
+    VkResult result = vulkan->vkCreateQueryPool(vulkan->logical_device, &query_pool_create_info, vulkan->allocation_callbacks,
+                                                &profiler->query_pool);
+    assert(result == VK_SUCCESS && profiler->query_pool != VK_NULL_HANDLE);
+
+    profiler_calibrate(vulkan, profiler, vulkan->queues[queue]);
+}
+
+static profiler_event_t *profiler_push_event(profiler_t *profiler) {
+    if (profiler->events_count == profiler->events_capacity) {
+        if (profiler->events_capacity == PROFILER_MAX_EVENTS) {
+            profiler->dropped_count++;
+            return NULL;
+        }
+        profiler->events_capacity *= 2;
+        profiler->events =
+            (profiler_event_t *)realloc(profiler->events, sizeof(profiler_event_t) * profiler->events_capacity);
+    }
+    return &profiler->events[profiler->events_count++];
+}
+
+static void profiler_collect(vulkan_t *vulkan, profiler_t *profiler, uint32_t frame_index, VkQueryResultFlags flags) {
+    profiler_frame_t *frame = &profiler->frames[frame_index];
+    frame->pending = false;
+    if (frame->scopes_count == 0)
+        return;
+
+    uint64_t timestamps[PROFILER_MAX_GPU_SCOPES * 2];
+    VkResult result = vulkan->vkGetQueryPoolResults(
+        vulkan->logical_device, profiler->query_pool, profiler_first_query(frame_index), frame->scopes_count * 2,
+        sizeof(timestamps), timestamps, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT | flags);
+    // never wait for the gpu here, a frame that is somehow still running is simply left out of the trace
+    if (result == VK_NOT_READY) {
+        profiler->dropped_count += frame->scopes_count;
+        return;
+    }
+    assert(result == VK_SUCCESS);
+
+    for (uint32_t i = 0; i < frame->scopes_count; i++) {
+        uint64_t begin = timestamps[frame->scopes[i].query] & profiler->timestamp_mask;
+        uint64_t end = timestamps[frame->scopes[i].query + 1] & profiler->timestamp_mask;
+        profiler_event_t *event = profiler_push_event(profiler);
+        if (event == NULL)
+            return;
+
+        *event = (profiler_event_t){
+            .name = frame->scopes[i].name,
+            .track = PROFILER_TRACK_GPU,
+            .start_ns = (uint64_t)((int64_t)((double)begin * profiler->timestamp_period) + profiler->gpu_to_cpu_offset_ns),
+            .duration_ns = (uint64_t)((double)((end - begin) & profiler->timestamp_mask) * profiler->timestamp_period),
+        };
+    }
+}
+
+// frame_index is the frame-in-flight slot whose fence the caller has just waited on
+void profiler_begin_frame(vulkan_t *vulkan, profiler_t *profiler, uint32_t frame_index, VkCommandBuffer command_buffer) {
+    if (profiler == NULL)
+        return;
+    assert(frame_index < profiler->frames_count);
+    profiler->frame_index = frame_index;
+
+    profiler_frame_t *frame = &profiler->frames[frame_index];
+    if (frame->pending)
+        profiler_collect(vulkan, profiler, frame_index, 0);
+    frame->scopes_count = 0;
+    frame->depth = 0;
+
+    if (profiler->timestamps_supported)
+        vulkan->vkCmdResetQueryPool(command_buffer, profiler->query_pool, profiler_first_query(frame_index),
+                                    PROFILER_MAX_GPU_SCOPES * 2);
+}
+
+void profiler_end_frame(profiler_t *profiler) {
+    if (profiler == NULL)
+        return;
+
+    profiler_frame_t *frame = &profiler->frames[profiler->frame_index];
+    assert(frame->depth == 0);
+    frame->pending = profiler->timestamps_supported && frame->scopes_count > 0;
+}
+
+void profiler_gpu_begin(vulkan_t *vulkan, profiler_t *profiler, VkCommandBuffer command_buffer, const char *name) {
+    if (profiler == NULL)
+        return;
+
+    if (vulkan->vkCmdBeginDebugUtilsLabelEXT) {
+        VkDebugUtilsLabelEXT label = {
+            .sType = VK_STRUCTURE_TYPE_DEBUG_UTILS_LABEL_EXT,
+            .pLabelName = name,
+        };
+        vulkan->vkCmdBeginDebugUtilsLabelEXT(command_buffer, &label);
+    }
+
+    profiler_frame_t *frame = &profiler->frames[profiler->frame_index];
+    assert(frame->scopes_count < PROFILER_MAX_GPU_SCOPES && frame->depth < PROFILER_MAX_DEPTH);
+    uint32_t scope = frame->scopes_count++;
+    frame->scopes[scope] = (profiler_gpu_scope_t){.name = name, .query = scope * 2};
+    frame->stack[frame->depth++] = scope;
+
+    if (profiler->timestamps_supported)
+        vulkan->vkCmdWriteTimestamp(command_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, profiler->query_pool,
+                                    profiler_first_query(profiler->frame_index) + scope * 2);
+}
+
+void profiler_gpu_end(vulkan_t *vulkan, profiler_t *profiler, VkCommandBuffer command_buffer) {
+    if (profiler == NULL)
+        return;
+
+    profiler_frame_t *frame = &profiler->frames[profiler->frame_index];
+    assert(frame->depth > 0);
+    uint32_t scope = frame->stack[--frame->depth];
+
+    if (profiler->timestamps_supported)
+        vulkan->vkCmdWriteTimestamp(command_buffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, profiler->query_pool,
+                                    profiler_first_query(profiler->frame_index) + scope * 2 + 1);
+    if (vulkan->vkCmdEndDebugUtilsLabelEXT)
+        vulkan->vkCmdEndDebugUtilsLabelEXT(command_buffer);
+}
+
+void profiler_cpu_begin(profiler_t *profiler, const char *name) {
+    if (profiler == NULL)
+        return;
+    assert(profiler->cpu_depth < PROFILER_MAX_DEPTH);
+
+    profiler_event_t *event = profiler_push_event(profiler);
+    if (event)
+        *event = (profiler_event_t){.name = name, .track = PROFILER_TRACK_CPU, .start_ns = bench_now_ns()};
+    profiler->cpu_stack[profiler->cpu_depth++] = event ? (uint32_t)(event - profiler->events) : UINT32_MAX;
+}
+
+void profiler_cpu_end(profiler_t *profiler) {
+    if (profiler == NULL)
+        return;
+    assert(profiler->cpu_depth > 0);
+
+    uint32_t event = profiler->cpu_stack[--profiler->cpu_depth];
+    if (event != UINT32_MAX)
+        profiler->events[event].duration_ns = bench_now_ns() - profiler->events[event].start_ns;
+}
+
+static void profiler_write_string(FILE *file, const char *string) {
+    fputc('"', file);
+    for (const char *c = string; *c; c++) {
+        if (*c == '"' || *c == '\\')
+            fputc('\\', file);
+        if ((unsigned char)*c >= 0x20)
+            fputc(*c, file);
+    }
+    fputc('"', file);
+}
+
+// chrome trace event format, loads in chrome://tracing and ui.perfetto.dev
+bool profiler_write_trace(profiler_t *profiler, const char *path) {
+    FILE *file = fopen(path, "w");
+    if (file == NULL)
+        return false;
+
+    uint64_t origin = UINT64_MAX;
+    for (uint32_t i = 0; i < profiler->events_count; i++)
+        if (profiler->events[i].start_ns < origin)
+            origin = profiler->events[i].start_ns;
+
+    fprintf(file, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+    fprintf(file, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"vulkookbook\"}},\n");
+    fprintf(file, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"cpu\"}},\n",
+            PROFILER_TRACK_CPU + 1);
+    fprintf(file, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"gpu\"}}",
+            PROFILER_TRACK_GPU + 1);
+
+    for (uint32_t i = 0; i < profiler->events_count; i++) {
+        profiler_event_t *event = &profiler->events[i];
+        fprintf(file, ",\n{\"name\":");
+        profiler_write_string(file, event->name);
+        fprintf(file, ",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}", event->track + 1,
+                (double)(event->start_ns - origin) / 1000.0, (double)event->duration_ns / 1000.0);
+    }
+    fprintf(file, "\n]}\n");
+
+    bool written = !ferror(file);
+    return fclose(file) == 0 && written;
+}
+
+// reads back every frame still in flight, blocking, so only for the end of a capture
+void profiler_flush(vulkan_t *vulkan, profiler_t *profiler) {
+    for (uint32_t i = 0; i < profiler->frames_count; i++)
+        if (profiler->frames[i].pending)
+            profiler_collect(vulkan, profiler, i, VK_QUERY_RESULT_WAIT_BIT);
+}
+
+void profiler_free_resources(vulkan_t *vulkan, profiler_t *profiler) {
+    profiler_flush(vulkan, profiler);
+    if (profiler->dropped_count > 0)
+        fprintf(stderr, "profiler dropped %u scopes\n", profiler->dropped_count);
+    if (profiler->query_pool != VK_NULL_HANDLE)
+        vulkan->vkDestroyQueryPool(vulkan->logical_device, profiler->query_pool, vulkan->allocation_callbacks);
+    free(profiler->events);
+}
@@ -0,0 +1,71 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include "vulkan.h"
+#include <stdbool.h>
+
+#define PROFILER_MAX_FRAMES 8
+#define PROFILER_MAX_GPU_SCOPES 256
+#define PROFILER_MAX_DEPTH 32
+#define PROFILER_MAX_EVENTS (1u << 20)
+
+typedef enum {
+    PROFILER_TRACK_CPU,
+    PROFILER_TRACK_GPU,
+} profiler_track_t;
+
+// names are kept by pointer, so they have to outlive the profiler (string literals in practice)
+typedef struct {
+    const char *name;
+    profiler_track_t track;
+    uint64_t start_ns;
+    uint64_t duration_ns;
+} profiler_event_t;
+
+typedef struct {
+    const char *name;
+    uint32_t query;
+} profiler_gpu_scope_t;
+
+// queries of a frame slot are only read back once the slot comes around again, by then its fence has signaled
+typedef struct {
+    bool pending;
+    uint32_t scopes_count;
+    profiler_gpu_scope_t scopes[PROFILER_MAX_GPU_SCOPES];
+    uint32_t depth;
+    uint32_t stack[PROFILER_MAX_DEPTH];
+} profiler_frame_t;
+
+typedef struct {
+    bool timestamps_supported;
+    double timestamp_period;
+    uint64_t timestamp_mask;
+    // added to a gpu timestamp in nanoseconds to place it on the cpu clock
+    int64_t gpu_to_cpu_offset_ns;
+
+    VkQueryPool query_pool;
+    uint32_t frames_count;
+    uint32_t frame_index;
+    profiler_frame_t frames[PROFILER_MAX_FRAMES];
+
+    uint32_t cpu_depth;
+    uint32_t cpu_stack[PROFILER_MAX_DEPTH];
+
+    uint32_t events_count;
+    uint32_t events_capacity;
+    profiler_event_t *events;
+    uint32_t dropped_count;
+} profiler_t;
+
+void profiler_create(vulkan_t *vulkan, profiler_t *profiler, uint32_t frames_count, vulkan_queue_type_t queue);
+void profiler_begin_frame(vulkan_t *vulkan, profiler_t *profiler, uint32_t frame_index, VkCommandBuffer command_buffer);
+void profiler_end_frame(profiler_t *profiler);
+void profiler_gpu_begin(vulkan_t *vulkan, profiler_t *profiler, VkCommandBuffer command_buffer, const char *name);
+void profiler_gpu_end(vulkan_t *vulkan, profiler_t *profiler, VkCommandBuffer command_buffer);
+void profiler_cpu_begin(profiler_t *profiler, const char *name);
+void profiler_cpu_end(profiler_t *profiler);
+void profiler_flush(vulkan_t *vulkan, profiler_t *profiler);
+bool profiler_write_trace(profiler_t *profiler, const char *path);
+void profiler_free_resources(vulkan_t *vulkan, profiler_t *profiler);
+
+#endif // PROFILER_H
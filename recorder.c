@@ -0,0 +1,304 @@
+#include "recorder.h"
+#include "bench.h"
+#include "shader.h"
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+
+#define RECORDER_BENCHMARK_FRAMES 32
+#define RECORDER_BENCHMARK_DRAWS_PER_BATCH 8
+
+void recorder_create(vulkan_t *vulkan, recorder_t *recorder, uint32_t workers_count, uint32_t frames_count,
+                     uint32_t queue_family_index) {
+    *recorder = (recorder_t){
+        .workers_count = workers_count,
+        .frames_count = frames_count,
+    };
+
+    uint32_t pools_count = workers_count * frames_count;
+    recorder->pools = (recorder_pool_t *)arena_allocate(&recorder->arena, sizeof(recorder_pool_t) * pools_count);
+    memset(recorder->pools, 0, sizeof(recorder_pool_t) * pools_count);
+    uint32_t chunks_count = workers_count * RECORDER_CHUNKS_PER_WORKER;
+    recorder->chunks = (recorder_chunk_t *)arena_allocate(&recorder->arena, sizeof(recorder_chunk_t) * chunks_count);
+    recorder->chunk_jobs = (job_t *)arena_allocate(&recorder->arena, sizeof(job_t) * chunks_count);
+    recorder->secondaries = (VkCommandBuffer *)arena_allocate(&recorder->arena, sizeof(VkCommandBuffer) * chunks_count);
+
+    for (uint32_t i = 0; i < pools_count; i++) {
+        // transient, since every buffer is rerecorded each frame, and no reset bit, since only whole pools get reset
+        VkCommandPoolCreateInfo command_pool_create_info = {
+            .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+            .flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT,
+            .queueFamilyIndex = queue_family_index,
+        };
+        VkResult result = vulkan->vkCreateCommandPool(vulkan->logical_device, &command_pool_create_info,
+                                                      vulkan->allocation_callbacks, &recorder->pools[i].command_pool);
+        assert(result == VK_SUCCESS && recorder->pools[i].command_pool != VK_NULL_HANDLE);
+    }
+}
+
+void recorder_begin_frame(vulkan_t *vulkan, recorder_t *recorder, uint32_t frame_index) {
+    assert(frame_index < recorder->frames_count);
+    recorder->frame_index = frame_index;
+
+    for (uint32_t i = 0; i < recorder->workers_count; i++) {
+        recorder_pool_t *pool = &recorder->pools[frame_index * recorder->workers_count + i];
+        VkResult result = vulkan->vkResetCommandPool(vulkan->logical_device, pool->command_pool, 0);
+        assert(result == VK_SUCCESS);
+        pool->used_count = 0;
+    }
+}
+
+static VkCommandBuffer recorder_acquire_secondary(vulkan_t *vulkan, recorder_pool_t *pool) {
+    if (pool->used_count == pool->command_buffers_count) {
+        uint32_t grown_count = pool->command_buffers_count ? pool->command_buffers_count * 2 : 4;
+        pool->command_buffers = (VkCommandBuffer *)arena_reallocate(&pool->arena, pool->command_buffers,
+                                                                    sizeof(VkCommandBuffer) * pool->command_buffers_count,
+                                                                    sizeof(VkCommandBuffer) * grown_count);
+
+        VkCommandBufferAllocateInfo command_buffer_allocate_info = {
+            .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+            .commandPool = pool->command_pool,
+            .level = VK_COMMAND_BUFFER_LEVEL_SECONDARY,
+            .commandBufferCount = grown_count - pool->command_buffers_count,
+        };
+        VkResult result = vulkan->vkAllocateCommandBuffers(vulkan->logical_device, &command_buffer_allocate_info,
+                                                           pool->command_buffers + pool->command_buffers_count);
+        assert(result == VK_SUCCESS);
+        pool->command_buffers_count = grown_count;
+    }
+    return pool->command_buffers[pool->used_count++];
+}
+
+static void recorder_record_chunk(uint32_t worker_index, void *data) {
+    recorder_chunk_t *chunk = (recorder_chunk_t *)data;
+    recorder_t *recorder = chunk->recorder;
+    vulkan_t *vulkan = chunk->vulkan;
+
+    recorder_pool_t *pool = &recorder->pools[recorder->frame_index * recorder->workers_count + worker_index];
+    VkCommandBuffer command_buffer = recorder_acquire_secondary(vulkan, pool);
+
+    VkCommandBufferBeginInfo command_buffer_begin_info = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+        .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+        .pInheritanceInfo = chunk->inheritance_info,
+    };
+    if (chunk->inheritance_info->renderPass != VK_NULL_HANDLE)
+        command_buffer_begin_info.flags |= VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+
+    VkResult result = vulkan->vkBeginCommandBuffer(command_buffer, &command_buffer_begin_info);
+    assert(result == VK_SUCCESS);
+    chunk->record(vulkan, command_buffer, chunk->first, chunk->count, chunk->data);
+    result = vulkan->vkEndCommandBuffer(command_buffer);
+    assert(result == VK_SUCCESS);
+
+    // slots are indexed by chunk, not by worker, so execution order never depends on who ran what
+    recorder->secondaries[chunk->index] = command_buffer;
+}
+
+// splits the items into a few chunks per worker, so faster threads can steal the leftovers of slower ones
+void recorder_record(vulkan_t *vulkan, recorder_t *recorder, jobs_t *jobs, VkCommandBuffer primary,
+                     const VkCommandBufferInheritanceInfo *inheritance_info, uint32_t items_count, recorder_record_t record,
+                     void *data) {
+    assert(jobs->workers_count == recorder->workers_count);
+    if (items_count == 0)
+        return;
+
+    uint32_t chunks_count = recorder->workers_count * RECORDER_CHUNKS_PER_WORKER;
+    if (chunks_count > items_count)
+        chunks_count = items_count;
+
+    for (uint32_t i = 0; i < chunks_count; i++) {
+        uint32_t first = (uint32_t)((uint64_t)items_count * i / chunks_count);
+        uint32_t last = (uint32_t)((uint64_t)items_count * (i + 1) / chunks_count);
+        recorder->chunks[i] = (recorder_chunk_t){
+            .vulkan = vulkan,
+            .recorder = recorder,
+            .inheritance_info = inheritance_info,
+            .record = record,
+            .data = data,
+            .first = first,
+            .count = last - first,
+            .index = i,
+        };
+        recorder->chunk_jobs[i] = (job_t){
+            .function = recorder_record_chunk,
+            .data = &recorder->chunks[i],
+        };
+    }
+
+    jobs_run(jobs, chunks_count, recorder->chunk_jobs);
+    vulkan->vkCmdExecuteCommands(primary, chunks_count, recorder->secondaries);
+}
+
+void recorder_free_resources(vulkan_t *vulkan, recorder_t *recorder) {
+    for (uint32_t i = 0; i < recorder->workers_count * recorder->frames_count; i++) {
+        recorder_pool_t *pool = &recorder->pools[i];
+        if (pool->command_buffers_count > 0)
+            vulkan->vkFreeCommandBuffers(vulkan->logical_device, pool->command_pool, pool->command_buffers_count,
+                                         pool->command_buffers);
+        vulkan->vkDestroyCommandPool(vulkan->logical_device, pool->command_pool, vulkan->allocation_callbacks);
+        arena_free(&pool->arena);
+    }
+    arena_free(&recorder->arena);
+}
+
+typedef struct {
+    VkPipeline pipeline;
+    VkPipelineLayout pipeline_layout;
+} recorder_benchmark_scene_t;
+
+// secondaries inherit no state, so every chunk rebinds the pipeline before its batches
+static void recorder_benchmark_record(vulkan_t *vulkan, VkCommandBuffer command_buffer, uint32_t first, uint32_t count,
+                                      void *data) {
+    recorder_benchmark_scene_t *scene = (recorder_benchmark_scene_t *)data;
+    vulkan->vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, scene->pipeline);
+
+    for (uint32_t batch = first; batch < first + count; batch++) {
+        for (uint32_t draw = 0; draw < RECORDER_BENCHMARK_DRAWS_PER_BATCH; draw++) {
+            uint32_t constants[2] = {batch, draw};
+            vulkan->vkCmdPushConstants(command_buffer, scene->pipeline_layout, VK_SHADER_STAGE_COMPUTE_BIT, 0,
+                                       sizeof(constants), constants);
+            vulkan->vkCmdDispatch(command_buffer, 1, 1, 1);
+        }
+    }
+}
+
+void recorder_benchmark(uint32_t iterations) {
+    vulkan_t vulkan = {.headless = true};
+    bench_bootstrap(&vulkan);
+    vulkan_queue_t queue = vulkan.queues[VULKAN_QUEUE_GRAPHICS];
+
+    VkShaderModule shader_module = shader_create_module(&vulkan, "shaders/recorder.spv");
+
+    VkPushConstantRange push_constant_range = {
+        .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+        .offset = 0,
+        .size = 2 * sizeof(uint32_t),
+    };
+    VkPipelineLayoutCreateInfo pipeline_layout_create_info = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+        .pushConstantRangeCount = 1,
+        .pPushConstantRanges = &push_constant_range,
+    };
+    recorder_benchmark_scene_t scene = {0};
+    VkResult result = vulkan.vkCreatePipelineLayout(vulkan.logical_device, &pipeline_layout_create_info,
+                                                    vulkan.allocation_callbacks, &scene.pipeline_layout);
+    assert(result == VK_SUCCESS);
+
+    VkComputePipelineCreateInfo compute_pipeline_create_info = {
+        .sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+        .stage =
+            {
+                .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+                .stage = VK_SHADER_STAGE_COMPUTE_BIT,
+                .module = shader_module,
+                .pName = "main",
+            },
+        .layout = scene.pipeline_layout,
+    };
+    result = vulkan.vkCreateComputePipelines(vulkan.logical_device, vulkan.pipeline_cache, 1, &compute_pipeline_create_info,
+                                             vulkan.allocation_callbacks, &scene.pipeline);
+    assert(result == VK_SUCCESS);
+
+    VkCommandPoolCreateInfo command_pool_create_info = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+        .flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT,
+        .queueFamilyIndex = queue.family_index,
+    };
+    VkCommandPool primary_pool = VK_NULL_HANDLE;
+    result = vulkan.vkCreateCommandPool(vulkan.logical_device, &command_pool_create_info, vulkan.allocation_callbacks,
+                                        &primary_pool);
+    assert(result == VK_SUCCESS);
+
+    VkCommandBufferAllocateInfo command_buffer_allocate_info = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+        .commandPool = primary_pool,
+        .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+        .commandBufferCount = 1,
+    };
+    VkCommandBuffer primary = VK_NULL_HANDLE;
+    result = vulkan.vkAllocateCommandBuffers(vulkan.logical_device, &command_buffer_allocate_info, &primary);
+    assert(result == VK_SUCCESS);
+
+    VkFenceCreateInfo fence_create_info = {
+        .sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
+    };
+    VkFence fence = VK_NULL_HANDLE;
+    result = vulkan.vkCreateFence(vulkan.logical_device, &fence_create_info, vulkan.allocation_callbacks, &fence);
+    assert(result == VK_SUCCESS);
+
+    VkCommandBufferInheritanceInfo inheritance_info = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO,
+    };
+
+    uint32_t max_threads = jobs_hardware_threads();
+    printf("recording: %u batches of %u dispatches, 1..%u threads\n", iterations, RECORDER_BENCHMARK_DRAWS_PER_BATCH,
+           max_threads);
+
+    uint64_t single_thread_median = 0;
+    for (uint32_t threads = 1; threads <= max_threads; threads++) {
+        jobs_t jobs;
+        jobs_create(&jobs, threads);
+        recorder_t recorder;
+        recorder_create(&vulkan, &recorder, threads, 1, queue.family_index);
+
+        char name[64];
+        snprintf(name, sizeof(name), "record frame, %u threads", threads);
+        bench_samples_t samples;
+        bench_samples_create(&samples, name, RECORDER_BENCHMARK_FRAMES);
+
+        for (uint32_t frame = 0; frame < RECORDER_BENCHMARK_FRAMES; frame++) {
+            uint64_t start = bench_now_ns();
+            recorder_begin_frame(&vulkan, &recorder, 0);
+            result = vulkan.vkResetCommandPool(vulkan.logical_device, primary_pool, 0);
+            assert(result == VK_SUCCESS);
+
+            VkCommandBufferBeginInfo command_buffer_begin_info = {
+                .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+                .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+            };
+            result = vulkan.vkBeginCommandBuffer(primary, &command_buffer_begin_info);
+            assert(result == VK_SUCCESS);
+            recorder_record(&vulkan, &recorder, &jobs, primary, &inheritance_info, iterations, recorder_benchmark_record,
+                            &scene);
+            result = vulkan.vkEndCommandBuffer(primary);
+            assert(result == VK_SUCCESS);
+            bench_samples_push(&samples, bench_now_ns() - start);
+
+            // recording is what is being measured, so only the last frame is actually executed
+            if (frame + 1 < RECORDER_BENCHMARK_FRAMES)
+                continue;
+
+            VkSubmitInfo submit_info = {
+                .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+                .commandBufferCount = 1,
+                .pCommandBuffers = &primary,
+            };
+            result = vulkan.vkQueueSubmit(queue.queue, 1, &submit_info, fence);
+            assert(result == VK_SUCCESS);
+            result = vulkan.vkWaitForFences(vulkan.logical_device, 1, &fence, VK_TRUE, UINT64_MAX);
+            assert(result == VK_SUCCESS);
+            result = vulkan.vkResetFences(vulkan.logical_device, 1, &fence);
+            assert(result == VK_SUCCESS);
+        }
+
+        uint64_t median = bench_samples_percentile(&samples, 0.5);
+        if (threads == 1)
+            single_thread_median = median;
+        bench_samples_report(&samples);
+        printf("%-48s %.2fx\n", "  speedup over 1 thread", (double)single_thread_median / (double)median);
+        if (threads == max_threads)
+            jobs_report(&jobs);
+
+        bench_samples_free(&samples);
+        recorder_free_resources(&vulkan, &recorder);
+        jobs_free_resources(&jobs);
+    }
+
+    vulkan.vkDestroyFence(vulkan.logical_device, fence, vulkan.allocation_callbacks);
+    vulkan.vkDestroyCommandPool(vulkan.logical_device, primary_pool, vulkan.allocation_callbacks);
+    vulkan.vkDestroyPipeline(vulkan.logical_device, scene.pipeline, vulkan.allocation_callbacks);
+    vulkan.vkDestroyPipelineLayout(vulkan.logical_device, scene.pipeline_layout, vulkan.allocation_callbacks);
+    vulkan.vkDestroyShaderModule(vulkan.logical_device, shader_module, vulkan.allocation_callbacks);
+    vulkan_free_resources(&vulkan);
+}
@@ -0,0 +1,57 @@
+#ifndef RECORDER_H
+#define RECORDER_H
+
+#include "jobs.h"
+#include "vulkan.h"
+
+#define RECORDER_CHUNKS_PER_WORKER 4
+
+typedef void (*recorder_record_t)(vulkan_t *vulkan, VkCommandBuffer command_buffer, uint32_t first, uint32_t count,
+                                  void *data);
+
+// secondaries handed out this frame, recycled wholesale when the pool is reset; the array grows in the pool's own arena,
+// since only the worker recording into the pool touches it
+typedef struct {
+    arena_t arena;
+    VkCommandPool command_pool;
+    uint32_t command_buffers_count;
+    uint32_t used_count;
+    VkCommandBuffer *command_buffers;
+} recorder_pool_t;
+
+typedef struct {
+    vulkan_t *vulkan;
+    struct recorder_s *recorder;
+    const VkCommandBufferInheritanceInfo *inheritance_info;
+    recorder_record_t record;
+    void *data;
+    uint32_t first;
+    uint32_t count;
+    uint32_t index;
+} recorder_chunk_t;
+
+typedef struct recorder_s {
+    arena_t arena;
+    uint32_t workers_count;
+    uint32_t frames_count;
+    uint32_t frame_index;
+    // one pool per worker per frame, so no two threads ever touch the same pool
+    recorder_pool_t *pools;
+
+    // sized for the most chunks a recording can be split into
+    recorder_chunk_t *chunks;
+    job_t *chunk_jobs;
+    VkCommandBuffer *secondaries;
+} recorder_t;
+
+void recorder_create(vulkan_t *vulkan, recorder_t *recorder, uint32_t workers_count, uint32_t frames_count,
+                     uint32_t queue_family_index);
+void recorder_begin_frame(vulkan_t *vulkan, recorder_t *recorder, uint32_t frame_index);
+void recorder_record(vulkan_t *vulkan, recorder_t *recorder, jobs_t *jobs, VkCommandBuffer primary,
+                     const VkCommandBufferInheritanceInfo *inheritance_info, uint32_t items_count, recorder_record_t record,
+                     void *data);
+void recorder_free_resources(vulkan_t *vulkan, recorder_t *recorder);
+
+void recorder_benchmark(uint32_t iterations);
+
+#endif // RECORDER_H
@@ -0,0 +1,193 @@
+#include "runtime.h"
+#include "sdl.h"
+#include <SDL3/SDL_timer.h>
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+
+// indices run free and wrap, so the ring is full once they are a whole capacity apart
+bool runtime_queue_push(runtime_queue_t *queue, const runtime_event_t *event) {
+    uint32_t tail = atomic_load_explicit(&queue->tail, memory_order_relaxed);
+    if (tail - queue->cached_head == RUNTIME_QUEUE_CAPACITY) {
+        queue->cached_head = atomic_load_explicit(&queue->head, memory_order_acquire);
+        if (tail - queue->cached_head == RUNTIME_QUEUE_CAPACITY)
+            return false;
+    }
+
+    queue->events[tail & (RUNTIME_QUEUE_CAPACITY - 1)] = *event;
+    atomic_store_explicit(&queue->tail, tail + 1, memory_order_release);
+    return true;
+}
+
+bool runtime_queue_pop(runtime_queue_t *queue, runtime_event_t *event) {
+    uint32_t head = atomic_load_explicit(&queue->head, memory_order_relaxed);
+    if (head == queue->cached_tail) {
+        queue->cached_tail = atomic_load_explicit(&queue->tail, memory_order_acquire);
+        if (head == queue->cached_tail)
+            return false;
+    }
+
+    *event = queue->events[head & (RUNTIME_QUEUE_CAPACITY - 1)];
+    atomic_store_explicit(&queue->head, head + 1, memory_order_release);
+    return true;
+}
+
+// only meaningful on the consumer side, where head cannot move underneath it
+static bool runtime_queue_empty(runtime_queue_t *queue) {
+    uint32_t head = atomic_load_explicit(&queue->head, memory_order_relaxed);
+    return head == atomic_load_explicit(&queue->tail, memory_order_acquire);
+}
+
+void runtime_create(runtime_t *runtime, uint32_t width, uint32_t height) {
+    static_assert((RUNTIME_QUEUE_CAPACITY & (RUNTIME_QUEUE_CAPACITY - 1)) == 0, "queue capacity must be a power of two");
+
+    memset(runtime, 0, sizeof(*runtime));
+    atomic_init(&runtime->queue.head, 0);
+    atomic_init(&runtime->queue.tail, 0);
+    atomic_init(&runtime->rendering, false);
+    atomic_init(&runtime->dropped_inputs, 0);
+    runtime->width = width;
+    runtime->height = height;
+    pthread_mutex_init(&runtime->wake_mutex, NULL);
+    pthread_cond_init(&runtime->wake, NULL);
+    bench_samples_create(&runtime->input_to_present, "input to present", RUNTIME_LATENCY_WINDOW);
+}
+
+static void *runtime_render_main(void *data) {
+    runtime_t *runtime = (runtime_t *)data;
+    runtime->render(runtime->render_data);
+    atomic_store_explicit(&runtime->rendering, false, memory_order_release);
+    return NULL;
+}
+
+// quit and resize must reach the render thread, so they wait for room, while input is dropped when the ring is full
+static void runtime_send(runtime_t *runtime, const runtime_event_t *event) {
+    while (!runtime_queue_push(&runtime->queue, event)) {
+        if (event->type == RUNTIME_EVENT_INPUT) {
+            atomic_fetch_add_explicit(&runtime->dropped_inputs, 1, memory_order_relaxed);
+            return;
+        }
+        if (!atomic_load_explicit(&runtime->rendering, memory_order_acquire))
+            return;
+        SDL_Delay(1);
+    }
+
+    // taking the lock after the push means a render thread that found the queue empty is already waiting
+    if (event->type != RUNTIME_EVENT_INPUT) {
+        pthread_mutex_lock(&runtime->wake_mutex);
+        pthread_cond_signal(&runtime->wake);
+        pthread_mutex_unlock(&runtime->wake_mutex);
+    }
+}
+
+// sdl wants its events pumped on the thread that made the window, so that one stays here and rendering moves out
+void runtime_run(runtime_t *runtime, runtime_render_t render, void *data) {
+    runtime->render = render;
+    runtime->render_data = data;
+    atomic_store_explicit(&runtime->rendering, true, memory_order_release);
+    int error = pthread_create(&runtime->render_thread, NULL, runtime_render_main, runtime);
+    assert(error == 0);
+
+    bool quit = false;
+    while (!quit && atomic_load_explicit(&runtime->rendering, memory_order_acquire)) {
+        SDL_Event event;
+        if (!SDL_WaitEventTimeout(&event, 10))
+            continue;
+
+        // sdl stamps events with SDL_GetTicksNS, which only differs from bench_now_ns by a constant
+        uint64_t clock_offset = bench_now_ns() - SDL_GetTicksNS();
+        do {
+            runtime_event_t runtime_event = {.arrival_ns = event.common.timestamp + clock_offset};
+            switch (event.type) {
+            case SDL_EVENT_QUIT:
+                runtime_event.type = RUNTIME_EVENT_QUIT;
+                quit = true;
+                break;
+            case SDL_EVENT_WINDOW_PIXEL_SIZE_CHANGED:
+                runtime_event.type = RUNTIME_EVENT_RESIZE;
+                runtime_event.width = (uint32_t)event.window.data1;
+                runtime_event.height = (uint32_t)event.window.data2;
+                break;
+            case SDL_EVENT_KEY_DOWN:
+            case SDL_EVENT_KEY_UP:
+            case SDL_EVENT_MOUSE_MOTION:
+            case SDL_EVENT_MOUSE_BUTTON_DOWN:
+            case SDL_EVENT_MOUSE_BUTTON_UP:
+            case SDL_EVENT_MOUSE_WHEEL:
+                runtime_event.type = RUNTIME_EVENT_INPUT;
+                break;
+            default:
+                continue;
+            }
+            runtime_send(runtime, &runtime_event);
+        } while (!quit && SDL_PollEvent(&event));
+    }
+
+    pthread_join(runtime->render_thread, NULL);
+}
+
+// called by the render thread before building a frame, false once the window has been closed
+bool runtime_poll(runtime_t *runtime) {
+    runtime_event_t event;
+    while (runtime_queue_pop(&runtime->queue, &event)) {
+        switch (event.type) {
+        case RUNTIME_EVENT_QUIT:
+            return false;
+        case RUNTIME_EVENT_RESIZE:
+            runtime->resized = true;
+            runtime->width = event.width;
+            runtime->height = event.height;
+            break;
+        case RUNTIME_EVENT_INPUT:
+            // past the cap the latest inputs go untimed, the oldest ones are the slow ones
+            if (runtime->pending_inputs_count < RUNTIME_MAX_PENDING_INPUTS)
+                runtime->pending_inputs[runtime->pending_inputs_count++] = event.arrival_ns;
+            break;
+        }
+    }
+    return true;
+}
+
+// blocks a render thread whose window is minimized until it has a size to render at again, false once it has been closed
+bool runtime_wait_for_size(runtime_t *runtime) {
+    for (;;) {
+        if (!runtime_poll(runtime))
+            return false;
+        if (runtime->width > 0 && runtime->height > 0)
+            return true;
+
+        pthread_mutex_lock(&runtime->wake_mutex);
+        while (runtime_queue_empty(&runtime->queue))
+            pthread_cond_wait(&runtime->wake, &runtime->wake_mutex);
+        pthread_mutex_unlock(&runtime->wake_mutex);
+    }
+}
+
+// called right after vkQueuePresentKHR of a frame that went through runtime_poll
+void runtime_presented(runtime_t *runtime) {
+    uint64_t presented_ns = bench_now_ns();
+    for (uint32_t i = 0; i < runtime->pending_inputs_count; i++) {
+        uint64_t arrival_ns = runtime->pending_inputs[i];
+        bench_samples_push(&runtime->input_to_present, presented_ns > arrival_ns ? presented_ns - arrival_ns : 0);
+        runtime->presented_inputs++;
+        if (runtime->input_to_present.count == RUNTIME_LATENCY_WINDOW)
+            runtime_report(runtime);
+    }
+    runtime->pending_inputs_count = 0;
+}
+
+void runtime_report(runtime_t *runtime) {
+    if (runtime->input_to_present.count == 0)
+        return;
+
+    printf("runtime: %llu inputs presented, %u dropped\n", (unsigned long long)runtime->presented_inputs,
+           atomic_load_explicit(&runtime->dropped_inputs, memory_order_relaxed));
+    bench_samples_report(&runtime->input_to_present);
+    runtime->input_to_present.count = 0;
+}
+
+void runtime_free_resources(runtime_t *runtime) {
+    pthread_cond_destroy(&runtime->wake);
+    pthread_mutex_destroy(&runtime->wake_mutex);
+    bench_samples_free(&runtime->input_to_present);
+}
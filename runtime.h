@@ -0,0 +1,72 @@
+#ifndef RUNTIME_H
+#define RUNTIME_H
+
+#include "bench.h"
+#include <pthread.h>
+#include <stdalign.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+
+#define RUNTIME_QUEUE_CAPACITY 1024
+#define RUNTIME_MAX_PENDING_INPUTS 256
+#define RUNTIME_LATENCY_WINDOW 1000
+#define RUNTIME_CACHE_LINE 64
+
+typedef enum {
+    RUNTIME_EVENT_QUIT,
+    RUNTIME_EVENT_RESIZE,
+    RUNTIME_EVENT_INPUT,
+} runtime_event_type_t;
+
+// arrival is the os timestamp of the input, moved onto the bench_now_ns clock
+typedef struct {
+    runtime_event_type_t type;
+    uint32_t width;
+    uint32_t height;
+    uint64_t arrival_ns;
+} runtime_event_t;
+
+// single producer (the sdl thread), single consumer (the render thread), each index on a cache line of its own
+typedef struct {
+    alignas(RUNTIME_CACHE_LINE) atomic_uint head;
+    uint32_t cached_tail;
+    alignas(RUNTIME_CACHE_LINE) atomic_uint tail;
+    uint32_t cached_head;
+    alignas(RUNTIME_CACHE_LINE) runtime_event_t events[RUNTIME_QUEUE_CAPACITY];
+} runtime_queue_t;
+
+typedef void (*runtime_render_t)(void *data);
+
+typedef struct {
+    runtime_queue_t queue;
+    pthread_t render_thread;
+    runtime_render_t render;
+    void *render_data;
+    atomic_bool rendering;
+    atomic_uint dropped_inputs;
+    // quit and resize also wake a render thread that has nothing to draw into
+    pthread_mutex_t wake_mutex;
+    pthread_cond_t wake;
+
+    // render thread side, the inputs the next presented frame will have taken in and the size to build it at
+    bool resized;
+    uint32_t width;
+    uint32_t height;
+    uint32_t pending_inputs_count;
+    uint64_t pending_inputs[RUNTIME_MAX_PENDING_INPUTS];
+    uint64_t presented_inputs;
+    bench_samples_t input_to_present;
+} runtime_t;
+
+bool runtime_queue_push(runtime_queue_t *queue, const runtime_event_t *event);
+bool runtime_queue_pop(runtime_queue_t *queue, runtime_event_t *event);
+
+void runtime_create(runtime_t *runtime, uint32_t width, uint32_t height);
+void runtime_run(runtime_t *runtime, runtime_render_t render, void *data);
+bool runtime_poll(runtime_t *runtime);
+bool runtime_wait_for_size(runtime_t *runtime);
+void runtime_presented(runtime_t *runtime);
+void runtime_report(runtime_t *runtime);
+void runtime_free_resources(runtime_t *runtime);
+
+#endif // RUNTIME_H
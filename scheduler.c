@@ -0,0 +1,556 @@
+#include "scheduler.h"
+#include "allocator.h"
+#include "bench.h"
+#include "compute.h"
+#include "swapchain.h"
+#include "upload.h"
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define SCHEDULER_BENCHMARK_ELEMENTS (1u << 20)
+#define SCHEDULER_BENCHMARK_SLOTS 2
+#define SCHEDULER_BENCHMARK_WORKGROUP_SIZE 256
+#define SCHEDULER_BENCHMARK_RING_SIZE (32ull * 1024 * 1024)
+
+void scheduler_create(vulkan_t *vulkan, scheduler_t *scheduler) {
+    *scheduler = (scheduler_t){0};
+    // VK_KHR_timeline_semaphore is optional on a 1.0 device, fences and binary semaphores stand in for it there
+    scheduler->timeline = vulkan->vkWaitSemaphoresKHR && vulkan->vkGetSemaphoreCounterValueKHR;
+
+    for (uint32_t i = 0; i < VULKAN_QUEUE_TYPE_COUNT; i++) {
+        uint32_t lane = 0;
+        while (lane < scheduler->lanes_count && scheduler->lanes[lane].queue != vulkan->queues[i].queue)
+            lane++;
+        scheduler->lane_of[i] = lane;
+        if (lane < scheduler->lanes_count)
+            continue;
+
+        scheduler_lane_t *new_lane = &scheduler->lanes[scheduler->lanes_count++];
+        new_lane->queue = vulkan->queues[i].queue;
+        new_lane->next_value = 1;
+        if (!scheduler->timeline)
+            continue;
+
+        VkSemaphoreTypeCreateInfoKHR semaphore_type_create_info = {
+            .sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO_KHR,
+            .semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE_KHR,
+            .initialValue = 0,
+        };
+        VkSemaphoreCreateInfo semaphore_create_info = {
+            .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+            .pNext = &semaphore_type_create_info,
+        };
+        VkResult result = vulkan->vkCreateSemaphore(vulkan->logical_device, &semaphore_create_info, vulkan->allocation_callbacks,
+                                                    &new_lane->timeline);
+        assert(result == VK_SUCCESS && new_lane->timeline != VK_NULL_HANDLE);
+    }
+}
+
+// fences signal in submission order per queue, so the completed value only ever moves forward
+static void scheduler_retire_lane(vulkan_t *vulkan, scheduler_lane_t *lane) {
+    while (lane->fences_retired < lane->fences_submitted) {
+        scheduler_fence_t *entry = &lane->fences[lane->fences_retired % SCHEDULER_MAX_FENCES];
+        if (vulkan->vkGetFenceStatus(vulkan->logical_device, entry->fence) != VK_SUCCESS)
+            break;
+        lane->completed_value = entry->value;
+        lane->fences_retired++;
+    }
+}
+
+static VkFence scheduler_next_fence(vulkan_t *vulkan, scheduler_lane_t *lane, uint64_t value) {
+    if (lane->fences_submitted - lane->fences_retired == SCHEDULER_MAX_FENCES) {
+        scheduler_fence_t *oldest = &lane->fences[lane->fences_retired % SCHEDULER_MAX_FENCES];
+        VkResult result = vulkan->vkWaitForFences(vulkan->logical_device, 1, &oldest->fence, VK_TRUE, UINT64_MAX);
+        assert(result == VK_SUCCESS);
+        scheduler_retire_lane(vulkan, lane);
+    }
+
+    scheduler_fence_t *entry = &lane->fences[lane->fences_submitted % SCHEDULER_MAX_FENCES];
+    if (entry->fence == VK_NULL_HANDLE) {
+        VkFenceCreateInfo fence_create_info = {.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO};
+        VkResult result =
+            vulkan->vkCreateFence(vulkan->logical_device, &fence_create_info, vulkan->allocation_callbacks, &entry->fence);
+        assert(result == VK_SUCCESS);
+    } else {
+        VkResult result = vulkan->vkResetFences(vulkan->logical_device, 1, &entry->fence);
+        assert(result == VK_SUCCESS);
+    }
+    entry->value = value;
+    lane->fences_submitted++;
+    return entry->fence;
+}
+
+static void scheduler_flush_lane(vulkan_t *vulkan, scheduler_t *scheduler, scheduler_lane_t *lane) {
+    if (lane->batches_count == 0)
+        return;
+
+    VkSubmitInfo submit_infos[SCHEDULER_MAX_BATCHES];
+    for (uint32_t i = 0; i < lane->batches_count; i++) {
+        scheduler_batch_t *batch = &lane->batches[i];
+        submit_infos[i] = (VkSubmitInfo){
+            .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+            .waitSemaphoreCount = batch->waits_count,
+            .pWaitSemaphores = batch->wait_semaphores,
+            .pWaitDstStageMask = batch->wait_stages,
+            .commandBufferCount = batch->command_buffers_count,
+            .pCommandBuffers = lane->command_buffers + batch->command_buffers_offset,
+            .signalSemaphoreCount = batch->signals_count,
+            .pSignalSemaphores = batch->signal_semaphores,
+        };
+        if (!scheduler->timeline)
+            continue;
+
+        // binary semaphores among the timelines ignore their values
+        batch->timeline_submit_info = (VkTimelineSemaphoreSubmitInfoKHR){
+            .sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO_KHR,
+            .waitSemaphoreValueCount = batch->waits_count,
+            .pWaitSemaphoreValues = batch->wait_values,
+            .signalSemaphoreValueCount = batch->signals_count,
+            .pSignalSemaphoreValues = batch->signal_values,
+        };
+        submit_infos[i].pNext = &batch->timeline_submit_info;
+    }
+
+    VkFence fence = VK_NULL_HANDLE;
+    if (!scheduler->timeline)
+        fence = scheduler_next_fence(vulkan, lane, lane->batches[lane->batches_count - 1].signal_value);
+    VkResult result = vulkan->vkQueueSubmit(lane->queue, lane->batches_count, submit_infos, fence);
+    assert(result == VK_SUCCESS);
+
+    scheduler->queue_submits_count++;
+    lane->batches_count = 0;
+    lane->command_buffers_count = 0;
+}
+
+static uint64_t scheduler_lane_completed(vulkan_t *vulkan, scheduler_t *scheduler, scheduler_lane_t *lane) {
+    if (!scheduler->timeline) {
+        scheduler_retire_lane(vulkan, lane);
+        return lane->completed_value;
+    }
+
+    uint64_t value = 0;
+    VkResult result = vulkan->vkGetSemaphoreCounterValueKHR(vulkan->logical_device, lane->timeline, &value);
+    assert(result == VK_SUCCESS);
+    return value;
+}
+
+static VkResult scheduler_wait_lane(vulkan_t *vulkan, scheduler_t *scheduler, scheduler_lane_t *lane, uint64_t value,
+                                    uint64_t timeout) {
+    if (scheduler->timeline) {
+        VkSemaphoreWaitInfoKHR semaphore_wait_info = {
+            .sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO_KHR,
+            .semaphoreCount = 1,
+            .pSemaphores = &lane->timeline,
+            .pValues = &value,
+        };
+        return vulkan->vkWaitSemaphoresKHR(vulkan->logical_device, &semaphore_wait_info, timeout);
+    }
+
+    // a fence only exists once its submission was made, so a value still sitting in a batch goes out first
+    assert(value < lane->next_value);
+    if (value > lane->next_value - 1 - lane->batches_count)
+        scheduler_flush_lane(vulkan, scheduler, lane);
+    if (scheduler_lane_completed(vulkan, scheduler, lane) >= value)
+        return VK_SUCCESS;
+
+    uint32_t i = lane->fences_retired;
+    while (lane->fences[i % SCHEDULER_MAX_FENCES].value < value)
+        i++;
+    VkResult result =
+        vulkan->vkWaitForFences(vulkan->logical_device, 1, &lane->fences[i % SCHEDULER_MAX_FENCES].fence, VK_TRUE, timeout);
+    scheduler_retire_lane(vulkan, lane);
+    return result;
+}
+
+// binary semaphores go back to the pool once the lane that waited on them is past that wait
+static VkSemaphore scheduler_take_semaphore(vulkan_t *vulkan, scheduler_t *scheduler) {
+    for (;;) {
+        uint32_t waiting_count = 0;
+        for (uint32_t i = 0; i < scheduler->waiting_semaphores_count; i++) {
+            scheduler_semaphore_t *waiting = &scheduler->waiting_semaphores[i];
+            if (scheduler_lane_completed(vulkan, scheduler, &scheduler->lanes[waiting->lane]) >= waiting->value)
+                scheduler->free_semaphores[scheduler->free_semaphores_count++] = waiting->semaphore;
+            else
+                scheduler->waiting_semaphores[waiting_count++] = *waiting;
+        }
+        scheduler->waiting_semaphores_count = waiting_count;
+
+        if (scheduler->free_semaphores_count > 0)
+            return scheduler->free_semaphores[--scheduler->free_semaphores_count];
+
+        if (scheduler->semaphores_count < SCHEDULER_MAX_SEMAPHORES) {
+            VkSemaphoreCreateInfo semaphore_create_info = {.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO};
+            VkSemaphore semaphore = VK_NULL_HANDLE;
+            VkResult result = vulkan->vkCreateSemaphore(vulkan->logical_device, &semaphore_create_info,
+                                                        vulkan->allocation_callbacks, &semaphore);
+            assert(result == VK_SUCCESS);
+            scheduler->semaphores_count++;
+            return semaphore;
+        }
+
+        scheduler_semaphore_t *oldest = &scheduler->waiting_semaphores[0];
+        VkResult result = scheduler_wait_lane(vulkan, scheduler, &scheduler->lanes[oldest->lane], oldest->value, UINT64_MAX);
+        assert(result == VK_SUCCESS);
+    }
+}
+
+// a binary semaphore that is signaled once lane reaches value, or none when it already has; waiter_value on the
+// waiting lane consumes it
+static VkSemaphore scheduler_signal_semaphore(vulkan_t *vulkan, scheduler_t *scheduler, uint32_t lane_index, uint64_t value,
+                                              uint32_t waiter_lane, uint64_t waiter_value) {
+    scheduler_lane_t *lane = &scheduler->lanes[lane_index];
+    if (scheduler_lane_completed(vulkan, scheduler, lane) >= value)
+        return VK_NULL_HANDLE;
+
+    VkSemaphore semaphore = scheduler_take_semaphore(vulkan, scheduler);
+    uint64_t submitted_value = lane->next_value - 1 - lane->batches_count;
+    if (value > submitted_value) {
+        // binary semaphores must be signaled by an earlier submission than their wait, so the lane goes out now
+        scheduler_batch_t *batch = &lane->batches[value - submitted_value - 1];
+        batch->signal_values[batch->signals_count] = 0;
+        batch->signal_semaphores[batch->signals_count++] = semaphore;
+        scheduler_flush_lane(vulkan, scheduler, lane);
+    } else {
+        // the signal of an empty submission covers everything submitted to that queue before it
+        VkSubmitInfo submit_info = {
+            .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+            .signalSemaphoreCount = 1,
+            .pSignalSemaphores = &semaphore,
+        };
+        VkResult result = vulkan->vkQueueSubmit(lane->queue, 1, &submit_info, VK_NULL_HANDLE);
+        assert(result == VK_SUCCESS);
+        scheduler->queue_submits_count++;
+    }
+
+    scheduler->waiting_semaphores[scheduler->waiting_semaphores_count++] = (scheduler_semaphore_t){
+        .semaphore = semaphore,
+        .lane = waiter_lane,
+        .value = waiter_value,
+    };
+    return semaphore;
+}
+
+static scheduler_batch_t *scheduler_add_batch(vulkan_t *vulkan, scheduler_t *scheduler, vulkan_queue_type_t queue,
+                                              uint32_t command_buffers_count, const VkCommandBuffer *command_buffers,
+                                              uint32_t dependencies_count, const scheduler_dependency_t *dependencies) {
+    assert(command_buffers_count <= SCHEDULER_MAX_COMMAND_BUFFERS);
+    uint32_t lane_index = scheduler->lane_of[queue];
+    scheduler_lane_t *lane = &scheduler->lanes[lane_index];
+
+    // several dependencies on one lane collapse into a single wait on the latest value
+    uint32_t waits_count = 0;
+    uint32_t wait_lanes[VULKAN_QUEUE_TYPE_COUNT];
+    uint64_t wait_values[VULKAN_QUEUE_TYPE_COUNT];
+    VkPipelineStageFlags wait_stages[VULKAN_QUEUE_TYPE_COUNT];
+    for (uint32_t i = 0; i < dependencies_count; i++) {
+        uint32_t dependency_lane = scheduler->lane_of[dependencies[i].queue];
+        uint32_t wait = 0;
+        while (wait < waits_count && wait_lanes[wait] != dependency_lane)
+            wait++;
+
+        if (wait == waits_count) {
+            waits_count++;
+            wait_lanes[wait] = dependency_lane;
+            wait_values[wait] = 0;
+            wait_stages[wait] = 0;
+        }
+        if (dependencies[i].value > wait_values[wait])
+            wait_values[wait] = dependencies[i].value;
+        wait_stages[wait] |= dependencies[i].stage;
+    }
+
+    // resolving binary semaphores may flush lanes, this one included, so it happens before the batch is added
+    VkSemaphore wait_semaphores[VULKAN_QUEUE_TYPE_COUNT];
+    for (uint32_t i = 0; i < waits_count; i++)
+        wait_semaphores[i] = scheduler->timeline ? scheduler->lanes[wait_lanes[i]].timeline
+                                                 : scheduler_signal_semaphore(vulkan, scheduler, wait_lanes[i], wait_values[i],
+                                                                              lane_index, lane->next_value);
+
+    if (lane->batches_count == SCHEDULER_MAX_BATCHES ||
+        lane->command_buffers_count + command_buffers_count > SCHEDULER_MAX_COMMAND_BUFFERS)
+        scheduler_flush_lane(vulkan, scheduler, lane);
+
+    scheduler_batch_t *batch = &lane->batches[lane->batches_count++];
+    batch->command_buffers_offset = lane->command_buffers_count;
+    batch->command_buffers_count = command_buffers_count;
+    for (uint32_t i = 0; i < command_buffers_count; i++)
+        lane->command_buffers[lane->command_buffers_count++] = command_buffers[i];
+
+    batch->waits_count = 0;
+    for (uint32_t i = 0; i < waits_count; i++) {
+        if (wait_semaphores[i] == VK_NULL_HANDLE)
+            continue;
+        batch->wait_semaphores[batch->waits_count] = wait_semaphores[i];
+        batch->wait_values[batch->waits_count] = wait_values[i];
+        batch->wait_stages[batch->waits_count] = wait_stages[i];
+        batch->waits_count++;
+    }
+
+    batch->signal_value = lane->next_value++;
+    batch->signals_count = 0;
+    if (scheduler->timeline) {
+        batch->signal_semaphores[0] = lane->timeline;
+        batch->signal_values[0] = batch->signal_value;
+        batch->signals_count = 1;
+    }
+    scheduler->submits_count++;
+    return batch;
+}
+
+// nothing reaches the gpu until the next flush, which turns every batched submission into one vkQueueSubmit per queue
+uint64_t scheduler_submit(vulkan_t *vulkan, scheduler_t *scheduler, vulkan_queue_type_t queue, uint32_t command_buffers_count,
+                          const VkCommandBuffer *command_buffers, uint32_t dependencies_count,
+                          const scheduler_dependency_t *dependencies) {
+    return scheduler_add_batch(vulkan, scheduler, queue, command_buffers_count, command_buffers, dependencies_count,
+                               dependencies)
+        ->signal_value;
+}
+
+// the present has to wait for render_finished, so the lane has to be flushed before vkQueuePresentKHR
+uint64_t scheduler_submit_swapchain(vulkan_t *vulkan, scheduler_t *scheduler, vulkan_queue_type_t queue,
+                                    VkCommandBuffer command_buffer, uint32_t dependencies_count,
+                                    const scheduler_dependency_t *dependencies, VkSemaphore image_available,
+                                    VkPipelineStageFlags wait_stage, VkSemaphore render_finished) {
+    scheduler_batch_t *batch =
+        scheduler_add_batch(vulkan, scheduler, queue, 1, &command_buffer, dependencies_count, dependencies);
+    batch->wait_semaphores[batch->waits_count] = image_available;
+    batch->wait_values[batch->waits_count] = 0;
+    batch->wait_stages[batch->waits_count] = wait_stage;
+    batch->waits_count++;
+    batch->signal_semaphores[batch->signals_count] = render_finished;
+    batch->signal_values[batch->signals_count] = 0;
+    batch->signals_count++;
+    return batch->signal_value;
+}
+
+void scheduler_flush(vulkan_t *vulkan, scheduler_t *scheduler) {
+    for (uint32_t i = 0; i < scheduler->lanes_count; i++)
+        scheduler_flush_lane(vulkan, scheduler, &scheduler->lanes[i]);
+}
+
+uint64_t scheduler_completed(vulkan_t *vulkan, scheduler_t *scheduler, vulkan_queue_type_t queue) {
+    return scheduler_lane_completed(vulkan, scheduler, &scheduler->lanes[scheduler->lane_of[queue]]);
+}
+
+VkResult scheduler_wait(vulkan_t *vulkan, scheduler_t *scheduler, vulkan_queue_type_t queue, uint64_t value, uint64_t timeout) {
+    return scheduler_wait_lane(vulkan, scheduler, &scheduler->lanes[scheduler->lane_of[queue]], value, timeout);
+}
+
+void scheduler_report(scheduler_t *scheduler) {
+    printf("scheduler: %u queue lanes, %llu submissions in %llu vkQueueSubmit calls, %s\n", scheduler->lanes_count,
+           (unsigned long long)scheduler->submits_count, (unsigned long long)scheduler->queue_submits_count,
+           scheduler->timeline ? "timeline semaphores" : "fences and binary semaphores");
+}
+
+void scheduler_free_resources(vulkan_t *vulkan, scheduler_t *scheduler) {
+    scheduler_flush(vulkan, scheduler);
+    for (uint32_t i = 0; i < scheduler->lanes_count; i++) {
+        scheduler_lane_t *lane = &scheduler->lanes[i];
+        VkResult result = scheduler_wait_lane(vulkan, scheduler, lane, lane->next_value - 1, UINT64_MAX);
+        assert(result == VK_SUCCESS);
+        vulkan->vkDestroySemaphore(vulkan->logical_device, lane->timeline, vulkan->allocation_callbacks);
+        for (uint32_t j = 0; j < SCHEDULER_MAX_FENCES; j++)
+            vulkan->vkDestroyFence(vulkan->logical_device, lane->fences[j].fence, vulkan->allocation_callbacks);
+    }
+
+    // every lane has drained, so no semaphore is still waited on
+    for (uint32_t i = 0; i < scheduler->free_semaphores_count; i++)
+        vulkan->vkDestroySemaphore(vulkan->logical_device, scheduler->free_semaphores[i], vulkan->allocation_callbacks);
+    for (uint32_t i = 0; i < scheduler->waiting_semaphores_count; i++)
+        vulkan->vkDestroySemaphore(vulkan->logical_device, scheduler->waiting_semaphores[i].semaphore,
+                                   vulkan->allocation_callbacks);
+}
+
+typedef struct {
+    compute_t compute;
+    VkBuffer x, y, result;
+    allocation_t x_allocation, y_allocation, result_allocation;
+    uint64_t presented_value;
+} scheduler_benchmark_slot_t;
+
+typedef struct {
+    vulkan_t *vulkan;
+    allocator_t allocator;
+    scheduler_t scheduler;
+    upload_t upload;
+    swapchain_t swapchain;
+    compute_kernel_t saxpy;
+    scheduler_benchmark_slot_t slots[SCHEDULER_BENCHMARK_SLOTS];
+    float *data;
+} scheduler_benchmark_t;
+
+static void scheduler_benchmark_record_present(scheduler_benchmark_t *benchmark, VkCommandBuffer command_buffer,
+                                               VkBuffer source) {
+    swapchain_t *swapchain = &benchmark->swapchain;
+    VkImage image = swapchain->images[swapchain->image_index];
+    VkImageMemoryBarrier barrier = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+        .dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+        .oldLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+        .newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .image = image,
+        .subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1},
+    };
+    benchmark->vulkan->vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0,
+                                            NULL, 0, NULL, 1, &barrier);
+
+    // every surface format the swapchain picks is four bytes a texel, so the input covers as many rows as it fills
+    uint32_t rows = SCHEDULER_BENCHMARK_ELEMENTS / swapchain->extent.width;
+    if (rows > swapchain->extent.height)
+        rows = swapchain->extent.height;
+    VkBufferImageCopy region = {
+        .imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1},
+        .imageExtent = {swapchain->extent.width, rows, 1},
+    };
+    benchmark->vulkan->vkCmdCopyBufferToImage(command_buffer, source, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = 0;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier.newLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+    benchmark->vulkan->vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                                            VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, NULL, 0, NULL, 1, &barrier);
+}
+
+// one frame uploads saxpy's inputs, then runs saxpy on the compute queue and copies x into the swapchain image on the
+// graphics queue, both waiting only on the upload lane; serialized waits on the host after every stage instead
+static void scheduler_benchmark_frame(scheduler_benchmark_t *benchmark, scheduler_benchmark_slot_t *slot, bool serialized) {
+    vulkan_t *vulkan = benchmark->vulkan;
+    scheduler_t *scheduler = &benchmark->scheduler;
+    VkDeviceSize size = SCHEDULER_BENCHMARK_ELEMENTS * sizeof(float);
+
+    // the slot's previous saxpy and present were the last to read its inputs
+    compute_begin(vulkan, &slot->compute);
+    VkResult result = scheduler_wait(vulkan, scheduler, VULKAN_QUEUE_GRAPHICS, slot->presented_value, UINT64_MAX);
+    assert(result == VK_SUCCESS);
+
+    upload_buffer(vulkan, &benchmark->upload, slot->x, &slot->x_allocation, 0, benchmark->data, size);
+    upload_buffer(vulkan, &benchmark->upload, slot->y, &slot->y_allocation, 0, benchmark->data + SCHEDULER_BENCHMARK_ELEMENTS,
+                  size);
+    uint64_t uploaded = upload_flush(vulkan, &benchmark->upload);
+    if (serialized)
+        upload_wait(vulkan, &benchmark->upload, uploaded);
+
+    struct {
+        uint32_t count;
+        float a;
+    } push_constants = {SCHEDULER_BENCHMARK_ELEMENTS, 2.5f};
+    compute_reset_descriptor_sets(vulkan, &slot->compute);
+    VkBuffer buffers[] = {slot->x, slot->y, slot->result};
+    VkDescriptorSet descriptor_set = compute_bind_buffers(vulkan, &slot->compute, &benchmark->saxpy, buffers);
+    compute_dispatch(vulkan, &slot->compute, &benchmark->saxpy, descriptor_set, &push_constants,
+                     (SCHEDULER_BENCHMARK_ELEMENTS + benchmark->saxpy.workgroup_size - 1) / benchmark->saxpy.workgroup_size);
+    compute_end(vulkan, &slot->compute);
+    scheduler_dependency_t computes_after = {VULKAN_QUEUE_TRANSFER, uploaded, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT};
+    uint64_t computed = compute_submit_scheduled(vulkan, &slot->compute, scheduler, 1, &computes_after);
+    if (serialized) {
+        result = scheduler_wait(vulkan, scheduler, VULKAN_QUEUE_COMPUTE, computed, UINT64_MAX);
+        assert(result == VK_SUCCESS);
+    }
+
+    VkCommandBuffer command_buffer;
+    if (!swapchain_begin_frame(vulkan, &benchmark->swapchain, &command_buffer))
+        return;
+    scheduler_benchmark_record_present(benchmark, command_buffer, slot->x);
+    scheduler_dependency_t presents_after = {VULKAN_QUEUE_TRANSFER, uploaded, VK_PIPELINE_STAGE_TRANSFER_BIT};
+    slot->presented_value = swapchain_end_frame(vulkan, &benchmark->swapchain, 1, &presents_after);
+    if (serialized) {
+        result = scheduler_wait(vulkan, scheduler, VULKAN_QUEUE_GRAPHICS, slot->presented_value, UINT64_MAX);
+        assert(result == VK_SUCCESS);
+    }
+}
+
+static void scheduler_benchmark_pass(scheduler_benchmark_t *benchmark, const char *name, bool serialized,
+                                     uint32_t iterations) {
+    bench_samples_t samples;
+    bench_samples_create(&samples, name, iterations);
+    uint64_t start = bench_now_ns();
+    for (uint32_t i = 0; i < iterations; i++) {
+        uint64_t frame_start = bench_now_ns();
+        scheduler_benchmark_frame(benchmark, &benchmark->slots[i % SCHEDULER_BENCHMARK_SLOTS], serialized);
+        bench_samples_push(&samples, bench_now_ns() - frame_start);
+    }
+    for (uint32_t i = 0; i < SCHEDULER_BENCHMARK_SLOTS; i++) {
+        scheduler_benchmark_slot_t *slot = &benchmark->slots[i];
+        VkResult result = scheduler_wait(benchmark->vulkan, &benchmark->scheduler, VULKAN_QUEUE_GRAPHICS,
+                                         slot->presented_value, UINT64_MAX);
+        assert(result == VK_SUCCESS);
+        result = scheduler_wait(benchmark->vulkan, &benchmark->scheduler, VULKAN_QUEUE_COMPUTE, slot->compute.timeline_value,
+                                UINT64_MAX);
+        assert(result == VK_SUCCESS);
+    }
+    uint64_t elapsed = bench_now_ns() - start;
+
+    bench_samples_report(&samples);
+    printf("%-48s %8.3f ms per frame\n", "", (double)elapsed / iterations / 1e6);
+    bench_samples_free(&samples);
+}
+
+void scheduler_benchmark(uint32_t iterations) {
+    vulkan_t vulkan = {.headless = true};
+    bench_bootstrap(&vulkan);
+    if (vulkan.surface == VK_NULL_HANDLE || vulkan.vkCreateSwapchainKHR == NULL) {
+        printf("queues: no headless surface to present to, skipped\n");
+        vulkan_free_resources(&vulkan);
+        return;
+    }
+
+    scheduler_benchmark_t *benchmark = (scheduler_benchmark_t *)calloc(1, sizeof(scheduler_benchmark_t));
+    benchmark->vulkan = &vulkan;
+    allocator_create(&vulkan, &benchmark->allocator);
+    scheduler_create(&vulkan, &benchmark->scheduler);
+    upload_create(&vulkan, &benchmark->allocator, &benchmark->scheduler, &benchmark->upload, SCHEDULER_BENCHMARK_RING_SIZE);
+    // the inputs have to cross the transfer queue, or there is no upload lane for the other two to wait on
+    benchmark->upload.force_staging = true;
+    swapchain_create(&vulkan, &benchmark->swapchain, &benchmark->scheduler, SCHEDULER_BENCHMARK_SLOTS,
+                     VK_PRESENT_MODE_IMMEDIATE_KHR, 512, 512);
+    compute_create_kernel(&vulkan, &benchmark->saxpy, "shaders/saxpy.spv", SCHEDULER_BENCHMARK_WORKGROUP_SIZE, 0, NULL, 3,
+                          sizeof(uint32_t) + sizeof(float));
+
+    uint64_t random = 0x9e3779b97f4a7c15ull;
+    benchmark->data = (float *)malloc(2 * SCHEDULER_BENCHMARK_ELEMENTS * sizeof(float));
+    for (uint32_t i = 0; i < 2 * SCHEDULER_BENCHMARK_ELEMENTS; i++)
+        benchmark->data[i] = (float)(bench_random(&random) & 0xffff) / 65536.0f;
+
+    VkBufferCreateInfo buffer_create_info = {
+        .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+        .size = SCHEDULER_BENCHMARK_ELEMENTS * sizeof(float),
+        .usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+    };
+    for (uint32_t i = 0; i < SCHEDULER_BENCHMARK_SLOTS; i++) {
+        scheduler_benchmark_slot_t *slot = &benchmark->slots[i];
+        compute_create(&vulkan, &slot->compute);
+        // x and y are read on the transfer, compute and graphics queues, upload_create_buffer shares them across all three
+        VkResult result = upload_create_buffer(&vulkan, &benchmark->upload, &buffer_create_info, &slot->x, &slot->x_allocation);
+        assert(result == VK_SUCCESS);
+        result = upload_create_buffer(&vulkan, &benchmark->upload, &buffer_create_info, &slot->y, &slot->y_allocation);
+        assert(result == VK_SUCCESS);
+        result = allocator_create_buffer(&vulkan, &benchmark->allocator, &buffer_create_info, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                                         0, &slot->result, &slot->result_allocation);
+        assert(result == VK_SUCCESS);
+    }
+
+    scheduler_benchmark_pass(benchmark, "upload, compute, present serialized", true, iterations);
+    scheduler_benchmark_pass(benchmark, "upload, compute || present scheduled", false, iterations);
+    scheduler_report(&benchmark->scheduler);
+
+    for (uint32_t i = 0; i < SCHEDULER_BENCHMARK_SLOTS; i++) {
+        scheduler_benchmark_slot_t *slot = &benchmark->slots[i];
+        compute_free_resources(&vulkan, &slot->compute);
+        allocator_destroy_buffer(&vulkan, &benchmark->allocator, slot->x, &slot->x_allocation);
+        allocator_destroy_buffer(&vulkan, &benchmark->allocator, slot->y, &slot->y_allocation);
+        allocator_destroy_buffer(&vulkan, &benchmark->allocator, slot->result, &slot->result_allocation);
+    }
+    free(benchmark->data);
+    compute_destroy_kernel(&vulkan, &benchmark->saxpy);
+    swapchain_free_resources(&vulkan, &benchmark->swapchain);
+    upload_free_resources(&vulkan, &benchmark->upload);
+    scheduler_free_resources(&vulkan, &benchmark->scheduler);
+    allocator_free_resources(&vulkan, &benchmark->allocator);
+    vulkan_free_resources(&vulkan);
+    free(benchmark);
+}
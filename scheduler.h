@@ -0,0 +1,96 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include "vulkan.h"
+#include <stdbool.h>
+
+#define SCHEDULER_MAX_BATCHES 64
+#define SCHEDULER_MAX_COMMAND_BUFFERS 256
+#define SCHEDULER_MAX_FENCES 16
+#define SCHEDULER_MAX_SEMAPHORES 64
+
+// a point on another queue's timeline that a submission has to wait for
+typedef struct {
+    vulkan_queue_type_t queue;
+    uint64_t value;
+    VkPipelineStageFlags stage;
+} scheduler_dependency_t;
+
+// besides the lanes, a batch may wait on a swapchain's acquire and signal its present semaphore
+typedef struct {
+    uint32_t command_buffers_offset;
+    uint32_t command_buffers_count;
+    uint32_t waits_count;
+    VkSemaphore wait_semaphores[VULKAN_QUEUE_TYPE_COUNT + 1];
+    uint64_t wait_values[VULKAN_QUEUE_TYPE_COUNT + 1];
+    VkPipelineStageFlags wait_stages[VULKAN_QUEUE_TYPE_COUNT + 1];
+    uint64_t signal_value;
+    // without timeline semaphores the lane's own signal is a binary semaphore, and only when a later submission waits on it
+    uint32_t signals_count;
+    VkSemaphore signal_semaphores[2];
+    uint64_t signal_values[2];
+    VkTimelineSemaphoreSubmitInfoKHR timeline_submit_info;
+} scheduler_batch_t;
+
+// the last value of a vkQueueSubmit made without timeline semaphores, complete once its fence is signaled
+typedef struct {
+    VkFence fence;
+    uint64_t value;
+} scheduler_fence_t;
+
+// a binary semaphore some lane waits on, free for reuse once that lane has completed value
+typedef struct {
+    VkSemaphore semaphore;
+    uint32_t lane;
+    uint64_t value;
+} scheduler_semaphore_t;
+
+// queue types that ended up on the same VkQueue share a lane, so their submissions keep program order
+typedef struct {
+    VkQueue queue;
+    VkSemaphore timeline;
+    uint64_t next_value;
+    uint64_t completed_value;
+    uint32_t fences_submitted;
+    uint32_t fences_retired;
+    scheduler_fence_t fences[SCHEDULER_MAX_FENCES];
+    uint32_t batches_count;
+    scheduler_batch_t batches[SCHEDULER_MAX_BATCHES];
+    uint32_t command_buffers_count;
+    VkCommandBuffer command_buffers[SCHEDULER_MAX_COMMAND_BUFFERS];
+} scheduler_lane_t;
+
+// values are the same either way, only how they are tracked depends on VK_KHR_timeline_semaphore
+typedef struct {
+    bool timeline;
+    uint32_t lanes_count;
+    uint32_t lane_of[VULKAN_QUEUE_TYPE_COUNT];
+    scheduler_lane_t lanes[VULKAN_QUEUE_TYPE_COUNT];
+
+    uint32_t semaphores_count;
+    uint32_t free_semaphores_count;
+    VkSemaphore free_semaphores[SCHEDULER_MAX_SEMAPHORES];
+    uint32_t waiting_semaphores_count;
+    scheduler_semaphore_t waiting_semaphores[SCHEDULER_MAX_SEMAPHORES];
+
+    uint64_t submits_count;
+    uint64_t queue_submits_count;
+} scheduler_t;
+
+void scheduler_create(vulkan_t *vulkan, scheduler_t *scheduler);
+uint64_t scheduler_submit(vulkan_t *vulkan, scheduler_t *scheduler, vulkan_queue_type_t queue, uint32_t command_buffers_count,
+                          const VkCommandBuffer *command_buffers, uint32_t dependencies_count,
+                          const scheduler_dependency_t *dependencies);
+uint64_t scheduler_submit_swapchain(vulkan_t *vulkan, scheduler_t *scheduler, vulkan_queue_type_t queue,
+                                    VkCommandBuffer command_buffer, uint32_t dependencies_count,
+                                    const scheduler_dependency_t *dependencies, VkSemaphore image_available,
+                                    VkPipelineStageFlags wait_stage, VkSemaphore render_finished);
+void scheduler_flush(vulkan_t *vulkan, scheduler_t *scheduler);
+uint64_t scheduler_completed(vulkan_t *vulkan, scheduler_t *scheduler, vulkan_queue_type_t queue);
+VkResult scheduler_wait(vulkan_t *vulkan, scheduler_t *scheduler, vulkan_queue_type_t queue, uint64_t value, uint64_t timeout);
+void scheduler_report(scheduler_t *scheduler);
+void scheduler_free_resources(vulkan_t *vulkan, scheduler_t *scheduler);
+
+void scheduler_benchmark(uint32_t iterations);
+
+#endif // SCHEDULER_H
@@ -3,19 +3,28 @@
 #include <stdbool.h>
 
 void sdl_create_window(vulkan_t *vulkan, sdl_t *sdl) {
-    bool success = SDL_Init(SDL_INIT_AUDIO | SDL_INIT_VIDEO | SDL_INIT_EVENTS);
+    // audio was never used, and every subsystem started here adds its own threads and startup time
+    bool success = SDL_Init(SDL_INIT_VIDEO | SDL_INIT_EVENTS);
     assert(success);
     success = SDL_Vulkan_LoadLibrary(NULL);
     assert(success);
 
-    sdl->window = SDL_CreateWindow("sdl vulkan example", 512, 512, SDL_WINDOW_VULKAN);
+    sdl->window = SDL_CreateWindow("sdl vulkan example", 512, 512, SDL_WINDOW_VULKAN | SDL_WINDOW_RESIZABLE);
     assert(sdl->window);
-    success = SDL_Vulkan_CreateSurface(sdl->window, vulkan->instance, NULL, &vulkan->surface);
+    success = SDL_Vulkan_CreateSurface(sdl->window, vulkan->instance, vulkan->allocation_callbacks, &vulkan->surface);
     assert(success);
 }
 
+void sdl_get_window_size(sdl_t *sdl, uint32_t *width, uint32_t *height) {
+    int window_width = 0, window_height = 0;
+    bool success = SDL_GetWindowSizeInPixels(sdl->window, &window_width, &window_height);
+    assert(success);
+    *width = (uint32_t)window_width;
+    *height = (uint32_t)window_height;
+}
+
 void sdl_free_resources(vulkan_t *vulkan, sdl_t *sdl) {
-    SDL_Vulkan_DestroySurface(vulkan->instance, vulkan->surface, NULL);
+    SDL_Vulkan_DestroySurface(vulkan->instance, vulkan->surface, vulkan->allocation_callbacks);
     SDL_DestroyWindow(sdl->window);
     SDL_Quit();
 }
@@ -3,6 +3,7 @@
 
 #include "vulkan.h"
 #include <SDL3/SDL_error.h>
+#include <SDL3/SDL_events.h>
 #include <SDL3/SDL_init.h>
 #include <SDL3/SDL_render.h>
 #include <SDL3/SDL_video.h>
@@ -14,6 +15,7 @@ typedef struct {
 } sdl_t;
 
 void sdl_create_window(vulkan_t *vulkan, sdl_t *sdl);
+void sdl_get_window_size(sdl_t *sdl, uint32_t *width, uint32_t *height);
 void sdl_free_resources(vulkan_t *vulkan, sdl_t *sdl);
 
 #endif // SDL_H
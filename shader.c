@@ -0,0 +1,41 @@
+#include "shader.h"
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+uint32_t *shader_load_code(const char *path, size_t *size) {
+    FILE *file = fopen(path, "rb");
+    assert(file);
+
+    fseek(file, 0, SEEK_END);
+    long file_size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    assert(file_size > 0 && file_size % sizeof(uint32_t) == 0);
+
+    uint32_t *code = (uint32_t *)malloc(file_size);
+    size_t read = fread(code, 1, file_size, file);
+    assert(read == (size_t)file_size);
+    fclose(file);
+
+    *size = (size_t)file_size;
+    return code;
+}
+
+VkShaderModule shader_create_module(vulkan_t *vulkan, const char *path) {
+    size_t size;
+    uint32_t *code = shader_load_code(path, &size);
+
+    VkShaderModuleCreateInfo shader_module_create_info = {
+        .sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
+        .codeSize = size,
+        .pCode = code,
+    };
+
+    VkShaderModule shader_module = VK_NULL_HANDLE;
+    VkResult result = vulkan->vkCreateShaderModule(vulkan->logical_device, &shader_module_create_info,
+                                                   vulkan->allocation_callbacks, &shader_module);
+    assert(result == VK_SUCCESS && shader_module != VK_NULL_HANDLE);
+
+    free(code);
+    return shader_module;
+}
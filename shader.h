@@ -0,0 +1,9 @@
+#ifndef SHADER_H
+#define SHADER_H
+
+#include "vulkan.h"
+
+uint32_t *shader_load_code(const char *path, size_t *size);
+VkShaderModule shader_create_module(vulkan_t *vulkan, const char *path);
+
+#endif // SHADER_H
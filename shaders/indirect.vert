@@ -0,0 +1,37 @@
+#version 450
+
+layout(location = 0) in vec3 position;
+layout(location = 0) out vec3 color;
+
+layout(std430, set = 0, binding = 0) readonly buffer frame_buffer {
+    mat4 view_projection;
+};
+
+layout(std430, set = 0, binding = 1) readonly buffer x_buffer {
+    float x[];
+};
+
+layout(std430, set = 0, binding = 2) readonly buffer y_buffer {
+    float y[];
+};
+
+layout(std430, set = 0, binding = 3) readonly buffer z_buffer {
+    float z[];
+};
+
+layout(std430, set = 0, binding = 4) readonly buffer scale_buffer {
+    float scale[];
+};
+
+layout(std430, set = 0, binding = 5) readonly buffer colors_buffer {
+    uint colors[];
+};
+
+// the instance index comes in through firstInstance, whether the host or the culling pass wrote the draw
+void main() {
+    uint index = gl_InstanceIndex;
+    vec3 world = position * scale[index] + vec3(x[index], y[index], z[index]);
+    gl_Position = view_projection * vec4(world, 1.0);
+    // there are no normals, how high up its mesh a vertex sits stands in for lighting
+    color = unpackUnorm4x8(colors[index]).rgb * (0.6 + 0.4 * normalize(position).y);
+}
@@ -0,0 +1,373 @@
+#include "swapchain.h"
+#include <assert.h>
+#include <stdio.h>
+
+VkPresentModeKHR swapchain_select_present_mode(vulkan_t *vulkan, VkPresentModeKHR desired_present_mode) {
+    uint32_t present_modes_count;
+    VkResult result = vulkan->vkGetPhysicalDeviceSurfacePresentModesKHR(vulkan->physical_device, vulkan->surface,
+                                                                        &present_modes_count, NULL);
+    assert(result == VK_SUCCESS && present_modes_count > 0);
+
+    VkPresentModeKHR *present_modes =
+        (VkPresentModeKHR *)arena_allocate(&vulkan->arena, sizeof(VkPresentModeKHR) * present_modes_count);
+    result = vulkan->vkGetPhysicalDeviceSurfacePresentModesKHR(vulkan->physical_device, vulkan->surface, &present_modes_count,
+                                                               present_modes);
+    assert(result == VK_SUCCESS);
+
+    // mailbox and immediate both avoid waiting on vblank, so each is the other's next best; fifo always exists
+    VkPresentModeKHR fallbacks[3] = {desired_present_mode, VK_PRESENT_MODE_FIFO_KHR, VK_PRESENT_MODE_FIFO_KHR};
+    if (desired_present_mode == VK_PRESENT_MODE_MAILBOX_KHR)
+        fallbacks[1] = VK_PRESENT_MODE_IMMEDIATE_KHR;
+    else if (desired_present_mode == VK_PRESENT_MODE_IMMEDIATE_KHR)
+        fallbacks[1] = VK_PRESENT_MODE_MAILBOX_KHR;
+
+    VkPresentModeKHR present_mode = VK_PRESENT_MODE_FIFO_KHR;
+    bool found = false;
+    for (uint32_t i = 0; i < 3 && !found; i++) {
+        for (uint32_t j = 0; j < present_modes_count; j++) {
+            if (present_modes[j] == fallbacks[i]) {
+                present_mode = fallbacks[i];
+                found = true;
+                break;
+            }
+        }
+    }
+
+    return present_mode;
+}
+
+static VkSurfaceFormatKHR swapchain_select_surface_format(vulkan_t *vulkan) {
+    uint32_t formats_count;
+    VkResult result =
+        vulkan->vkGetPhysicalDeviceSurfaceFormatsKHR(vulkan->physical_device, vulkan->surface, &formats_count, NULL);
+    assert(result == VK_SUCCESS && formats_count > 0);
+
+    VkSurfaceFormatKHR *formats =
+        (VkSurfaceFormatKHR *)arena_allocate(&vulkan->arena, sizeof(VkSurfaceFormatKHR) * formats_count);
+    result = vulkan->vkGetPhysicalDeviceSurfaceFormatsKHR(vulkan->physical_device, vulkan->surface, &formats_count, formats);
+    assert(result == VK_SUCCESS);
+
+    VkSurfaceFormatKHR desired_format = {
+        .format = VK_FORMAT_B8G8R8A8_UNORM,
+        .colorSpace = VK_COLOR_SPACE_SRGB_NONLINEAR_KHR,
+    };
+    VkSurfaceFormatKHR surface_format = formats[0];
+    if (formats_count == 1 && formats[0].format == VK_FORMAT_UNDEFINED)
+        surface_format = desired_format;
+    for (uint32_t i = 0; i < formats_count; i++) {
+        if (formats[i].format == desired_format.format && formats[i].colorSpace == desired_format.colorSpace) {
+            surface_format = formats[i];
+            break;
+        }
+    }
+
+    return surface_format;
+}
+
+static void swapchain_destroy_images(vulkan_t *vulkan, VkSwapchainKHR swapchain, arena_t *arena, uint32_t images_count,
+                                     VkSemaphore *render_finished) {
+    for (uint32_t i = 0; i < images_count; i++)
+        vulkan->vkDestroySemaphore(vulkan->logical_device, render_finished[i], vulkan->allocation_callbacks);
+    vulkan->vkDestroySwapchainKHR(vulkan->logical_device, swapchain, vulkan->allocation_callbacks);
+    arena_free(arena);
+}
+
+static void swapchain_destroy_retired(vulkan_t *vulkan, swapchain_t *swapchain) {
+    swapchain_retired_t *retired = &swapchain->retired;
+    if (retired->swapchain == VK_NULL_HANDLE)
+        return;
+
+    swapchain_destroy_images(vulkan, retired->swapchain, &retired->arena, retired->images_count, retired->render_finished);
+    *retired = (swapchain_retired_t){0};
+}
+
+// frames finish in submission order on the graphics queue, so the latest one covers them all
+static void swapchain_wait_frames(vulkan_t *vulkan, swapchain_t *swapchain) {
+    uint64_t last = 0;
+    for (uint32_t i = 0; i < swapchain->frames_in_flight; i++)
+        if (swapchain->frames[i].timeline_value > last)
+            last = swapchain->frames[i].timeline_value;
+
+    VkResult result = scheduler_wait(vulkan, swapchain->scheduler, VULKAN_QUEUE_GRAPHICS, last, UINT64_MAX);
+    assert(result == VK_SUCCESS);
+}
+
+static void swapchain_build(vulkan_t *vulkan, swapchain_t *swapchain, uint32_t width, uint32_t height) {
+    VkSurfaceCapabilitiesKHR surface_capabilities;
+    VkResult result =
+        vulkan->vkGetPhysicalDeviceSurfaceCapabilitiesKHR(vulkan->physical_device, vulkan->surface, &surface_capabilities);
+    assert(result == VK_SUCCESS);
+
+    // 0xFFFFFFFF means the surface (e.g. a headless one) takes whatever extent the swapchain asks for
+    VkExtent2D extent = surface_capabilities.currentExtent;
+    if (extent.width == UINT32_MAX) {
+        extent.width = width;
+        extent.height = height;
+        if (extent.width < surface_capabilities.minImageExtent.width)
+            extent.width = surface_capabilities.minImageExtent.width;
+        if (extent.width > surface_capabilities.maxImageExtent.width)
+            extent.width = surface_capabilities.maxImageExtent.width;
+        if (extent.height < surface_capabilities.minImageExtent.height)
+            extent.height = surface_capabilities.minImageExtent.height;
+        if (extent.height > surface_capabilities.maxImageExtent.height)
+            extent.height = surface_capabilities.maxImageExtent.height;
+    }
+
+    uint32_t images_count = surface_capabilities.minImageCount + 1;
+    if (surface_capabilities.maxImageCount > 0 && images_count > surface_capabilities.maxImageCount)
+        images_count = surface_capabilities.maxImageCount;
+
+    // the frame is cleared with vkCmdClearColorImage, which needs the images to be transfer destinations
+    VkImageUsageFlags image_usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+    assert((surface_capabilities.supportedUsageFlags & image_usage) == image_usage);
+    image_usage |= surface_capabilities.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+
+    VkSurfaceTransformFlagBitsKHR pre_transform = surface_capabilities.currentTransform;
+    if (surface_capabilities.supportedTransforms & VK_SURFACE_TRANSFORM_IDENTITY_BIT_KHR)
+        pre_transform = VK_SURFACE_TRANSFORM_IDENTITY_BIT_KHR;
+
+    VkCompositeAlphaFlagBitsKHR composite_alpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
+    while (!(surface_capabilities.supportedCompositeAlpha & composite_alpha))
+        composite_alpha <<= 1;
+
+    // handing over the old swapchain lets the driver recycle its images instead of stalling until they drain
+    VkSwapchainKHR old_swapchain = swapchain->swapchain;
+    VkSwapchainCreateInfoKHR swapchain_create_info = {
+        .sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR,
+        .surface = vulkan->surface,
+        .minImageCount = images_count,
+        .imageFormat = swapchain->surface_format.format,
+        .imageColorSpace = swapchain->surface_format.colorSpace,
+        .imageExtent = extent,
+        .imageArrayLayers = 1,
+        .imageUsage = image_usage,
+        .imageSharingMode = VK_SHARING_MODE_EXCLUSIVE,
+        .preTransform = pre_transform,
+        .compositeAlpha = composite_alpha,
+        .presentMode = swapchain->present_mode,
+        .clipped = VK_TRUE,
+        .oldSwapchain = old_swapchain,
+    };
+
+    VkSwapchainKHR new_swapchain = VK_NULL_HANDLE;
+    result = vulkan->vkCreateSwapchainKHR(vulkan->logical_device, &swapchain_create_info, vulkan->allocation_callbacks,
+                                          &new_swapchain);
+    assert(result == VK_SUCCESS && new_swapchain != VK_NULL_HANDLE);
+
+    if (old_swapchain != VK_NULL_HANDLE) {
+        // only one swapchain can wait for retirement at a time, so a second resize in quick succession has to drain
+        if (swapchain->retired.swapchain != VK_NULL_HANDLE) {
+            swapchain_wait_frames(vulkan, swapchain);
+            swapchain_destroy_retired(vulkan, swapchain);
+        }
+        swapchain->retired = (swapchain_retired_t){
+            .swapchain = old_swapchain,
+            .arena = swapchain->arena,
+            .images_count = swapchain->images_count,
+            .images = swapchain->images,
+            .render_finished = swapchain->render_finished,
+            .retired_frame = swapchain->frame_counter,
+        };
+        swapchain->arena = (arena_t){0};
+    }
+
+    swapchain->swapchain = new_swapchain;
+    swapchain->extent = extent;
+
+    result = vulkan->vkGetSwapchainImagesKHR(vulkan->logical_device, swapchain->swapchain, &swapchain->images_count, NULL);
+    assert(result == VK_SUCCESS && swapchain->images_count > 0);
+    swapchain->images = (VkImage *)arena_allocate(&swapchain->arena, sizeof(VkImage) * swapchain->images_count);
+    result = vulkan->vkGetSwapchainImagesKHR(vulkan->logical_device, swapchain->swapchain, &swapchain->images_count,
+                                             swapchain->images);
+    assert(result == VK_SUCCESS);
+
+    // presentation has no fence, so render-finished semaphores are per image rather than per frame
+    VkSemaphoreCreateInfo semaphore_create_info = {
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+    };
+    swapchain->render_finished =
+        (VkSemaphore *)arena_allocate(&swapchain->arena, sizeof(VkSemaphore) * swapchain->images_count);
+    for (uint32_t i = 0; i < swapchain->images_count; i++) {
+        result = vulkan->vkCreateSemaphore(vulkan->logical_device, &semaphore_create_info, vulkan->allocation_callbacks,
+                                           &swapchain->render_finished[i]);
+        assert(result == VK_SUCCESS);
+    }
+
+    swapchain->needs_recreate = false;
+}
+
+void swapchain_create(vulkan_t *vulkan, swapchain_t *swapchain, scheduler_t *scheduler, uint32_t frames_in_flight,
+                      VkPresentModeKHR desired_present_mode, uint32_t width, uint32_t height) {
+    assert(frames_in_flight > 0 && frames_in_flight <= SWAPCHAIN_MAX_FRAMES_IN_FLIGHT);
+    assert(vulkan->surface != VK_NULL_HANDLE);
+
+    *swapchain = (swapchain_t){
+        .scheduler = scheduler,
+        .frames_in_flight = frames_in_flight,
+        .wait_stage = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+    };
+    swapchain->present_mode = swapchain_select_present_mode(vulkan, desired_present_mode);
+    swapchain->surface_format = swapchain_select_surface_format(vulkan);
+    vulkan->present_mode = swapchain->present_mode;
+
+    // the graphics family is picked with presentation support in mind
+    swapchain->queue_family_index = vulkan->queues[VULKAN_QUEUE_GRAPHICS].family_index;
+    swapchain->queue = vulkan->queues[VULKAN_QUEUE_GRAPHICS].queue;
+
+    VkCommandPoolCreateInfo command_pool_create_info = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+        .flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT,
+        .queueFamilyIndex = swapchain->queue_family_index,
+    };
+    VkSemaphoreCreateInfo semaphore_create_info = {
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+    };
+
+    for (uint32_t i = 0; i < frames_in_flight; i++) {
+        swapchain_frame_t *frame = &swapchain->frames[i];
+        VkResult result = vulkan->vkCreateCommandPool(vulkan->logical_device, &command_pool_create_info,
+                                                      vulkan->allocation_callbacks, &frame->command_pool);
+        assert(result == VK_SUCCESS);
+
+        VkCommandBufferAllocateInfo command_buffer_allocate_info = {
+            .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+            .commandPool = frame->command_pool,
+            .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+            .commandBufferCount = 1,
+        };
+        result = vulkan->vkAllocateCommandBuffers(vulkan->logical_device, &command_buffer_allocate_info, &frame->command_buffer);
+        assert(result == VK_SUCCESS);
+
+        result = vulkan->vkCreateSemaphore(vulkan->logical_device, &semaphore_create_info, vulkan->allocation_callbacks,
+                                           &frame->image_available);
+        assert(result == VK_SUCCESS);
+    }
+
+    bench_samples_create(&swapchain->frame_times, "frame time", SWAPCHAIN_STATS_WINDOW);
+    bench_samples_create(&swapchain->fence_waits, "frame slot wait", SWAPCHAIN_STATS_WINDOW);
+    bench_samples_create(&swapchain->acquire_to_present, "acquire to present", SWAPCHAIN_STATS_WINDOW);
+
+    swapchain_build(vulkan, swapchain, width, height);
+}
+
+void swapchain_recreate(vulkan_t *vulkan, swapchain_t *swapchain, uint32_t width, uint32_t height) {
+    swapchain_build(vulkan, swapchain, width, height);
+}
+
+bool swapchain_begin_frame(vulkan_t *vulkan, swapchain_t *swapchain, VkCommandBuffer *command_buffer) {
+    swapchain_frame_t *frame = &swapchain->frames[swapchain->frame_index];
+
+    // out of date acquires begin frames that never end, so these can fill up before the window is reported
+    uint64_t begin = bench_now_ns();
+    if (swapchain->last_begin_ns != 0 && swapchain->frame_times.count < SWAPCHAIN_STATS_WINDOW)
+        bench_samples_push(&swapchain->frame_times, begin - swapchain->last_begin_ns);
+    swapchain->last_begin_ns = begin;
+
+    VkResult result =
+        scheduler_wait(vulkan, swapchain->scheduler, VULKAN_QUEUE_GRAPHICS, frame->timeline_value, UINT64_MAX);
+    assert(result == VK_SUCCESS);
+    if (swapchain->fence_waits.count < SWAPCHAIN_STATS_WINDOW)
+        bench_samples_push(&swapchain->fence_waits, bench_now_ns() - begin);
+
+    // every frame slot has been waited on since the swap, so nothing can still reference the old images
+    if (swapchain->retired.swapchain != VK_NULL_HANDLE &&
+        swapchain->frame_counter >= swapchain->retired.retired_frame + swapchain->frames_in_flight)
+        swapchain_destroy_retired(vulkan, swapchain);
+
+    result = vulkan->vkAcquireNextImageKHR(vulkan->logical_device, swapchain->swapchain, UINT64_MAX, frame->image_available,
+                                           VK_NULL_HANDLE, &swapchain->image_index);
+    if (result == VK_ERROR_OUT_OF_DATE_KHR) {
+        swapchain->needs_recreate = true;
+        return false;
+    }
+    assert(result == VK_SUCCESS || result == VK_SUBOPTIMAL_KHR);
+    if (result == VK_SUBOPTIMAL_KHR)
+        swapchain->needs_recreate = true;
+    frame->acquired_ns = bench_now_ns();
+
+    result = vulkan->vkResetCommandPool(vulkan->logical_device, frame->command_pool, 0);
+    assert(result == VK_SUCCESS);
+
+    VkCommandBufferBeginInfo command_buffer_begin_info = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+        .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+    };
+    result = vulkan->vkBeginCommandBuffer(frame->command_buffer, &command_buffer_begin_info);
+    assert(result == VK_SUCCESS);
+
+    *command_buffer = frame->command_buffer;
+    return true;
+}
+
+// the frame also waits for whatever the other queues produced for it, e.g. the upload lane's copies
+uint64_t swapchain_end_frame(vulkan_t *vulkan, swapchain_t *swapchain, uint32_t dependencies_count,
+                             const scheduler_dependency_t *dependencies) {
+    swapchain_frame_t *frame = &swapchain->frames[swapchain->frame_index];
+    VkSemaphore render_finished = swapchain->render_finished[swapchain->image_index];
+
+    VkResult result = vulkan->vkEndCommandBuffer(frame->command_buffer);
+    assert(result == VK_SUCCESS);
+
+    frame->timeline_value = scheduler_submit_swapchain(vulkan, swapchain->scheduler, VULKAN_QUEUE_GRAPHICS,
+                                                       frame->command_buffer, dependencies_count, dependencies,
+                                                       frame->image_available, swapchain->wait_stage, render_finished);
+    scheduler_flush(vulkan, swapchain->scheduler);
+
+    VkPresentInfoKHR present_info = {
+        .sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR,
+        .waitSemaphoreCount = 1,
+        .pWaitSemaphores = &render_finished,
+        .swapchainCount = 1,
+        .pSwapchains = &swapchain->swapchain,
+        .pImageIndices = &swapchain->image_index,
+    };
+    result = vulkan->vkQueuePresentKHR(swapchain->queue, &present_info);
+    if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR)
+        swapchain->needs_recreate = true;
+    else
+        assert(result == VK_SUCCESS);
+    bench_samples_push(&swapchain->acquire_to_present, bench_now_ns() - frame->acquired_ns);
+
+    swapchain->frame_index = (swapchain->frame_index + 1) % swapchain->frames_in_flight;
+    swapchain->frame_counter++;
+
+    if (swapchain->acquire_to_present.count == SWAPCHAIN_STATS_WINDOW)
+        swapchain_report(swapchain);
+    return frame->timeline_value;
+}
+
+void swapchain_report(swapchain_t *swapchain) {
+    if (swapchain->acquire_to_present.count == 0)
+        return;
+
+    printf("swapchain: frame %llu, %u frames in flight, %u images, %ux%u\n", (unsigned long long)swapchain->frame_counter,
+           swapchain->frames_in_flight, swapchain->images_count, swapchain->extent.width, swapchain->extent.height);
+    bench_samples_report(&swapchain->frame_times);
+    bench_samples_report(&swapchain->fence_waits);
+    bench_samples_report(&swapchain->acquire_to_present);
+
+    swapchain->frame_times.count = 0;
+    swapchain->fence_waits.count = 0;
+    swapchain->acquire_to_present.count = 0;
+}
+
+void swapchain_free_resources(vulkan_t *vulkan, swapchain_t *swapchain) {
+    VkResult result = vulkan->vkDeviceWaitIdle(vulkan->logical_device);
+    assert(result == VK_SUCCESS);
+
+    swapchain_report(swapchain);
+    swapchain_destroy_retired(vulkan, swapchain);
+    swapchain_destroy_images(vulkan, swapchain->swapchain, &swapchain->arena, swapchain->images_count,
+                             swapchain->render_finished);
+
+    for (uint32_t i = 0; i < swapchain->frames_in_flight; i++) {
+        swapchain_frame_t *frame = &swapchain->frames[i];
+        vulkan->vkDestroySemaphore(vulkan->logical_device, frame->image_available, vulkan->allocation_callbacks);
+        vulkan->vkDestroyCommandPool(vulkan->logical_device, frame->command_pool, vulkan->allocation_callbacks);
+    }
+
+    bench_samples_free(&swapchain->frame_times);
+    bench_samples_free(&swapchain->fence_waits);
+    bench_samples_free(&swapchain->acquire_to_present);
+    *swapchain = (swapchain_t){0};
+}
@@ -0,0 +1,71 @@
+#ifndef SWAPCHAIN_H
+#define SWAPCHAIN_H
+
+#include "bench.h"
+#include "scheduler.h"
+#include "vulkan.h"
+#include <stdbool.h>
+
+#define SWAPCHAIN_MAX_FRAMES_IN_FLIGHT 8
+#define SWAPCHAIN_STATS_WINDOW 1000
+
+typedef struct {
+    VkCommandPool command_pool;
+    VkCommandBuffer command_buffer;
+    VkSemaphore image_available;
+    // the graphics timeline value of the frame's last submission, 0 before it has been used
+    uint64_t timeline_value;
+    uint64_t acquired_ns;
+} swapchain_frame_t;
+
+// a swapchain replaced through oldSwapchain, kept alive until the frames that used it have finished
+typedef struct {
+    VkSwapchainKHR swapchain;
+    arena_t arena;
+    uint32_t images_count;
+    VkImage *images;
+    VkSemaphore *render_finished;
+    uint64_t retired_frame;
+} swapchain_retired_t;
+
+typedef struct {
+    VkSwapchainKHR swapchain;
+    VkSurfaceFormatKHR surface_format;
+    VkExtent2D extent;
+    VkPresentModeKHR present_mode;
+    // the image arrays of this swapchain, handed over to retired along with it
+    arena_t arena;
+    uint32_t images_count;
+    VkImage *images;
+    VkSemaphore *render_finished;
+    swapchain_retired_t retired;
+
+    scheduler_t *scheduler;
+    VkQueue queue;
+    uint32_t queue_family_index;
+    VkPipelineStageFlags wait_stage;
+
+    uint32_t frames_in_flight;
+    uint32_t frame_index;
+    uint32_t image_index;
+    uint64_t frame_counter;
+    swapchain_frame_t frames[SWAPCHAIN_MAX_FRAMES_IN_FLIGHT];
+    bool needs_recreate;
+
+    uint64_t last_begin_ns;
+    bench_samples_t frame_times;
+    bench_samples_t fence_waits;
+    bench_samples_t acquire_to_present;
+} swapchain_t;
+
+VkPresentModeKHR swapchain_select_present_mode(vulkan_t *vulkan, VkPresentModeKHR desired_present_mode);
+void swapchain_create(vulkan_t *vulkan, swapchain_t *swapchain, scheduler_t *scheduler, uint32_t frames_in_flight,
+                      VkPresentModeKHR desired_present_mode, uint32_t width, uint32_t height);
+void swapchain_recreate(vulkan_t *vulkan, swapchain_t *swapchain, uint32_t width, uint32_t height);
+bool swapchain_begin_frame(vulkan_t *vulkan, swapchain_t *swapchain, VkCommandBuffer *command_buffer);
+uint64_t swapchain_end_frame(vulkan_t *vulkan, swapchain_t *swapchain, uint32_t dependencies_count,
+                             const scheduler_dependency_t *dependencies);
+void swapchain_report(swapchain_t *swapchain);
+void swapchain_free_resources(vulkan_t *vulkan, swapchain_t *swapchain);
+
+#endif // SWAPCHAIN_H
@@ -0,0 +1,570 @@
+#define _POSIX_C_SOURCE 200809L
+#include "upload.h"
+#include "bench.h"
+#include <assert.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define UPLOAD_BENCHMARK_RING_SIZE (16ull * 1024 * 1024)
+#define UPLOAD_BENCHMARK_FILE_SIZE (64ull * 1024 * 1024)
+#define UPLOAD_BENCHMARK_MIN_UPLOAD (4ull * 1024)
+#define UPLOAD_BENCHMARK_MAX_UPLOAD (1024ull * 1024)
+
+void upload_create(vulkan_t *vulkan, allocator_t *allocator, scheduler_t *scheduler, upload_t *upload, VkDeviceSize ring_size) {
+    assert(ring_size % UPLOAD_ALIGNMENT == 0);
+    *upload = (upload_t){
+        .allocator = allocator,
+        .scheduler = scheduler,
+        .ring_size = ring_size,
+    };
+
+    // integrated gpus expose device-local memory the cpu can write directly, so staging would only add a copy
+    uint32_t memory_type_index;
+    VkPhysicalDeviceType device_type = vulkan->device_properties.deviceType;
+    upload->uma = (device_type == VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU || device_type == VK_PHYSICAL_DEVICE_TYPE_CPU) &&
+                  allocator_find_memory_type(allocator, ~0u,
+                                             VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                                                 VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                             0, &memory_type_index);
+
+    // the ring is only ever read by the transfer queue's copies, so it stays exclusive to that family
+    VkBufferCreateInfo buffer_create_info = {
+        .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+        .size = ring_size,
+        .usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+        .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+    };
+    VkResult result = allocator_create_buffer(vulkan, allocator, &buffer_create_info,
+                                              VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, 0,
+                                              &upload->ring, &upload->ring_allocation);
+    assert(result == VK_SUCCESS && upload->ring_allocation.mapped);
+
+    for (uint32_t i = 0; i < UPLOAD_MAX_BATCHES; i++) {
+        VkCommandPoolCreateInfo command_pool_create_info = {
+            .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+            .flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT,
+            .queueFamilyIndex = vulkan->queues[VULKAN_QUEUE_TRANSFER].family_index,
+        };
+        result = vulkan->vkCreateCommandPool(vulkan->logical_device, &command_pool_create_info, vulkan->allocation_callbacks,
+                                             &upload->batches[i].command_pool);
+        assert(result == VK_SUCCESS);
+
+        VkCommandBufferAllocateInfo command_buffer_allocate_info = {
+            .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+            .commandPool = upload->batches[i].command_pool,
+            .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+            .commandBufferCount = 1,
+        };
+        result = vulkan->vkAllocateCommandBuffers(vulkan->logical_device, &command_buffer_allocate_info,
+                                                  &upload->batches[i].command_buffer);
+        assert(result == VK_SUCCESS);
+    }
+
+    upload->buffer_copies =
+        (upload_buffer_copy_t *)arena_allocate(&upload->arena, sizeof(upload_buffer_copy_t) * UPLOAD_MAX_COPIES);
+    upload->image_copies = (upload_image_copy_t *)arena_allocate(&upload->arena, sizeof(upload_image_copy_t) * UPLOAD_MAX_COPIES);
+    upload->buffer_regions = (VkBufferCopy *)arena_allocate(&upload->arena, sizeof(VkBufferCopy) * UPLOAD_MAX_COPIES);
+    upload->image_regions = (VkBufferImageCopy *)arena_allocate(&upload->arena, sizeof(VkBufferImageCopy) * UPLOAD_MAX_COPIES);
+    upload->image_barriers =
+        (VkImageMemoryBarrier *)arena_allocate(&upload->arena, sizeof(VkImageMemoryBarrier) * UPLOAD_MAX_COPIES);
+}
+
+// on uma devices the destination lands in host-visible memory and upload_buffer writes it in place
+VkResult upload_create_buffer(vulkan_t *vulkan, upload_t *upload, const VkBufferCreateInfo *buffer_create_info,
+                              VkBuffer *buffer, allocation_t *allocation) {
+    VkMemoryPropertyFlags preferred_flags = upload->uma && !upload->force_staging
+                                                ? VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
+                                                : 0;
+
+    // pieces keep landing in buffers the other queues already read, so they are shared instead of passed back and forth
+    uint32_t families[VULKAN_QUEUE_TYPE_COUNT];
+    uint32_t families_count = 0;
+    for (uint32_t i = 0; i < VULKAN_QUEUE_TYPE_COUNT; i++) {
+        uint32_t family = vulkan->queues[i].family_index;
+        uint32_t j = 0;
+        while (j < families_count && families[j] != family)
+            j++;
+        if (j == families_count)
+            families[families_count++] = family;
+    }
+    VkBufferCreateInfo shared_create_info = *buffer_create_info;
+    if (families_count > 1) {
+        shared_create_info.sharingMode = VK_SHARING_MODE_CONCURRENT;
+        shared_create_info.queueFamilyIndexCount = families_count;
+        shared_create_info.pQueueFamilyIndices = families;
+    }
+    return allocator_create_buffer(vulkan, upload->allocator, &shared_create_info, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                                   preferred_flags, buffer, allocation);
+}
+
+void *upload_map_file(const char *path, size_t *size) {
+    *size = 0;
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return NULL;
+
+    void *data = NULL;
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) == 0 && file_stat.st_size > 0) {
+        data = mmap(NULL, (size_t)file_stat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data == MAP_FAILED) {
+            data = NULL;
+        } else {
+            *size = (size_t)file_stat.st_size;
+            posix_madvise(data, *size, POSIX_MADV_SEQUENTIAL);
+        }
+    }
+    close(fd);
+    return data;
+}
+
+void upload_unmap_file(void *data, size_t size) {
+    if (data)
+        munmap(data, size);
+}
+
+static void upload_retire(vulkan_t *vulkan, upload_t *upload) {
+    if (upload->batches_retired == upload->batches_submitted)
+        return;
+
+    uint64_t completed = scheduler_completed(vulkan, upload->scheduler, VULKAN_QUEUE_TRANSFER);
+    while (upload->batches_retired < upload->batches_submitted) {
+        upload_batch_t *batch = &upload->batches[upload->batches_retired % UPLOAD_MAX_BATCHES];
+        if (batch->timeline_value > completed)
+            break;
+        upload->ring_tail = batch->ring_end;
+        upload->batches_retired++;
+    }
+}
+
+static void upload_wait_oldest(vulkan_t *vulkan, upload_t *upload) {
+    assert(upload->batches_retired < upload->batches_submitted);
+    upload_batch_t *batch = &upload->batches[upload->batches_retired % UPLOAD_MAX_BATCHES];
+    VkResult result =
+        scheduler_wait(vulkan, upload->scheduler, VULKAN_QUEUE_TRANSFER, batch->timeline_value, UINT64_MAX);
+    assert(result == VK_SUCCESS);
+    upload_retire(vulkan, upload);
+}
+
+static bool upload_pending(upload_t *upload) {
+    return upload->buffer_copies_count > 0 || upload->image_copies_count > 0;
+}
+
+// returns the offset into the ring, waiting on the oldest batches until enough space has been consumed
+static VkDeviceSize upload_reserve(vulkan_t *vulkan, upload_t *upload, VkDeviceSize size) {
+    assert(size <= upload->ring_size);
+    if (upload->buffer_copies_count == UPLOAD_MAX_COPIES || upload->image_copies_count == UPLOAD_MAX_COPIES)
+        upload_flush(vulkan, upload);
+    upload_retire(vulkan, upload);
+
+    uint64_t stall_start = 0;
+    for (;;) {
+        uint64_t head = (upload->ring_head + UPLOAD_ALIGNMENT - 1) & ~(uint64_t)(UPLOAD_ALIGNMENT - 1);
+        VkDeviceSize offset = head % upload->ring_size;
+        if (offset + size > upload->ring_size) {
+            head += upload->ring_size - offset;
+            offset = 0;
+        }
+
+        // nothing lives in the ring, so the skipped tail end is not worth waiting for
+        if (!upload_pending(upload) && upload->batches_retired == upload->batches_submitted)
+            upload->ring_tail = head;
+
+        if (head + size - upload->ring_tail <= upload->ring_size) {
+            if (stall_start) {
+                upload->stats.ring_stalls++;
+                upload->stats.stall_ns += bench_now_ns() - stall_start;
+            }
+            upload->ring_head = head + size;
+            return offset;
+        }
+
+        if (stall_start == 0)
+            stall_start = bench_now_ns();
+        if (upload_pending(upload))
+            upload_flush(vulkan, upload);
+        else
+            upload_wait_oldest(vulkan, upload);
+    }
+}
+
+// destinations that did not come from upload_create_buffer need concurrent sharing with the families reading them
+void upload_buffer(vulkan_t *vulkan, upload_t *upload, VkBuffer buffer, const allocation_t *allocation,
+                   VkDeviceSize offset, const void *data, VkDeviceSize size) {
+    upload->stats.uploads_count++;
+
+    VkMemoryPropertyFlags flags =
+        allocation ? upload->allocator->memory_properties.memoryTypes[allocation->memory_type_index].propertyFlags : 0;
+    if (!upload->force_staging && allocation && allocation->mapped && (flags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT)) {
+        memcpy((char *)allocation->mapped + offset, data, size);
+        upload->stats.bytes_direct += size;
+        return;
+    }
+
+    // big sources go through in pieces so the ring keeps several batches in flight
+    VkDeviceSize max_piece = upload->ring_size / 4;
+    for (VkDeviceSize done = 0; done < size;) {
+        VkDeviceSize piece = size - done < max_piece ? size - done : max_piece;
+        VkDeviceSize ring_offset = upload_reserve(vulkan, upload, piece);
+        memcpy((char *)upload->ring_allocation.mapped + ring_offset, (const char *)data + done, piece);
+
+        upload->buffer_copies[upload->buffer_copies_count] = (upload_buffer_copy_t){
+            .buffer = buffer,
+            .region = {.srcOffset = ring_offset, .dstOffset = offset + done, .size = piece},
+            .order = upload->buffer_copies_count,
+        };
+        upload->buffer_copies_count++;
+        upload->stats.bytes_staged += piece;
+        done += piece;
+    }
+}
+
+bool upload_file_to_buffer(vulkan_t *vulkan, upload_t *upload, const char *path, VkBuffer buffer,
+                           const allocation_t *allocation, VkDeviceSize offset) {
+    size_t size = 0;
+    void *data = upload_map_file(path, &size);
+    if (data == NULL)
+        return false;
+
+    // the mapping is copied into the ring right away, so it can go before the copies execute
+    upload_buffer(vulkan, upload, buffer, allocation, offset, data, size);
+    upload_unmap_file(data, size);
+    return true;
+}
+
+// the batch releases the mip level to the consumer's family in final_layout, where upload_acquire_image picks it up
+void upload_image(vulkan_t *vulkan, upload_t *upload, VkImage image, VkImageAspectFlags aspect, uint32_t mip_level,
+                  VkExtent3D extent, const void *data, VkDeviceSize size, VkImageLayout final_layout,
+                  vulkan_queue_type_t consumer) {
+    upload->stats.uploads_count++;
+    VkDeviceSize ring_offset = upload_reserve(vulkan, upload, size);
+    memcpy((char *)upload->ring_allocation.mapped + ring_offset, data, size);
+
+    upload->image_copies[upload->image_copies_count] = (upload_image_copy_t){
+        .image = image,
+        .region =
+            {
+                .bufferOffset = ring_offset,
+                .imageSubresource = {.aspectMask = aspect, .mipLevel = mip_level, .baseArrayLayer = 0, .layerCount = 1},
+                .imageExtent = extent,
+            },
+        .order = upload->image_copies_count,
+        .final_layout = final_layout,
+        .consumer = consumer,
+    };
+    upload->image_copies_count++;
+    upload->stats.bytes_staged += size;
+}
+
+static int upload_compare_buffer_copies(const void *a, const void *b) {
+    const upload_buffer_copy_t *x = (const upload_buffer_copy_t *)a;
+    const upload_buffer_copy_t *y = (const upload_buffer_copy_t *)b;
+    if (x->buffer != y->buffer)
+        return x->buffer < y->buffer ? -1 : 1;
+    return (x->order > y->order) - (x->order < y->order);
+}
+
+static int upload_compare_image_copies(const void *a, const void *b) {
+    const upload_image_copy_t *x = (const upload_image_copy_t *)a;
+    const upload_image_copy_t *y = (const upload_image_copy_t *)b;
+    if (x->image != y->image)
+        return x->image < y->image ? -1 : 1;
+    if (x->region.imageSubresource.mipLevel != y->region.imageSubresource.mipLevel)
+        return x->region.imageSubresource.mipLevel < y->region.imageSubresource.mipLevel ? -1 : 1;
+    return (x->order > y->order) - (x->order < y->order);
+}
+
+static void upload_record(vulkan_t *vulkan, upload_t *upload, VkCommandBuffer command_buffer) {
+    qsort(upload->image_copies, upload->image_copies_count, sizeof(upload_image_copy_t), upload_compare_image_copies);
+    uint32_t barriers_count = 0;
+    for (uint32_t i = 0; i < upload->image_copies_count; i++) {
+        upload_image_copy_t *copy = &upload->image_copies[i];
+        if (i > 0 && copy->image == upload->image_copies[i - 1].image &&
+            copy->region.imageSubresource.mipLevel == upload->image_copies[i - 1].region.imageSubresource.mipLevel)
+            continue;
+
+        upload->image_barriers[barriers_count++] = (VkImageMemoryBarrier){
+            .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+            .srcAccessMask = 0,
+            .dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+            .oldLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+            .newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+            .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .image = copy->image,
+            .subresourceRange =
+                {
+                    .aspectMask = copy->region.imageSubresource.aspectMask,
+                    .baseMipLevel = copy->region.imageSubresource.mipLevel,
+                    .levelCount = 1,
+                    .baseArrayLayer = 0,
+                    .layerCount = 1,
+                },
+        };
+    }
+    if (barriers_count > 0)
+        vulkan->vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0,
+                                     NULL, 0, NULL, barriers_count, upload->image_barriers);
+
+    for (uint32_t first = 0; first < upload->image_copies_count;) {
+        uint32_t count = 0;
+        VkImage image = upload->image_copies[first].image;
+        while (first + count < upload->image_copies_count && upload->image_copies[first + count].image == image) {
+            upload->image_regions[count] = upload->image_copies[first + count].region;
+            count++;
+        }
+        vulkan->vkCmdCopyBufferToImage(command_buffer, upload->ring, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, count,
+                                       upload->image_regions);
+        upload->stats.copy_commands_count++;
+        first += count;
+    }
+
+    // the copies of a mip level are sorted together, so the last one names its final layout and consumer
+    uint32_t transfer_family = vulkan->queues[VULKAN_QUEUE_TRANSFER].family_index;
+    barriers_count = 0;
+    for (uint32_t i = 0; i < upload->image_copies_count; i++) {
+        upload_image_copy_t *copy = &upload->image_copies[i];
+        if (i + 1 < upload->image_copies_count && copy->image == upload->image_copies[i + 1].image &&
+            copy->region.imageSubresource.mipLevel == upload->image_copies[i + 1].region.imageSubresource.mipLevel)
+            continue;
+
+        uint32_t consumer_family = vulkan->queues[copy->consumer].family_index;
+        bool release = consumer_family != transfer_family;
+        upload->image_barriers[barriers_count++] = (VkImageMemoryBarrier){
+            .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+            .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+            .dstAccessMask = 0,
+            .oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+            .newLayout = copy->final_layout,
+            .srcQueueFamilyIndex = release ? transfer_family : VK_QUEUE_FAMILY_IGNORED,
+            .dstQueueFamilyIndex = release ? consumer_family : VK_QUEUE_FAMILY_IGNORED,
+            .image = copy->image,
+            .subresourceRange =
+                {
+                    .aspectMask = copy->region.imageSubresource.aspectMask,
+                    .baseMipLevel = copy->region.imageSubresource.mipLevel,
+                    .levelCount = 1,
+                    .baseArrayLayer = 0,
+                    .layerCount = 1,
+                },
+        };
+    }
+    if (barriers_count > 0)
+        vulkan->vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0,
+                                     0, NULL, 0, NULL, barriers_count, upload->image_barriers);
+
+    qsort(upload->buffer_copies, upload->buffer_copies_count, sizeof(upload_buffer_copy_t), upload_compare_buffer_copies);
+    for (uint32_t first = 0; first < upload->buffer_copies_count;) {
+        uint32_t count = 0;
+        VkBuffer buffer = upload->buffer_copies[first].buffer;
+        while (first + count < upload->buffer_copies_count && upload->buffer_copies[first + count].buffer == buffer) {
+            upload->buffer_regions[count] = upload->buffer_copies[first + count].region;
+            count++;
+        }
+        vulkan->vkCmdCopyBuffer(command_buffer, upload->ring, buffer, count, upload->buffer_regions);
+        upload->stats.copy_commands_count++;
+        first += count;
+    }
+}
+
+// recorded by the consumer after waiting for the upload's timeline value, the other half of the batch's release
+void upload_acquire_image(vulkan_t *vulkan, VkCommandBuffer command_buffer, VkImage image, VkImageAspectFlags aspect,
+                          uint32_t mip_level, VkImageLayout final_layout, vulkan_queue_type_t consumer,
+                          VkPipelineStageFlags stage, VkAccessFlags access) {
+    // within one family the batch already moved the layout, and the semaphore wait makes the copy visible
+    uint32_t transfer_family = vulkan->queues[VULKAN_QUEUE_TRANSFER].family_index;
+    uint32_t consumer_family = vulkan->queues[consumer].family_index;
+    if (consumer_family == transfer_family)
+        return;
+
+    VkImageMemoryBarrier image_barrier = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+        .srcAccessMask = 0,
+        .dstAccessMask = access,
+        .oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        .newLayout = final_layout,
+        .srcQueueFamilyIndex = transfer_family,
+        .dstQueueFamilyIndex = consumer_family,
+        .image = image,
+        .subresourceRange =
+            {
+                .aspectMask = aspect,
+                .baseMipLevel = mip_level,
+                .levelCount = 1,
+                .baseArrayLayer = 0,
+                .layerCount = 1,
+            },
+    };
+    vulkan->vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, stage, 0, 0, NULL, 0, NULL, 1,
+                                 &image_barrier);
+}
+
+// records every pending copy into one command buffer and returns the transfer timeline value that marks its completion
+uint64_t upload_flush(vulkan_t *vulkan, upload_t *upload) {
+    if (!upload_pending(upload))
+        return upload->batches_submitted ? upload->batches[(upload->batches_submitted - 1) % UPLOAD_MAX_BATCHES].timeline_value
+                                         : 0;
+
+    if (upload->batches_submitted - upload->batches_retired == UPLOAD_MAX_BATCHES) {
+        uint64_t stall_start = bench_now_ns();
+        upload_wait_oldest(vulkan, upload);
+        upload->stats.ring_stalls++;
+        upload->stats.stall_ns += bench_now_ns() - stall_start;
+    }
+
+    upload_batch_t *batch = &upload->batches[upload->batches_submitted % UPLOAD_MAX_BATCHES];
+    VkResult result = vulkan->vkResetCommandPool(vulkan->logical_device, batch->command_pool, 0);
+    assert(result == VK_SUCCESS);
+
+    VkCommandBufferBeginInfo command_buffer_begin_info = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+        .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+    };
+    result = vulkan->vkBeginCommandBuffer(batch->command_buffer, &command_buffer_begin_info);
+    assert(result == VK_SUCCESS);
+    upload_record(vulkan, upload, batch->command_buffer);
+    result = vulkan->vkEndCommandBuffer(batch->command_buffer);
+    assert(result == VK_SUCCESS);
+
+    batch->ring_end = upload->ring_head;
+    batch->timeline_value =
+        scheduler_submit(vulkan, upload->scheduler, VULKAN_QUEUE_TRANSFER, 1, &batch->command_buffer, 0, NULL);
+    scheduler_flush(vulkan, upload->scheduler);
+
+    upload->batches_submitted++;
+    upload->stats.batches_count++;
+    upload->buffer_copies_count = 0;
+    upload->image_copies_count = 0;
+    return batch->timeline_value;
+}
+
+void upload_wait(vulkan_t *vulkan, upload_t *upload, uint64_t timeline_value) {
+    VkResult result = scheduler_wait(vulkan, upload->scheduler, VULKAN_QUEUE_TRANSFER, timeline_value, UINT64_MAX);
+    assert(result == VK_SUCCESS);
+    upload_retire(vulkan, upload);
+}
+
+void upload_report(upload_t *upload, uint64_t elapsed_ns) {
+    upload_stats_t *stats = &upload->stats;
+    double seconds = (double)elapsed_ns / 1e9;
+    double megabytes = (double)(stats->bytes_staged + stats->bytes_direct) / (1024.0 * 1024.0);
+    printf("upload: %s, %llu uploads, %.1f MiB staged, %.1f MiB written directly\n",
+           upload->uma && !upload->force_staging ? "uma" : "staged",
+           (unsigned long long)stats->uploads_count, (double)stats->bytes_staged / (1024.0 * 1024.0),
+           (double)stats->bytes_direct / (1024.0 * 1024.0));
+    printf("%-48s %.1f MiB/s\n", "throughput", seconds > 0 ? megabytes / seconds : 0.0);
+    printf("%-48s %llu batches, %llu copy commands\n", "submissions", (unsigned long long)stats->batches_count,
+           (unsigned long long)stats->copy_commands_count);
+    printf("%-48s %llu stalls, %.3f ms waiting\n", "ring", (unsigned long long)stats->ring_stalls,
+           (double)stats->stall_ns / 1e6);
+}
+
+void upload_free_resources(vulkan_t *vulkan, upload_t *upload) {
+    uint64_t last = upload_flush(vulkan, upload);
+    if (last > 0)
+        upload_wait(vulkan, upload, last);
+
+    for (uint32_t i = 0; i < UPLOAD_MAX_BATCHES; i++)
+        vulkan->vkDestroyCommandPool(vulkan->logical_device, upload->batches[i].command_pool, vulkan->allocation_callbacks);
+    allocator_destroy_buffer(vulkan, upload->allocator, upload->ring, &upload->ring_allocation);
+
+    arena_free(&upload->arena);
+}
+
+static bool upload_benchmark_write_file(const char *path, uint64_t *random) {
+    FILE *file = fopen(path, "wb");
+    if (file == NULL)
+        return false;
+
+    uint64_t chunk[8192];
+    bool written = true;
+    for (uint64_t done = 0; done < UPLOAD_BENCHMARK_FILE_SIZE && written; done += sizeof(chunk)) {
+        for (uint32_t i = 0; i < sizeof(chunk) / sizeof(chunk[0]); i++)
+            chunk[i] = bench_random(random);
+        written = fwrite(chunk, 1, sizeof(chunk), file) == sizeof(chunk);
+    }
+    return fclose(file) == 0 && written;
+}
+
+// each pass uploads into a destination of its own and reports only what it moved
+static void upload_benchmark_pass(vulkan_t *vulkan, upload_t *upload, bool force_staging, const char *name,
+                                  const char *data, size_t size, uint32_t iterations) {
+    upload->force_staging = force_staging;
+    upload->stats = (upload_stats_t){0};
+
+    VkBufferCreateInfo buffer_create_info = {
+        .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+        .size = size,
+        .usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+    };
+    VkBuffer buffer = VK_NULL_HANDLE;
+    allocation_t allocation;
+    VkResult result = upload_create_buffer(vulkan, upload, &buffer_create_info, &buffer, &allocation);
+    assert(result == VK_SUCCESS);
+
+    bench_samples_t samples;
+    bench_samples_create(&samples, name, iterations);
+
+    // mesh-sized pieces at random places in the file, the way a streamer pulls in whatever became visible
+    uint64_t random = 0x2545f4914f6cdd1dull;
+    uint64_t start = bench_now_ns();
+    for (uint32_t i = 0; i < iterations; i++) {
+        VkDeviceSize piece = UPLOAD_BENCHMARK_MIN_UPLOAD +
+                             bench_random(&random) % (UPLOAD_BENCHMARK_MAX_UPLOAD - UPLOAD_BENCHMARK_MIN_UPLOAD);
+        piece &= ~(VkDeviceSize)(UPLOAD_ALIGNMENT - 1);
+        VkDeviceSize offset = (bench_random(&random) % (size - piece)) & ~(VkDeviceSize)(UPLOAD_ALIGNMENT - 1);
+
+        uint64_t upload_start = bench_now_ns();
+        upload_buffer(vulkan, upload, buffer, &allocation, offset, data + offset, piece);
+        bench_samples_push(&samples, bench_now_ns() - upload_start);
+    }
+    upload_wait(vulkan, upload, upload_flush(vulkan, upload));
+    uint64_t elapsed = bench_now_ns() - start;
+
+    upload_report(upload, elapsed);
+    bench_samples_report(&samples);
+    bench_samples_free(&samples);
+    allocator_destroy_buffer(vulkan, upload->allocator, buffer, &allocation);
+}
+
+void upload_benchmark(uint32_t iterations) {
+    vulkan_t vulkan = {.headless = true};
+    bench_bootstrap(&vulkan);
+
+    allocator_t allocator;
+    allocator_create(&vulkan, &allocator);
+    scheduler_t scheduler;
+    scheduler_create(&vulkan, &scheduler);
+    upload_t upload;
+    upload_create(&vulkan, &allocator, &scheduler, &upload, UPLOAD_BENCHMARK_RING_SIZE);
+
+    char path[] = "/tmp/vulkookbook.upload.XXXXXX";
+    int fd = mkstemp(path);
+    assert(fd >= 0);
+    close(fd);
+
+    uint64_t random = 0x9e3779b97f4a7c15ull;
+    bool written = upload_benchmark_write_file(path, &random);
+    assert(written);
+    size_t size = 0;
+    const char *data = (const char *)upload_map_file(path, &size);
+    assert(data && size == UPLOAD_BENCHMARK_FILE_SIZE);
+
+    // uma devices write most destinations in place, the staged pass still puts the ring and transfer queue under load
+    upload_benchmark_pass(&vulkan, &upload, true, "upload_buffer staged", data, size, iterations);
+    if (upload.uma)
+        upload_benchmark_pass(&vulkan, &upload, false, "upload_buffer direct", data, size, iterations);
+
+    upload_unmap_file((void *)data, size);
+    remove(path);
+    upload_free_resources(&vulkan, &upload);
+    scheduler_free_resources(&vulkan, &scheduler);
+    allocator_free_resources(&vulkan, &allocator);
+    vulkan_free_resources(&vulkan);
+}
@@ -0,0 +1,102 @@
+#ifndef UPLOAD_H
+#define UPLOAD_H
+
+#include "allocator.h"
+#include "scheduler.h"
+#include "vulkan.h"
+#include <stdbool.h>
+#include <stddef.h>
+
+#define UPLOAD_DEFAULT_RING_SIZE (64ull * 1024 * 1024)
+#define UPLOAD_MAX_BATCHES 8
+#define UPLOAD_MAX_COPIES 4096
+// covers every power-of-two texel size as well as the 4 byte alignment of buffer copies
+#define UPLOAD_ALIGNMENT 16
+
+typedef struct {
+    VkBuffer buffer;
+    VkBufferCopy region;
+    uint32_t order;
+} upload_buffer_copy_t;
+
+typedef struct {
+    VkImage image;
+    VkBufferImageCopy region;
+    uint32_t order;
+    VkImageLayout final_layout;
+    vulkan_queue_type_t consumer;
+} upload_image_copy_t;
+
+typedef struct {
+    VkCommandPool command_pool;
+    VkCommandBuffer command_buffer;
+    uint64_t timeline_value;
+    // how far the ring has to be consumed before this batch's staging space can be reused
+    uint64_t ring_end;
+} upload_batch_t;
+
+typedef struct {
+    uint64_t uploads_count;
+    uint64_t bytes_staged;
+    uint64_t bytes_direct;
+    uint64_t copy_commands_count;
+    uint64_t batches_count;
+    uint64_t ring_stalls;
+    uint64_t stall_ns;
+} upload_stats_t;
+
+// ring positions only ever grow, the offset into the staging buffer is the position modulo the ring size
+typedef struct {
+    allocator_t *allocator;
+    scheduler_t *scheduler;
+    bool uma;
+    // sends every upload through the ring even where the destination could be written in place
+    bool force_staging;
+
+    VkBuffer ring;
+    allocation_t ring_allocation;
+    VkDeviceSize ring_size;
+    uint64_t ring_head;
+    uint64_t ring_tail;
+
+    upload_batch_t batches[UPLOAD_MAX_BATCHES];
+    uint32_t batches_submitted;
+    uint32_t batches_retired;
+
+    // copies are only recorded at flush time, grouped so each destination gets a single copy command; the arrays come
+    // out of the arena and last as long as the upload
+    arena_t arena;
+    uint32_t buffer_copies_count;
+    upload_buffer_copy_t *buffer_copies;
+    uint32_t image_copies_count;
+    upload_image_copy_t *image_copies;
+    VkBufferCopy *buffer_regions;
+    VkBufferImageCopy *image_regions;
+    VkImageMemoryBarrier *image_barriers;
+
+    upload_stats_t stats;
+} upload_t;
+
+void upload_create(vulkan_t *vulkan, allocator_t *allocator, scheduler_t *scheduler, upload_t *upload, VkDeviceSize ring_size);
+VkResult upload_create_buffer(vulkan_t *vulkan, upload_t *upload, const VkBufferCreateInfo *buffer_create_info,
+                              VkBuffer *buffer, allocation_t *allocation);
+void *upload_map_file(const char *path, size_t *size);
+void upload_unmap_file(void *data, size_t size);
+void upload_buffer(vulkan_t *vulkan, upload_t *upload, VkBuffer buffer, const allocation_t *allocation,
+                   VkDeviceSize offset, const void *data, VkDeviceSize size);
+bool upload_file_to_buffer(vulkan_t *vulkan, upload_t *upload, const char *path, VkBuffer buffer,
+                           const allocation_t *allocation, VkDeviceSize offset);
+void upload_image(vulkan_t *vulkan, upload_t *upload, VkImage image, VkImageAspectFlags aspect, uint32_t mip_level,
+                  VkExtent3D extent, const void *data, VkDeviceSize size, VkImageLayout final_layout,
+                  vulkan_queue_type_t consumer);
+void upload_acquire_image(vulkan_t *vulkan, VkCommandBuffer command_buffer, VkImage image, VkImageAspectFlags aspect,
+                          uint32_t mip_level, VkImageLayout final_layout, vulkan_queue_type_t consumer,
+                          VkPipelineStageFlags stage, VkAccessFlags access);
+uint64_t upload_flush(vulkan_t *vulkan, upload_t *upload);
+void upload_wait(vulkan_t *vulkan, upload_t *upload, uint64_t timeline_value);
+void upload_report(upload_t *upload, uint64_t elapsed_ns);
+void upload_free_resources(vulkan_t *vulkan, upload_t *upload);
+
+void upload_benchmark(uint32_t iterations);
+
+#endif // UPLOAD_H
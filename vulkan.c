@@ -1,50 +1,145 @@
+#include "device.h"
+#include "pipeline_cache.h"
 #include "vulkan.h"
 #include <assert.h>
 #include <stdbool.h>
 #include <stdio.h>
-#include <stdlib.h>
 #include <string.h>
 
 void vulkan_load_global_level_functions(vulkan_t *vulkan) {
-#define GLOBAL_LEVEL_VULKAN_FUNCTION(name)                         \
+#define LOAD_GLOBAL_LEVEL_FUNCTION(name)                           \
     vulkan->name = (PFN_##name)vkGetInstanceProcAddr(NULL, #name); \
-    assert(name);
+    assert(vulkan->name);
+
+    VULKAN_GLOBAL_LEVEL_FUNCTIONS(LOAD_GLOBAL_LEVEL_FUNCTION)
+
+#undef LOAD_GLOBAL_LEVEL_FUNCTION
+}
+
+// named by string so that no platform headers are needed to pick the surface extension at runtime
+static const char *platform_surface_extensions[] = {
+    "VK_EXT_metal_surface", "VK_KHR_android_surface", "VK_KHR_wayland_surface",
+    "VK_KHR_win32_surface", "VK_KHR_xcb_surface",     "VK_KHR_xlib_surface",
+};
+
+static bool vulkan_extension_available(const char *extension, VkExtensionProperties *available_extensions,
+                                       uint32_t available_extensions_count) {
+    for (uint32_t i = 0; i < available_extensions_count; i++)
+        if (strcmp(extension, available_extensions[i].extensionName) == 0)
+            return true;
+    return false;
+}
+
+// fnv-1a, extension names are short so anything heavier is wasted
+static uint64_t vulkan_extension_hash(const char *extension) {
+    uint64_t hash = 0xcbf29ce484222325ull;
+    for (const char *c = extension; *c; c++)
+        hash = (hash ^ (uint8_t)*c) * 0x100000001b3ull;
+    return hash;
+}
+
+// kept at most half full, so a probe for a missing name ends after a slot or two
+static void vulkan_extension_set_build(vulkan_extension_set_t *set, uint32_t extensions_count, const char **extensions) {
+    assert(extensions_count * 2 <= VULKAN_EXTENSION_SET_CAPACITY);
+    *set = (vulkan_extension_set_t){.count = extensions_count};
+
+    for (uint32_t i = 0; i < extensions_count; i++) {
+        uint64_t hash = vulkan_extension_hash(extensions[i]);
+        uint32_t slot = (uint32_t)hash & (VULKAN_EXTENSION_SET_CAPACITY - 1);
+        while (set->names[slot] != NULL)
+            slot = (slot + 1) & (VULKAN_EXTENSION_SET_CAPACITY - 1);
+        set->hashes[slot] = hash;
+        set->names[slot] = extensions[i];
+    }
+}
+
+static bool vulkan_extension_set_contains(const vulkan_extension_set_t *set, const char *extension) {
+    uint64_t hash = vulkan_extension_hash(extension);
+    uint32_t slot = (uint32_t)hash & (VULKAN_EXTENSION_SET_CAPACITY - 1);
+    while (set->names[slot] != NULL) {
+        if (set->hashes[slot] == hash && strcmp(set->names[slot], extension) == 0)
+            return true;
+        slot = (slot + 1) & (VULKAN_EXTENSION_SET_CAPACITY - 1);
+    }
+    return false;
+}
+
+bool vulkan_instance_extension_enabled(vulkan_t *vulkan, const char *extension) {
+    return vulkan_extension_set_contains(&vulkan->instance_extension_set, extension);
+}
 
-    GLOBAL_LEVEL_VULKAN_FUNCTION(vkCreateInstance)
-    GLOBAL_LEVEL_VULKAN_FUNCTION(vkEnumerateInstanceExtensionProperties)
-    GLOBAL_LEVEL_VULKAN_FUNCTION(vkEnumerateInstanceLayerProperties)
+bool vulkan_device_extension_enabled(vulkan_t *vulkan, const char *extension) {
+    return vulkan_extension_set_contains(&vulkan->device_extension_set, extension);
+}
 
-#undef GLOBAL_LEVEL_VULKAN_FUNCTION
+static void vulkan_enable_instance_extension(vulkan_t *vulkan, const char *extension) {
+    vulkan->enabled_instance_extensions[vulkan->enabled_instance_extensions_count++] = extension;
 }
 
 void vulkan_create_instance(vulkan_t *vulkan) {
-    uint32_t desired_instance_extensions_count = 5;
-    const char *desired_instance_extensions[] = {
-        VK_EXT_DEBUG_REPORT_EXTENSION_NAME,  VK_EXT_DEBUG_UTILS_EXTENSION_NAME,
-        VK_EXT_METAL_SURFACE_EXTENSION_NAME, VK_KHR_PORTABILITY_ENUMERATION_EXTENSION_NAME,
-        VK_KHR_SURFACE_EXTENSION_NAME,
+    host_memory_create(&vulkan->host_memory);
+    vulkan->allocation_callbacks = &vulkan->host_memory.callbacks;
+
+    const char *optional_instance_extensions[] = {
+        VK_EXT_DEBUG_REPORT_EXTENSION_NAME,
+        VK_EXT_DEBUG_UTILS_EXTENSION_NAME,
+        VK_KHR_DEVICE_GROUP_CREATION_EXTENSION_NAME,
+        VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME,
+        VK_KHR_PORTABILITY_ENUMERATION_EXTENSION_NAME,
     };
+    uint32_t optional_instance_extensions_count = sizeof(optional_instance_extensions) / sizeof(*optional_instance_extensions);
+    uint32_t platform_surface_extensions_count = sizeof(platform_surface_extensions) / sizeof(*platform_surface_extensions);
 
     VkResult result;
     result = vulkan->vkEnumerateInstanceExtensionProperties(NULL, &vulkan->available_instance_extensions_count, NULL);
     assert(result == VK_SUCCESS && vulkan->available_instance_extensions_count > 0);
 
-    vulkan->available_instance_extensions =
-        (VkExtensionProperties *)malloc(sizeof(VkExtensionProperties) * vulkan->available_instance_extensions_count);
+    vulkan->available_instance_extensions = (VkExtensionProperties *)arena_allocate(
+        &vulkan->arena, sizeof(VkExtensionProperties) * vulkan->available_instance_extensions_count);
     result = vulkan->vkEnumerateInstanceExtensionProperties(NULL, &vulkan->available_instance_extensions_count,
                                                             vulkan->available_instance_extensions);
     assert(result == VK_SUCCESS && vulkan->available_instance_extensions_count > 0);
 
-    for (int i = 0; i < desired_instance_extensions_count; i++) {
-        bool found = false;
-        for (int j = 0; j < vulkan->available_instance_extensions_count; j++) {
-            if (strcmp(desired_instance_extensions[i], vulkan->available_instance_extensions[j].extensionName) == 0) {
-                found = true;
-                break;
+    // surface, headless surface, every platform surface and every optional extension at most
+    vulkan->enabled_instance_extensions_count = 0;
+    vulkan->enabled_instance_extensions = (const char **)arena_allocate(
+        &vulkan->arena, sizeof(char *) * (2 + platform_surface_extensions_count + optional_instance_extensions_count));
+
+    for (uint32_t i = 0; i < optional_instance_extensions_count; i++)
+        if (vulkan_extension_available(optional_instance_extensions[i], vulkan->available_instance_extensions,
+                                       vulkan->available_instance_extensions_count))
+            vulkan_enable_instance_extension(vulkan, optional_instance_extensions[i]);
+
+    bool surface_available = vulkan_extension_available(VK_KHR_SURFACE_EXTENSION_NAME, vulkan->available_instance_extensions,
+                                                        vulkan->available_instance_extensions_count);
+    if (vulkan->headless) {
+        // without VK_EXT_headless_surface we fall back to rendering offscreen with no surface at all
+        if (surface_available && vulkan_extension_available(VK_EXT_HEADLESS_SURFACE_EXTENSION_NAME,
+                                                            vulkan->available_instance_extensions,
+                                                            vulkan->available_instance_extensions_count)) {
+            vulkan_enable_instance_extension(vulkan, VK_KHR_SURFACE_EXTENSION_NAME);
+            vulkan_enable_instance_extension(vulkan, VK_EXT_HEADLESS_SURFACE_EXTENSION_NAME);
+        }
+    } else {
+        assert(surface_available);
+        vulkan_enable_instance_extension(vulkan, VK_KHR_SURFACE_EXTENSION_NAME);
+
+        bool platform_surface_found = false;
+        for (uint32_t i = 0; i < platform_surface_extensions_count; i++) {
+            if (vulkan_extension_available(platform_surface_extensions[i], vulkan->available_instance_extensions,
+                                           vulkan->available_instance_extensions_count)) {
+                vulkan_enable_instance_extension(vulkan, platform_surface_extensions[i]);
+                platform_surface_found = true;
             }
         }
-        assert(found);
+        assert(platform_surface_found);
     }
+    vulkan_extension_set_build(&vulkan->instance_extension_set, vulkan->enabled_instance_extensions_count,
+                               vulkan->enabled_instance_extensions);
+
+    VkInstanceCreateFlags instance_create_flags = 0;
+    if (vulkan_instance_extension_enabled(vulkan, VK_KHR_PORTABILITY_ENUMERATION_EXTENSION_NAME))
+        instance_create_flags |= VK_INSTANCE_CREATE_ENUMERATE_PORTABILITY_BIT_KHR;
 
     VkApplicationInfo application_info = {
         .sType = VK_STRUCTURE_TYPE_APPLICATION_INFO,
@@ -57,136 +152,254 @@ void vulkan_create_instance(vulkan_t *vulkan) {
 
     VkInstanceCreateInfo instance_create_info = {
         .sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO,
-        .flags = VK_INSTANCE_CREATE_ENUMERATE_PORTABILITY_BIT_KHR,
+        .flags = instance_create_flags,
         .pApplicationInfo = &application_info,
-        .enabledExtensionCount = desired_instance_extensions_count,
-        .ppEnabledExtensionNames = desired_instance_extensions,
+        .enabledExtensionCount = vulkan->enabled_instance_extensions_count,
+        .ppEnabledExtensionNames = vulkan->enabled_instance_extensions,
     };
 
-    result = vulkan->vkCreateInstance(&instance_create_info, NULL, &vulkan->instance);
+    result = vulkan->vkCreateInstance(&instance_create_info, vulkan->allocation_callbacks, &vulkan->instance);
     assert(result == VK_SUCCESS && vulkan->instance != VK_NULL_HANDLE);
 }
 
 void vulkan_load_instance_level_functions(vulkan_t *vulkan) {
-#define INSTANCE_LEVEL_VULKAN_FUNCTION(name)                                   \
+#define LOAD_INSTANCE_LEVEL_FUNCTION(name)                                     \
     vulkan->name = (PFN_##name)vkGetInstanceProcAddr(vulkan->instance, #name); \
     assert(vulkan->name);
 
-    INSTANCE_LEVEL_VULKAN_FUNCTION(vkCreateDevice)
-    INSTANCE_LEVEL_VULKAN_FUNCTION(vkDestroyInstance)
-    INSTANCE_LEVEL_VULKAN_FUNCTION(vkEnumerateDeviceExtensionProperties)
-    INSTANCE_LEVEL_VULKAN_FUNCTION(vkEnumeratePhysicalDevices)
-    INSTANCE_LEVEL_VULKAN_FUNCTION(vkGetDeviceProcAddr)
-    INSTANCE_LEVEL_VULKAN_FUNCTION(vkGetPhysicalDeviceFeatures)
-    INSTANCE_LEVEL_VULKAN_FUNCTION(vkGetPhysicalDeviceProperties)
-    INSTANCE_LEVEL_VULKAN_FUNCTION(vkGetPhysicalDeviceQueueFamilyProperties)
+    VULKAN_INSTANCE_LEVEL_FUNCTIONS(LOAD_INSTANCE_LEVEL_FUNCTION)
 
-#undef INSTANCE_LEVEL_VULKAN_FUNCTION
+#undef LOAD_INSTANCE_LEVEL_FUNCTION
 }
 
+// functions of extensions that were not enabled are never resolved and stay NULL
 void vulkan_load_instance_level_extension_functions(vulkan_t *vulkan) {
-#define INSTANCE_LEVEL_VULKAN_FUNCTION_FROM_EXTENSION(name, extension)                        \
-    for (int i = 0; i < vulkan->available_instance_extensions_count; i++) {                   \
-        if (strcmp(extension, vulkan->available_instance_extensions[i].extensionName) == 0) { \
-            vulkan->name = (PFN_##name)vkGetInstanceProcAddr(vulkan->instance, #name);        \
-            assert(vulkan->name);                                                             \
-        }                                                                                     \
+#define LOAD_INSTANCE_LEVEL_EXTENSION_FUNCTION(name, extension)                    \
+    if (vulkan_instance_extension_enabled(vulkan, extension)) {                    \
+        vulkan->name = (PFN_##name)vkGetInstanceProcAddr(vulkan->instance, #name); \
+        assert(vulkan->name);                                                      \
     }
 
-    INSTANCE_LEVEL_VULKAN_FUNCTION_FROM_EXTENSION(vkCmdBeginDebugUtilsLabelEXT, VK_EXT_DEBUG_UTILS_EXTENSION_NAME)
-    INSTANCE_LEVEL_VULKAN_FUNCTION_FROM_EXTENSION(vkCmdEndDebugUtilsLabelEXT, VK_EXT_DEBUG_UTILS_EXTENSION_NAME)
-    INSTANCE_LEVEL_VULKAN_FUNCTION_FROM_EXTENSION(vkCmdInsertDebugUtilsLabelEXT, VK_EXT_DEBUG_UTILS_EXTENSION_NAME)
-    INSTANCE_LEVEL_VULKAN_FUNCTION_FROM_EXTENSION(vkCreateDebugUtilsMessengerEXT, VK_EXT_DEBUG_UTILS_EXTENSION_NAME)
-    INSTANCE_LEVEL_VULKAN_FUNCTION_FROM_EXTENSION(vkDestroyDebugUtilsMessengerEXT, VK_EXT_DEBUG_UTILS_EXTENSION_NAME)
-    INSTANCE_LEVEL_VULKAN_FUNCTION_FROM_EXTENSION(vkQueueBeginDebugUtilsLabelEXT, VK_EXT_DEBUG_UTILS_EXTENSION_NAME)
-    INSTANCE_LEVEL_VULKAN_FUNCTION_FROM_EXTENSION(vkQueueEndDebugUtilsLabelEXT, VK_EXT_DEBUG_UTILS_EXTENSION_NAME)
-    INSTANCE_LEVEL_VULKAN_FUNCTION_FROM_EXTENSION(vkQueueInsertDebugUtilsLabelEXT, VK_EXT_DEBUG_UTILS_EXTENSION_NAME)
-    INSTANCE_LEVEL_VULKAN_FUNCTION_FROM_EXTENSION(vkSetDebugUtilsObjectNameEXT, VK_EXT_DEBUG_UTILS_EXTENSION_NAME)
-    INSTANCE_LEVEL_VULKAN_FUNCTION_FROM_EXTENSION(vkSetDebugUtilsObjectTagEXT, VK_EXT_DEBUG_UTILS_EXTENSION_NAME)
-    INSTANCE_LEVEL_VULKAN_FUNCTION_FROM_EXTENSION(vkSubmitDebugUtilsMessageEXT, VK_EXT_DEBUG_UTILS_EXTENSION_NAME)
-
-    INSTANCE_LEVEL_VULKAN_FUNCTION_FROM_EXTENSION(vkCreateDebugReportCallbackEXT, VK_EXT_DEBUG_REPORT_EXTENSION_NAME)
-    INSTANCE_LEVEL_VULKAN_FUNCTION_FROM_EXTENSION(vkDebugReportMessageEXT, VK_EXT_DEBUG_REPORT_EXTENSION_NAME)
-    INSTANCE_LEVEL_VULKAN_FUNCTION_FROM_EXTENSION(vkDestroyDebugReportCallbackEXT, VK_EXT_DEBUG_REPORT_EXTENSION_NAME)
-
-    INSTANCE_LEVEL_VULKAN_FUNCTION_FROM_EXTENSION(vkGetPhysicalDeviceSurfacePresentModesKHR, VK_KHR_SURFACE_EXTENSION_NAME)
-    INSTANCE_LEVEL_VULKAN_FUNCTION_FROM_EXTENSION(vkGetPhysicalDeviceSurfaceSupportKHR, VK_KHR_SURFACE_EXTENSION_NAME)
-
-#undef INSTANCE_LEVEL_VULKAN_FUNCTION_FROM_EXTENSION
+    VULKAN_INSTANCE_LEVEL_EXTENSION_FUNCTIONS(LOAD_INSTANCE_LEVEL_EXTENSION_FUNCTION)
+
+#undef LOAD_INSTANCE_LEVEL_EXTENSION_FUNCTION
+}
+
+// a bindless heap needs descriptor indexing with update-after-bind, partially bound runtime arrays and non-uniform
+// indexing, queried through VK_KHR_get_physical_device_properties2 since the instance targets Vulkan 1.0
+static bool vulkan_query_descriptor_indexing(vulkan_t *vulkan) {
+    if (vulkan->vkGetPhysicalDeviceFeatures2KHR == NULL ||
+        !vulkan_extension_available(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME, vulkan->available_device_extensions,
+                                    vulkan->available_device_extensions_count) ||
+        !vulkan_extension_available(VK_KHR_MAINTENANCE3_EXTENSION_NAME, vulkan->available_device_extensions,
+                                    vulkan->available_device_extensions_count))
+        return false;
+
+    VkPhysicalDeviceDescriptorIndexingFeaturesEXT supported = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT,
+    };
+    VkPhysicalDeviceFeatures2 features = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2_KHR,
+        .pNext = &supported,
+    };
+    vulkan->vkGetPhysicalDeviceFeatures2KHR(vulkan->physical_device, &features);
+    if (!supported.shaderSampledImageArrayNonUniformIndexing || !supported.shaderStorageBufferArrayNonUniformIndexing ||
+        !supported.descriptorBindingSampledImageUpdateAfterBind || !supported.descriptorBindingStorageImageUpdateAfterBind ||
+        !supported.descriptorBindingStorageBufferUpdateAfterBind || !supported.descriptorBindingUpdateUnusedWhilePending ||
+        !supported.descriptorBindingPartiallyBound || !supported.runtimeDescriptorArray)
+        return false;
+
+    vulkan->descriptor_indexing_properties = (VkPhysicalDeviceDescriptorIndexingPropertiesEXT){
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_PROPERTIES_EXT,
+    };
+    VkPhysicalDeviceProperties2 properties = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2_KHR,
+        .pNext = &vulkan->descriptor_indexing_properties,
+    };
+    vulkan->vkGetPhysicalDeviceProperties2KHR(vulkan->physical_device, &properties);
+
+    // only what the heap uses is enabled, and create_logical_device chains it in once the extension is in the set
+    vulkan->descriptor_indexing_features = (VkPhysicalDeviceDescriptorIndexingFeaturesEXT){
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT,
+        .shaderSampledImageArrayNonUniformIndexing = VK_TRUE,
+        .shaderStorageBufferArrayNonUniformIndexing = VK_TRUE,
+        .shaderStorageImageArrayNonUniformIndexing = supported.shaderStorageImageArrayNonUniformIndexing,
+        .descriptorBindingSampledImageUpdateAfterBind = VK_TRUE,
+        .descriptorBindingStorageImageUpdateAfterBind = VK_TRUE,
+        .descriptorBindingStorageBufferUpdateAfterBind = VK_TRUE,
+        .descriptorBindingUpdateUnusedWhilePending = VK_TRUE,
+        .descriptorBindingPartiallyBound = VK_TRUE,
+        .runtimeDescriptorArray = VK_TRUE,
+    };
+    return true;
 }
 
 void vulkan_create_physical_device(vulkan_t *vulkan) {
-    VkResult result = vkEnumeratePhysicalDevices(vulkan->instance, &vulkan->device_count, NULL);
+    VkResult result = vulkan->vkEnumeratePhysicalDevices(vulkan->instance, &vulkan->device_count, NULL);
     assert(result == VK_SUCCESS && vulkan->device_count > 0);
 
-    vulkan->available_devices = (VkPhysicalDevice *)malloc(sizeof(VkPhysicalDevice) * vulkan->device_count);
-    result = vkEnumeratePhysicalDevices(vulkan->instance, &vulkan->device_count, vulkan->available_devices);
+    vulkan->available_devices =
+        (VkPhysicalDevice *)arena_allocate(&vulkan->arena, sizeof(VkPhysicalDevice) * vulkan->device_count);
+    result = vulkan->vkEnumeratePhysicalDevices(vulkan->instance, &vulkan->device_count, vulkan->available_devices);
     assert(result == VK_SUCCESS && vulkan->device_count > 0);
 
-    assert(vulkan->device_count == 1);
-    vulkan->physical_device = vulkan->available_devices[0];
-    vkGetPhysicalDeviceProperties(vulkan->physical_device, &vulkan->device_properties);
-    vkGetPhysicalDeviceFeatures(vulkan->physical_device, &vulkan->device_features);
+    device_candidate_t *candidates =
+        (device_candidate_t *)arena_allocate(&vulkan->arena, sizeof(device_candidate_t) * vulkan->device_count);
+    device_rank(vulkan, candidates);
+    const device_candidate_t *selected = device_select(candidates, vulkan->device_count, vulkan->device_override);
+    assert(selected != NULL);
 
-    assert(vulkan->device_features.tessellationShader);
-    vulkan->device_features = (VkPhysicalDeviceFeatures){.tessellationShader = VK_TRUE};
+    vulkan->physical_device = selected->physical_device;
+    vulkan->device_properties = selected->properties;
+    vulkan->device_features = device_enable_features(&selected->features);
+    vulkan->device_group_count = selected->group_count;
+    memcpy(vulkan->device_group_devices, selected->group_devices, sizeof(VkPhysicalDevice) * selected->group_count);
 
-    vulkan->desired_device_extensions_count = 3;
-    vulkan->desired_device_extensions = (const char **)malloc(3 * sizeof(char *));
-    vulkan->desired_device_extensions[0] = VK_EXT_DEBUG_MARKER_EXTENSION_NAME;
-    vulkan->desired_device_extensions[1] = VK_KHR_DRIVER_PROPERTIES_EXTENSION_NAME;
-    vulkan->desired_device_extensions[2] = VK_KHR_SWAPCHAIN_EXTENSION_NAME;
-
-    result = vkEnumerateDeviceExtensionProperties(vulkan->physical_device, NULL, &vulkan->available_device_extensions_count, NULL);
+    result = vulkan->vkEnumerateDeviceExtensionProperties(vulkan->physical_device, NULL,
+                                                          &vulkan->available_device_extensions_count, NULL);
     assert(result == VK_SUCCESS && vulkan->available_device_extensions_count > 0);
 
-    vulkan->available_device_extensions =
-        (VkExtensionProperties *)malloc(sizeof(VkExtensionProperties) * vulkan->available_device_extensions_count);
-    result = vkEnumerateDeviceExtensionProperties(vulkan->physical_device, NULL, &vulkan->available_device_extensions_count,
-                                                  vulkan->available_device_extensions);
+    vulkan->available_device_extensions = (VkExtensionProperties *)arena_allocate(
+        &vulkan->arena, sizeof(VkExtensionProperties) * vulkan->available_device_extensions_count);
+    result = vulkan->vkEnumerateDeviceExtensionProperties(vulkan->physical_device, NULL,
+                                                          &vulkan->available_device_extensions_count,
+                                                          vulkan->available_device_extensions);
     assert(result == VK_SUCCESS && vulkan->available_device_extensions_count > 0);
 
-    for (int i = 0; i < vulkan->desired_device_extensions_count; i++) {
-        bool found = false;
-        for (int j = 0; j < vulkan->available_device_extensions_count; j++) {
-            if (strcmp(vulkan->desired_device_extensions[i], vulkan->available_device_extensions[j].extensionName) == 0) {
-                found = true;
-                break;
-            }
+    // debug markers only show up under tools like renderdoc, and headless runs can go without a swapchain
+    const char *device_extensions[] = {
+        VK_EXT_DEBUG_MARKER_EXTENSION_NAME,
+        VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME,
+        VK_KHR_DEVICE_GROUP_EXTENSION_NAME,
+        VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME,
+        VK_KHR_DRIVER_PROPERTIES_EXTENSION_NAME,
+        VK_KHR_MAINTENANCE3_EXTENSION_NAME,
+        VK_KHR_SWAPCHAIN_EXTENSION_NAME,
+        VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME,
+    };
+    bool device_extensions_required[] = {false, false, false, false, false, false, !vulkan->headless, false};
+    uint32_t device_extensions_count = sizeof(device_extensions) / sizeof(*device_extensions);
+    bool descriptor_indexing = vulkan_query_descriptor_indexing(vulkan);
+
+    vulkan->desired_device_extensions_count = 0;
+    vulkan->desired_device_extensions =
+        (const char **)arena_allocate(&vulkan->arena, device_extensions_count * sizeof(char *));
+    for (uint32_t i = 0; i < device_extensions_count; i++) {
+        bool found = vulkan_extension_available(device_extensions[i], vulkan->available_device_extensions,
+                                                vulkan->available_device_extensions_count);
+        if (strcmp(device_extensions[i], VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME) == 0)
+            found = found && descriptor_indexing;
+        // a group of one gains nothing from device masks, and needs the instance half of the extension pair anyway
+        if (strcmp(device_extensions[i], VK_KHR_DEVICE_GROUP_EXTENSION_NAME) == 0)
+            found = found && vulkan->device_group_count > 1 && vulkan->vkEnumeratePhysicalDeviceGroupsKHR != NULL;
+        assert(found || !device_extensions_required[i]);
+        if (found)
+            vulkan->desired_device_extensions[vulkan->desired_device_extensions_count++] = device_extensions[i];
+    }
+    vulkan_extension_set_build(&vulkan->device_extension_set, vulkan->desired_device_extensions_count,
+                               vulkan->desired_device_extensions);
+}
+
+void vulkan_create_headless_surface(vulkan_t *vulkan) {
+    // no VK_EXT_headless_surface means we stay offscreen with a null surface
+    if (vulkan->vkCreateHeadlessSurfaceEXT == NULL)
+        return;
+
+    VkHeadlessSurfaceCreateInfoEXT surface_create_info = {
+        .sType = VK_STRUCTURE_TYPE_HEADLESS_SURFACE_CREATE_INFO_EXT,
+    };
+
+    VkResult result = vulkan->vkCreateHeadlessSurfaceEXT(vulkan->instance, &surface_create_info, vulkan->allocation_callbacks,
+                                                         &vulkan->surface);
+    assert(result == VK_SUCCESS && vulkan->surface != VK_NULL_HANDLE);
+}
+
+// returns the first family that has every required flag and none of the excluded ones, or UINT32_MAX
+static uint32_t vulkan_find_queue_family(vulkan_t *vulkan, VkQueueFlags required, VkQueueFlags excluded, bool present) {
+    for (uint32_t i = 0; i < vulkan->queue_families_count; i++) {
+        VkQueueFlags flags = vulkan->queue_families[i].queueFlags;
+        if ((flags & required) != required || (flags & excluded) != 0)
+            continue;
+
+        if (present && vulkan->surface != VK_NULL_HANDLE) {
+            VkBool32 presentation_supported = VK_FALSE;
+            VkResult res = vulkan->vkGetPhysicalDeviceSurfaceSupportKHR(vulkan->physical_device, i, vulkan->surface,
+                                                                        &presentation_supported);
+            if (res != VK_SUCCESS || !presentation_supported)
+                continue;
         }
-        assert(found);
+        return i;
     }
+    return UINT32_MAX;
+}
+
+// takes the family's next unused queue, or shares its last one once the family runs out
+static void vulkan_select_queue(vulkan_t *vulkan, vulkan_queue_type_t type, uint32_t family_index, float priority) {
+    queue_info_t *info = &vulkan->queue_infos[family_index];
+    uint32_t queue_index = info->queue_count;
+    if (queue_index < vulkan->queue_families[family_index].queueCount) {
+        info->priorities[queue_index] = priority;
+        info->queue_count++;
+    } else {
+        queue_index--;
+    }
+
+    vulkan->queues[type] = (vulkan_queue_t){
+        .family_index = family_index,
+        .queue_index = queue_index,
+    };
 }
 
 void vulkan_create_logical_device(vulkan_t *vulkan) {
-    vkGetPhysicalDeviceQueueFamilyProperties(vulkan->physical_device, &vulkan->queue_families_count, NULL);
+    vulkan->vkGetPhysicalDeviceQueueFamilyProperties(vulkan->physical_device, &vulkan->queue_families_count, NULL);
     assert(vulkan->queue_families_count > 0);
 
-    vulkan->queue_families = (VkQueueFamilyProperties *)malloc(sizeof(VkQueueFamilyProperties) * vulkan->queue_families_count);
-    vkGetPhysicalDeviceQueueFamilyProperties(vulkan->physical_device, &vulkan->queue_families_count, vulkan->queue_families);
+    vulkan->queue_families = (VkQueueFamilyProperties *)arena_allocate(
+        &vulkan->arena, sizeof(VkQueueFamilyProperties) * vulkan->queue_families_count);
+    vulkan->vkGetPhysicalDeviceQueueFamilyProperties(vulkan->physical_device, &vulkan->queue_families_count,
+                                                     vulkan->queue_families);
     assert(vulkan->queue_families_count > 0);
 
-    VkQueueFlags desired_capabilities = VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT;
-    vulkan->queue_infos = (queue_info_t *)malloc(sizeof(queue_info_t) * vulkan->queue_families_count);
+    vulkan->queue_infos =
+        (queue_info_t *)arena_allocate(&vulkan->arena, sizeof(queue_info_t) * vulkan->queue_families_count);
     for (uint32_t i = 0; i < vulkan->queue_families_count; i++) {
-        VkQueueFamilyProperties queue_family = vulkan->queue_families[i];
-        assert((queue_family.queueFlags & desired_capabilities) == desired_capabilities);
-
-        VkBool32 presentation_supported = VK_FALSE;
-        VkResult res = vkGetPhysicalDeviceSurfaceSupportKHR(vulkan->physical_device, i, vulkan->surface, &presentation_supported);
-        assert(res == VK_SUCCESS && presentation_supported);
-
         vulkan->queue_infos[i].family_index = i;
-        vulkan->queue_infos[i].queue_count = queue_family.queueCount;
-        vulkan->queue_infos[i].priorities = (float *)malloc(sizeof(float) * queue_family.queueCount);
-        for (int j = 0; j < queue_family.queueCount; j++)
-            vulkan->queue_infos[i].priorities[j] = 1.0 / ((float)queue_family.queueCount);
+        vulkan->queue_infos[i].queue_count = 0;
+        vulkan->queue_infos[i].priorities =
+            (float *)arena_allocate(&vulkan->arena, sizeof(float) * vulkan->queue_families[i].queueCount);
     }
 
-    vulkan->queue_create_infos = (VkDeviceQueueCreateInfo *)malloc(sizeof(VkDeviceQueueCreateInfo) * vulkan->queue_families_count);
-    for (int i = 0; i < vulkan->queue_families_count; i++) {
+    // graphics also presents, so swapchain images never need an ownership transfer between families
+    uint32_t graphics_family = vulkan_find_queue_family(vulkan, VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT, 0, true);
+    if (graphics_family == UINT32_MAX)
+        graphics_family = vulkan_find_queue_family(vulkan, VK_QUEUE_GRAPHICS_BIT, 0, true);
+    assert(graphics_family != UINT32_MAX);
+
+    // async compute wants a family without graphics, transfer one with neither (usually the copy engine)
+    uint32_t compute_family = vulkan_find_queue_family(vulkan, VK_QUEUE_COMPUTE_BIT, VK_QUEUE_GRAPHICS_BIT, false);
+    if (compute_family == UINT32_MAX)
+        compute_family = vulkan_find_queue_family(vulkan, VK_QUEUE_COMPUTE_BIT, 0, false);
+    assert(compute_family != UINT32_MAX);
+
+    uint32_t transfer_family =
+        vulkan_find_queue_family(vulkan, VK_QUEUE_TRANSFER_BIT, VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT, false);
+    if (transfer_family == UINT32_MAX)
+        transfer_family = compute_family;
+
+    // graphics drives frame latency, so it outranks async compute, which outranks background uploads
+    vulkan_select_queue(vulkan, VULKAN_QUEUE_GRAPHICS, graphics_family, 1.0f);
+    vulkan_select_queue(vulkan, VULKAN_QUEUE_COMPUTE, compute_family, 0.75f);
+    vulkan_select_queue(vulkan, VULKAN_QUEUE_TRANSFER, transfer_family, 0.5f);
+
+    vulkan->queue_create_infos = (VkDeviceQueueCreateInfo *)arena_allocate(
+        &vulkan->arena, sizeof(VkDeviceQueueCreateInfo) * vulkan->queue_families_count);
+    uint32_t queue_create_infos_count = 0;
+    for (uint32_t i = 0; i < vulkan->queue_families_count; i++) {
         queue_info_t info = vulkan->queue_infos[i];
-        vulkan->queue_create_infos[i] = (VkDeviceQueueCreateInfo){
+        if (info.queue_count == 0)
+            continue;
+
+        vulkan->queue_create_infos[queue_create_infos_count++] = (VkDeviceQueueCreateInfo){
             .sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
             .queueFamilyIndex = info.family_index,
             .queueCount = info.queue_count,
@@ -194,64 +407,97 @@ void vulkan_create_logical_device(vulkan_t *vulkan) {
         };
     }
 
+    vulkan->timeline_semaphore_features = (VkPhysicalDeviceTimelineSemaphoreFeaturesKHR){
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES_KHR,
+        .timelineSemaphore = VK_TRUE,
+    };
+
+    // feature structs are chained front to back, each only when its extension made it into the set
+    void *features = NULL;
+    if (vulkan_device_extension_enabled(vulkan, VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME)) {
+        vulkan->descriptor_indexing_features.pNext = features;
+        features = &vulkan->descriptor_indexing_features;
+    }
+    if (vulkan_device_extension_enabled(vulkan, VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME)) {
+        vulkan->timeline_semaphore_features.pNext = features;
+        features = &vulkan->timeline_semaphore_features;
+    }
+
+    // one logical device over the whole group, commands then run on every device unless a device mask narrows them
+    if (vulkan_device_extension_enabled(vulkan, VK_KHR_DEVICE_GROUP_EXTENSION_NAME)) {
+        vulkan->device_group_create_info = (VkDeviceGroupDeviceCreateInfoKHR){
+            .sType = VK_STRUCTURE_TYPE_DEVICE_GROUP_DEVICE_CREATE_INFO_KHR,
+            .pNext = features,
+            .physicalDeviceCount = vulkan->device_group_count,
+            .pPhysicalDevices = vulkan->device_group_devices,
+        };
+        features = &vulkan->device_group_create_info;
+    }
+
     vulkan->device_create_info = (VkDeviceCreateInfo){
         .sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO,
-        .queueCreateInfoCount = vulkan->queue_families_count,
+        .pNext = features,
+        .queueCreateInfoCount = queue_create_infos_count,
         .pQueueCreateInfos = vulkan->queue_create_infos,
         .enabledExtensionCount = vulkan->desired_device_extensions_count,
         .ppEnabledExtensionNames = vulkan->desired_device_extensions,
         .pEnabledFeatures = &vulkan->device_features,
     };
 
-    VkResult result = vkCreateDevice(vulkan->physical_device, &vulkan->device_create_info, NULL, &vulkan->logical_device);
+    VkResult result = vulkan->vkCreateDevice(vulkan->physical_device, &vulkan->device_create_info, vulkan->allocation_callbacks,
+                                             &vulkan->logical_device);
     assert(result == VK_SUCCESS && vulkan->logical_device != VK_NULL_HANDLE);
 }
 
 void vulkan_load_device_level_functions(vulkan_t *vulkan) {
-#define DEVICE_LEVEL_VULKAN_FUNCTION(name)                                                 \
+#define LOAD_DEVICE_LEVEL_FUNCTION(name)                                                   \
     vulkan->name = (PFN_##name)vulkan->vkGetDeviceProcAddr(vulkan->logical_device, #name); \
     assert(vulkan->name);
 
-    DEVICE_LEVEL_VULKAN_FUNCTION(vkCreateBuffer)
-    DEVICE_LEVEL_VULKAN_FUNCTION(vkDestroyDevice)
-    DEVICE_LEVEL_VULKAN_FUNCTION(vkDeviceWaitIdle)
-    DEVICE_LEVEL_VULKAN_FUNCTION(vkGetBufferMemoryRequirements)
-    DEVICE_LEVEL_VULKAN_FUNCTION(vkGetDeviceQueue)
+    VULKAN_DEVICE_LEVEL_FUNCTIONS(LOAD_DEVICE_LEVEL_FUNCTION)
 
-#undef DEVICE_LEVEL_VULKAN_FUNCTION
+#undef LOAD_DEVICE_LEVEL_FUNCTION
 }
 
+void vulkan_get_device_queues(vulkan_t *vulkan) {
+    for (uint32_t i = 0; i < VULKAN_QUEUE_TYPE_COUNT; i++)
+        vulkan->vkGetDeviceQueue(vulkan->logical_device, vulkan->queues[i].family_index, vulkan->queues[i].queue_index,
+                                 &vulkan->queues[i].queue);
+}
+
+// device-level commands of instance extensions (debug utils labels) count as enabled through the instance set
 void vulkan_load_device_level_extension_functions(vulkan_t *vulkan) {
-#define DEVICE_LEVEL_VULKAN_FUNCTION_FROM_EXTENSION(name, extension)                               \
-    for (int i = 0; i < vulkan->available_device_extensions_count; i++) {                          \
-        if (strcmp(#extension, vulkan->available_device_extensions[i].extensionName) == 0) {       \
-            vulkan->name = (PFN_##name)vulkan->vkGetDeviceProcAddr(vulkan->logical_device, #name); \
-            assert(vulkan->name);                                                                  \
-        }                                                                                          \
+#define LOAD_DEVICE_LEVEL_EXTENSION_FUNCTION(name, extension)                                  \
+    if (vulkan_device_extension_enabled(vulkan, extension) ||                                  \
+        vulkan_instance_extension_enabled(vulkan, extension)) {                                \
+        vulkan->name = (PFN_##name)vulkan->vkGetDeviceProcAddr(vulkan->logical_device, #name); \
+        assert(vulkan->name);                                                                  \
     }
 
-    DEVICE_LEVEL_VULKAN_FUNCTION_FROM_EXTENSION(vkAcquireNextImageKHR, VK_KHR_SWAPCHAIN_EXTENSION_NAME)
-    DEVICE_LEVEL_VULKAN_FUNCTION_FROM_EXTENSION(vkCreateSwapchainKHR, VK_KHR_SWAPCHAIN_EXTENSION_NAME)
-    DEVICE_LEVEL_VULKAN_FUNCTION_FROM_EXTENSION(vkDestroySwapchainKHR, VK_KHR_SWAPCHAIN_EXTENSION_NAME)
-    DEVICE_LEVEL_VULKAN_FUNCTION_FROM_EXTENSION(vkGetSwapchainImagesKHR, VK_KHR_SWAPCHAIN_EXTENSION_NAME)
-    DEVICE_LEVEL_VULKAN_FUNCTION_FROM_EXTENSION(vkQueuePresentKHR, VK_KHR_SWAPCHAIN_EXTENSION_NAME)
+    VULKAN_DEVICE_LEVEL_EXTENSION_FUNCTIONS(LOAD_DEVICE_LEVEL_EXTENSION_FUNCTION)
 
-#undef DEVICE_LEVEL_VULKAN_FUNCTION_FROM_EXTENSION
+#undef LOAD_DEVICE_LEVEL_EXTENSION_FUNCTION
 }
 
 void vulkan_free_resources(vulkan_t *vulkan) {
-    vkDestroyDevice(vulkan->logical_device, NULL);
-    vkDestroyInstance(vulkan->instance, NULL);
+    if (vulkan->pipeline_cache != VK_NULL_HANDLE)
+        pipeline_cache_free(vulkan);
+    vulkan->vkDestroyDevice(vulkan->logical_device, vulkan->allocation_callbacks);
+    if (vulkan->headless && vulkan->surface != VK_NULL_HANDLE)
+        vulkan->vkDestroySurfaceKHR(vulkan->instance, vulkan->surface, vulkan->allocation_callbacks);
+    vulkan->vkDestroyInstance(vulkan->instance, vulkan->allocation_callbacks);
     vulkan->logical_device = VK_NULL_HANDLE;
+    vulkan->surface = VK_NULL_HANDLE;
     vulkan->instance = VK_NULL_HANDLE;
-
-    for (int i = 0; i < vulkan->queue_families_count; i++)
-        free(vulkan->queue_infos[i].priorities);
-    free(vulkan->queue_infos);
-    free(vulkan->queue_create_infos);
-    free(vulkan->queue_families);
-    free(vulkan->available_device_extensions);
-    free(vulkan->available_instance_extensions);
-    free(vulkan->desired_device_extensions);
-    free(vulkan->available_devices);
+    vulkan->allocation_callbacks = NULL;
+
+    arena_free(&vulkan->arena);
+    vulkan->queue_infos = NULL;
+    vulkan->queue_create_infos = NULL;
+    vulkan->queue_families = NULL;
+    vulkan->available_device_extensions = NULL;
+    vulkan->available_instance_extensions = NULL;
+    vulkan->enabled_instance_extensions = NULL;
+    vulkan->desired_device_extensions = NULL;
+    vulkan->available_devices = NULL;
 }
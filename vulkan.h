@@ -1,8 +1,180 @@
 #ifndef VULKAN_H
 #define VULKAN_H
 
+#include "arena.h"
+#include "host_memory.h"
+#include <stdbool.h>
 #include <vulkan/vulkan.h>
-#include <vulkan/vulkan_metal.h>
+
+// every function the app calls, expanded into the dispatch tables below and into the loaders in vulkan.c
+#define VULKAN_GLOBAL_LEVEL_FUNCTIONS(X)      \
+    X(vkCreateInstance)                       \
+    X(vkEnumerateInstanceExtensionProperties) \
+    X(vkEnumerateInstanceLayerProperties)
+
+#define VULKAN_INSTANCE_LEVEL_FUNCTIONS(X)      \
+    X(vkCreateDevice)                           \
+    X(vkDestroyInstance)                        \
+    X(vkEnumerateDeviceExtensionProperties)     \
+    X(vkEnumeratePhysicalDevices)               \
+    X(vkGetDeviceProcAddr)                      \
+    X(vkGetPhysicalDeviceFeatures)              \
+    X(vkGetPhysicalDeviceMemoryProperties)      \
+    X(vkGetPhysicalDeviceProperties)            \
+    X(vkGetPhysicalDeviceQueueFamilyProperties)
+
+#define VULKAN_INSTANCE_LEVEL_EXTENSION_FUNCTIONS(X)                                             \
+    /* VK_EXT_debug_utils */                                                                     \
+    X(vkCreateDebugUtilsMessengerEXT, VK_EXT_DEBUG_UTILS_EXTENSION_NAME)                         \
+    X(vkDestroyDebugUtilsMessengerEXT, VK_EXT_DEBUG_UTILS_EXTENSION_NAME)                        \
+    X(vkSubmitDebugUtilsMessageEXT, VK_EXT_DEBUG_UTILS_EXTENSION_NAME)                           \
+    /* VK_EXT_debug_report */                                                                    \
+    X(vkCreateDebugReportCallbackEXT, VK_EXT_DEBUG_REPORT_EXTENSION_NAME)                        \
+    X(vkDebugReportMessageEXT, VK_EXT_DEBUG_REPORT_EXTENSION_NAME)                               \
+    X(vkDestroyDebugReportCallbackEXT, VK_EXT_DEBUG_REPORT_EXTENSION_NAME)                       \
+    /* VK_EXT_headless_surface */                                                                \
+    X(vkCreateHeadlessSurfaceEXT, VK_EXT_HEADLESS_SURFACE_EXTENSION_NAME)                        \
+    /* VK_KHR_device_group_creation */                                                           \
+    X(vkEnumeratePhysicalDeviceGroupsKHR, VK_KHR_DEVICE_GROUP_CREATION_EXTENSION_NAME)           \
+    /* VK_KHR_get_physical_device_properties2 */                                                 \
+    X(vkGetPhysicalDeviceFeatures2KHR, VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME)   \
+    X(vkGetPhysicalDeviceProperties2KHR, VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME) \
+    /* VK_KHR_surface */                                                                         \
+    X(vkDestroySurfaceKHR, VK_KHR_SURFACE_EXTENSION_NAME)                                        \
+    X(vkGetPhysicalDeviceSurfaceCapabilitiesKHR, VK_KHR_SURFACE_EXTENSION_NAME)                  \
+    X(vkGetPhysicalDeviceSurfaceFormatsKHR, VK_KHR_SURFACE_EXTENSION_NAME)                       \
+    X(vkGetPhysicalDeviceSurfacePresentModesKHR, VK_KHR_SURFACE_EXTENSION_NAME)                  \
+    X(vkGetPhysicalDeviceSurfaceSupportKHR, VK_KHR_SURFACE_EXTENSION_NAME)
+
+#define VULKAN_DEVICE_LEVEL_FUNCTIONS(X) \
+    X(vkAllocateCommandBuffers)          \
+    X(vkAllocateDescriptorSets)          \
+    X(vkAllocateMemory)                  \
+    X(vkBeginCommandBuffer)              \
+    X(vkBindBufferMemory)                \
+    X(vkBindImageMemory)                 \
+    X(vkCmdBeginRenderPass)              \
+    X(vkCmdBindDescriptorSets)           \
+    X(vkCmdBindIndexBuffer)              \
+    X(vkCmdBindPipeline)                 \
+    X(vkCmdBindVertexBuffers)            \
+    X(vkCmdClearColorImage)              \
+    X(vkCmdCopyBuffer)                   \
+    X(vkCmdCopyBufferToImage)            \
+    X(vkCmdCopyImageToBuffer)            \
+    X(vkCmdDispatch)                     \
+    X(vkCmdDrawIndexed)                  \
+    X(vkCmdDrawIndexedIndirect)          \
+    X(vkCmdEndRenderPass)                \
+    X(vkCmdExecuteCommands)              \
+    X(vkCmdFillBuffer)                   \
+    X(vkCmdPipelineBarrier)              \
+    X(vkCmdPushConstants)                \
+    X(vkCmdResetQueryPool)               \
+    X(vkCmdWriteTimestamp)               \
+    X(vkCreateBuffer)                    \
+    X(vkCreateCommandPool)               \
+    X(vkCreateComputePipelines)          \
+    X(vkCreateDescriptorPool)            \
+    X(vkCreateDescriptorSetLayout)       \
+    X(vkCreateFence)                     \
+    X(vkCreateFramebuffer)               \
+    X(vkCreateGraphicsPipelines)         \
+    X(vkCreateImage)                     \
+    X(vkCreateImageView)                 \
+    X(vkCreatePipelineCache)             \
+    X(vkCreatePipelineLayout)            \
+    X(vkCreateQueryPool)                 \
+    X(vkCreateRenderPass)                \
+    X(vkCreateSampler)                   \
+    X(vkCreateSemaphore)                 \
+    X(vkCreateShaderModule)              \
+    X(vkDestroyBuffer)                   \
+    X(vkDestroyCommandPool)              \
+    X(vkDestroyDescriptorPool)           \
+    X(vkDestroyDescriptorSetLayout)      \
+    X(vkDestroyDevice)                   \
+    X(vkDestroyFence)                    \
+    X(vkDestroyFramebuffer)              \
+    X(vkDestroyImage)                    \
+    X(vkDestroyImageView)                \
+    X(vkDestroyPipeline)                 \
+    X(vkDestroyPipelineCache)            \
+    X(vkDestroyPipelineLayout)           \
+    X(vkDestroyQueryPool)                \
+    X(vkDestroyRenderPass)               \
+    X(vkDestroySampler)                  \
+    X(vkDestroySemaphore)                \
+    X(vkDestroyShaderModule)             \
+    X(vkDeviceWaitIdle)                  \
+    X(vkEndCommandBuffer)                \
+    X(vkFreeCommandBuffers)              \
+    X(vkFreeMemory)                      \
+    X(vkGetBufferMemoryRequirements)     \
+    X(vkGetDeviceQueue)                  \
+    X(vkGetFenceStatus)                  \
+    X(vkGetImageMemoryRequirements)      \
+    X(vkGetPipelineCacheData)            \
+    X(vkGetQueryPoolResults)             \
+    X(vkMapMemory)                       \
+    X(vkMergePipelineCaches)             \
+    X(vkQueueSubmit)                     \
+    X(vkResetCommandPool)                \
+    X(vkResetDescriptorPool)             \
+    X(vkResetFences)                     \
+    X(vkUnmapMemory)                     \
+    X(vkUpdateDescriptorSets)            \
+    X(vkWaitForFences)
+
+#define VULKAN_DEVICE_LEVEL_EXTENSION_FUNCTIONS(X)                                         \
+    /* VK_EXT_debug_utils, an instance extension whose labels are device-level commands */ \
+    X(vkCmdBeginDebugUtilsLabelEXT, VK_EXT_DEBUG_UTILS_EXTENSION_NAME)                     \
+    X(vkCmdEndDebugUtilsLabelEXT, VK_EXT_DEBUG_UTILS_EXTENSION_NAME)                       \
+    X(vkCmdInsertDebugUtilsLabelEXT, VK_EXT_DEBUG_UTILS_EXTENSION_NAME)                    \
+    X(vkQueueBeginDebugUtilsLabelEXT, VK_EXT_DEBUG_UTILS_EXTENSION_NAME)                   \
+    X(vkQueueEndDebugUtilsLabelEXT, VK_EXT_DEBUG_UTILS_EXTENSION_NAME)                     \
+    X(vkQueueInsertDebugUtilsLabelEXT, VK_EXT_DEBUG_UTILS_EXTENSION_NAME)                  \
+    X(vkSetDebugUtilsObjectNameEXT, VK_EXT_DEBUG_UTILS_EXTENSION_NAME)                     \
+    X(vkSetDebugUtilsObjectTagEXT, VK_EXT_DEBUG_UTILS_EXTENSION_NAME)                      \
+    /* VK_KHR_device_group */                                                              \
+    X(vkCmdDispatchBaseKHR, VK_KHR_DEVICE_GROUP_EXTENSION_NAME)                            \
+    X(vkCmdSetDeviceMaskKHR, VK_KHR_DEVICE_GROUP_EXTENSION_NAME)                           \
+    /* VK_KHR_draw_indirect_count */                                                       \
+    X(vkCmdDrawIndexedIndirectCountKHR, VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME)         \
+    /* VK_KHR_swapchain */                                                                 \
+    X(vkAcquireNextImageKHR, VK_KHR_SWAPCHAIN_EXTENSION_NAME)                              \
+    X(vkCreateSwapchainKHR, VK_KHR_SWAPCHAIN_EXTENSION_NAME)                               \
+    X(vkDestroySwapchainKHR, VK_KHR_SWAPCHAIN_EXTENSION_NAME)                              \
+    X(vkGetSwapchainImagesKHR, VK_KHR_SWAPCHAIN_EXTENSION_NAME)                            \
+    X(vkQueuePresentKHR, VK_KHR_SWAPCHAIN_EXTENSION_NAME)                                  \
+    /* VK_KHR_timeline_semaphore */                                                        \
+    X(vkGetSemaphoreCounterValueKHR, VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME)             \
+    X(vkSignalSemaphoreKHR, VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME)                      \
+    X(vkWaitSemaphoresKHR, VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME)
+
+#define VULKAN_FUNCTION_POINTER(name) PFN_##name name;
+#define VULKAN_EXTENSION_FUNCTION_POINTER(name, extension) PFN_##name name;
+
+// functions dispatched on the instance or a physical device, extension functions stay NULL unless enabled
+typedef struct {
+    VULKAN_INSTANCE_LEVEL_FUNCTIONS(VULKAN_FUNCTION_POINTER)
+    VULKAN_INSTANCE_LEVEL_EXTENSION_FUNCTIONS(VULKAN_EXTENSION_FUNCTION_POINTER)
+} vulkan_instance_table_t;
+
+// resolved through vkGetDeviceProcAddr, so calls go straight to the driver instead of the loader trampoline
+typedef struct {
+    VULKAN_DEVICE_LEVEL_FUNCTIONS(VULKAN_FUNCTION_POINTER)
+    VULKAN_DEVICE_LEVEL_EXTENSION_FUNCTIONS(VULKAN_EXTENSION_FUNCTION_POINTER)
+} vulkan_device_table_t;
+
+#define VULKAN_EXTENSION_SET_CAPACITY 64
+
+// open-addressed set of enabled extension names, built once so loading functions never scans name lists
+typedef struct {
+    uint32_t count;
+    uint64_t hashes[VULKAN_EXTENSION_SET_CAPACITY];
+    const char *names[VULKAN_EXTENSION_SET_CAPACITY];
+} vulkan_extension_set_t;
 
 typedef struct {
     uint32_t family_index;
@@ -10,23 +182,50 @@ typedef struct {
     float *priorities;
 } queue_info_t;
 
+typedef enum {
+    VULKAN_QUEUE_GRAPHICS,
+    VULKAN_QUEUE_COMPUTE,
+    VULKAN_QUEUE_TRANSFER,
+    VULKAN_QUEUE_TYPE_COUNT,
+} vulkan_queue_type_t;
+
+// queue types without a family of their own share a family, and share a queue once the family runs out
+typedef struct {
+    uint32_t family_index;
+    uint32_t queue_index;
+    VkQueue queue;
+} vulkan_queue_t;
+
 typedef struct {
 
     VkInstance instance;
     VkDevice logical_device;
     VkSurfaceKHR surface;
     VkPresentModeKHR present_mode;
+    bool headless;
+
+    // init-time bookkeeping lives in the arena, and every vulkan object is created through the counting callbacks
+    arena_t arena;
+    host_memory_t host_memory;
+    const VkAllocationCallbacks *allocation_callbacks;
 
     // extension information
+    uint32_t enabled_instance_extensions_count;
+    const char **enabled_instance_extensions;
     uint32_t desired_device_extensions_count;
     const char **desired_device_extensions;
     uint32_t available_instance_extensions_count;
     VkExtensionProperties *available_instance_extensions;
+    vulkan_extension_set_t instance_extension_set;
+    vulkan_extension_set_t device_extension_set;
 
-    // physical device information
+    // physical device information, the override is an enumeration index or part of a device name
+    const char *device_override;
     uint32_t device_count;
     VkPhysicalDevice *available_devices;
     VkPhysicalDevice physical_device;
+    uint32_t device_group_count;
+    VkPhysicalDevice device_group_devices[VK_MAX_DEVICE_GROUP_SIZE];
     VkPhysicalDeviceProperties device_properties;
     VkPhysicalDeviceFeatures device_features;
     uint32_t available_device_extensions_count;
@@ -38,57 +237,34 @@ typedef struct {
     queue_info_t *queue_infos;
     VkDeviceQueueCreateInfo *queue_create_infos;
     VkDeviceCreateInfo device_create_info;
+    VkDeviceGroupDeviceCreateInfoKHR device_group_create_info;
+    VkPhysicalDeviceTimelineSemaphoreFeaturesKHR timeline_semaphore_features;
+    VkPhysicalDeviceDescriptorIndexingFeaturesEXT descriptor_indexing_features;
+    VkPhysicalDeviceDescriptorIndexingPropertiesEXT descriptor_indexing_properties;
+    vulkan_queue_t queues[VULKAN_QUEUE_TYPE_COUNT];
+
+    // pipeline cache information
+    const char *pipeline_cache_path;
+    VkPipelineCache pipeline_cache;
 
     // global-level functions
-    PFN_vkCreateInstance vkCreateInstance;
-    PFN_vkEnumerateInstanceExtensionProperties vkEnumerateInstanceExtensionProperties;
-    PFN_vkEnumerateInstanceLayerProperties vkEnumerateInstanceLayerProperties;
-
-    // instance-level functions
-    PFN_vkCreateDevice vkCreateDevice;
-    PFN_vkDestroyInstance vkDestroyInstance;
-    PFN_vkEnumerateDeviceExtensionProperties vkEnumerateDeviceExtensionProperties;
-    PFN_vkEnumeratePhysicalDevices vkEnumeratePhysicalDevices;
-    PFN_vkGetDeviceProcAddr vkGetDeviceProcAddr;
-    PFN_vkGetPhysicalDeviceFeatures vkGetPhysicalDeviceFeatures;
-    PFN_vkGetPhysicalDeviceProperties vkGetPhysicalDeviceProperties;
-    PFN_vkGetPhysicalDeviceQueueFamilyProperties vkGetPhysicalDeviceQueueFamilyProperties;
-
-    // instance-level extension functions
-    // VK_EXT_debug_utils
-    PFN_vkCmdBeginDebugUtilsLabelEXT vkCmdBeginDebugUtilsLabelEXT;
-    PFN_vkCmdEndDebugUtilsLabelEXT vkCmdEndDebugUtilsLabelEXT;
-    PFN_vkCmdInsertDebugUtilsLabelEXT vkCmdInsertDebugUtilsLabelEXT;
-    PFN_vkCreateDebugUtilsMessengerEXT vkCreateDebugUtilsMessengerEXT;
-    PFN_vkDestroyDebugUtilsMessengerEXT vkDestroyDebugUtilsMessengerEXT;
-    PFN_vkQueueBeginDebugUtilsLabelEXT vkQueueBeginDebugUtilsLabelEXT;
-    PFN_vkQueueEndDebugUtilsLabelEXT vkQueueEndDebugUtilsLabelEXT;
-    PFN_vkQueueInsertDebugUtilsLabelEXT vkQueueInsertDebugUtilsLabelEXT;
-    PFN_vkSetDebugUtilsObjectNameEXT vkSetDebugUtilsObjectNameEXT;
-    PFN_vkSetDebugUtilsObjectTagEXT vkSetDebugUtilsObjectTagEXT;
-    PFN_vkSubmitDebugUtilsMessageEXT vkSubmitDebugUtilsMessageEXT;
-    // VK_EXT_debug_report
-    PFN_vkCreateDebugReportCallbackEXT vkCreateDebugReportCallbackEXT;
-    PFN_vkDebugReportMessageEXT vkDebugReportMessageEXT;
-    PFN_vkDestroyDebugReportCallbackEXT vkDestroyDebugReportCallbackEXT;
-    // VK_KHR_surface
-    PFN_vkGetPhysicalDeviceSurfacePresentModesKHR vkGetPhysicalDeviceSurfacePresentModesKHR;
-    PFN_vkGetPhysicalDeviceSurfaceSupportKHR vkGetPhysicalDeviceSurfaceSupportKHR;
-
-    // device-level functions
-    PFN_vkCreateBuffer vkCreateBuffer;
-    PFN_vkDestroyDevice vkDestroyDevice;
-    PFN_vkDeviceWaitIdle vkDeviceWaitIdle;
-    PFN_vkGetBufferMemoryRequirements vkGetBufferMemoryRequirements;
-    PFN_vkGetDeviceQueue vkGetDeviceQueue;
-
-    // device-level extension functions
-    PFN_vkAcquireNextImageKHR vkAcquireNextImageKHR;
-    PFN_vkCreateSwapchainKHR vkCreateSwapchainKHR;
-    PFN_vkDestroySwapchainKHR vkDestroySwapchainKHR;
-    PFN_vkGetSwapchainImagesKHR vkGetSwapchainImagesKHR;
-    PFN_vkQueuePresentKHR vkQueuePresentKHR;
+    VULKAN_GLOBAL_LEVEL_FUNCTIONS(VULKAN_FUNCTION_POINTER)
 
+    // dispatch tables, whose members are also reachable directly as vulkan->vkName
+    union {
+        vulkan_instance_table_t instance_table;
+        struct {
+            VULKAN_INSTANCE_LEVEL_FUNCTIONS(VULKAN_FUNCTION_POINTER)
+            VULKAN_INSTANCE_LEVEL_EXTENSION_FUNCTIONS(VULKAN_EXTENSION_FUNCTION_POINTER)
+        };
+    };
+    union {
+        vulkan_device_table_t device_table;
+        struct {
+            VULKAN_DEVICE_LEVEL_FUNCTIONS(VULKAN_FUNCTION_POINTER)
+            VULKAN_DEVICE_LEVEL_EXTENSION_FUNCTIONS(VULKAN_EXTENSION_FUNCTION_POINTER)
+        };
+    };
 } vulkan_t;
 
 void vulkan_load_global_level_functions(vulkan_t *vulkan);
@@ -96,9 +272,14 @@ void vulkan_create_instance(vulkan_t *vulkan);
 void vulkan_load_instance_level_functions(vulkan_t *vulkan);
 void vulkan_load_instance_level_extension_functions(vulkan_t *vulkan);
 void vulkan_create_physical_device(vulkan_t *vulkan);
+void vulkan_create_headless_surface(vulkan_t *vulkan);
 void vulkan_create_logical_device(vulkan_t *vulkan);
 void vulkan_load_device_level_functions(vulkan_t *vulkan);
+void vulkan_get_device_queues(vulkan_t *vulkan);
 void vulkan_load_device_level_extension_functions(vulkan_t *vulkan);
 void vulkan_free_resources(vulkan_t *vulkan);
 
+bool vulkan_instance_extension_enabled(vulkan_t *vulkan, const char *extension);
+bool vulkan_device_extension_enabled(vulkan_t *vulkan, const char *extension);
+
 #endif // VULKAN_H